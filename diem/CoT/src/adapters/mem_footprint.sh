@@ -0,0 +1,222 @@
+#!/bin/sh
+# Measures memory footprint of adapters and of the server.
+#
+# Starts N instances of memtest_adapter against a running oBIX server, samples
+# RSS, PSS and USS (private memory) of every adapter and of the server, and
+# prints a JSON summary: memory used by one adapter and the growth of the
+# server per registered device. Optional budgets make the script fail when
+# the footprint grows, so it can be used to catch regressions.
+
+usage()
+{
+	echo "Usage: mem_footprint.sh [options] <cfg> <count>"
+	echo "where: "
+	echo "    <cfg>   - Address of the config file for adapters;"
+	echo "    <count> - Number of adapters to start."
+	echo "Options:"
+	echo "    -s <pid|name> - Server process (default: obix.fcgi);"
+	echo "    -x <path>     - Adapter binary (default: ./memtest_adapter);"
+	echo "    -m <memi>     - Memory allocated by each adapter permanently;"
+	echo "    -M <memd>     - Memory allocated by each adapter periodically;"
+	echo "    -i <sec>      - Sampling interval (default: 1);"
+	echo "    -w <sec>      - Sampling time after all adapters are started"
+	echo "                    (default: 10);"
+	echo "    -t <sec>      - Time to wait for each adapter to register"
+	echo "                    (default: 10);"
+	echo "    -o <file>     - Write all samples to CSV file;"
+	echo "    -A <kB>       - Fail if one adapter uses more private memory;"
+	echo "    -D <bytes>    - Fail if the server grows more per device."
+}
+
+SERVER="obix.fcgi"
+ADAPTER="./memtest_adapter"
+MEM_CONST=0
+MEM_VAR=0
+INTERVAL=1
+SETTLE=10
+START_TIMEOUT=10
+CSV=""
+ADAPTER_BUDGET=""
+DEVICE_BUDGET=""
+
+while getopts "s:x:m:M:i:w:t:o:A:D:h" OPT; do
+	case $OPT in
+	s) SERVER=$OPTARG ;;
+	x) ADAPTER=$OPTARG ;;
+	m) MEM_CONST=$OPTARG ;;
+	M) MEM_VAR=$OPTARG ;;
+	i) INTERVAL=$OPTARG ;;
+	w) SETTLE=$OPTARG ;;
+	t) START_TIMEOUT=$OPTARG ;;
+	o) CSV=$OPTARG ;;
+	A) ADAPTER_BUDGET=$OPTARG ;;
+	D) DEVICE_BUDGET=$OPTARG ;;
+	*) usage; exit 1 ;;
+	esac
+done
+shift $(( $OPTIND - 1 ))
+
+if [ $# != 2 ]; then
+	echo "Wrong number input arguments!"
+	usage
+	exit 1
+fi
+CONFIG=$1
+COUNT=$2
+
+# find the server process
+case $SERVER in
+	*[!0-9]*) SERVER_PID=$(pidof -s "$SERVER") ;;
+	*) SERVER_PID=$SERVER ;;
+esac
+if [ -z "$SERVER_PID" ] || [ ! -d /proc/$SERVER_PID ]; then
+	echo "Server process \"$SERVER\" is not found. Start the server first."
+	exit 1
+fi
+
+# prints "rss pss uss dirty" of the process in kB, or nothing if it is not
+# running; dirty is the private modified memory (mostly heap)
+sample()
+{
+	if [ -r /proc/$1/smaps_rollup ]; then
+		FILE=/proc/$1/smaps_rollup
+	else
+		# older kernels: sum up all mappings
+		FILE=/proc/$1/smaps
+	fi
+	awk '/^Rss:/ {rss += $2}
+	     /^Pss:/ {pss += $2}
+	     /^Private_(Clean|Dirty):/ {uss += $2}
+	     /^Private_Dirty:/ {dirty += $2}
+	     END {if (NR > 0) print rss + 0, pss + 0, uss + 0, dirty + 0}' \
+		$FILE 2> /dev/null
+}
+
+# appends a sample of the process to the CSV file
+record()
+{
+	if [ -n "$CSV" ]; then
+		echo "$(date +%s),$1,$(echo $2 | tr ' ' ',')" >> "$CSV"
+	fi
+}
+
+WORK_DIR=$(mktemp -d /tmp/mem_footprint.XXXXXX) || exit 1
+PIDS=""
+
+# stops all started adapters: they unregister their devices on SIGINT, those
+# which do not stop in 5 seconds are terminated
+cleanup()
+{
+	if [ -n "$PIDS" ]; then
+		kill -INT $PIDS 2> /dev/null
+		WAITED=0
+		while [ $WAITED -lt 50 ] && kill -0 $PIDS 2> /dev/null; do
+			sleep 0.1
+			WAITED=$(( $WAITED + 1 ))
+		done
+		kill -TERM $PIDS 2> /dev/null
+		wait
+	fi
+	rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+trap "exit 1" INT TERM
+
+if [ -n "$CSV" ]; then
+	echo "time,process,rss_kb,pss_kb,uss_kb,dirty_kb" > "$CSV"
+fi
+
+# server footprint before any adapter is started
+SERVER_BASE=$(sample $SERVER_PID)
+record server "$SERVER_BASE"
+
+# start adapters one by one, waiting until each of them registers its device
+i=1
+while [ $i -le $COUNT ]; do
+	LOG=$WORK_DIR/adapter$i.log
+	"$ADAPTER" "$CONFIG" /obix/memfootprint$i $MEM_CONST $MEM_VAR \
+		<&- > $LOG 2>&1 &
+	PID=$!
+	PIDS="$PIDS $PID"
+
+	WAITED=0
+	while ! grep -q "successfully registered" $LOG; do
+		if [ ! -d /proc/$PID ] || [ $WAITED -ge $(( $START_TIMEOUT * 10 )) ]
+		then
+			echo "Adapter N $i failed to start:"
+			cat $LOG
+			exit 1
+		fi
+		sleep 0.1
+		WAITED=$(( $WAITED + 1 ))
+	done
+	echo "Adapter N $i is started..." >&2
+	i=$(( $i + 1 ))
+done
+
+# sample everything while the adapters work; the last sample is used for
+# the report
+ELAPSED=0
+while [ $ELAPSED -lt $SETTLE ]; do
+	sleep $INTERVAL
+	ELAPSED=$(( $ELAPSED + $INTERVAL ))
+
+	SERVER_NOW=$(sample $SERVER_PID)
+	if [ -z "$SERVER_NOW" ]; then
+		echo "Server process has terminated!"
+		exit 1
+	fi
+	record server "$SERVER_NOW"
+
+	ADAPTERS_NOW=""
+	i=1
+	for PID in $PIDS; do
+		SAMPLE=$(sample $PID)
+		if [ -z "$SAMPLE" ]; then
+			echo "Adapter N $i has terminated!"
+			exit 1
+		fi
+		record adapter$i "$SAMPLE"
+		ADAPTERS_NOW="$ADAPTERS_NOW$SAMPLE
+"
+		i=$(( $i + 1 ))
+	done
+done
+
+# print the report and check the budgets
+printf "%s" "$ADAPTERS_NOW" | awk \
+	-v count=$COUNT \
+	-v base="$SERVER_BASE" \
+	-v now="$SERVER_NOW" \
+	-v adapterBudget="$ADAPTER_BUDGET" \
+	-v deviceBudget="$DEVICE_BUDGET" '
+	{
+		rss += $1; pss += $2; uss += $3
+		if ($3 > ussMax) ussMax = $3
+	}
+	END {
+		split(base, b, " ")
+		split(now, s, " ")
+		# clean pages of the server become shared when adapters map the
+		# same libraries, thus only modified private memory is compared
+		perDevice = (s[4] - b[4]) * 1024 / count
+		printf "{\"benchmark\":\"adapter_footprint\",\"adapters\":%d," \
+		       "\"adapter_rss_kb\":%.0f,\"adapter_pss_kb\":%.0f," \
+		       "\"adapter_uss_kb\":%.0f,\"adapter_uss_max_kb\":%d," \
+		       "\"server_dirty_base_kb\":%d,\"server_dirty_kb\":%d," \
+		       "\"server_pss_kb\":%d,\"server_per_device_bytes\":%.0f}\n",
+		       count, rss / count, pss / count, uss / count, ussMax,
+		       b[4], s[4], s[2], perDevice
+		failed = 0
+		if ((adapterBudget != "") && (ussMax > adapterBudget)) {
+			printf "Adapter footprint %d kB exceeds budget %d kB.\n",
+			       ussMax, adapterBudget > "/dev/stderr"
+			failed = 1
+		}
+		if ((deviceBudget != "") && (perDevice > deviceBudget)) {
+			printf "Server grows by %.0f bytes per device, budget is %d.\n",
+			       perDevice, deviceBudget > "/dev/stderr"
+			failed = 1
+		}
+		exit failed
+	}'
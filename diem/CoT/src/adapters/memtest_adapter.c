@@ -316,6 +316,9 @@ int main(int argc, char** argv)
 
     printf("Test device is successfully registered at the server at the "
            "following address: %s\n", argv[2]);
+    // stdout is fully buffered when redirected, but mem_footprint.sh waits
+    // for this line in the log
+    fflush(stdout);
 
     // allocate additional memory
     int size = atoi(argv[3]);
@@ -30,6 +30,19 @@
  * arguments can be found by launching poll generator with no arguments. The XML
  * configuration template can be found at res/poll_generator_config.xml
  *
+ * Latency of each read and write request is collected into a log-linear
+ * histogram, as well as the delay between writing a value and receiving it
+ * in a Watch notification. Written values contain the time when they were
+ * sent, thus notification delay is measured on receipt. Samples collected
+ * during the warm-up period are excluded, and final results can be exported
+ * in JSON or CSV format.
+ *
+ * By default, each device sends its requests from a periodic task, which
+ * means that a slow response delays all following requests and the delay is
+ * not visible in the latency (so called coordinated omission). In open-loop
+ * mode (-c) requests are sent at constant rate and latency is measured from
+ * the moment when a request should have been sent.
+ *
  * @author Andrey Litvinov
  * @version 1.0
  */
@@ -39,6 +52,8 @@
 #include <string.h>
 #include <signal.h>
 #include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <obix_client.h>
 #include <xml_config.h>
@@ -53,7 +68,8 @@
 	"where\n" \
 	" config_file - Name of the configuration file\n" \
 	" params = -d<count> [-p<delay> | -P<rate>] -t[r|s|l<min_d>]\n" \
-	"          [-w<delay> | -W<rate>] [-f<count>]\n" \
+	"          [-w<delay> | -W<rate>] [-f<count>] [-c] [-u<sec>]\n" \
+	"          [-T<sec>] [-J<file>] [-C<file>]\n" \
 	"\n" \
 	"Obligatory parameters:\n" \
 	" -d<count>:\t Number of devices;\n" \
@@ -72,7 +88,15 @@
 	"           \t -W  - Total writing request rate per second generated\n" \
 	"           \t       by the application;\n" \
 	" -f<count>:\t Number of fields which will be polled by each device\n" \
-	"           \t (default value is %d).\n" \
+	"           \t (default value is %d);\n" \
+	" -c:       \t Open-loop (constant rate) sending of read and write\n" \
+	"           \t requests. Latency is measured from the moment when\n" \
+	"           \t a request should have been sent;\n" \
+	" -u<sec>:  \t Warm-up time, which is excluded from final statistics;\n" \
+	" -T<sec>:  \t Test duration including warm-up. By default, the test\n" \
+	"           \t runs until Ctrl+C is pressed;\n" \
+	" -J<file>: \t Export final statistics to JSON file;\n" \
+	" -C<file>: \t Export final statistics to CSV file.\n" \
 	"\n" \
 	"Example:\n" \
 	"   poll_generator -d5 -P5 -ts config.xml\n" \
@@ -85,6 +109,19 @@
 
 #define POLL_FIELDS_PER_DEVICE_DEFAULT 10
 
+/** @name Latency histograms
+ * Latencies (in microseconds) are counted in log-linear buckets:
+ * each power of two is split into 2^HIST_SUB_BITS buckets, which keeps
+ * relative error of any reported value below 2^-HIST_SUB_BITS (~6%).
+ * @{ */
+#define HIST_SUB_BITS 4
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+/** Values above 2^HIST_MAX_EXP microseconds (more than an hour) are counted
+ * in the last bucket. */
+#define HIST_MAX_EXP 32
+#define HIST_BUCKETS ((HIST_MAX_EXP - HIST_SUB_BITS + 2) * HIST_SUB_COUNT)
+/** @} */
+
 typedef enum {
     POLL_T_NONE,
     POLL_T_READ,
@@ -92,6 +129,27 @@ typedef enum {
     POLL_T_LONG
 } POLL_TYPE;
 
+/** Types of measured operations. */
+typedef enum {
+    OP_READ,
+    OP_WRITE,
+    OP_NOTIFY,
+    OP_COUNT
+} OPERATION_TYPE;
+
+/** Latency histogram of one operation type. */
+typedef struct
+{
+    const char* name;
+    pthread_mutex_t mutex;
+    long counts[HIST_BUCKETS];
+    long count;
+    long errors;
+    long long total;
+    long long min;
+    long long max;
+} Latency_Histogram;
+
 char* _configFile = NULL;
 long _deviceCount = 0;
 long _pollIntervalPerDevice = 0;
@@ -114,6 +172,32 @@ long _writeCounter = 0;
 long _writeErrorCounter = 0;
 long _executionTime = 0;
 
+Latency_Histogram _latency[OP_COUNT] = {
+    {"read", PTHREAD_MUTEX_INITIALIZER},
+    {"write", PTHREAD_MUTEX_INITIALIZER},
+    {"notify", PTHREAD_MUTEX_INITIALIZER}
+};
+
+BOOL _openLoop = FALSE;
+long _warmUpTime = 0;
+long _testDuration = 0;
+char* _jsonFile = NULL;
+char* _csvFile = NULL;
+pthread_t _openLoopThread;
+BOOL _openLoopStarted = FALSE;
+
+/** @name Time marks (in microseconds of monotonic clock)
+ * @{ */
+/** Time when request generation is started. */
+long long _startTime = 0;
+/** Samples of operations started earlier are not included into statistics. */
+long long _measureStartTime = 0;
+/** Time when request generation is stopped. */
+long long _stopTime = 0;
+/** Values written before that time are not used for measuring notification
+ * latency, because they could be written by another instance. */
+long long _writeStartTime = 0;
+/** @} */
 
 BOOL _shutDown = FALSE;
 
@@ -139,6 +223,25 @@ BOOL parseLong(long* output, char* argument, int startPos)
     return TRUE;
 }
 
+BOOL parseFileName(char** output, char* argument)
+{
+    if (*output != NULL)
+    {
+        printf("Duplicate argument \"%s\" is found.\n", argument);
+        return FALSE;
+    }
+
+    if (argument[2] == '\0')
+    {
+        printf("Argument \"%s\" must be followed with a file name.\n",
+               argument);
+        return FALSE;
+    }
+
+    *output = argument + 2;
+    return TRUE;
+}
+
 POLL_TYPE parseAndSetPollType(char* argument)
 {
     if (_pollType != POLL_T_NONE)
@@ -267,6 +370,13 @@ int checkParsedArguments(long pollPerSecond, long writePerSecond)
         return -1;
     }
 
+    if ((_testDuration > 0) && (_warmUpTime >= _testDuration))
+    {
+        printf("Warm-up time (\"-u\") must be shorter than test duration "
+               "(\"-T\").\n");
+        return -1;
+    }
+
     return 0;
 }
 
@@ -368,6 +478,33 @@ int parseInputArguments(int argumentsCount, char** arguments)
                 return -1;
             }
             break;
+        case 'c': // Open-loop scheduling of requests
+            _openLoop = TRUE;
+            break;
+        case 'u': // Warm-up time
+            if (!parseLong(&_warmUpTime, arg, 2))
+            {	// parsing failed
+                return -1;
+            }
+            break;
+        case 'T': // Test duration
+            if (!parseLong(&_testDuration, arg, 2))
+            {	// parsing failed
+                return -1;
+            }
+            break;
+        case 'J': // JSON file with final statistics
+            if (!parseFileName(&_jsonFile, arg))
+            {	// parsing failed
+                return -1;
+            }
+            break;
+        case 'C': // CSV file with final statistics
+            if (!parseFileName(&_csvFile, arg))
+            {	// parsing failed
+                return -1;
+            }
+            break;
         default:
             {
                 printf("Unknown argument: %s\n", arg);
@@ -666,6 +803,116 @@ int signUpDevices()
     return error;
 }
 
+/** Returns current time of monotonic clock in microseconds. */
+long long getTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return ((long long) time.tv_sec * 1000000) + (time.tv_nsec / 1000);
+}
+
+/** Returns index of the histogram bucket which counts provided value. */
+int histogram_getIndex(long long value)
+{
+    if (value < HIST_SUB_COUNT)
+    {
+        return (value < 0) ? 0 : (int) value;
+    }
+    if ((value >> (HIST_MAX_EXP + 1)) != 0)
+    {   // value is too big
+        return HIST_BUCKETS - 1;
+    }
+
+    int exp = HIST_SUB_BITS;
+    while ((value >> (exp + 1)) != 0)
+    {
+        exp++;
+    }
+
+    return (exp - HIST_SUB_BITS + 1) * HIST_SUB_COUNT +
+           (int) ((value >> (exp - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+}
+
+/** Returns the highest value which is counted by the bucket. */
+long long histogram_getValue(int index)
+{
+    if (index < HIST_SUB_COUNT)
+    {
+        return index;
+    }
+
+    int shift = (index / HIST_SUB_COUNT) - 1;
+    long long low =
+        ((long long) (HIST_SUB_COUNT + (index % HIST_SUB_COUNT))) << shift;
+    return low + (1LL << shift) - 1;
+}
+
+/**
+ * Returns value below which the given percentage of samples fall.
+ * Histogram should be locked by the caller.
+ */
+long long histogram_getPercentile(Latency_Histogram* histogram,
+                                  double percentile)
+{
+    double target = percentile / 100.0 * histogram->count;
+    long seen = 0;
+    int i;
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += histogram->counts[i];
+        if ((seen > 0) && (seen >= target))
+        {
+            long long value = histogram_getValue(i);
+            return (value < histogram->max) ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+/**
+ * Saves latency of the operation.
+ * @param startTime Time when the operation was started. In open-loop mode it
+ *                  is the time when the request should have been sent.
+ */
+void recordLatency(OPERATION_TYPE type, long long startTime, long long endTime)
+{
+    if (startTime < _measureStartTime)
+    {   // warm-up is not finished yet
+        return;
+    }
+
+    Latency_Histogram* histogram = &(_latency[type]);
+    long long latency = endTime - startTime;
+
+    pthread_mutex_lock(&(histogram->mutex));
+    histogram->counts[histogram_getIndex(latency)]++;
+    if ((histogram->count == 0) || (latency < histogram->min))
+    {
+        histogram->min = latency;
+    }
+    if (latency > histogram->max)
+    {
+        histogram->max = latency;
+    }
+    histogram->count++;
+    histogram->total += latency;
+    pthread_mutex_unlock(&(histogram->mutex));
+}
+
+/** Counts failed operation. */
+void recordError(OPERATION_TYPE type, long long startTime)
+{
+    if (startTime < _measureStartTime)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&(_latency[type].mutex));
+    _latency[type].errors++;
+    pthread_mutex_unlock(&(_latency[type].mutex));
+}
+
 int pollListener(int connectionId,
                  int deviceId,
                  int listenerId,
@@ -673,6 +920,17 @@ int pollListener(int connectionId,
 {
     log_debug("Device #%d: Parameter #%d is \"%s\".",
               connectionId, listenerId, newValue);
+
+    if ((_pollType != POLL_T_READ) && (_writeStartTime > 0))
+    {
+        // written values contain the time when they were sent
+        long long writeTime = _startTime + atoll(newValue);
+        long long now = getTime();
+        if ((writeTime >= _writeStartTime) && (writeTime <= now))
+        {
+            recordLatency(OP_NOTIFY, writeTime, now);
+        }
+    }
     return 0;
 }
 
@@ -707,35 +965,47 @@ int startWatchPolling()
     return doForEachDevice(&createWatch);
 }
 
+/**
+ * Reads one parameter of the device.
+ * @param startTime Time when the request should be sent.
+ */
+void readParameter(int connectionId, int paramId, long long startTime)
+{
+    char* paramUri = getStringFromLong("dummy/str5/int%d", paramId);
+    if (paramUri == NULL)
+    {	// can't do anything else :(
+        return;
+    }
+    char* paramValue;
+    int error = obix_readValue(connectionId, 1, paramUri, &paramValue);
+    if (error == OBIX_SUCCESS)
+    {
+        recordLatency(OP_READ, startTime, getTime());
+        pollListener(connectionId, 1, paramId, paramValue);
+        free(paramValue);
+        pthread_mutex_lock(&_pollCounterMutex);
+        _pollCounter++;
+        pthread_mutex_unlock(&_pollCounterMutex);
+    }
+    else
+    {
+        recordError(OP_READ, startTime);
+        log_error("Device #%d: Unable to read parameter \"%s\".",
+                  connectionId, paramUri);
+        pthread_mutex_lock(&_pollCounterMutex);
+        _pollErrorCounter++;
+        pthread_mutex_unlock(&_pollCounterMutex);
+    }
+    free(paramUri);
+}
+
 void taskPeriodicRead(void* arg)
 {
     int connectionId = *((int*)arg);
     int i;
     for (i = 0; i < _pollFieldsPerDevice; i++)
     {
-        char* paramUri = getStringFromLong("dummy/str5/int%d", i);
-        if (paramUri == NULL)
-        {	// can't do anything else :(
-            return;
-        }
-        char* paramValue;
-        int error = obix_readValue(connectionId, 1, paramUri, &paramValue);
-        if (error == OBIX_SUCCESS)
-        {
-            pollListener(connectionId, 1, i, paramValue);
-            free(paramValue);
-            pthread_mutex_lock(&_pollCounterMutex);
-            _pollCounter++;
-            pthread_mutex_unlock(&_pollCounterMutex);
-        }
-        else
-        {
-            log_error("Device #%d: Unable to read parameter \"%s\".", paramUri);
-            pthread_mutex_lock(&_pollCounterMutex);
-            _pollErrorCounter++;
-            pthread_mutex_unlock(&_pollCounterMutex);
-        }
-        free(paramUri);
+        readParameter(connectionId, i, getTime());
     }
 }
 
@@ -800,30 +1070,26 @@ int startReadCycles()
     return doForEachDevice(&scheduleReadTask);
 }
 
-
-void taskPeriodicWrite(void* arg)
+/**
+ * Writes the time when request should be sent to one parameter of the
+ * device. The time is counted from #_startTime in microseconds.
+ */
+void writeParameter(int connectionId, int paramId, long long startTime)
 {
-    int connectionId = *((int*) arg);
-    // generate random parameter id
-    int paramId = rand() % _pollFieldsPerDevice;
-
     char* paramUri = getStringFromLong("dummy/str5/int%d", paramId);
     if (paramUri == NULL)
     {	// can't do anything else :(
         return;
     }
 
-    char* newValue = getStringFromLong("%ld", rand());
-    if (newValue == NULL)
-    {	// can't proceed
-        free(paramUri);
-        return;
-    }
+    char newValue[24];
+    sprintf(newValue, "%lld", startTime - _startTime);
 
     int error =
         obix_writeValue(connectionId, 1, paramUri, newValue, OBIX_T_INT);
     if (error != OBIX_SUCCESS)
     {
+        recordError(OP_WRITE, startTime);
         log_error("Device #%d: Unable to write \"%s\" to parameter \"%s\".",
                   connectionId, newValue, paramUri);
         pthread_mutex_lock(&_writeCounterMutex);
@@ -832,6 +1098,7 @@ void taskPeriodicWrite(void* arg)
     }
     else
     {
+        recordLatency(OP_WRITE, startTime, getTime());
         log_debug("Device #%d: New value (\"%s\") is set to \"%s\".",
                   connectionId, newValue, paramUri);
         pthread_mutex_lock(&_writeCounterMutex);
@@ -839,7 +1106,13 @@ void taskPeriodicWrite(void* arg)
         pthread_mutex_unlock(&_writeCounterMutex);
     }
     free(paramUri);
-    free(newValue);
+}
+
+void taskPeriodicWrite(void* arg)
+{
+    int connectionId = *((int*) arg);
+    // generate random parameter id
+    writeParameter(connectionId, rand() % _pollFieldsPerDevice, getTime());
 }
 
 int scheduleWriteTask(int deviceId)
@@ -859,6 +1132,12 @@ int scheduleWriteTask(int deviceId)
 int startWriteCycle()
 {
     srand(time(NULL));
+    _writeStartTime = getTime();
+    if (_openLoop)
+    {	// requests are sent by the open-loop thread
+        return 0;
+    }
+
     int error = startThread(&_readThread);
     if (error != 0)
     {
@@ -868,6 +1147,97 @@ int startWriteCycle()
     return doForEachDevice(&scheduleWriteTask);
 }
 
+/**
+ * Sends read and write requests of all devices at constant rate. Unlike
+ * periodic tasks, a slow response doesn't shift the schedule: following
+ * requests are sent immediately and their latency is counted from the moment
+ * when they should have been sent.
+ */
+void* openLoopCycle(void* arg)
+{
+    // intervals between two consecutive requests of all devices in
+    // microseconds
+    long long readInterval = 0;
+    long long writeInterval = 0;
+    if (_pollType == POLL_T_READ)
+    {
+        readInterval = (long long) _pollIntervalPerDevice * 1000 /
+                       (_deviceCount * _pollFieldsPerDevice);
+        if (readInterval == 0)
+        {
+            readInterval = 1;
+        }
+    }
+    if (_writeIntervalPerDevice > 0)
+    {
+        writeInterval =
+            (long long) _writeIntervalPerDevice * 1000 / _deviceCount;
+        if (writeInterval == 0)
+        {
+            writeInterval = 1;
+        }
+    }
+
+    long long nextReadTime = getTime() + readInterval;
+    long long nextWriteTime = getTime() + writeInterval;
+    long readCount = 0;
+    long writeCount = 0;
+
+    while (_shutDown == FALSE)
+    {
+        BOOL isRead = (readInterval > 0) &&
+                      ((writeInterval == 0) || (nextReadTime <= nextWriteTime));
+        long long startTime = isRead ? nextReadTime : nextWriteTime;
+        long long delay = startTime - getTime();
+        if (delay > 0)
+        {
+            // sleep in short steps in order to stop quickly on shutdown
+            usleep((delay < 100000) ? delay : 100000);
+            continue;
+        }
+
+        int connectionId = _connectionIds[(isRead ? readCount : writeCount) %
+                                          _deviceCount];
+        if (isRead)
+        {
+            readParameter(connectionId,
+                          (readCount / _deviceCount) % _pollFieldsPerDevice,
+                          startTime);
+            readCount++;
+            nextReadTime += readInterval;
+        }
+        else
+        {
+            writeParameter(connectionId,
+                           rand() % _pollFieldsPerDevice,
+                           startTime);
+            writeCount++;
+            nextWriteTime += writeInterval;
+        }
+    }
+
+    return NULL;
+}
+
+int startOpenLoopCycle()
+{
+    if ((_pollType != POLL_T_READ) && (_writeIntervalPerDevice == 0))
+    {
+        log_warning("Open-loop mode affects only read and write requests, "
+                    "but none of them are generated.");
+        return 0;
+    }
+
+    int error = pthread_create(&_openLoopThread, NULL, &openLoopCycle, NULL);
+    if (error != 0)
+    {
+        log_error("Unable to start a new thread.");
+        return -1;
+    }
+    _openLoopStarted = TRUE;
+    return 0;
+}
+
 long getCounterGrowth(long* counter,
                       long* previousValue)
 {
@@ -964,6 +1334,155 @@ void showFinalStatistics()
     }
 }
 
+/** Summary of the latency histogram. All times are in microseconds. */
+typedef struct
+{
+    long count;
+    long errors;
+    double rate;
+    long long min;
+    double mean;
+    long long p50;
+    long long p90;
+    long long p99;
+    long long p999;
+    long long max;
+} Latency_Summary;
+
+/** Returns duration of measurements (excluding warm-up) in seconds. */
+double getMeasuredTime()
+{
+    double duration = (_stopTime - _measureStartTime) / 1000000.0;
+    return (duration > 0) ? duration : 0;
+}
+
+void getLatencySummary(OPERATION_TYPE type, Latency_Summary* summary)
+{
+    Latency_Histogram* histogram = &(_latency[type]);
+    double duration = getMeasuredTime();
+
+    pthread_mutex_lock(&(histogram->mutex));
+    summary->count = histogram->count;
+    summary->errors = histogram->errors;
+    summary->rate = (duration > 0) ? (histogram->count / duration) : 0;
+    summary->min = histogram->min;
+    summary->mean = (histogram->count > 0) ?
+                    ((double) histogram->total / histogram->count) : 0;
+    summary->p50 = histogram_getPercentile(histogram, 50);
+    summary->p90 = histogram_getPercentile(histogram, 90);
+    summary->p99 = histogram_getPercentile(histogram, 99);
+    summary->p999 = histogram_getPercentile(histogram, 99.9);
+    summary->max = histogram->max;
+    pthread_mutex_unlock(&(histogram->mutex));
+}
+
+void showLatencyStatistics()
+{
+    printf("Latency statistics (ms), %.1f seconds%s:\n"
+           "           count    errors   rate     min      p50      "
+           "p90      p99      p99.9    max\n",
+           getMeasuredTime(),
+           (_warmUpTime > 0) ? " after warm-up" : "");
+
+    int i;
+    for (i = 0; i < OP_COUNT; i++)
+    {
+        Latency_Summary summary;
+        getLatencySummary(i, &summary);
+        if ((summary.count == 0) && (summary.errors == 0))
+        {   // operation was not used
+            continue;
+        }
+        printf("   %-7s: %-9ld%-9ld%-9.2f%-9.3f%-9.3f%-9.3f%-9.3f%-9.3f"
+               "%-9.3f\n",
+               _latency[i].name, summary.count, summary.errors, summary.rate,
+               summary.min / 1000.0, summary.p50 / 1000.0,
+               summary.p90 / 1000.0, summary.p99 / 1000.0,
+               summary.p999 / 1000.0, summary.max / 1000.0);
+    }
+}
+
+const char* getPollTypeName()
+{
+    switch (_pollType)
+    {
+    case POLL_T_READ:
+        return "read";
+    case POLL_T_SHORT:
+        return "short";
+    case POLL_T_LONG:
+        return "long";
+    default:
+        return "none";
+    }
+}
+
+int exportJSON(const char* fileName)
+{
+    FILE* file = fopen(fileName, "w");
+    if (file == NULL)
+    {
+        log_error("Unable to open file \"%s\" for writing.", fileName);
+        return -1;
+    }
+
+    fprintf(file, "{\"devices\":%ld,\"fields\":%ld,\"poll_type\":\"%s\","
+            "\"open_loop\":%s,\"warm_up_s\":%ld,\"duration_s\":%.3f,"
+            "\"operations\":[",
+            _deviceCount, _pollFieldsPerDevice, getPollTypeName(),
+            _openLoop ? "true" : "false", _warmUpTime, getMeasuredTime());
+
+    int i;
+    for (i = 0; i < OP_COUNT; i++)
+    {
+        Latency_Summary summary;
+        getLatencySummary(i, &summary);
+        fprintf(file, "%s{\"name\":\"%s\",\"count\":%ld,\"errors\":%ld,"
+                "\"rate\":%.2f,\"min_us\":%lld,\"mean_us\":%.1f,"
+                "\"p50_us\":%lld,\"p90_us\":%lld,\"p99_us\":%lld,"
+                "\"p999_us\":%lld,\"max_us\":%lld}",
+                (i > 0) ? "," : "", _latency[i].name,
+                summary.count, summary.errors, summary.rate, summary.min,
+                summary.mean, summary.p50, summary.p90, summary.p99,
+                summary.p999, summary.max);
+    }
+    fprintf(file, "]}\n");
+
+    fclose(file);
+    return 0;
+}
+
+int exportCSV(const char* fileName)
+{
+    FILE* file = fopen(fileName, "w");
+    if (file == NULL)
+    {
+        log_error("Unable to open file \"%s\" for writing.", fileName);
+        return -1;
+    }
+
+    fprintf(file, "operation,devices,fields,poll_type,open_loop,duration_s,"
+            "count,errors,rate,min_us,mean_us,p50_us,p90_us,p99_us,p999_us,"
+            "max_us\n");
+
+    int i;
+    for (i = 0; i < OP_COUNT; i++)
+    {
+        Latency_Summary summary;
+        getLatencySummary(i, &summary);
+        fprintf(file, "%s,%ld,%ld,%s,%d,%.3f,%ld,%ld,%.2f,%lld,%.1f,%lld,"
+                "%lld,%lld,%lld,%lld\n",
+                _latency[i].name, _deviceCount, _pollFieldsPerDevice,
+                getPollTypeName(), _openLoop ? 1 : 0, getMeasuredTime(),
+                summary.count, summary.errors, summary.rate, summary.min,
+                summary.mean, summary.p50, summary.p90, summary.p99,
+                summary.p999, summary.max);
+    }
+
+    fclose(file);
+    return 0;
+}
+
 void signalHandler(int signal)
 {
     _shutDown = TRUE;
@@ -999,11 +1518,14 @@ int main(int argumentsCount, char** arguments)
         return error;
     }
 
+    _startTime = getTime();
+    _measureStartTime = _startTime + (long long) _warmUpTime * 1000000;
+
     if (_pollType == POLL_T_READ)
     {
         // we can collect statistics about requests only when
         // we issue all of them manually ( == we do not use Watches)
-        error = startReadCycles();
+        error = _openLoop ? 0 : startReadCycles();
         error += startStatisticsGathering();
     }
     else
@@ -1024,21 +1546,50 @@ int main(int argumentsCount, char** arguments)
         }
     }
 
+    if (_openLoop)
+    {
+        error = startOpenLoopCycle();
+        if (error != 0)
+        {
+            return error;
+        }
+    }
+
     // register signal handler
     signal(SIGINT, &signalHandler);
     printf("Poll Generator is started.\n\n"
            "Press Ctrl+C to stop...\n");
 
-    // wait for signal SIGINT (Ctrl+C)
+    // wait for signal SIGINT (Ctrl+C) or the end of the test
     while (_shutDown == FALSE)
     {
-        sleep(10);
+        sleep(1);
+        if ((_testDuration > 0) &&
+                (getTime() - _startTime >= (long long) _testDuration * 1000000))
+        {
+            printf("\nTest duration is over, terminating.\n");
+            _shutDown = TRUE;
+        }
     }
+    _stopTime = getTime();
 
     // shutdown gracefully
+    if (_openLoopStarted)
+    {
+        pthread_join(_openLoopThread, NULL);
+    }
     stopThread(_readThread);
     stopThread(_statisticsThread);
     showFinalStatistics();
+    showLatencyStatistics();
+    if (_jsonFile != NULL)
+    {
+        exportJSON(_jsonFile);
+    }
+    if (_csvFile != NULL)
+    {
+        exportCSV(_csvFile);
+    }
 
     // release all resources allocated by oBIX client library.
     // No need to close connection or unregister listener explicitly - it is
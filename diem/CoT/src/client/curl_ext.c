@@ -30,15 +30,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <log_utils.h>
+#include <obix_binary.h>
+#include <probes.h>
 #include "curl_ext.h"
 
 #define DEF_INPUT_BUFFER_SIZE 2048
-#define REQUEST_HTTP_PUT 0
-#define REQUEST_HTTP_POST 1
+#define DEF_REQUEST_BUFFER_SIZE 1024
 
 static int _defaultInputBufferSize = DEF_INPUT_BUFFER_SIZE;
 
 static struct curl_slist* _header;
+/** Header of requests, whose response is parsed to DOM structure. Such
+ * responses can be binary encoded by the server (see obix_binary.h). */
+static struct curl_slist* _domHeader;
+/** Header of requests, whose body is binary encoded. */
+static struct curl_slist* _binaryHeader;
 
 /**
  * libcurl write callback function. Called each time when
@@ -75,12 +81,49 @@ static size_t inputWriter(char* inputData,
             return 0;
         }
     }
-    // append data to the end of buffer
-    strncat(handle->inputBuffer, inputData, newDataSize);
+    // append data to the end of buffer. Binary encoded input can contain
+    // zero bytes, thus strncat() can't be used.
+    int length = handle->inputBufferSize - 1 - handle->inputBufferFree;
+    memcpy(handle->inputBuffer + length, inputData, newDataSize);
+    handle->inputBuffer[length + newDataSize] = '\0';
     handle->inputBufferFree -= newDataSize;
     return newDataSize;
 }
 
+/**
+ * libcurl header callback function. Saves entity tag of the received object.
+ */
+static size_t headerWriter(char* header,
+                           size_t size,
+                           size_t nmemb,
+                           void* arg)
+{
+    CURL_EXT* handle = (CURL_EXT*) arg;
+    size_t length = size * nmemb;
+
+    if ((length > 5) && (strncasecmp(header, "ETag:", 5) == 0))
+    {
+        // skip leading spaces and trailing line break
+        const char* value = header + 5;
+        const char* end = header + length;
+        while ((value < end) && (*value == ' '))
+        {
+            value++;
+        }
+        while ((end > value) && ((end[-1] == '\r') || (end[-1] == '\n')))
+        {
+            end--;
+        }
+        if ((end - value) < CURL_EXT_ETAG_MAX)
+        {
+            memcpy(handle->etag, value, end - value);
+            handle->etag[end - value] = '\0';
+        }
+    }
+
+    return length;
+}
+
 /**
  * libcurl read callback function. Called each time when
  * something is sent to read the sending buffer.
@@ -119,6 +162,10 @@ static void curl_ext_freeMemory(CURL_EXT* handle)
         {
             curl_easy_cleanup(handle->curl);
         }
+        if (handle->transport != NULL)
+        {
+            handle->transport->free(handle);
+        }
         if (handle->errorBuffer != NULL)
         {
             free(handle->errorBuffer);
@@ -127,6 +174,14 @@ static void curl_ext_freeMemory(CURL_EXT* handle)
         {
             free(handle->inputBuffer);
         }
+        if (handle->requestBuffer != NULL)
+        {
+            strbuf_free(handle->requestBuffer);
+        }
+        if (handle->binaryBuffer != NULL)
+        {
+            strbuf_free(handle->binaryBuffer);
+        }
         free(handle);
     }
 }
@@ -146,13 +201,21 @@ static CURL_EXT* curl_ext_allocateMemory()
     }
     // initialize default values
     handle->curl = NULL;
+    handle->transport = NULL;
+    handle->transportData = NULL;
+    handle->transportFd = -1;
     handle->errorBuffer = NULL;
     handle->inputBuffer = NULL;
     handle->inputBufferFree = _defaultInputBufferSize - 1;
     handle->inputBufferSize = _defaultInputBufferSize;
     handle->outputBuffer = NULL;
+    handle->requestBuffer = NULL;
+    handle->binaryBuffer = NULL;
+    handle->serverBinary = FALSE;
     handle->outputPos = 0;
     handle->outputSize = 0;
+    handle->etag[0] = '\0';
+    handle->notModified = FALSE;
 
     // allocate space for buffers
     handle->errorBuffer = (char*) malloc(CURL_ERROR_SIZE);
@@ -170,6 +233,13 @@ static CURL_EXT* curl_ext_allocateMemory()
         return NULL;
     }
 
+    handle->requestBuffer = strbuf_create(DEF_REQUEST_BUFFER_SIZE);
+    if (handle->requestBuffer == NULL)
+    {
+        curl_ext_freeMemory(handle);
+        return NULL;
+    }
+
     return handle;
 }
 
@@ -194,6 +264,18 @@ int curl_ext_init(int defaultInputBufferSize)
     // disable default header for PUT requests "Expect: 100-continue"
     _header = curl_slist_append(_header, "Expect:");
 
+    _domHeader = curl_slist_append(_domHeader, "Content-Type: text/xml");
+    _domHeader = curl_slist_append(_domHeader, "Expect:");
+    char accept[64];
+    sprintf(accept, "Accept: %s, text/xml", OBIX_BINARY_CONTENT_TYPE);
+    _domHeader = curl_slist_append(_domHeader, accept);
+
+    char contentType[64];
+    sprintf(contentType, "Content-Type: %s", OBIX_BINARY_CONTENT_TYPE);
+    _binaryHeader = curl_slist_append(_binaryHeader, contentType);
+    _binaryHeader = curl_slist_append(_binaryHeader, "Expect:");
+    _binaryHeader = curl_slist_append(_binaryHeader, accept);
+
     return 0;
 }
 
@@ -204,6 +286,10 @@ void curl_ext_dispose()
     // cleanup custom headers
     curl_slist_free_all(_header);
     _header = NULL;
+    curl_slist_free_all(_domHeader);
+    _domHeader = NULL;
+    curl_slist_free_all(_binaryHeader);
+    _binaryHeader = NULL;
 }
 
 int curl_ext_create(CURL_EXT** handle)
@@ -243,6 +329,17 @@ int curl_ext_create(CURL_EXT** handle)
         return -1;
     }
 
+    // empty string makes CURL advertise all supported compressions and
+    // decompress responses automatically
+    code = curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    if (code != CURLE_OK)
+    {
+        log_error("Unable to initialize CURL handle: "
+                  "Failed to enable compression (%d).", code);
+        curl_ext_freeMemory(h);
+        return -1;
+    }
+
     // Set incoming data handler (is called by curl to write down
     // received data)
     code = curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &inputWriter);
@@ -264,6 +361,20 @@ int curl_ext_create(CURL_EXT** handle)
         return -1;
     }
 
+    // Set header handler, which looks for entity tags of received objects
+    code = curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &headerWriter);
+    if (code == CURLE_OK)
+    {
+        code = curl_easy_setopt(curl, CURLOPT_HEADERDATA, h);
+    }
+    if (code != CURLE_OK)
+    {
+        log_error("Unable to initialize CURL handle: "
+                  "Failed to set header handler (%d).", code);
+        curl_ext_freeMemory(h);
+        return -1;
+    }
+
     // Set output reader function (is called by curl to read
     // body of request from buffer)
     code = curl_easy_setopt(curl, CURLOPT_READFUNCTION, &outputReader);
@@ -291,6 +402,43 @@ int curl_ext_create(CURL_EXT** handle)
     return 0;
 }
 
+int curl_ext_createCustom(CURL_EXT** handle,
+                          const CURL_EXT_Transport* transport,
+                          void* transportData)
+{
+    CURL_EXT* h = curl_ext_allocateMemory();
+    if (h == NULL)
+    {
+        log_error("Unable to allocate memory for request handle.");
+        return -2;
+    }
+
+    h->transport = transport;
+    h->transportData = transportData;
+    *handle = h;
+
+    return 0;
+}
+
+int curl_ext_appendInput(CURL_EXT* handle, const char* data, int size)
+{
+    return (inputWriter((char*) data, 1, size, handle) == size) ? 0 : -1;
+}
+
+void curl_ext_abort(CURL_EXT* handle, const char* uri)
+{
+    if (handle->transport != NULL)
+    {
+        handle->transport->abort(handle);
+    }
+    else
+    {
+        // restore the header, which was changed by curl_ext_preparePost
+        curl_easy_setopt(handle->curl, CURLOPT_HTTPHEADER, _header);
+    }
+    OBIX_PROBE3(http__request__done, uri, -1, 0);
+}
+
 int curl_ext_setSSL(CURL_EXT* curl,
                     int verifyPeer,
                     int verifyHost,
@@ -352,11 +500,46 @@ void curl_ext_free(CURL_EXT* handle)
     curl_ext_freeMemory(handle);
 }
 
+/** Tells whether the output buffer contains binary encoded request body. */
+static BOOL isOutputBinary(CURL_EXT* handle)
+{
+    return (handle->binaryBuffer != NULL)
+           && (handle->outputBuffer != NULL)
+           && (handle->outputBuffer == strbuf_getString(handle->binaryBuffer));
+}
+
 /**
- * Helper function which performs actual HTTP request
- * assumes that type of request was already set by a caller.
+ * Returns size of the data in output buffer. Length of the request buffer is
+ * already known, so it is not calculated again.
  */
-static int sendRequest(CURL_EXT* handle, const char* uri)
+static int getOutputSize(CURL_EXT* handle)
+{
+    if (handle->outputBuffer == strbuf_getString(handle->requestBuffer))
+    {
+        return handle->requestBuffer->length;
+    }
+    if (isOutputBinary(handle))
+    {
+        return handle->binaryBuffer->length;
+    }
+
+    return strlen(handle->outputBuffer);
+}
+
+/** Cleans the input buffer before new request. */
+static void resetInput(CURL_EXT* handle)
+{
+    *(handle->inputBuffer) = '\0';
+    handle->inputBufferFree = handle->inputBufferSize - 1;
+    handle->etag[0] = '\0';
+    handle->notModified = FALSE;
+}
+
+/**
+ * Helper function which sets target URI of the HTTP request and cleans the
+ * input buffer. Assumes that type of request was already set by a caller.
+ */
+static int prepareRequest(CURL_EXT* handle, const char* uri)
 {
     CURLcode code = curl_easy_setopt(handle->curl, CURLOPT_URL, uri);
     if (code != CURLE_OK)
@@ -366,12 +549,65 @@ static int sendRequest(CURL_EXT* handle, const char* uri)
         return -1;
     }
 
-    // Cleanup input buffer
-    *(handle->inputBuffer) = '\0';
-    handle->inputBufferFree = handle->inputBufferSize - 1;
+    resetInput(handle);
+    return 0;
+}
 
-    // Retrieve content of the URL
-    code = curl_easy_perform(handle->curl);
+/**
+ * Sends request using custom transport of the handle.
+ * Doesn't wait for the response.
+ */
+static int sendCustomRequest(CURL_EXT* handle,
+                             CURL_EXT_METHOD method,
+                             const char* uri)
+{
+    resetInput(handle);
+    if (handle->transport->send(handle, method, uri) != 0)
+    {
+        log_error("Request to \"%s\" failed: Unable to send the request.",
+                  uri);
+        return -1;
+    }
+
+    return 0;
+}
+
+/** Receives response of the request sent by #sendCustomRequest. */
+static int receiveCustomResponse(CURL_EXT* handle, const char* uri)
+{
+    if (handle->transport->receive(handle) != 0)
+    {
+        log_error("Request to \"%s\" failed: Unable to receive the response.",
+                  uri);
+        return -1;
+    }
+
+    log_debug("Received input:\n%s", handle->inputBuffer);
+    return 0;
+}
+
+/** Performs request using custom transport of the handle. */
+static int performCustomRequest(CURL_EXT* handle,
+                                CURL_EXT_METHOD method,
+                                const char* uri)
+{
+    OBIX_PROBE1(http__request__start, uri);
+    int error = sendCustomRequest(handle, method, uri);
+    if (error == 0)
+    {
+        error = receiveCustomResponse(handle, uri);
+    }
+    OBIX_PROBE3(http__request__done, uri, error,
+                handle->inputBufferSize - 1 - handle->inputBufferFree);
+
+    return error;
+}
+
+/**
+ * Helper function which checks the result of completed HTTP request.
+ */
+static int checkRequestResult(CURL_EXT* handle, const char* uri, CURLcode code)
+{
     // allow server empty responses
     if ((code != CURLE_OK) && (code != CURLE_GOT_NOTHING))
     {
@@ -385,8 +621,35 @@ static int sendRequest(CURL_EXT* handle, const char* uri)
     return 0;
 }
 
+/**
+ * Helper function which performs actual HTTP request
+ * assumes that type of request was already set by a caller.
+ */
+static int sendRequest(CURL_EXT* handle, const char* uri)
+{
+    if (prepareRequest(handle, uri) != 0)
+    {
+        return -1;
+    }
+
+    // Retrieve content of the URL
+    OBIX_PROBE1(http__request__start, uri);
+    CURLcode code = curl_easy_perform(handle->curl);
+    int error = checkRequestResult(handle, uri, code);
+    OBIX_PROBE3(http__request__done, uri, error,
+                handle->inputBufferSize - 1 - handle->inputBufferFree);
+
+    return error;
+}
+
 int curl_ext_get(CURL_EXT* handle, const char* uri)
 {
+    if (handle->transport != NULL)
+    {
+        log_debug("Requesting data from %s.", uri);
+        return performCustomRequest(handle, CURL_EXT_GET, uri);
+    }
+
     // perform HTTP GET operation
     CURLcode code = curl_easy_setopt(handle->curl, CURLOPT_HTTPGET, 1L);
     if (code != CURLE_OK)
@@ -402,15 +665,6 @@ int curl_ext_get(CURL_EXT* handle, const char* uri)
 
 int curl_ext_put(CURL_EXT* handle, const char* uri)
 {
-    // perform HTTP PUT operation
-    CURLcode code = curl_easy_setopt(handle->curl, CURLOPT_UPLOAD, 1L);
-    if (code != CURLE_OK)
-    {
-        log_error("Unable to initialize HTTP PUT request: "
-                  "Failed to switch to PUT (%d).", code);
-        return -1;
-    }
-
     // Reset output counters
     handle->outputPos = 0;
     if (handle->outputBuffer == NULL)
@@ -419,7 +673,22 @@ int curl_ext_put(CURL_EXT* handle, const char* uri)
         log_error("Trying to perform PUT request with empty body.");
         return -1;
     }
-    handle->outputSize = strlen(handle->outputBuffer);
+    handle->outputSize = getOutputSize(handle);
+
+    if (handle->transport != NULL)
+    {
+        log_debug("Sending data to %s:\n%s", uri, handle->outputBuffer);
+        return performCustomRequest(handle, CURL_EXT_PUT, uri);
+    }
+
+    // perform HTTP PUT operation
+    CURLcode code = curl_easy_setopt(handle->curl, CURLOPT_UPLOAD, 1L);
+    if (code != CURLE_OK)
+    {
+        log_error("Unable to initialize HTTP PUT request: "
+                  "Failed to switch to PUT (%d).", code);
+        return -1;
+    }
 
     // Set output length
     code = curl_easy_setopt(handle->curl, CURLOPT_INFILESIZE, handle->outputSize);
@@ -430,12 +699,41 @@ int curl_ext_put(CURL_EXT* handle, const char* uri)
         return -1;
     }
 
-    log_debug("CURL sending data:\n%s", handle->outputBuffer);
+    // binary body is logged before encoding
+    if (!isOutputBinary(handle))
+    {
+        log_debug("CURL sending data:\n%s", handle->outputBuffer);
+    }
     return sendRequest(handle, uri);
 }
 
-int curl_ext_post(CURL_EXT* handle, const char* uri)
+/**
+ * Helper function which switches the handle to POST mode and sets request body
+ * from the output buffer.
+ */
+static int setPostOptions(CURL_EXT* handle, const char* uri)
 {
+    // Reset output counters
+    handle->outputPos = 0;
+    // allow empty body of POST request
+    if (handle->outputBuffer == NULL)
+    {
+        handle->outputSize = 0;
+    }
+    else
+    {
+        handle->outputSize = getOutputSize(handle);
+    }
+
+    if (!isOutputBinary(handle))
+    {
+        log_debug("CURL sending data to %s:\n%s", uri, handle->outputBuffer);
+    }
+    if (handle->transport != NULL)
+    {   // custom transport reads the output buffer directly
+        return 0;
+    }
+
     // perform HTTP POST operation
     // have to set explicitly upload mode to 0, otherwise
     // PUT will be used instead of POST
@@ -455,18 +753,6 @@ int curl_ext_post(CURL_EXT* handle, const char* uri)
         return -1;
     }
 
-    // Reset output counters
-    handle->outputPos = 0;
-    // allow empty body of POST request
-    if (handle->outputBuffer == NULL)
-    {
-        handle->outputSize = 0;
-    }
-    else
-    {
-        handle->outputSize = strlen(handle->outputBuffer);
-    }
-
     // Set output length
     code = curl_easy_setopt(handle->curl, CURLOPT_POSTFIELDSIZE, handle->outputSize);
     if (code != CURLE_OK)
@@ -476,13 +762,125 @@ int curl_ext_post(CURL_EXT* handle, const char* uri)
         return -1;
     }
 
-    log_debug("CURL sending data to %s:\n%s", uri, handle->outputBuffer);
+    return 0;
+}
+
+int curl_ext_post(CURL_EXT* handle, const char* uri)
+{
+    int error = setPostOptions(handle, uri);
+    if (error != 0)
+    {
+        return error;
+    }
+
+    if (handle->transport != NULL)
+    {
+        return performCustomRequest(handle, CURL_EXT_POST, uri);
+    }
+
     return sendRequest(handle, uri);
 }
 
+/**
+ * Switches the handle between plain requests and requests whose response
+ * can be binary encoded. Custom transports always receive XML.
+ */
+static int acceptBinary(CURL_EXT* handle, BOOL binary)
+{
+    if (handle->transport != NULL)
+    {
+        return 0;
+    }
+
+    struct curl_slist* header = _header;
+    if (binary)
+    {
+        header = isOutputBinary(handle) ? _binaryHeader : _domHeader;
+    }
+    CURLcode code = curl_easy_setopt(handle->curl,
+                                     CURLOPT_HTTPHEADER,
+                                     header);
+    if (code != CURLE_OK)
+    {
+        log_error("Unable to set custom header (%d).", code);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Replaces XML body of the request with its binary encoding, if the server
+ * is known to understand it (see obix_binary.h). Request bodies are short
+ * templates, so they are converted from the text composed by callers.
+ * Custom transports always send XML. If the body can't be encoded, it is
+ * sent as is.
+ */
+static void encodeOutput(CURL_EXT* handle)
+{
+    if ((handle->transport != NULL) || !handle->serverBinary
+            || (handle->outputBuffer == NULL))
+    {
+        return;
+    }
+
+    if (handle->binaryBuffer == NULL)
+    {
+        handle->binaryBuffer = strbuf_create(DEF_REQUEST_BUFFER_SIZE);
+        if (handle->binaryBuffer == NULL)
+        {
+            return;
+        }
+    }
+    strbuf_reset(handle->binaryBuffer);
+
+    log_debug("Encoding request body:\n%s", handle->outputBuffer);
+    if ((obixBinary_appendHeader(handle->binaryBuffer) != 0)
+            || (obixBinary_encodeXml(handle->outputBuffer,
+                                     handle->binaryBuffer) != 0))
+    {
+        log_warning("Unable to encode request body. It is sent as XML.");
+        return;
+    }
+    handle->outputBuffer = strbuf_getString(handle->binaryBuffer);
+}
+
+int curl_ext_preparePost(CURL_EXT* handle, const char* uri)
+{
+    encodeOutput(handle);
+    int error = setPostOptions(handle, uri);
+    if (error != 0)
+    {
+        return error;
+    }
+
+    // the request is completed by curl_ext_finishDOM or curl_ext_abort,
+    // which fire the closing probe
+    OBIX_PROBE1(http__request__start, uri);
+    if (handle->transport != NULL)
+    {
+        error = sendCustomRequest(handle, CURL_EXT_POST, uri);
+    }
+    else
+    {
+        // response is decoded by curl_ext_finishDOM, which also restores the
+        // usual header
+        error = acceptBinary(handle, TRUE);
+        if (error == 0)
+        {
+            error = prepareRequest(handle, uri);
+        }
+    }
+    if (error != 0)
+    {
+        OBIX_PROBE3(http__request__done, uri, -1, 0);
+    }
+    return error;
+}
+
 /**
  * Helper function for parsing received response at input buffer of provided
- * handle.
+ * handle. The response can be either XML or binary encoded oBIX document.
  * @return @a 0 on success; @a -1 on error.
  */
 static int parseXmlInput(CURL_EXT* handle, IXML_Document** doc)
@@ -493,6 +891,22 @@ static int parseXmlInput(CURL_EXT* handle, IXML_Document** doc)
         return 0;
     }
 
+    if ((unsigned char) *(handle->inputBuffer) == OBIX_BINARY_MAGIC)
+    {
+        IXML_Element* element = obixBinary_decode(
+                                    handle->inputBuffer,
+                                    handle->inputBufferSize - 1 -
+                                    handle->inputBufferFree);
+        if (element == NULL)
+        {
+            log_error("Unable to decode binary server response.");
+            return -1;
+        }
+        *doc = ixmlNode_getOwnerDocument(ixmlElement_getNode(element));
+        handle->serverBinary = TRUE;
+        return 0;
+    }
+
     int error = ixmlParseBufferEx(handle->inputBuffer, doc);
     if (error != IXML_SUCCESS)
     {
@@ -506,7 +920,12 @@ static int parseXmlInput(CURL_EXT* handle, IXML_Document** doc)
 
 int curl_ext_getDOM(CURL_EXT* handle, const char* uri, IXML_Document** response)
 {
+    if (acceptBinary(handle, TRUE) != 0)
+    {
+        return -1;
+    }
     int error = curl_ext_get(handle, uri);
+    acceptBinary(handle, FALSE);
     if (error != 0)
     {
         return error;
@@ -515,9 +934,65 @@ int curl_ext_getDOM(CURL_EXT* handle, const char* uri, IXML_Document** response)
     return parseXmlInput(handle, response);
 }
 
+int curl_ext_getDOMIfChanged(CURL_EXT* handle,
+                             const char* uri,
+                             const char* etag,
+                             IXML_Document** response)
+{
+    if ((etag == NULL) || (handle->transport != NULL))
+    {   // custom transports do not support conditional requests
+        return curl_ext_getDOM(handle, uri, response);
+    }
+
+    // add condition to the usual headers
+    char condition[strlen(etag) + 16];
+    sprintf(condition, "If-None-Match: %s", etag);
+    struct curl_slist* header = NULL;
+    struct curl_slist* item;
+    for (item = _domHeader; item != NULL; item = item->next)
+    {
+        header = curl_slist_append(header, item->data);
+    }
+    header = curl_slist_append(header, condition);
+    if ((header == NULL) ||
+            (curl_easy_setopt(handle->curl, CURLOPT_HTTPHEADER, header)
+             != CURLE_OK))
+    {
+        log_error("Unable to set conditional request header.");
+        curl_slist_free_all(header);
+        return -1;
+    }
+
+    int error = curl_ext_get(handle, uri);
+    acceptBinary(handle, FALSE);
+    curl_slist_free_all(header);
+    if (error != 0)
+    {
+        return error;
+    }
+
+    long responseCode = 0;
+    curl_easy_getinfo(handle->curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    if (responseCode == 304)
+    {
+        log_debug("Object \"%s\" is not modified.", uri);
+        handle->notModified = TRUE;
+        *response = NULL;
+        return 0;
+    }
+
+    return parseXmlInput(handle, response);
+}
+
 int curl_ext_putDOM(CURL_EXT* handle, const char* uri, IXML_Document** response)
 {
+    encodeOutput(handle);
+    if (acceptBinary(handle, TRUE) != 0)
+    {
+        return -1;
+    }
     int error = curl_ext_put(handle, uri);
+    acceptBinary(handle, FALSE);
     if (error != 0)
     {
         return error;
@@ -528,7 +1003,39 @@ int curl_ext_putDOM(CURL_EXT* handle, const char* uri, IXML_Document** response)
 
 int curl_ext_postDOM(CURL_EXT* handle, const char* uri, IXML_Document** response)
 {
+    encodeOutput(handle);
+    if (acceptBinary(handle, TRUE) != 0)
+    {
+        return -1;
+    }
     int error = curl_ext_post(handle, uri);
+    acceptBinary(handle, FALSE);
+    if (error != 0)
+    {
+        return error;
+    }
+
+    return parseXmlInput(handle, response);
+}
+
+int curl_ext_finishDOM(CURL_EXT* handle,
+                       const char* uri,
+                       CURLcode result,
+                       IXML_Document** response)
+{
+    int error;
+    if (handle->transport != NULL)
+    {
+        error = receiveCustomResponse(handle, uri);
+    }
+    else
+    {
+        error = checkRequestResult(handle, uri, result);
+        // the handle can be reused for plain requests afterwards
+        acceptBinary(handle, FALSE);
+    }
+    OBIX_PROBE3(http__request__done, uri, error,
+                handle->inputBufferSize - 1 - handle->inputBufferFree);
     if (error != 0)
     {
         return error;
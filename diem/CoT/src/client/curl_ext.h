@@ -40,15 +40,67 @@
 #define CURL_EXT_H_
 
 #include <ixml_ext.h>
+#include <str_buffer.h>
 #include <curl/curl.h>
 
+/** Types of requests, which are passed to a custom transport. */
+typedef enum
+{
+    CURL_EXT_GET,
+    CURL_EXT_PUT,
+    CURL_EXT_POST
+} CURL_EXT_METHOD;
+
+struct _CURL_EXT;
+
+/** Maximum length of the entity tag, which is stored by the handle. */
+#define CURL_EXT_ETAG_MAX 64
+
+/**
+ * Custom transport, which can deliver requests of a handle instead of
+ * @a libcurl. It allows to reuse the whole oBIX client on top of another
+ * communication channel (e.g. a local socket).
+ */
+typedef struct _CURL_EXT_Transport
+{
+    /**
+     * Sends request. Body of the request is stored at the output buffer of
+     * the handle (outputSize bytes).
+     * @return @a 0 on success, @a -1 on error.
+     */
+    int (*send)(struct _CURL_EXT* handle,
+                CURL_EXT_METHOD method,
+                const char* uri);
+    /**
+     * Receives response of the last sent request and writes it to the handle
+     * using #curl_ext_appendInput.
+     * @return @a 0 on success, @a -1 on error.
+     */
+    int (*receive)(struct _CURL_EXT* handle);
+    /**
+     * Drops the request, which was sent but whose response was not received.
+     */
+    void (*abort)(struct _CURL_EXT* handle);
+    /** Releases transport data of the handle. */
+    void (*free)(struct _CURL_EXT* handle);
+}
+CURL_EXT_Transport;
+
 /**
  * Defines a handle for HTTP client, which wraps CURL handle.
  */
 typedef struct _CURL_EXT
 {
-    /** CURL handle */
+    /** CURL handle. @a NULL if the handle uses custom transport. */
     CURL* curl;
+    /** Custom transport, or @a NULL if requests are performed by CURL. */
+    const CURL_EXT_Transport* transport;
+    /** Data of the custom transport. */
+    void* transportData;
+    /** File descriptor of the custom transport, which becomes readable when
+     * response to the sent request arrives. @a -1 if there is no such
+     * descriptor. */
+    int transportFd;
 
     /** Buffer for storing incoming data.*/
     char* inputBuffer;
@@ -57,11 +109,28 @@ typedef struct _CURL_EXT
     int inputBufferFree;
     /** Buffer for storing sending data.*/
     const char* outputBuffer;
+    /** Buffer which can be used for composing request body. It is reused
+     * by all requests of the handle, so that memory is not allocated for
+     * every new request. */
+    String_Buffer* requestBuffer;
+    /** Buffer for binary encoded request body (see obix_binary.h).
+     * Allocated when the first binary request is sent. */
+    String_Buffer* binaryBuffer;
+    /** Tells whether the server has already sent binary encoded response.
+     * Such server understands binary request bodies too, so bodies of the
+     * following requests with DOM responses are sent in binary form. */
+    BOOL serverBinary;
     // counters for outgoing data
     int outputSize; // size of output data
     int outputPos; // number of sent bytes
     /** buffer for storing CURL error messages.*/
     char* errorBuffer;
+    /** Entity tag of the object received by the last request, or empty
+     * string if the server did not provide it. */
+    char etag[CURL_EXT_ETAG_MAX];
+    /** Tells whether server answered to the last conditional request that
+     * the object is not modified (see #curl_ext_getDOMIfChanged). */
+    BOOL notModified;
 }
 CURL_EXT;
 
@@ -93,6 +162,39 @@ void curl_ext_dispose();
  */
 int curl_ext_create(CURL_EXT** handle);
 
+/**
+ * Creates handle which performs requests using custom transport instead of
+ * HTTP.
+ *
+ * @param handle A pointer to created handle is returned here.
+ * @param transport Transport which will deliver requests of the handle.
+ * @param transportData Transport specific data, which is stored at the
+ *                      handle. It is released by the transport when the
+ *                      handle is deleted.
+ * @return  @li @a 0 - On success.
+ * 			@li @a -2 - Not enough memory.
+ */
+int curl_ext_createCustom(CURL_EXT** handle,
+                          const CURL_EXT_Transport* transport,
+                          void* transportData);
+
+/**
+ * Appends received data to the input buffer of the handle. Used by custom
+ * transports.
+ *
+ * @return @a 0 on success, @a -1 if there is not enough memory.
+ */
+int curl_ext_appendInput(CURL_EXT* handle, const char* data, int size);
+
+/**
+ * Drops the request which was started by #curl_ext_preparePost. CURL
+ * handles should be removed from the multi handle before that; for them
+ * only the usual request headers are restored.
+ *
+ * @param uri Requested URI (used for tracing).
+ */
+void curl_ext_abort(CURL_EXT* handle, const char* uri);
+
 /**
  * Sets SSL settings to the provide handle.
  *
@@ -168,6 +270,20 @@ int curl_ext_getDOM(CURL_EXT* handle,
                     const char* uri,
                     IXML_Document** response);
 
+/**
+ * Works as #curl_ext_getDOM, but asks the server to send the object only if
+ * its entity tag differs from the provided one. If the object is not modified,
+ * @a response is set to @a NULL and @a notModified field of the handle is set.
+ * Entity tag of the received object is stored at @a etag field of the handle.
+ *
+ * @param etag Entity tag of the object, which was received earlier. If
+ *             @a NULL, the function works exactly as #curl_ext_getDOM.
+ */
+int curl_ext_getDOMIfChanged(CURL_EXT* handle,
+                             const char* uri,
+                             const char* etag,
+                             IXML_Document** response);
+
 /**
  * Works as #curl_ext_put. In addition, tries to parse received XML response.
  *
@@ -186,4 +302,41 @@ int curl_ext_postDOM(CURL_EXT* handle,
                      const char* uri,
                      IXML_Document** response);
 
+/**
+ * Prepares HTTP POST request on provided handle without performing it. Used
+ * together with @a curl_multi interface: after calling this function, the
+ * @a curl field of the handle can be added to a multi handle, which will
+ * perform the request. When transfer is completed, #curl_ext_finishDOM should
+ * be called to get the response.
+ *
+ * A reference to the data to be sent should be stored at handle's output buffer
+ * field. It should stay valid until the request is completed.
+ *
+ * Probes @a http__request__start and @a http__request__done (see probes.h)
+ * span the whole transfer: the latter is fired by #curl_ext_finishDOM or
+ * #curl_ext_abort.
+ *
+ * @param handle A handle which will be used to perform the request.
+ * @param uri    Requesting URI.
+ * @return @a 0 on success; @a -1 on error.
+ */
+int curl_ext_preparePost(CURL_EXT* handle, const char* uri);
+
+/**
+ * Completes request, which was prepared by #curl_ext_preparePost and performed
+ * by a @a curl_multi handle. Checks the transfer result and tries to parse
+ * received XML response.
+ *
+ * @param handle Handle which was used to perform the request.
+ * @param uri    Requested URI (used for log messages).
+ * @param result Result code of the transfer, returned by @a curl_multi
+ *               interface. Ignored for handles with custom transport.
+ * @param response A pointer to the parsed XML DOM structure is returned here.
+ * @return @a 0 on success; @a -1 on error.
+ */
+int curl_ext_finishDOM(CURL_EXT* handle,
+                       const char* uri,
+                       CURLcode result,
+                       IXML_Document** response);
+
 #endif /* CURL_EXT_H_ */
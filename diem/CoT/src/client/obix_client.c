@@ -33,6 +33,7 @@
 #include <log_utils.h>
 #include <xml_config.h>
 #include <obix_http.h>
+#include <obix_socket.h>
 #include "obix_client.h"
 
 /** Default maximum amount of devices, which can be registered under one
@@ -47,6 +48,8 @@ static const char* CT_CONNECTION = "connection";
 static const char* CTA_CONNECTION_ID = "id";
 static const char* CTA_CONNECTION_TYPE = "type";
 static const char* CTAV_CONNECTION_TYPE_HTTP = "http";
+static const char* CTAV_CONNECTION_TYPE_SOCKET = "socket";
+static const char* CTAV_CONNECTION_TYPE_LOCAL = "local";
 static const char* CT_MAX_DEVICES = "max-devices";
 static const char* CT_MAX_LISTENERS = "max-listeners";
 /** @} */
@@ -55,6 +58,10 @@ static const char* CT_MAX_LISTENERS = "max-listeners";
 static Connection** _connections;
 static int _connectionCount;
 
+/** Stack of local communication functions. It is set by libcot-local (see
+ * obix_client_local.h), otherwise local connections are not available. */
+static const Comm_Stack* _localCommStack = NULL;
+
 /**
  * List of names of all primitive value types in oBIX.
  * This lists reflects the order of #OBIX_DATA_TYPE, so that:
@@ -77,6 +84,11 @@ static const char** OBIX_DATA_TYPE_NAMES[] =
     };
 
 
+void obix_setLocalCommStack(const Comm_Stack* stack)
+{
+    _localCommStack = stack;
+}
+
 const char* obix_getDataTypeName(OBIX_DATA_TYPE type)
 {
 	return *(OBIX_DATA_TYPE_NAMES[type]);
@@ -171,15 +183,14 @@ static void device_free(Device* device)
     free(device);
 }
 
-/** Creates new device object and registers it at the server. */
-static int device_register(Connection* connection, int deviceId, const char* data)
+/** Allocates and initializes new device object. */
+static Device* device_allocate(Connection* connection, int deviceId)
 {
-    // create new device object
     Device* device = (Device*) malloc(sizeof(Device));
     if (device == NULL)
     {
         log_error("Unable to initialize device object: Not enough memory.");
-        return OBIX_ERR_NO_MEMORY;
+        return NULL;
     }
 
     // initialize device fields
@@ -189,11 +200,24 @@ static int device_register(Connection* connection, int deviceId, const char* dat
     {
         log_error("Unable to initialize new device: Not enough memory.");
         free(device);
-        return OBIX_ERR_NO_MEMORY;
+        return NULL;
     }
     device->id = deviceId;
     device->listenerCount = 0;
 
+    return device;
+}
+
+/** Creates new device object and registers it at the server. */
+static int device_register(Connection* connection, int deviceId, const char* data)
+{
+    // create new device object
+    Device* device = device_allocate(connection, deviceId);
+    if (device == NULL)
+    {
+        return OBIX_ERR_NO_MEMORY;
+    }
+
     // call connection type specific device initialization
     // but not for the fake device
     if (deviceId != 0)
@@ -214,6 +238,73 @@ static int device_register(Connection* connection, int deviceId, const char* dat
     return OBIX_SUCCESS;
 }
 
+/**
+ * Creates several device objects and registers them at the server at once.
+ * @param deviceIds Id of each created device, or error code is written here.
+ * @return Number of registered devices, or error code if the request failed.
+ */
+static int device_registerAll(Connection* connection,
+                              const char** data,
+                              int count,
+                              int* deviceIds)
+{
+    Device* devices[count];
+    int results[count];
+    int i;
+    int id = 1;
+
+    // create device objects in free slots
+    for (i = 0; i < count; i++)
+    {
+        for ( ; (id < connection->maxDevices)
+                && (connection->devices[id] != NULL); id++)
+            ;
+        if (id == connection->maxDevices)
+        {	// this should never happen
+            log_error("Unable to find free slot for a new device.");
+            while (--i >= 0)
+            {
+                device_free(devices[i]);
+            }
+            return OBIX_ERR_UNKNOWN_BUG;
+        }
+        devices[i] = device_allocate(connection, id++);
+        if (devices[i] == NULL)
+        {
+            while (--i >= 0)
+            {
+                device_free(devices[i]);
+            }
+            return OBIX_ERR_NO_MEMORY;
+        }
+    }
+
+    int error = (connection->comm->registerDevices)(connection,
+                devices,
+                data,
+                count,
+                results);
+
+    int registered = 0;
+    for (i = 0; i < count; i++)
+    {
+        if ((error == OBIX_SUCCESS) && (results[i] == OBIX_SUCCESS))
+        {
+            connection->devices[devices[i]->id] = devices[i];
+            connection->deviceCount++;
+            deviceIds[i] = devices[i]->id;
+            registered++;
+        }
+        else
+        {
+            deviceIds[i] = (error == OBIX_SUCCESS) ? results[i] : error;
+            device_free(devices[i]);
+        }
+    }
+
+    return (error == OBIX_SUCCESS) ? registered : error;
+}
+
 static int device_unregisterAllListeners(
     Connection* connection,
     Device* device)
@@ -305,6 +396,19 @@ int device_get(Connection* connection, int deviceId, Device** device)
     return OBIX_SUCCESS;
 }
 
+void connection_release(Connection* connection)
+{
+    if (connection->devices != NULL)
+    {
+        if (connection->devices[0] != NULL)
+        {
+            device_free(connection->devices[0]);
+        }
+        free(connection->devices);
+    }
+    free(connection);
+}
+
 /** Frees memory allocated for the Connection object. */
 static int connection_free(Connection* connection)
 {
@@ -315,20 +419,15 @@ static int connection_free(Connection* connection)
     }
 
     // clean connection type specific attributes
-    if (connection->comm != NULL)
+    if ((connection->comm != NULL) &&
+            ((connection->comm->freeConnection)(connection) != 0))
     {
-        (connection->comm->freeConnection)(connection);
+        // connection is still used by the communication layer, which
+        // releases it later
+        return OBIX_SUCCESS;
     }
     // clean the rest of connection object
-    if (connection->devices != NULL)
-    {
-        if (connection->devices[0] != NULL)
-        {
-            device_free(connection->devices[0]);
-        }
-        free(connection->devices);
-    }
-    free(connection);
+    connection_release(connection);
     return OBIX_SUCCESS;
 }
 
@@ -398,10 +497,41 @@ static int connection_create(IXML_Element* connItem)
             return error;
         }
     }
+    else if (strcmp(attrValue, CTAV_CONNECTION_TYPE_SOCKET) == 0)
+    {
+        type = OBIX_SOCKET;
+        comm = &OBIX_SOCKET_COMM_STACK;
+        // socket stack reuses HTTP module (e.g. its Watch polling thread)
+        error = http_init(ixmlNode_convertToElement(
+                              ixmlNode_getParentNode(
+                                  ixmlElement_getNode(connItem))));
+        if (error != OBIX_SUCCESS)
+        {
+            log_error("Unable to initialize communication module (needed "
+                      "by connection id %d).", id);
+            return error;
+        }
+    }
+    else if (strcmp(attrValue, CTAV_CONNECTION_TYPE_LOCAL) == 0)
+    {
+        if (_localCommStack == NULL)
+        {
+            log_error("Local connections are not enabled. The application "
+                      "should be linked with libcot-local and call "
+                      "obix_enableLocalConnections().");
+            log_error("Settings parsing for connection id %d failed.", id);
+            return OBIX_ERR_INVALID_ARGUMENT;
+        }
+        // server is started when connection is opened
+        type = OBIX_LOCAL;
+        comm = _localCommStack;
+    }
     else
     {
-        log_error("Wrong connection type \"%s\". Available values: \"%s\".",
-                  attrValue, CTAV_CONNECTION_TYPE_HTTP);
+        log_error("Wrong connection type \"%s\". Available values: "
+                  "\"%s\", \"%s\", \"%s\".", attrValue,
+                  CTAV_CONNECTION_TYPE_HTTP, CTAV_CONNECTION_TYPE_SOCKET,
+                  CTAV_CONNECTION_TYPE_LOCAL);
         log_error("Settings parsing for connection id %d failed.", id);
         return OBIX_ERR_INVALID_ARGUMENT;
     }
@@ -684,6 +814,30 @@ int obix_registerDevice(int connectionId, const char* obixData)
     return id;
 }
 
+int obix_registerDevices(int connectionId,
+                         const char** obixData,
+                         int count,
+                         int* deviceIds)
+{
+    if ((obixData == NULL) || (deviceIds == NULL) || (count <= 0))
+    {
+        return OBIX_ERR_INVALID_ARGUMENT;
+    }
+
+    Connection* connection;
+    int error = connection_get(connectionId, TRUE, &connection);
+    if (error != OBIX_SUCCESS)
+    {
+        return error;
+    }
+    if (connection->deviceCount + count > connection->maxDevices)
+    {
+        return OBIX_ERR_LIMIT_REACHED;
+    }
+
+    return device_registerAll(connection, obixData, count, deviceIds);
+}
+
 int obix_unregisterDevice(int connectionId, int deviceId)
 {
     Connection* connection;
@@ -291,6 +291,28 @@ int obix_closeConnection(int connectionId);
  */
 int obix_registerDevice(int connectionId, const char* obixData);
 
+/**
+ * Registers several devices at the oBIX server at once.
+ * It works like calling #obix_registerDevice for each device, but all data
+ * is sent to the server in one request, which is much faster when there are
+ * many devices (e.g. a gateway publishing hundreds of virtual devices).
+ * If the server doesn't support bulk registration, devices are registered
+ * one by one.
+ *
+ * @param connectionId ID of the connection which should be used.
+ * @param obixData Array of oBIX objects representing new devices.
+ * @param count Number of devices in @a obixData.
+ * @param deviceIds Array of @a count elements, where result for each device
+ *                  is written: ID of the created device record (>0), or error
+ *                  code (<0).
+ * @return @li >=0 Number of registered devices;
+ *         @li <0 error code, if the request failed completely.
+ */
+int obix_registerDevices(int connectionId,
+                         const char** obixData,
+                         int count,
+                         int* deviceIds);
+
 /**
  * Removes device record from the oBIX server.
  * Also removes all listeners which were registered for this device.
@@ -0,0 +1,50 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * @brief Local connections of C oBIX Client API.
+ *
+ * Besides HTTP and socket connections, oBIX client library can run oBIX server
+ * in the same process with the application (connection type @a "local", see
+ * obix_local.h). This mode is provided by a separate library (libcot-local),
+ * so that applications which do not use it are not linked with the server.
+ *
+ * In order to use local connections, link the application with libcot-local
+ * (pkg-config package @a libcot-local) and call
+ * #obix_enableLocalConnections() before the configuration is loaded:
+ * @code
+ * obix_enableLocalConnections();
+ * obix_loadConfigFile("config.xml");
+ * @endcode
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef OBIX_CLIENT_LOCAL_H_
+#define OBIX_CLIENT_LOCAL_H_
+
+/**
+ * Enables connections of type @a "local" in oBIX client library. Should be
+ * called before #obix_loadConfig or #obix_loadConfigFile.
+ */
+void obix_enableLocalConnections();
+
+#endif /* OBIX_CLIENT_LOCAL_H_ */
@@ -42,6 +42,8 @@
 typedef enum
 {
     OBIX_HTTP,
+    OBIX_SOCKET,
+    OBIX_LOCAL,
 } Connection_Type;
 
 /** See #_Comm_Stack */
@@ -130,8 +132,16 @@ typedef int (*comm_closeConnection)(Connection* connection);
 /**
  * Prototype of a function, which should free all resources allocated by
  * communication type-specific settings of the provided Connection object.
+ *
+ * If the connection is still used by another activity of the communication
+ * layer (e.g. the function is called by a listener, which is notified about
+ * an update received through this connection), releasing can be postponed.
+ * Then the layer calls #connection_release itself when the connection is not
+ * used anymore.
+ *
+ * @return @a 0 if the connection is freed, or @a 1 if releasing is postponed.
  */
-typedef void (*comm_freeConnection)(Connection* connection);
+typedef int (*comm_freeConnection)(Connection* connection);
 
 /**
  * Prototype of a function, which should register device data at oBIX server
@@ -144,6 +154,26 @@ typedef int (*comm_registerDevice)(Connection* connection,
                                    Device** device,
                                    const char* data);
 
+/**
+ * Prototype of a function, which should register data of several devices at
+ * oBIX server at once using provided connection.
+ *
+ * @param devices Array of allocated device objects, which can be
+ * 				reallocated by the function like in #comm_registerDevice.
+ * @param data Array of device data.
+ * @param count Number of devices.
+ * @param results Array where result of each device registration is written
+ * 				(#OBIX_SUCCESS or one of negative error codes).
+ * @return Function should return #OBIX_SUCCESS if the request was processed
+ * 				(even if some of devices failed). Otherwise - one of negative
+ * 				error codes defined by #OBIX_ERRORCODE.
+ */
+typedef int (*comm_registerDevices)(Connection* connection,
+                                    Device** devices,
+                                    const char** data,
+                                    int count,
+                                    int* results);
+
 /**
  * Prototype of a function, which should unregister device from oBIX server
  * using provided connection.
@@ -258,6 +288,8 @@ struct _Comm_Stack
     comm_freeConnection freeConnection;
     /** See #comm_registerDevice */
     comm_registerDevice registerDevice;
+    /** See #comm_registerDevices */
+    comm_registerDevices registerDevices;
     /** See #comm_unregisterDevice */
     comm_unregisterDevice unregisterDevice;
     /** See #comm_registerListener */
@@ -303,4 +335,21 @@ int connection_get(int connectionId,
  */
 int device_get(Connection* connection, int deviceId, Device** device);
 
+/**
+ * Frees the common part of the Connection object (including all registered
+ * devices) after communication type-specific part is freed. Used by
+ * communication layers which postpone #comm_freeConnection.
+ */
+void connection_release(Connection* connection);
+
+/**
+ * Sets stack of functions, which is used by connections of type @a "local".
+ * The stack is provided by a separate library, so that the client library
+ * itself does not depend on the server.
+ *
+ * @param stack Local communication stack, or @a NULL to disable local
+ *              connections.
+ */
+void obix_setLocalCommStack(const Comm_Stack* stack);
+
 #endif /* OBIX_COMM_H_ */
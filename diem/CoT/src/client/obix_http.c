@@ -31,13 +31,15 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <ixml_ext.h>
 #include <xml_config.h>
 #include <log_utils.h>
 #include <curl_ext.h>
-#include <ptask.h>
 #include <obix_utils.h>
 #include <table.h>
+#include <probes.h>
 // TODO obix_client.h is included only for error codes
 #include "obix_client.h"
 #include "obix_batch.h"
@@ -47,44 +49,77 @@
 #define DEFAULT_POLLING_INTERVAL 500
 /** Default difference between Watch poll interval and Watch.lease time. */
 #define DEFAULT_WATCH_LEASE_PADDING 20000
+/** Delay before polling is resumed after several failed poll requests. */
+#define WATCH_POLL_RESUME_DELAY 15000
+/** Maximum time the polling thread sleeps without checking its schedule. */
+#define WATCH_POLL_MAX_SLEEP 1000
+/** Default maximum number of objects kept in the read cache. */
+#define DEFAULT_READ_CACHE_SIZE 32
+
+/** Object received by #http_read together with its entity tag. Items are
+ * kept in a list ordered by the last access, most recent first. */
+typedef struct _Read_Cache_Item
+{
+    char etag[CURL_EXT_ETAG_MAX];
+    IXML_Element* element;
+    /** URI of the object, which is the key of the item in the cache table. */
+    char* uri;
+    struct _Read_Cache_Item* prev;
+    struct _Read_Cache_Item* next;
+}
+Read_Cache_Item;
+
+/** @name States of Watch polling of a connection.
+ * @{ */
+/** Watch object of the connection is not polled. */
+#define WATCH_POLL_IDLE 0
+/** Next poll request is scheduled at Http_Connection::watchPollTime. */
+#define WATCH_POLL_WAITING 1
+/** Poll request is performed by the multi handle. */
+#define WATCH_POLL_ACTIVE 2
+/** Response of the poll request is being handled. */
+#define WATCH_POLL_DISPATCHING 3
+/** @} */
 
 /**
  * @name Templates of some oBIX objects, used in communication with the server.
- * These templates are represented as strings in order to improve processing
- * speed. There is also pre-calculated length for each template. This length
- * defines size of the static part of template. Thus the full size of
- * resulting object would be (static_length + length of all added strings).
+ * These templates are represented as string pieces which are appended to the
+ * request buffer of the CURL handle (see str_buffer.h) together with escaped
+ * values. Thus each request is composed in one pass without measuring its
+ * size beforehand.
  * @{
  */
 #define OBIX_WATCH_IN_TEMPLATE_HEADER ("<obj is=\"obix:WatchIn\">\r\n" \
 							           "  <list name=\"hrefs\" of=\"obix:Uri\">\r\n")
-#define OBIX_WATCH_IN_TEMPLATE_HEADER_LENGTH 62
-
-#define OBIX_WATCH_IN_TEMPLATE_URI "    <uri val=\"%s\"/>\r\n"
-#define OBIX_WATCH_IN_TEMPLATE_URI_LENGTH 19
-
+#define OBIX_WATCH_IN_TEMPLATE_URI_START "    <uri val=\""
+#define OBIX_WATCH_IN_TEMPLATE_URI_END "\"/>\r\n"
 #define OBIX_WATCH_IN_TEMPLATE_FOOTER ("  </list>\r\n" \
 							           "</obj>")
-#define OBIX_WATCH_IN_TEMPLATE_FOOTER_LENGTH 17
 
-#define OBIX_WRITE_REQUEST_TEMPLATE "<%s href=\"%s\" val=\"%s\"/>"
-#define OBIX_WRITE_REQUEST_TEMPLATE_LENGTH 18
+#define OBIX_WRITE_REQUEST_TEMPLATE_START "<"
+#define OBIX_WRITE_REQUEST_TEMPLATE_HREF " href=\""
+#define OBIX_WRITE_REQUEST_TEMPLATE_VAL "\" val=\""
+#define OBIX_WRITE_REQUEST_TEMPLATE_END "\"/>"
 
+#define OBIX_SIGN_UP_DEVICES_TEMPLATE_HEADER "<list of=\"obix:obj\">\r\n"
+#define OBIX_SIGN_UP_DEVICES_TEMPLATE_FOOTER "\r\n</list>"
+
+#define OBIX_UNREGISTER_TEMPLATE_START "<uri val=\""
+#define OBIX_UNREGISTER_TEMPLATE_END "\"/>"
 
 #define OBIX_BATCH_TEMPLATE_HEADER "<list is=\"obix:BatchIn\" of=\"obix:uri\">\r\n"
-#define OBIX_BATCH_TEMPLATE_HEADER_LENGTH 40
 #define OBIX_BATCH_TEMPLATE_FOOTER "</list>"
-#define OBIX_BATCH_TEMPLATE_FOOTER_LENGTH 7
-#define OBIX_BATCH_TEMPLATE_CMD_READ " <uri is=\"obix:Read\" val=\"%s\" />\r\n"
-#define OBIX_BATCH_TEMPLATE_CMD_READ_LENGTH 32
-#define OBIX_BATCH_TEMPLATE_CMD_WRITE (" <uri is=\"obix:Write\" val=\"%s\" >\r\n" \
-									   "  <%s name=\"in\" val=\"%s\"/>\r\n" \
-									   " </uri>\r\n")
-#define OBIX_BATCH_TEMPLATE_CMD_WRITE_LENGTH 65
-#define OBIX_BATCH_TEMPLATE_CMD_INVOKE (" <uri is=\"obix:Invoke\" val=\"%s\" >\r\n" \
-									    "  %s\r\n" \
-									    " </uri>\r\n")
-#define OBIX_BATCH_TEMPLATE_CMD_INVOKE_LENGTH 46
+#define OBIX_BATCH_TEMPLATE_CMD_READ_START " <uri is=\"obix:Read\" val=\""
+#define OBIX_BATCH_TEMPLATE_CMD_READ_END "\" />\r\n"
+#define OBIX_BATCH_TEMPLATE_CMD_WRITE_START " <uri is=\"obix:Write\" val=\""
+#define OBIX_BATCH_TEMPLATE_CMD_WRITE_IN "\" >\r\n  <"
+#define OBIX_BATCH_TEMPLATE_CMD_WRITE_VAL " name=\"in\" val=\""
+#define OBIX_BATCH_TEMPLATE_CMD_WRITE_END ("\"/>\r\n" \
+										   " </uri>\r\n")
+#define OBIX_BATCH_TEMPLATE_CMD_INVOKE_START " <uri is=\"obix:Invoke\" val=\""
+#define OBIX_BATCH_TEMPLATE_CMD_INVOKE_IN "\" >\r\n  "
+#define OBIX_BATCH_TEMPLATE_CMD_INVOKE_END ("\r\n" \
+											" </uri>\r\n")
 /** @} */
 
 /** Name of child object of WatchOut, which contains list of updates. */
@@ -111,6 +146,7 @@ const Comm_Stack OBIX_HTTP_COMM_STACK =
         &http_closeConnection,
         &http_freeConnection,
         &http_registerDevice,
+        &http_registerDevices,
         &http_unregisterDevice,
         &http_registerListener,
         &http_unregisterListener,
@@ -130,6 +166,7 @@ static const char* CT_WATCH_LEASE = "watch-lease";
 static const char* CT_LONG_POLL = "long-poll";
 static const char* CT_LONG_POLL_MIN = "min-interval";
 static const char* CT_LONG_POLL_MAX = "max-interval";
+static const char* CT_READ_CACHE_SIZE = "read-cache-size";
 static const char* CTA_LOBBY = "lobby";
 /** @} */
 
@@ -137,18 +174,41 @@ static const char* CTA_LOBBY = "lobby";
 static BOOL _initialized;
 /** Handle for all requests excluding Watch polling requests.*/
 static CURL_EXT* _curl_handle;
-/** Handle for Watch poll requests.
- * The reason for this is that used CURL handle is not thread safe, but Watch
- * objects are polling in the separate thread.
+/** Multi handle which performs Watch poll requests of all connections.
+ * Each connection has its own poll handle (Http_Connection::watchPollHandle),
+ * thus long poll requests to different servers are outstanding concurrently
+ * and a slow server does not delay updates from others.
  */
-static CURL_EXT* _curl_watch_handle;
-
-/** Thread used for Watch polling cycle. */
-static Task_Thread* _watchThread;
+static CURLM* _curl_multi;
+
+/** Thread used for Watch polling cycle of all connections. */
+static pthread_t _watchPollThread;
+/** Protects the list of polled connections and their poll states. */
+static pthread_mutex_t _watchPollMutex = PTHREAD_MUTEX_INITIALIZER;
+/** Signaled when polling of some connection is stopped. */
+static pthread_cond_t _watchPollCond = PTHREAD_COND_INITIALIZER;
+/** List of connections whose Watch objects are polled. */
+static Http_Connection* _watchPollList;
+/** Pipe used to wake up the polling thread from curl_multi_wait(). */
+static int _watchPollWakeupPipe[2] = {-1, -1};
+/** Tells polling thread to stop. */
+static BOOL _watchPollStop;
+/** Tells polling thread to release global resources when it stops, because
+ * the module was disposed from the thread itself. */
+static BOOL _watchPollDispose;
+
+/** @name SSL settings
+ * Stored in order to apply them to every created poll handle.
+ * @{ */
+static int _sslVerifyPeer = -1;
+static int _sslVerifyHost;
+static char* _sslCaFile;
+/** @} */
 
-// definitions of asynchronous tasks implemented later in this file
-void watchPollTaskResume(void* arg);
-void watchPollTask(void* arg);
+// definition of polling helpers implemented later in this file
+static void stopWatchPolling(Http_Connection* c);
+static void releaseConnection(Http_Connection* c);
+static void disposeModule();
 
 static Http_Connection* getHttpConnection(Connection* connection)
 {
@@ -363,42 +423,36 @@ static void resetWatchUris(Http_Connection* c)
 /**
  * Generates string representation of WatchIn object.
  *
+ * @param buffer Buffer where WatchIn object is written. Previous contents of
+ *               the buffer are dropped.
  * @param paramUri List of URIs which should be added to WatchIn object.
  * @param count Number of elements in @a paramUri list.
- * @return Generated WatchIn object, or @a NULL if error occurred.
+ * @return @a 0 on success, or @a -1 if there is not enough memory.
  */
-static char* getStrWatchIn(const char** paramUri, int count)
+static int getStrWatchIn(String_Buffer* buffer,
+                         const char** paramUri,
+                         int count)
 {
-    // calculate size of WatchIn object
-    int size = OBIX_WATCH_IN_TEMPLATE_HEADER_LENGTH;
-    int i;
-    for (i = 0; i < count; i++)
-    {
-        size += OBIX_WATCH_IN_TEMPLATE_URI_LENGTH + strlen(paramUri[i]);
-    }
-    size += OBIX_WATCH_IN_TEMPLATE_FOOTER_LENGTH + 1;
-
-    char* watchIn = (char*) malloc(size);
-    if (watchIn == NULL)
-    {
-        return NULL;
-    }
-
+    strbuf_reset(buffer);
     // print header
-    strcpy(watchIn, OBIX_WATCH_IN_TEMPLATE_HEADER);
-    size = OBIX_WATCH_IN_TEMPLATE_HEADER_LENGTH;
+    int error = strbuf_append(buffer, OBIX_WATCH_IN_TEMPLATE_HEADER);
     // print URIs
+    int i;
     for (i = 0; i < count; i++)
     {
-        size += sprintf(watchIn + size, OBIX_WATCH_IN_TEMPLATE_URI, paramUri[i]);
+        error += strbuf_append(buffer, OBIX_WATCH_IN_TEMPLATE_URI_START);
+        error += strbuf_appendXml(buffer, paramUri[i]);
+        error += strbuf_append(buffer, OBIX_WATCH_IN_TEMPLATE_URI_END);
     }
     // print footer
-    strcpy(watchIn + size, OBIX_WATCH_IN_TEMPLATE_FOOTER);
+    error += strbuf_append(buffer, OBIX_WATCH_IN_TEMPLATE_FOOTER);
 
-    return watchIn;
+    return (error == 0) ? 0 : -1;
 }
 
 /** Performs write request to oBIX server.
+ * Request body is composed in the request buffer of @a curlHandle, which is
+ * reused by all requests of the handle.
  * @return #OBIX_SUCCESS, or one of error codes defined by #OBIX_ERRORCODE.
  */
 static int writeValue(const char* paramUri,
@@ -407,25 +461,25 @@ static int writeValue(const char* paramUri,
                       CURL_EXT* curlHandle)
 {
     // generate request body
-    const char* objName = obix_getDataTypeName(dataType);
-    char* requestBody = (char*)
-                        malloc(OBIX_WRITE_REQUEST_TEMPLATE_LENGTH
-                               + strlen(objName)
-                               + strlen(paramUri)
-                               + strlen(newValue) + 1);
-    if (requestBody == NULL)
+    String_Buffer* requestBody = curlHandle->requestBuffer;
+    strbuf_reset(requestBody);
+    int error = strbuf_append(requestBody, OBIX_WRITE_REQUEST_TEMPLATE_START);
+    error += strbuf_append(requestBody, obix_getDataTypeName(dataType));
+    error += strbuf_append(requestBody, OBIX_WRITE_REQUEST_TEMPLATE_HREF);
+    error += strbuf_appendXml(requestBody, paramUri);
+    error += strbuf_append(requestBody, OBIX_WRITE_REQUEST_TEMPLATE_VAL);
+    error += strbuf_appendXml(requestBody, newValue);
+    error += strbuf_append(requestBody, OBIX_WRITE_REQUEST_TEMPLATE_END);
+    if (error != 0)
     {
         log_error("Unable to write to the oBIX server: "
                   "Not enough memory.");
         return OBIX_ERR_NO_MEMORY;
     }
-    sprintf(requestBody, OBIX_WRITE_REQUEST_TEMPLATE,
-            objName, paramUri, newValue);
 
     // send request
-    curlHandle->outputBuffer = requestBody;
-    int error = curl_ext_put(curlHandle, paramUri);
-    free(requestBody);
+    curlHandle->outputBuffer = strbuf_getString(requestBody);
+    error = curl_ext_put(curlHandle, paramUri);
     if (error != 0)
     {
         log_error("Unable to write to the server %s: "
@@ -526,16 +580,13 @@ static int addWatchItems(Http_Connection* c,
     char fullWatchAddUri[c->serverUriLength + strlen(watchAddUri) + 1];
     strcpy(fullWatchAddUri, c->serverUri);
     strcat(fullWatchAddUri, watchAddUri);
-    char *requestBody = getStrWatchIn(paramUri, count);
-
-    if (requestBody == NULL)
+    if (getStrWatchIn(curlHandle->requestBuffer, paramUri, count) != 0)
     {
         log_error("Unable to register new listener: Not enough memory.");
         return OBIX_ERR_NO_MEMORY;
     }
-    curlHandle->outputBuffer = requestBody;
+    curlHandle->outputBuffer = strbuf_getString(curlHandle->requestBuffer);
     int error = curl_ext_postDOM(curlHandle, fullWatchAddUri, response);
-    free(requestBody);
 
     if (error != 0)
     {
@@ -657,9 +708,9 @@ static void deleteWatchFromServer(Http_Connection* c)
                             + strlen(c->watchDeleteUri) + 1];
     strcpy(watchDeleteFullUri, c->serverUri);
     strcat(watchDeleteFullUri, c->watchDeleteUri);
-    _curl_handle->outputBuffer = NULL;
+    c->requestHandle->outputBuffer = NULL;
     IXML_Document* response;
-    int error = curl_ext_postDOM(_curl_handle,
+    int error = curl_ext_postDOM(c->requestHandle,
                                  watchDeleteFullUri,
                                  &response);
     if (error != 0)
@@ -718,22 +769,12 @@ static int removeWatch(Http_Connection* c)
                     "Some subscribed listeners can stop receiving updates.");
     }
 
-    // change poll task properties so that it will be executed only once
-    int error = ptask_reschedule(_watchThread, c->watchPollTaskId, 0, 1, TRUE);
-    if (error != 0)
-    {
-        log_error("Unable to cancel Watch Poll Task:"
-                  "ptask_reschedule() returned %d", error);
-        return error;
-    }
+    // stop polling and wait if the poll response is handled right now;
+    // outstanding poll request is aborted.
+    stopWatchPolling(c);
 
     deleteWatchFromServer(c);
 
-    // stop polling task and wait for it if it is executing right now
-    // ignore error - we just want make sure that the task is canceled
-    // but it can be canceled earlier
-    ptask_cancel(_watchThread, c->watchPollTaskId, TRUE);
-
     // reset all Watch related variables, because they are no longer valid
     pthread_mutex_lock(&(c->watchMutex));
     resetWatchUris(c);
@@ -1268,6 +1309,8 @@ static int parseWatchOut(IXML_Document* doc,
         {
             log_error("Unable to find listener for the object with URI \"%s\".", uri);
             retVal = OBIX_ERR_BAD_CONNECTION;
+            // ignore this node
+            continue;
         }
 
         // execute callback function
@@ -1290,7 +1333,18 @@ static void resetWatchPollErrorCount(Http_Connection* c)
     c->watchPollErrorCount = 0;
 }
 
-static void handleWatchPollError(int error, Http_Connection* c)
+/** Returns delay between the end of one poll request and the next one. */
+static long getWatchPollInterval(Http_Connection* c)
+{
+    // long poll requests are sent one after another without any delay
+    return (c->pollWaitMax == 0) ? c->pollInterval : 0;
+}
+
+/**
+ * Handles failed poll request.
+ * @return Delay in milliseconds before next poll request.
+ */
+static long handleWatchPollError(int error, Http_Connection* c)
 {
     log_error("Watch Poll Task: "
               "Error occurred while parsing WatchOut object (error %d).",
@@ -1301,25 +1355,13 @@ static void handleWatchPollError(int error, Http_Connection* c)
     {
         log_error("Last 3 poll requests to %s failed. Probably connection with "
                   "the server is lost. "
-                  "Server polling will be resumed after 1 minute.",
-                  c->serverUri);
-
-        if (ptask_cancel(_watchThread, c->watchPollTaskId, FALSE) != 0)
-        {
-            log_error("Unable to delete Watch poll task.");
-            return;
-        }
-        int ptaskId =
-            ptask_schedule(_watchThread, &watchPollTaskResume, c, 15000, 1);
-        if (ptaskId < 0)
-        {
-            log_error("Internal error: Unable to schedule new Watch poll task. "
-                      "Watch polling will not be restarted, i.e. client will "
-                      "not receive any new updates!");
-            return;
-        }
+                  "Server polling will be resumed after %d seconds.",
+                  c->serverUri, WATCH_POLL_RESUME_DELAY / 1000);
+        resetWatchPollErrorCount(c);
+        return WATCH_POLL_RESUME_DELAY;
     }
 
+    return getWatchPollInterval(c);
 }
 
 static int checkWatchPollResponse(Http_Connection* c,
@@ -1352,99 +1394,412 @@ static int checkWatchPollResponse(Http_Connection* c,
     return error;
 }
 
+/** Sets time of the next poll request. Should be called with
+ * _watchPollMutex locked. */
+static void setWatchPollTime(Http_Connection* c, long delay)
+{
+    clock_gettime(CLOCK_MONOTONIC, &(c->watchPollTime));
+    c->watchPollTime.tv_sec += delay / 1000;
+    c->watchPollTime.tv_nsec += (delay % 1000) * 1000000;
+    if (c->watchPollTime.tv_nsec >= 1000000000)
+    {
+        c->watchPollTime.tv_sec++;
+        c->watchPollTime.tv_nsec -= 1000000000;
+    }
+    c->watchPollState = WATCH_POLL_WAITING;
+}
+
+/** Interrupts curl_multi_wait() in polling thread, so that it would
+ * reconsider its schedule. */
+static void wakeupWatchPollThread()
+{
+    // pipe is non-blocking: if it is full, the thread is woken up anyway
+    if (write(_watchPollWakeupPipe[1], "w", 1) < 0)
+    {
+        log_debug("Watch polling thread is already signaled.");
+    }
+}
+
+/** Adds connection to the list of polled connections. */
 static int scheduleWatchPollTask(Http_Connection* c)
 {
+    pthread_mutex_lock(&_watchPollMutex);
     resetWatchPollErrorCount(c);
-    long pollInterval = (c->pollWaitMax == 0) ? c->pollInterval : 0;
-    int ptaskId = ptask_schedule(_watchThread, &watchPollTask, c,
-                                 pollInterval, EXECUTE_INDEFINITE);
-    if (ptaskId < 0)
+    c->watchPollCancel = FALSE;
+    // polling can be still running if it was stopped from a listener
+    // callback, then it will be simply continued.
+    if (c->watchPollState == WATCH_POLL_IDLE)
     {
-        log_error("Unable to schedule Watch Poll Task: Not enough memory.");
-        return OBIX_ERR_NO_MEMORY;
+        c->watchPollNext = _watchPollList;
+        _watchPollList = c;
+        setWatchPollTime(c, getWatchPollInterval(c));
+        wakeupWatchPollThread();
     }
-    c->watchPollTaskId = ptaskId;
+    pthread_mutex_unlock(&_watchPollMutex);
+
     return OBIX_SUCCESS;
 }
 
-void watchPollTaskResume(void* arg)
+/** Stops polling of Watch object of the connection. If poll response is
+ * handled at the moment, waits until it is finished. */
+static void stopWatchPolling(Http_Connection* c)
 {
-    Http_Connection* c = (Http_Connection*) arg;
-
-    int error = scheduleWatchPollTask(c);
-    if (error != OBIX_SUCCESS)
-    {
-        log_error("Watch Poll Task is not scheduled! No updates from the "
-                  "server will be received!");
+    pthread_mutex_lock(&_watchPollMutex);
+    if (c->watchPollState != WATCH_POLL_IDLE)
+    {
+        c->watchPollCancel = TRUE;
+        wakeupWatchPollThread();
+        // listeners are called from the polling thread itself, which can't
+        // wait for itself. It will drop the connection when the callback
+        // returns.
+        if (!pthread_equal(pthread_self(), _watchPollThread))
+        {
+            while (c->watchPollState != WATCH_POLL_IDLE)
+            {
+                pthread_cond_wait(&_watchPollCond, &_watchPollMutex);
+            }
+        }
     }
+    pthread_mutex_unlock(&_watchPollMutex);
 }
 
 /**
- * Calls Watch.pollChanges at the server and handles response.
+ * Sends Watch.pollChanges request of provided connection to the multi handle.
+ * Called by polling thread with _watchPollMutex locked.
  */
-void watchPollTask(void* arg)
+static void startWatchPoll(Http_Connection* c)
 {
-    Http_Connection* c = (Http_Connection*) arg;
-
-    pthread_mutex_lock(&(c->watchMutex));
+    // Watch URIs are changed either when polling is stopped or by the polling
+    // thread itself, so it is safe to read them without watchMutex here.
     if (c->watchPollChangesFullUri == NULL)
     {
         log_error("Watch Poll Task: Someone deleted Watch object but did not "
-                  "cancel the poll task.");
-        if (ptask_cancel(_watchThread, c->watchPollTaskId, FALSE) != 0)
-        {
-            log_error("Watch Poll Task: Unable to delete myself.");
-        }
-        pthread_mutex_unlock(&(c->watchMutex));
+                  "stop polling.");
+        c->watchPollCancel = TRUE;
         return;
     }
 
-    // we copy URI so that we could release mutex before sending HTTP requests
-    // if we don't copy URI than someone can be lucky enough to delete watchUri
-    // string before curl_ext_postDOM. We can't hold mutex during request
-    // because long poll requests can take considerable amount of time.
-    char watchPollChangesUri[strlen(c->watchPollChangesFullUri) + 1];
-    strcpy(watchPollChangesUri, c->watchPollChangesFullUri);
-    pthread_mutex_unlock(&(c->watchMutex));
+    log_debug("requesting %s", c->watchPollChangesFullUri);
+    c->watchPollHandle->outputBuffer = NULL;
+    // requests of custom transports are sent immediately, their responses
+    // are awaited together with the multi handle
+    int error = curl_ext_preparePost(c->watchPollHandle,
+                                     c->watchPollChangesFullUri);
+    if ((error == 0) && (c->watchPollHandle->transport == NULL)
+            && (curl_multi_add_handle(_curl_multi, c->watchPollHandle->curl)
+                != CURLM_OK))
+    {
+        curl_ext_abort(c->watchPollHandle, c->watchPollChangesFullUri);
+        error = -1;
+    }
+    if (error != 0)
+    {
+        log_error("Watch Poll Task: Unable to start poll request to %s.",
+                  c->watchPollChangesFullUri);
+        setWatchPollTime(c, handleWatchPollError(OBIX_ERR_HTTP_LIB, c));
+        return;
+    }
 
-    log_debug("requesting %s", watchPollChangesUri);
-    IXML_Document* response;
+    c->watchPollState = WATCH_POLL_ACTIVE;
+    OBIX_PROBE1(watch__poll__start, c->watchPollChangesFullUri);
+}
 
-    _curl_watch_handle->outputBuffer = NULL;
-    int error = curl_ext_postDOM(_curl_watch_handle,
-                                 watchPollChangesUri,
-                                 &response);
+/**
+ * Handles completed Watch.pollChanges request: parses WatchOut object and
+ * calls listeners of updated objects.
+ * @return Delay in milliseconds before next poll request.
+ */
+static long handleWatchPollResponse(Http_Connection* c, CURLcode result)
+{
+    IXML_Document* response = NULL;
+    int error = curl_ext_finishDOM(c->watchPollHandle,
+                                   c->watchPollChangesFullUri,
+                                   result,
+                                   &response);
     if (error != 0)
     {
         log_error("Watch Poll Task: "
                   "Unable to poll changes from the server %s.",
-                  watchPollChangesUri);
-        handleWatchPollError(OBIX_ERR_BAD_CONNECTION, c);
-        return;
+                  c->watchPollChangesFullUri);
+        return handleWatchPollError(OBIX_ERR_BAD_CONNECTION, c);
     }
 
-    error = checkWatchPollResponse(c, &response, _curl_watch_handle);
+    // poll handle is not used by the multi handle now, so it can be reused
+    // for blocking requests sent during response handling.
+    error = checkWatchPollResponse(c, &response, c->watchPollHandle);
     if (error != OBIX_SUCCESS)
     {
         if (response != NULL)
         {
             ixmlDocument_free(response);
         }
-        handleWatchPollError(error, c);
-        return;
+        return handleWatchPollError(error, c);
     }
 
-    error = parseWatchOut(response, c, _curl_watch_handle);
+    error = parseWatchOut(response, c, c->watchPollHandle);
+    ixmlDocument_free(response);
     if (error != OBIX_SUCCESS)
     {
-        ixmlDocument_free(response);
-        handleWatchPollError(error, c);
-        return;
+        return handleWatchPollError(error, c);
     }
 
     // everything was OK
-    ixmlDocument_free(response);
     resetWatchPollErrorCount(c);
+    return getWatchPollInterval(c);
+}
+
+/**
+ * Handles completed poll request of the connection, unless it was aborted
+ * meanwhile.
+ */
+static void dispatchWatchPoll(Http_Connection* c, CURLcode result)
+{
+    pthread_mutex_lock(&_watchPollMutex);
+    if (c->watchPollState != WATCH_POLL_ACTIVE)
+    {   // request was aborted: the polling cycle has already called
+        // curl_ext_abort(), which also closed the connection of a custom
+        // transport, so no stale response is left there
+        pthread_mutex_unlock(&_watchPollMutex);
+        return;
+    }
+    if (c->watchPollHandle->transport == NULL)
+    {
+        curl_multi_remove_handle(_curl_multi, c->watchPollHandle->curl);
+    }
+    c->watchPollState = WATCH_POLL_DISPATCHING;
+    BOOL canceled = c->watchPollCancel;
+    pthread_mutex_unlock(&_watchPollMutex);
+
+    // listeners are called without any lock held, so that they could
+    // use other client API functions
+    long delay = 0;
+    if (!canceled)
+    {
+        delay = handleWatchPollResponse(c, result);
+    }
+    else
+    {
+        // the response is not needed, but it can't be left unread: the next
+        // request of a custom transport would receive it instead of its own
+        // answer. Aborting drops the connection, which is reopened on the
+        // next request.
+        curl_ext_abort(c->watchPollHandle, c->watchPollChangesFullUri);
+    }
+    OBIX_PROBE2(watch__poll__done, c->watchPollChangesFullUri, result);
+
+    pthread_mutex_lock(&_watchPollMutex);
+    setWatchPollTime(c, delay);
+    pthread_mutex_unlock(&_watchPollMutex);
+}
+
+/**
+ * Performs poll requests which are added to the multi handle and dispatches
+ * all completed ones.
+ * @param timeout Maximum time in milliseconds to wait for network activity.
+ * @param customPolls Connections with custom transport, which wait for poll
+ *                    response.
+ * @param customCount Number of connections in @a customPolls.
+ */
+static void performWatchPolls(long timeout,
+                              Http_Connection** customPolls,
+                              int customCount)
+{
+    int running;
+    int i;
+    // wakeup pipe is followed by descriptors of custom transports
+    struct curl_waitfd waitFds[customCount + 1];
+    waitFds[0].fd = _watchPollWakeupPipe[0];
+    waitFds[0].events = CURL_WAIT_POLLIN;
+    waitFds[0].revents = 0;
+    for (i = 0; i < customCount; i++)
+    {
+        waitFds[i + 1].fd = customPolls[i]->watchPollHandle->transportFd;
+        waitFds[i + 1].events = CURL_WAIT_POLLIN;
+        waitFds[i + 1].revents = 0;
+    }
+
+    curl_multi_perform(_curl_multi, &running);
+    CURLMcode code = curl_multi_wait(_curl_multi, waitFds, customCount + 1,
+                                     (int) timeout, NULL);
+    if (code != CURLM_OK)
+    {
+        log_error("Watch Poll Task: curl_multi_wait() returned %d.", code);
+    }
+    if (waitFds[0].revents != 0)
+    {
+        // empty the wakeup pipe
+        char buffer[16];
+        while (read(_watchPollWakeupPipe[0], buffer, sizeof(buffer)) > 0);
+    }
+
+    for (i = 0; i < customCount; i++)
+    {
+        if (waitFds[i + 1].revents != 0)
+        {
+            dispatchWatchPoll(customPolls[i], CURLE_OK);
+        }
+    }
+
+    curl_multi_perform(_curl_multi, &running);
+
+    CURLMsg* message;
+    int messagesLeft;
+    while ((message = curl_multi_info_read(_curl_multi, &messagesLeft)) != NULL)
+    {
+        if (message->msg != CURLMSG_DONE)
+        {
+            continue;
+        }
+        // message is not valid after the handle is removed
+        CURLcode result = message->data.result;
+        char* privateData = NULL;
+        curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &privateData);
+
+        dispatchWatchPoll((Http_Connection*) privateData, result);
+    }
+}
+
+/**
+ * Watch polling cycle. Sends poll requests of all connections according to
+ * their schedule and handles responses as soon as they arrive.
+ */
+static void* watchPollThreadCycle(void* arg)
+{
+    // connections which were freed while they were polled
+    Http_Connection* released = NULL;
+
+    pthread_mutex_lock(&_watchPollMutex);
+    while (!_watchPollStop)
+    {
+        long timeout = WATCH_POLL_MAX_SLEEP;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        Http_Connection** link = &_watchPollList;
+        while (*link != NULL)
+        {
+            Http_Connection* c = *link;
+            if (c->watchPollCancel)
+            {
+                // remove connection from the polling list
+                if (c->watchPollState == WATCH_POLL_ACTIVE)
+                {
+                    if (c->watchPollHandle->transport == NULL)
+                    {
+                        curl_multi_remove_handle(_curl_multi,
+                                                 c->watchPollHandle->curl);
+                    }
+                    curl_ext_abort(c->watchPollHandle,
+                                   c->watchPollChangesFullUri);
+                }
+                *link = c->watchPollNext;
+                c->watchPollNext = NULL;
+                c->watchPollCancel = FALSE;
+                c->watchPollState = WATCH_POLL_IDLE;
+                pthread_cond_broadcast(&_watchPollCond);
+                if (c->watchPollRelease)
+                {
+                    c->watchPollNext = released;
+                    released = c;
+                }
+                continue;
+            }
+
+            if (c->watchPollState == WATCH_POLL_WAITING)
+            {
+                long delay =
+                    (c->watchPollTime.tv_sec - now.tv_sec) * 1000
+                    + (c->watchPollTime.tv_nsec - now.tv_nsec) / 1000000;
+                if (delay <= 0)
+                {
+                    startWatchPoll(c);
+                }
+                else if (delay < timeout)
+                {
+                    timeout = delay;
+                }
+            }
+            link = &(c->watchPollNext);
+        }
+
+        // collect connections with custom transport, which wait for
+        // response. They can't be removed from the list until this thread
+        // marks them idle, so it is safe to use them without lock.
+        Http_Connection* c;
+        int customCount = 0;
+        for (c = _watchPollList; c != NULL; c = c->watchPollNext)
+        {
+            if ((c->watchPollState == WATCH_POLL_ACTIVE)
+                    && (c->watchPollHandle->transport != NULL))
+            {
+                customCount++;
+            }
+        }
+        Http_Connection* customPolls[customCount + 1];
+        customCount = 0;
+        for (c = _watchPollList; c != NULL; c = c->watchPollNext)
+        {
+            if ((c->watchPollState == WATCH_POLL_ACTIVE)
+                    && (c->watchPollHandle->transport != NULL))
+            {
+                customPolls[customCount++] = c;
+            }
+        }
+        pthread_mutex_unlock(&_watchPollMutex);
+
+        // connections are not used by anybody anymore, so they can be
+        // released now, when no poll response is dispatched
+        while (released != NULL)
+        {
+            c = released;
+            released = c->watchPollNext;
+            c->watchPollNext = NULL;
+            releaseConnection(c);
+        }
+
+        performWatchPolls(timeout, customPolls, customCount);
+
+        pthread_mutex_lock(&_watchPollMutex);
+    }
+
+    // release connections which were freed before the thread was stopped
+    Http_Connection** link = &_watchPollList;
+    while (*link != NULL)
+    {
+        Http_Connection* c = *link;
+        if (c->watchPollRelease)
+        {
+            if ((c->watchPollState == WATCH_POLL_ACTIVE)
+                    && (c->watchPollHandle->transport == NULL))
+            {
+                curl_multi_remove_handle(_curl_multi,
+                                         c->watchPollHandle->curl);
+            }
+            *link = c->watchPollNext;
+            c->watchPollNext = released;
+            c->watchPollState = WATCH_POLL_IDLE;
+            released = c;
+        }
+        else
+        {
+            link = &(c->watchPollNext);
+        }
+    }
+    pthread_mutex_unlock(&_watchPollMutex);
+
+    while (released != NULL)
+    {
+        Http_Connection* c = released;
+        released = c->watchPollNext;
+        c->watchPollNext = NULL;
+        releaseConnection(c);
+    }
+
+    if (_watchPollDispose)
+    {
+        disposeModule();
+    }
+    return NULL;
 }
 
 /** Adds provided listener to local database.
@@ -1461,7 +1816,7 @@ static int addListener(Http_Connection* c,
     if (c->watchAddUri == NULL)
     {
         // create new one
-        int error = createWatch(c, _curl_handle);
+        int error = createWatch(c, c->requestHandle);
         if (error != OBIX_SUCCESS)
         {
             pthread_mutex_unlock(&(c->watchMutex));
@@ -1649,14 +2004,124 @@ static int configureSSL(IXML_Element* settings)
 
     // now set parsed settings
     int error = curl_ext_setSSL(_curl_handle, verifyPeer, verifyHost, caFile);
-    error +=
-        curl_ext_setSSL(_curl_watch_handle, verifyPeer, verifyHost, caFile);
-
     if (error != 0)
     {
         return OBIX_ERR_UNKNOWN_BUG;
     }
 
+    // store settings for poll handles, which are created for each connection
+    _sslVerifyPeer = verifyPeer;
+    _sslVerifyHost = verifyHost;
+    // settings can be loaded again after the module was disposed
+    if (_sslCaFile != NULL)
+    {
+        free(_sslCaFile);
+        _sslCaFile = NULL;
+    }
+    if (caFile != NULL)
+    {
+        _sslCaFile = (char*) malloc(strlen(caFile) + 1);
+        if (_sslCaFile == NULL)
+        {
+            log_error("Unable to allocate enough memory.");
+            return OBIX_ERR_NO_MEMORY;
+        }
+        strcpy(_sslCaFile, caFile);
+    }
+
+    return OBIX_SUCCESS;
+}
+
+/**
+ * Creates handles for the requests of connection with custom transport.
+ * @param address Server address, which is passed to the transport.
+ */
+static int createCustomHandles(Http_Connection* c,
+                               const char* address,
+                               http_create_handle createHandle)
+{
+    int error = (*createHandle)(address, &(c->watchPollHandle));
+    if (error != OBIX_SUCCESS)
+    {
+        c->watchPollHandle = NULL;
+        return error;
+    }
+
+    error = (*createHandle)(address, &(c->requestHandle));
+    if (error != OBIX_SUCCESS)
+    {
+        curl_ext_free(c->watchPollHandle);
+        c->watchPollHandle = NULL;
+        c->requestHandle = NULL;
+        return error;
+    }
+
+    return OBIX_SUCCESS;
+}
+
+/** Creates CURL handle for Watch poll requests of the connection. */
+static int createWatchPollHandle(Http_Connection* c)
+{
+    c->requestHandle = _curl_handle;
+    int error = curl_ext_create(&(c->watchPollHandle));
+    if (error != 0)
+    {
+        c->watchPollHandle = NULL;
+        return (error == -2) ? OBIX_ERR_NO_MEMORY : OBIX_ERR_HTTP_LIB;
+    }
+
+    if ((_sslVerifyPeer >= 0)
+            && (curl_ext_setSSL(c->watchPollHandle, _sslVerifyPeer,
+                                _sslVerifyHost, _sslCaFile) != 0))
+    {
+        curl_ext_free(c->watchPollHandle);
+        c->watchPollHandle = NULL;
+        return OBIX_ERR_HTTP_LIB;
+    }
+
+    // polling thread finds the connection by the handle
+    CURLcode code = curl_easy_setopt(c->watchPollHandle->curl,
+                                     CURLOPT_PRIVATE, c);
+    if (code != CURLE_OK)
+    {
+        log_error("Unable to initialize Watch poll handle (%d).", code);
+        curl_ext_free(c->watchPollHandle);
+        c->watchPollHandle = NULL;
+        return OBIX_ERR_HTTP_LIB;
+    }
+
+    return OBIX_SUCCESS;
+}
+
+/** Creates multi handle and starts the thread which polls Watch objects of
+ * all connections. */
+static int startWatchPollThread()
+{
+    _curl_multi = curl_multi_init();
+    if (_curl_multi == NULL)
+    {
+        log_error("Unable to initialize CURL multi handle.");
+        return OBIX_ERR_HTTP_LIB;
+    }
+
+    if ((pipe(_watchPollWakeupPipe) != 0)
+            || (fcntl(_watchPollWakeupPipe[0], F_SETFL, O_NONBLOCK) != 0)
+            || (fcntl(_watchPollWakeupPipe[1], F_SETFL, O_NONBLOCK) != 0))
+    {
+        log_error("Unable to create wakeup pipe for Watch polling thread.");
+        return OBIX_ERR_HTTP_LIB;
+    }
+
+    _watchPollStop = FALSE;
+    _watchPollDispose = FALSE;
+    _watchPollList = NULL;
+    if (pthread_create(&_watchPollThread, NULL,
+                       &watchPollThreadCycle, NULL) != 0)
+    {
+        log_error("Unable to start Watch polling thread.");
+        return OBIX_ERR_HTTP_LIB;
+    }
+
     return OBIX_SUCCESS;
 }
 
@@ -1674,8 +2139,8 @@ int http_init(IXML_Element* settings)
     {
         return OBIX_ERR_HTTP_LIB;
     }
-    // initialize 2 curl handles: one for watch polling thread
-    // and one for other calls.
+    // initialize curl handle for all calls except watch polling. Poll handles
+    // are created for each connection.
     error = curl_ext_create(&_curl_handle);
     if (error != 0)
     {
@@ -1685,15 +2150,6 @@ int http_init(IXML_Element* settings)
         }
         return OBIX_ERR_HTTP_LIB;
     }
-    error = curl_ext_create(&_curl_watch_handle);
-    if (error != 0)
-    {
-        if (error == -2)
-        {
-            return OBIX_ERR_NO_MEMORY;
-        }
-        return OBIX_ERR_HTTP_LIB;
-    }
 
     error = configureSSL(settings);
     if (error != OBIX_SUCCESS)
@@ -1702,44 +2158,78 @@ int http_init(IXML_Element* settings)
     }
 
     // uncomment this to get lot's of debug log from CURL
-    //    curl_easy_setopt(_curl_watch_handle->curl, CURLOPT_VERBOSE, 1L);
-    //    curl_easy_setopt(_curl_watch_handle->curl, CURLOPT_STDERR, stdout);
-    //
     //    curl_easy_setopt(_curl_handle->curl, CURLOPT_VERBOSE, 1L);
     //    curl_easy_setopt(_curl_handle->curl, CURLOPT_STDERR, stdout);
 
-    // initialize Periodic Task thread which will be used for watch polling
-    _watchThread = ptask_init();
-    if (_watchThread == NULL)
+    // initialize thread which will be used for watch polling
+    error = startWatchPollThread();
+    if (error != OBIX_SUCCESS)
     {
-        return OBIX_ERR_HTTP_LIB;
+        return error;
     }
 
     _initialized = TRUE;
     return OBIX_SUCCESS;
 }
 
-int http_dispose()
+/** Releases global resources of the module after polling thread is
+ * stopped. */
+static void disposeModule()
 {
-    int retVal = 0;
-    if (_initialized)
+    curl_multi_cleanup(_curl_multi);
+    close(_watchPollWakeupPipe[0]);
+    close(_watchPollWakeupPipe[1]);
+    // destroy curl handles
+    curl_ext_free(_curl_handle);
+    // stop curl library
+    curl_ext_dispose();
+    if (_sslCaFile != NULL)
+    {
+        free(_sslCaFile);
+        _sslCaFile = NULL;
+    }
+}
+
+int http_dispose()
+{
+    int retVal = 0;
+    if (_initialized)
     {
-        // destroy curl handles
-        curl_ext_free(_curl_handle);
-        curl_ext_free(_curl_watch_handle);
-        // stop curl library
-        curl_ext_dispose();
-        // stop Periodic Task thread
-        retVal = ptask_dispose(_watchThread, TRUE);
+        // stop Watch polling thread
+        pthread_mutex_lock(&_watchPollMutex);
+        _watchPollStop = TRUE;
+        wakeupWatchPollThread();
+        if (pthread_equal(pthread_self(), _watchPollThread))
+        {
+            // called by a listener: the thread can't wait for itself, so it
+            // disposes the module when the listener returns
+            _watchPollDispose = TRUE;
+            pthread_mutex_unlock(&_watchPollMutex);
+            retVal = pthread_detach(_watchPollThread);
+        }
+        else
+        {
+            pthread_mutex_unlock(&_watchPollMutex);
+            retVal = pthread_join(_watchPollThread, NULL);
+            disposeModule();
+        }
     }
 
     _initialized = FALSE;
     return (retVal == 0) ? OBIX_SUCCESS : OBIX_ERR_UNKNOWN_BUG;
 }
 
-int http_initConnection(IXML_Element* connItem, Connection** connection)
+/**
+ * Loads connection settings and initializes connection object.
+ * @param createHandle Creates handles for custom transport. If @a NULL, the
+ *                     connection uses HTTP.
+ */
+static int initConnection(IXML_Element* connItem,
+                          Connection** connection,
+                          http_create_handle createHandle)
 {
     char* serverUri = NULL;
+    char* transportAddress = NULL;
     char* lobbyUri = NULL;
     Http_Connection* c;
     Table* table = NULL;
@@ -1747,12 +2237,15 @@ int http_initConnection(IXML_Element* connItem, Connection** connection)
     long watchLease;
     long pollWaitMin = 0;
     long pollWaitMax = 0;
+    long readCacheSize = DEFAULT_READ_CACHE_SIZE;
 
     // helper function for releasing resources on error
     void cleanup()
     {
         if (serverUri != NULL)
             free(serverUri);
+        if (transportAddress != NULL)
+            free(transportAddress);
         if (lobbyUri != NULL)
             free(lobbyUri);
         if (table != NULL)
@@ -1789,6 +2282,20 @@ int http_initConnection(IXML_Element* connItem, Connection** connection)
     }
     strncpy(serverUri, attrValue, serverUriLength);
     serverUri[serverUriLength] = '\0';
+    if (createHandle != NULL)
+    {
+        // server address is used only by transport, URIs are relative
+        transportAddress = serverUri;
+        serverUriLength = 0;
+        serverUri = (char*) malloc(1);
+        if (serverUri == NULL)
+        {
+            log_error("Unable to initialize connection: Not enough memory.");
+            cleanup();
+            return OBIX_ERR_NO_MEMORY;
+        }
+        *serverUri = '\0';
+    }
     // load Lobby object address
     attrValue = config_getTagAttributeValue(element, CTA_LOBBY, TRUE);
     if (attrValue == NULL)
@@ -1885,6 +2392,24 @@ int http_initConnection(IXML_Element* connItem, Connection** connection)
                          watchLease);
     }
 
+    // load maximum size of the read cache, 0 disables caching
+    element = config_getChildTag(connItem, CT_READ_CACHE_SIZE, FALSE);
+    if (element != NULL)
+    {
+        readCacheSize = config_getTagAttrLongValue(
+                            element,
+                            CTA_VALUE,
+                            FALSE,
+                            DEFAULT_READ_CACHE_SIZE);
+        if (readCacheSize < 0)
+        {
+            log_error("Configuration tag <%s/> should have non-negative "
+                      "value.", CT_READ_CACHE_SIZE);
+            cleanup();
+            return OBIX_ERR_INVALID_ARGUMENT;
+        }
+    }
+
     // allocate space for the connection object
     int listenerMaxCount = (*connection)->maxDevices * (*connection)->maxListeners;
     c = (Http_Connection*) realloc(*connection, sizeof(Http_Connection));
@@ -1905,10 +2430,29 @@ int http_initConnection(IXML_Element* connItem, Connection** connection)
         return OBIX_ERR_HTTP_LIB;
     }
 
+    int error;
+    if (createHandle == NULL)
+    {
+        error = createWatchPollHandle(c);
+    }
+    else
+    {
+        error = createCustomHandles(c, transportAddress, createHandle);
+    }
+    if (error != OBIX_SUCCESS)
+    {
+        log_error("Unable to initialize HTTP connection: "
+                  "Unable to create Watch poll handle.");
+        pthread_mutex_destroy(&(c->watchMutex));
+        cleanup();
+        return error;
+    }
+
     c->watchTable = table;
 
     c->serverUri = serverUri;
     c->serverUriLength = serverUriLength;
+    c->transportAddress = transportAddress;
     c->lobbyUri = lobbyUri;
     c->pollInterval = pollInterval;
     c->watchLease = watchLease;
@@ -1917,7 +2461,9 @@ int http_initConnection(IXML_Element* connItem, Connection** connection)
 
     // initialize other values with zeros
     c->signUpUri = NULL;
+    c->signUpDevicesUri = NULL;
     c->batchUri = NULL;
+    c->unregisterUri = NULL;
     c->watchMakeUri = NULL;
     c->watchAddUri = NULL;
     c->watchAddOperationUri = NULL;
@@ -1926,36 +2472,119 @@ int http_initConnection(IXML_Element* connItem, Connection** connection)
     c->watchPollChangesFullUri = NULL;
     c->watchRemoveUri = NULL;
 
+    c->readCache = NULL;
+    c->readCacheHead = NULL;
+    c->readCacheTail = NULL;
+    c->readCacheSize = readCacheSize;
+    c->watchPollErrorCount = 0;
+    c->watchPollState = WATCH_POLL_IDLE;
+    c->watchPollCancel = FALSE;
+    c->watchPollRelease = FALSE;
+    c->watchPollNext = NULL;
+
     return OBIX_SUCCESS;
 }
 
-void http_freeConnection(Connection* connection)
+int http_initConnection(IXML_Element* connItem, Connection** connection)
+{
+    return initConnection(connItem, connection, NULL);
+}
+
+int http_initCustomConnection(IXML_Element* connItem,
+                              Connection** connection,
+                              http_create_handle createHandle)
+{
+    return initConnection(connItem, connection, createHandle);
+}
+
+/** Frees all specific attributes of HTTP connection. */
+static void freeHttpConnection(Http_Connection* c)
 {
-    // free all specific attributes of HTTP connection
-    Http_Connection* c = getHttpConnection(connection);
     if (c->serverUri != NULL)
         free(c->serverUri);
+    if (c->transportAddress != NULL)
+        free(c->transportAddress);
     if (c->lobbyUri != NULL)
         free(c->lobbyUri);
     if (c->signUpUri != NULL)
         free(c->signUpUri);
+    if (c->signUpDevicesUri != NULL)
+        free(c->signUpDevicesUri);
     if (c->batchUri != NULL)
         free(c->batchUri);
+    if (c->unregisterUri != NULL)
+        free(c->unregisterUri);
     if (c->watchMakeUri != NULL)
         free(c->watchMakeUri);
+    // make sure that the connection is not polled anymore
+    stopWatchPolling(c);
     resetWatchUris(c);
+    if (c->watchPollHandle != NULL)
+    {
+        curl_ext_free(c->watchPollHandle);
+    }
+    // shared HTTP handle is freed by http_dispose()
+    if ((c->requestHandle != NULL) && (c->requestHandle != _curl_handle))
+    {
+        curl_ext_free(c->requestHandle);
+    }
     pthread_mutex_destroy(&(c->watchMutex));
     if (c->watchTable != 0)
     {
         table_free(c->watchTable);
     }
+    if (c->readCache != NULL)
+    {
+        Read_Cache_Item* item = c->readCacheHead;
+        while (item != NULL)
+        {
+            Read_Cache_Item* next = item->next;
+            ixmlElement_freeOwnerDocument(item->element);
+            free(item->uri);
+            free(item);
+            item = next;
+        }
+        table_free(c->readCache);
+    }
+}
+
+/** Frees connection, which was released by the polling thread. */
+static void releaseConnection(Http_Connection* c)
+{
+    log_debug("Releasing connection to the server %s.", c->serverUri);
+    freeHttpConnection(c);
+    connection_release(&(c->c));
+}
+
+int http_freeConnection(Connection* connection)
+{
+    Http_Connection* c = getHttpConnection(connection);
+
+    pthread_mutex_lock(&_watchPollMutex);
+    if ((c->watchPollState != WATCH_POLL_IDLE)
+            && pthread_equal(pthread_self(), _watchPollThread))
+    {
+        // called by a listener: polling thread still uses the connection
+        // when the listener returns, so it is released later by the thread
+        c->watchPollCancel = TRUE;
+        c->watchPollRelease = TRUE;
+        wakeupWatchPollThread();
+        pthread_mutex_unlock(&_watchPollMutex);
+        return 1;
+    }
+    pthread_mutex_unlock(&_watchPollMutex);
+
+    freeHttpConnection(c);
+    return 0;
 }
 
 int http_openConnection(Connection* connection)
 {
     char* signUpUri = NULL;
+    char* signUpDevicesUri = NULL;
     char* watchServiceUri = NULL;
     char* batchUri = NULL;
+    char* unregisterUri = NULL;
     IXML_Document* response = NULL;
 
     // helper function for releasing resources on error
@@ -1963,10 +2592,14 @@ int http_openConnection(Connection* connection)
     {
         if (signUpUri != NULL)
             free(signUpUri);
+        if (signUpDevicesUri != NULL)
+            free(signUpDevicesUri);
         if (watchServiceUri != NULL)
             free(watchServiceUri);
         if (batchUri != NULL)
             free(batchUri);
+        if (unregisterUri != NULL)
+            free(unregisterUri);
         if (response != NULL)
             ixmlDocument_free(response);
     }
@@ -1977,7 +2610,7 @@ int http_openConnection(Connection* connection)
     char lobbyFullUri[strlen(c->serverUri) + strlen(c->lobbyUri) + 1];
     strcpy(lobbyFullUri, c->serverUri);
     strcat(lobbyFullUri, c->lobbyUri);
-    curl_ext_getDOM(_curl_handle, lobbyFullUri, &response);
+    curl_ext_getDOM(c->requestHandle, lobbyFullUri, &response);
     int error = checkResponseDoc(response, NULL);
     if (error != OBIX_SUCCESS)
     {
@@ -1991,9 +2624,15 @@ int http_openConnection(Connection* connection)
     signUpUri = getObjectUri(response,
                              OBIX_NAME_SIGN_UP,
                              c, FALSE);
+    signUpDevicesUri = getObjectUri(response,
+                                    OBIX_NAME_SIGN_UP_DEVICES,
+                                    c, FALSE);
     batchUri = getObjectUri(response,
                             OBIX_NAME_BATCH,
                             c, FALSE);
+    unregisterUri = getObjectUri(response,
+                                 OBIX_NAME_UNREGISTER,
+                                 c, FALSE);
     watchServiceUri = getObjectUri(response,
                                    OBIX_NAME_WATCH_SERVICE,
                                    c, TRUE);
@@ -2008,7 +2647,7 @@ int http_openConnection(Connection* connection)
     // now get watchService object
     ixmlDocument_free(response);
     response = NULL;
-    curl_ext_getDOM(_curl_handle, watchServiceUri, &response);
+    curl_ext_getDOM(c->requestHandle, watchServiceUri, &response);
     error = checkResponseDoc(response, NULL);
     if (error != OBIX_SUCCESS)
     {
@@ -2031,7 +2670,9 @@ int http_openConnection(Connection* connection)
     ixmlDocument_free(response);
 
     c->signUpUri = signUpUri;
+    c->signUpDevicesUri = signUpDevicesUri;
     c->batchUri = batchUri;
+    c->unregisterUri = unregisterUri;
     c->watchMakeUri = watchServiceUri;
     return OBIX_SUCCESS;
 }
@@ -2051,6 +2692,35 @@ int http_closeConnection(Connection* connection)
     return retVal;
 }
 
+/**
+ * Creates HTTP device object with provided URI.
+ * @param device Generic device object, which is extended to #Http_Device.
+ * @return #OBIX_SUCCESS or #OBIX_ERR_NO_MEMORY.
+ */
+static int createHttpDevice(Device** device, const char* uri)
+{
+    Http_Device* d = (Http_Device*) realloc(*device, sizeof(Http_Device));
+    if (d == NULL)
+    {
+        log_error("Unable to create device: Not enough memory.");
+        return OBIX_ERR_NO_MEMORY;
+    }
+    *device = &(d->d);
+
+    char* deviceUri = (char*) malloc(strlen(uri) + 1);
+    if (deviceUri == NULL)
+    {
+        log_error("Unable to create device: Not enough memory.");
+        return OBIX_ERR_NO_MEMORY;
+    }
+
+    strcpy(deviceUri, uri);
+    d->uri = deviceUri;
+    d->uriLength = strlen(deviceUri);
+
+    return OBIX_SUCCESS;
+}
+
 int http_registerDevice(Connection* connection, Device** device, const char* data)
 {
     Http_Connection* c = getHttpConnection(connection);
@@ -2064,12 +2734,12 @@ int http_registerDevice(Connection* connection, Device** device, const char* dat
     }
 
     // register new device at the server
-    _curl_handle->outputBuffer = data;
+    c->requestHandle->outputBuffer = data;
     char signUpFullUri[c->serverUriLength + strlen(c->signUpUri) + 1];
     strcpy(signUpFullUri, c->serverUri);
     strcat(signUpFullUri, c->signUpUri);
     IXML_Document* response = NULL;
-    int error = curl_ext_postDOM(_curl_handle, signUpFullUri, &response);
+    int error = curl_ext_postDOM(c->requestHandle, signUpFullUri, &response);
     if (error != 0 || response == NULL)
     {
         log_error("Unable to register device using service at \"%s\".",
@@ -2110,7 +2780,7 @@ int http_registerDevice(Connection* connection, Device** device, const char* dat
         char* uri = ixmlCloneDOMString(attrValue);
         ixmlDocument_free(response);
         response = NULL;
-        curl_ext_getDOM(_curl_handle, uri, &response);
+        curl_ext_getDOM(c->requestHandle, uri, &response);
         int error = checkResponseDoc(response, &element);
         if (error != OBIX_SUCCESS)
         {
@@ -2139,48 +2809,185 @@ int http_registerDevice(Connection* connection, Device** device, const char* dat
     {
         ixmlDocument_free(response);
         log_error("Object in server response doesn't contain \"%s\" "
-                  "attribute:\n%s", OBIX_ATTR_HREF, _curl_handle->inputBuffer);
+                  "attribute:\n%s", OBIX_ATTR_HREF,
+                  c->requestHandle->inputBuffer);
         return OBIX_ERR_BAD_CONNECTION;
     }
     // remove server address from the uri
-    const char* uri = removeServerAddress(attrValue, c);
+    error = createHttpDevice(device, removeServerAddress(attrValue, c));
+    ixmlDocument_free(response);
+    return error;
+}
 
-    // create device object
-    Http_Device* d = (Http_Device*) realloc(*device, sizeof(Http_Device));
-    if (d == NULL)
+int http_registerDevices(Connection* connection,
+                         Device** devices,
+                         const char** data,
+                         int count,
+                         int* results)
+{
+    Http_Connection* c = getHttpConnection(connection);
+    int i;
+    if (c->signUpDevicesUri == NULL)
     {
-        ixmlDocument_free(response);
-        log_error("Unable to create device: Not enough memory.");
+        log_debug("oBIX server \"%s\" doesn't support signUpDevices "
+                  "operation. Registering devices one by one...",
+                  c->serverUri);
+        for (i = 0; i < count; i++)
+        {
+            results[i] = http_registerDevice(connection, &(devices[i]), data[i]);
+        }
+        return OBIX_SUCCESS;
+    }
+
+    log_debug("Registering %d devices at the server %s...",
+              count, c->serverUri);
+    // all devices are sent in one list
+    String_Buffer* requestBody = c->requestHandle->requestBuffer;
+    strbuf_reset(requestBody);
+    int error = strbuf_append(requestBody, OBIX_SIGN_UP_DEVICES_TEMPLATE_HEADER);
+    for (i = 0; i < count; i++)
+    {
+        // XML declaration is not allowed inside the list
+        const char* device = data[i];
+        if (strncmp(device, "<?", 2) == 0)
+        {
+            const char* end = strstr(device, "?>");
+            device = (end != NULL) ? end + 2 : device;
+        }
+        error += strbuf_append(requestBody, device);
+    }
+    error += strbuf_append(requestBody, OBIX_SIGN_UP_DEVICES_TEMPLATE_FOOTER);
+    if (error != 0)
+    {
+        log_error("Unable to register devices: Not enough memory.");
         return OBIX_ERR_NO_MEMORY;
     }
-    *device = &(d->d);
 
-    char* deviceUri = (char*) malloc(strlen(uri) + 1);
-    if (deviceUri == NULL)
+    char signUpFullUri[c->serverUriLength + strlen(c->signUpDevicesUri) + 1];
+    strcpy(signUpFullUri, c->serverUri);
+    strcat(signUpFullUri, c->signUpDevicesUri);
+    c->requestHandle->outputBuffer = strbuf_getString(requestBody);
+    IXML_Document* response = NULL;
+    error = curl_ext_postDOM(c->requestHandle, signUpFullUri, &response);
+    if ((error != 0) || (response == NULL))
+    {
+        log_error("Unable to register devices using service at \"%s\".",
+                  signUpFullUri);
+        return OBIX_ERR_BAD_CONNECTION;
+    }
+
+    IXML_Element* element;
+    error = checkResponseDoc(response, &element);
+    if (error != OBIX_SUCCESS)
     {
         ixmlDocument_free(response);
-        log_error("Unable to create device: Not enough memory.");
-        return OBIX_ERR_NO_MEMORY;
+        return error;
     }
 
-    strcpy(deviceUri, uri);
-    ixmlDocument_free(response);
-    d->uri = deviceUri;
-    d->uriLength = strlen(deviceUri);
+    // response contains a reference or an error for each device in the same
+    // order
+    IXML_Node* node = ixmlNode_getFirstChild(ixmlElement_getNode(element));
+    for (i = 0; i < count; i++)
+    {
+        IXML_Element* item = NULL;
+        for ( ; (node != NULL) && (item == NULL);
+                node = ixmlNode_getNextSibling(node))
+        {
+            item = ixmlNode_convertToElement(node);
+        }
+        if (item == NULL)
+        {
+            log_error("Server response doesn't contain results for all "
+                      "devices.");
+            results[i] = OBIX_ERR_BAD_CONNECTION;
+            continue;
+        }
 
+        const char* href = ixmlElement_getAttribute(item, OBIX_ATTR_HREF);
+        if (checkResponseElement(item) != OBIX_SUCCESS)
+        {
+            // the same workaround as in http_registerDevice: if the object
+            // already exists, we proceed with it
+            const char* display =
+                ixmlElement_getAttribute(item, OBIX_ATTR_DISPLAY);
+            if ((href == NULL) || (display == NULL)
+                    || (strstr(display, "already exists") == NULL))
+            {
+                results[i] = OBIX_ERR_SERVER_ERROR;
+                continue;
+            }
+            log_warning("Object \"%s\" already exists at oBIX server. "
+                        "Trying to proceed with it.", href);
+        }
+        else if (href == NULL)
+        {
+            log_error("Reference in server response doesn't contain \"%s\" "
+                      "attribute.", OBIX_ATTR_HREF);
+            results[i] = OBIX_ERR_BAD_CONNECTION;
+            continue;
+        }
+
+        results[i] =
+            createHttpDevice(&(devices[i]), removeServerAddress(href, c));
+    }
+
+    ixmlDocument_free(response);
     return OBIX_SUCCESS;
 }
 
 int http_unregisterDevice(Connection* connection, Device* device)
 {
-    // TODO implement me
-    log_debug("Unregistering device from the server %s",
-              getHttpConnection(connection)->serverUri);
-    log_warning("Unfortunately driver unregistering is not supported yet.");
-
+    Http_Connection* c = getHttpConnection(connection);
     Http_Device* d = getHttpDevice(device);
+    log_debug("Unregistering device \"%s\" from the server %s...",
+              d->uri, c->serverUri);
+
+    if (c->unregisterUri == NULL)
+    {
+        log_warning("oBIX server \"%s\" doesn't support unregister "
+                    "operation. Device data \"%s\" is left at the server.",
+                    c->serverUri, d->uri);
+        free(d->uri);
+        return OBIX_SUCCESS;
+    }
+
+    // generate request body
+    String_Buffer* requestBody = c->requestHandle->requestBuffer;
+    strbuf_reset(requestBody);
+    int error = strbuf_append(requestBody, OBIX_UNREGISTER_TEMPLATE_START);
+    error += strbuf_appendXml(requestBody, d->uri);
+    error += strbuf_append(requestBody, OBIX_UNREGISTER_TEMPLATE_END);
+    if (error != 0)
+    {
+        log_error("Unable to unregister device: Not enough memory.");
+        free(d->uri);
+        return OBIX_ERR_NO_MEMORY;
+    }
+
+    char unregisterFullUri[c->serverUriLength + strlen(c->unregisterUri) + 1];
+    strcpy(unregisterFullUri, c->serverUri);
+    strcat(unregisterFullUri, c->unregisterUri);
+    c->requestHandle->outputBuffer = strbuf_getString(requestBody);
+    IXML_Document* response = NULL;
+    error = curl_ext_postDOM(c->requestHandle, unregisterFullUri, &response);
+    if ((error != 0) || (response == NULL))
+    {
+        log_error("Unable to unregister device using service at \"%s\".",
+                  unregisterFullUri);
+        free(d->uri);
+        return OBIX_ERR_BAD_CONNECTION;
+    }
+
+    error = checkResponseDoc(response, NULL);
+    ixmlDocument_free(response);
+    if (error != OBIX_SUCCESS)
+    {
+        log_error("Server \"%s\" failed to unregister device \"%s\".",
+                  c->serverUri, d->uri);
+    }
+
     free(d->uri);
-    return 0;
+    return error;
 }
 
 int http_registerListener(Connection* connection,
@@ -2215,7 +3022,7 @@ int http_registerListener(Connection* connection,
                           1,
                           isOperationHandler,
                           &response,
-                          _curl_handle);
+                          c->requestHandle);
     if (error != OBIX_SUCCESS)
     {
         removeListener(c, fullParamUri);
@@ -2228,7 +3035,7 @@ int http_registerListener(Connection* connection,
     if ((error == OBIX_SUCCESS) && ((*listener)->opHandler == NULL))
     {
         // for simple value listener we need also to parse current value
-        error = parseWatchOut(response, c, _curl_handle);
+        error = parseWatchOut(response, c, c->requestHandle);
     }
 
     ixmlDocument_free(response);
@@ -2265,17 +3072,19 @@ int http_unregisterListener(Connection* connection,
     strcat(fullWatchRemoveUri, c->watchRemoveUri);
 
     // send request
-    char* requestBody = getStrWatchIn((const char**) (&fullParamUri), 1);
-    if (requestBody == NULL)
+    if (getStrWatchIn(c->requestHandle->requestBuffer,
+                      (const char**) (&fullParamUri), 1) != 0)
     {
         free(fullParamUri);
         log_error("Unable to unregister listener: Not enough memory.");
         return OBIX_ERR_NO_MEMORY;
     }
-    _curl_handle->outputBuffer = requestBody;
+    c->requestHandle->outputBuffer =
+        strbuf_getString(c->requestHandle->requestBuffer);
     IXML_Document* response;
-    int error = curl_ext_postDOM(_curl_handle, fullWatchRemoveUri, &response);
-    free(requestBody);
+    int error = curl_ext_postDOM(c->requestHandle,
+                                 fullWatchRemoveUri,
+                                 &response);
     if (error != 0)
     {
         free(fullParamUri);
@@ -2315,6 +3124,126 @@ int http_unregisterListener(Connection* connection,
     return error;
 }
 
+/** Removes the item from the access list of the read cache. */
+static void unlinkReadCacheItem(Http_Connection* c, Read_Cache_Item* item)
+{
+    if (item->prev != NULL)
+    {
+        item->prev->next = item->next;
+    }
+    else
+    {
+        c->readCacheHead = item->next;
+    }
+    if (item->next != NULL)
+    {
+        item->next->prev = item->prev;
+    }
+    else
+    {
+        c->readCacheTail = item->prev;
+    }
+}
+
+/** Puts the item to the head of the access list of the read cache. */
+static void touchReadCacheItem(Http_Connection* c, Read_Cache_Item* item)
+{
+    if (c->readCacheHead == item)
+    {
+        return;
+    }
+    if (item->prev != NULL)
+    {   // item is already in the list, but not at its head
+        unlinkReadCacheItem(c, item);
+    }
+    item->prev = NULL;
+    item->next = c->readCacheHead;
+    if (c->readCacheHead != NULL)
+    {
+        c->readCacheHead->prev = item;
+    }
+    c->readCacheHead = item;
+    if (c->readCacheTail == NULL)
+    {
+        c->readCacheTail = item;
+    }
+}
+
+/** Removes the item from the read cache and frees it. */
+static void removeReadCacheItem(Http_Connection* c, Read_Cache_Item* item)
+{
+    unlinkReadCacheItem(c, item);
+    table_remove(c->readCache, item->uri);
+    ixmlElement_freeOwnerDocument(item->element);
+    free(item->uri);
+    free(item);
+}
+
+/**
+ * Saves a copy of the object received by #http_read, if server has provided
+ * its entity tag. Otherwise, removes old copy of the object if any. When the
+ * cache is full, the least recently used object is dropped.
+ */
+static void saveReadCacheItem(Http_Connection* c,
+                              const char* uri,
+                              IXML_Element* element)
+{
+    const char* etag = c->requestHandle->etag;
+    Read_Cache_Item* item = (c->readCache == NULL) ?
+                            NULL : table_get(c->readCache, uri);
+    if ((*etag == '\0') || (c->readCacheSize == 0))
+    {
+        if (item != NULL)
+        {
+            removeReadCacheItem(c, item);
+        }
+        return;
+    }
+
+    IXML_Element* copy = ixmlElement_cloneWithLog(element, TRUE);
+    if (copy == NULL)
+    {
+        return;
+    }
+
+    if (item != NULL)
+    {   // replace the outdated copy
+        ixmlElement_freeOwnerDocument(item->element);
+        item->element = copy;
+        strcpy(item->etag, etag);
+        touchReadCacheItem(c, item);
+        return;
+    }
+
+    if (c->readCache == NULL)
+    {
+        c->readCache = table_create(
+                           (c->readCacheSize < 10) ? c->readCacheSize : 10);
+    }
+    else if (table_getCount(c->readCache) >= c->readCacheSize)
+    {
+        removeReadCacheItem(c, c->readCacheTail);
+    }
+    item = (Read_Cache_Item*) malloc(sizeof(Read_Cache_Item));
+    char* key = (char*) malloc(strlen(uri) + 1);
+    if ((c->readCache == NULL) || (item == NULL) || (key == NULL) ||
+            (table_put(c->readCache, uri, item) != 0))
+    {
+        log_warning("Unable to save object \"%s\" to the cache.", uri);
+        ixmlElement_freeOwnerDocument(copy);
+        free(item);
+        free(key);
+        return;
+    }
+    strcpy(key, uri);
+    item->uri = key;
+    item->element = copy;
+    strcpy(item->etag, etag);
+    item->prev = NULL;
+    item->next = NULL;
+    touchReadCacheItem(c, item);
+}
+
 int http_read(Connection* connection,
               Device* device,
               const char* paramUri,
@@ -2331,7 +3260,21 @@ int http_read(Connection* connection,
         return OBIX_ERR_NO_MEMORY;
     }
 
-    curl_ext_getDOM(_curl_handle, fullUri, &response);
+    // if the object was read before, the server sends it only if it changed
+    Read_Cache_Item* cached = (c->readCache == NULL) ?
+                              NULL : table_get(c->readCache, fullUri);
+    curl_ext_getDOMIfChanged(c->requestHandle,
+                             fullUri,
+                             (cached != NULL) ? cached->etag : NULL,
+                             &response);
+    if (c->requestHandle->notModified && (cached != NULL))
+    {
+        touchReadCacheItem(c, cached);
+        free(fullUri);
+        *output = ixmlElement_cloneWithLog(cached->element, TRUE);
+        return (*output != NULL) ? OBIX_SUCCESS : OBIX_ERR_NO_MEMORY;
+    }
+
     int error = checkResponseDoc(response, NULL);
     if (error != OBIX_SUCCESS)
     {
@@ -2359,6 +3302,7 @@ int http_read(Connection* connection,
         return OBIX_ERR_BAD_CONNECTION;
     }
 
+    saveReadCacheItem(c, fullUri, element);
     free(fullUri);
     *output = element;
     return OBIX_SUCCESS;
@@ -2396,7 +3340,7 @@ int http_writeValue(Connection* connection,
     }
 
     log_debug("Performing write operation...");
-    int error = writeValue(fullUri, newValue, dataType, _curl_handle);
+    int error = writeValue(fullUri, newValue, dataType, c->requestHandle);
     free(fullUri);
     return error;
 }
@@ -2417,15 +3361,15 @@ int http_invoke(Connection* connection,
         return OBIX_ERR_NO_MEMORY;
     }
 
-    _curl_handle->outputBuffer = input;
-    int error = curl_ext_post(_curl_handle, fullUri);
+    c->requestHandle->outputBuffer = input;
+    int error = curl_ext_post(c->requestHandle, fullUri);
     free(fullUri);
     if (error != 0)
     {
         log_error("Unable to send invoke request.");
         return OBIX_ERR_HTTP_LIB;
     }
-    *output = strdup(_curl_handle->inputBuffer);
+    *output = strdup(c->requestHandle->inputBuffer);
     if (*output == NULL)
     {
         log_error("Not enough memory.");
@@ -2435,125 +3379,82 @@ int http_invoke(Connection* connection,
     return OBIX_SUCCESS;
 }
 
-/** Generates string representation of Batch object including all commands
- * it contains. */
-static char* getStrBatch(oBIX_Batch* batch)
+/**
+ * Appends URI relative to the server root (combined from device's URI and
+ * parameter's URI) to the buffer. Works as #getRelUri, but does not allocate
+ * memory for the URI.
+ */
+static int appendRelUri(String_Buffer* buffer,
+                        Device* device,
+                        const char* paramUri)
 {
-    // start with forming correct URI's and calculating size of the final
-    // message
-    char* uri[batch->commandCounter];
-
-    // helper function to free memory
-    void cleanup()
-    {
-        // free all generated URIs
-        int i;
-        for (i = 0; i < batch->commandCounter; i++)
-        {
-            if (uri[i] != NULL)
-            {
-                free(uri[i]);
-            }
-        }
-    }
-
-    int batchMessageSize = OBIX_BATCH_TEMPLATE_HEADER_LENGTH +
-                           OBIX_BATCH_TEMPLATE_FOOTER_LENGTH + 1;
-
-    int i;
-    for (i = 0; i < batch->commandCounter; i++)
+    int error = 0;
+    if (device != NULL)
     {
-        uri[i] = NULL;
+        error += strbuf_appendXml(buffer, getHttpDevice(device)->uri);
     }
-
-    oBIX_BatchCmd* command = batch->command;
-    while (command != NULL)
+    if (paramUri != NULL)
     {
-        char* fullUri = getRelUri(command->device, command->uri);
-        if (fullUri == NULL)
-        {
-            cleanup();
-            return NULL;
-        }
-        uri[command->id] = fullUri;
-
-        // calculate length of this command
-        batchMessageSize += strlen(fullUri);
-        switch (command->type)
-        {
-        case OBIX_BATCH_WRITE_VALUE:
-            batchMessageSize +=
-                OBIX_BATCH_TEMPLATE_CMD_WRITE_LENGTH +
-                strlen(obix_getDataTypeName(command->dataType)) +
-                strlen(command->input);
-            break;
-        case OBIX_BATCH_READ:
-        case OBIX_BATCH_READ_VALUE:
-            batchMessageSize += OBIX_BATCH_TEMPLATE_CMD_READ_LENGTH;
-            break;
-        case OBIX_BATCH_INVOKE:
-            batchMessageSize +=
-                OBIX_BATCH_TEMPLATE_CMD_INVOKE_LENGTH +
-                strlen((command->input != NULL) ?
-                       command->input : OBIX_OBJ_NULL_TEMPLATE);
-            break;
-        }
-
-        command = command->next;
+        error += strbuf_appendXml(buffer, paramUri);
     }
 
-    char* batchMessage = (char*) malloc(batchMessageSize);
-    if (batchMessage == NULL)
-    {
-        cleanup();
-        return NULL;
-    }
+    return error;
+}
 
+/** Generates string representation of Batch object including all commands
+ * it contains.
+ * @return @a 0 on success, or @a -1 if there is not enough memory. */
+static int getStrBatch(String_Buffer* buffer, oBIX_Batch* batch)
+{
+    strbuf_reset(buffer);
     // print batch header
-    strcpy(batchMessage, OBIX_BATCH_TEMPLATE_HEADER);
-    int size = OBIX_BATCH_TEMPLATE_HEADER_LENGTH;
+    int error = strbuf_append(buffer, OBIX_BATCH_TEMPLATE_HEADER);
 
     // print commands
-    command = batch->command;
-    while (command != NULL)
+    oBIX_BatchCmd* command = batch->command;
+    for (; (command != NULL) && (error == 0); command = command->next)
     {
         switch (command->type)
         {
         case OBIX_BATCH_WRITE_VALUE:
-            size += sprintf(batchMessage + size,
-                            OBIX_BATCH_TEMPLATE_CMD_WRITE,
-                            uri[command->id],
-                            obix_getDataTypeName(command->dataType),
-                            command->input);
+            error += strbuf_append(buffer, OBIX_BATCH_TEMPLATE_CMD_WRITE_START);
+            error += appendRelUri(buffer, command->device, command->uri);
+            error += strbuf_append(buffer, OBIX_BATCH_TEMPLATE_CMD_WRITE_IN);
+            error += strbuf_append(buffer,
+                                   obix_getDataTypeName(command->dataType));
+            error += strbuf_append(buffer, OBIX_BATCH_TEMPLATE_CMD_WRITE_VAL);
+            error += strbuf_appendXml(buffer, command->input);
+            error += strbuf_append(buffer, OBIX_BATCH_TEMPLATE_CMD_WRITE_END);
             break;
         case OBIX_BATCH_READ:
         case OBIX_BATCH_READ_VALUE:
-            size += sprintf(batchMessage + size,
-                            OBIX_BATCH_TEMPLATE_CMD_READ,
-                            uri[command->id]);
+            error += strbuf_append(buffer, OBIX_BATCH_TEMPLATE_CMD_READ_START);
+            error += appendRelUri(buffer, command->device, command->uri);
+            error += strbuf_append(buffer, OBIX_BATCH_TEMPLATE_CMD_READ_END);
             break;
         case OBIX_BATCH_INVOKE:
-            size += sprintf(batchMessage + size,
-                            OBIX_BATCH_TEMPLATE_CMD_INVOKE,
-                            uri[command->id],
-                            (command->input != NULL) ?
-                            command->input : OBIX_OBJ_NULL_TEMPLATE);
+            error += strbuf_append(buffer, OBIX_BATCH_TEMPLATE_CMD_INVOKE_START);
+            error += appendRelUri(buffer, command->device, command->uri);
+            error += strbuf_append(buffer, OBIX_BATCH_TEMPLATE_CMD_INVOKE_IN);
+            // operation input is an oBIX object, thus it is not escaped
+            error += strbuf_append(buffer, (command->input != NULL) ?
+                                   command->input : OBIX_OBJ_NULL_TEMPLATE);
+            error += strbuf_append(buffer, OBIX_BATCH_TEMPLATE_CMD_INVOKE_END);
             break;
         }
-        free(uri[command->id]);
-        command = command->next;
     }
 
     // print batch footer
-    strcpy(batchMessage + size, OBIX_BATCH_TEMPLATE_FOOTER);
-    return batchMessage;
+    error += strbuf_append(buffer, OBIX_BATCH_TEMPLATE_FOOTER);
+
+    return (error == 0) ? 0 : -1;
 }
 
 int http_sendBatch(oBIX_Batch* batch)
 {
+    Http_Connection* c = getHttpConnection(batch->connection);
     // generate batch request
-    char* requestBody = getStrBatch(batch);
-    if (requestBody == NULL)
+    if (getStrBatch(c->requestHandle->requestBuffer, batch) != 0)
     {
         log_error("Unable to generate the Batch object: "
                   "Not enough memory.");
@@ -2561,16 +3462,15 @@ int http_sendBatch(oBIX_Batch* batch)
     }
 
     // get full URI of batch operation
-    Http_Connection* c = getHttpConnection(batch->connection);
     char fullBatchUri[c->serverUriLength + strlen(c->batchUri) + 1];
     strcpy(fullBatchUri, c->serverUri);
     strcat(fullBatchUri, c->batchUri);
 
     // send the batch request
-    _curl_handle->outputBuffer = requestBody;
+    c->requestHandle->outputBuffer =
+        strbuf_getString(c->requestHandle->requestBuffer);
     IXML_Document* response;
-    int error = curl_ext_postDOM(_curl_handle, fullBatchUri, &response);
-    free(requestBody);
+    int error = curl_ext_postDOM(c->requestHandle, fullBatchUri, &response);
     if (error != 0)
     {
         return OBIX_ERR_BAD_CONNECTION;
@@ -2656,5 +3556,9 @@ int http_sendBatch(oBIX_Batch* batch)
 const char* http_getServerAddress(Connection* connection)
 {
     Http_Connection* c = getHttpConnection(connection);
+    if (c->transportAddress != NULL)
+    {
+        return c->transportAddress;
+    }
     return c->serverUri;
 }
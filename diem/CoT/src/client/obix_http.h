@@ -34,7 +34,9 @@
 #define OBIX_HTTP_H_
 
 #include <pthread.h>
+#include <time.h>
 #include <table.h>
+#include <curl_ext.h>
 #include <obix_comm.h>
 
 /** Extended Connection object, which stores HTTP specific settings. */
@@ -44,6 +46,13 @@ typedef struct _Http_Connection
     // HTTP specific connection properties
     char* serverUri;
     int serverUriLength;
+    /** Address of the server for connections with custom transport (e.g.
+     * socket path). For such connections #serverUri is empty. */
+    char* transportAddress;
+    /** Handle used for all requests of the connection except Watch
+     * polling. HTTP connections share one handle; connections with custom
+     * transport have their own. */
+    CURL_EXT* requestHandle;
     char* lobbyUri;
     long pollInterval;
     long watchLease;
@@ -51,7 +60,9 @@ typedef struct _Http_Connection
     long pollWaitMax;
 
     char* signUpUri;
+    char* signUpDevicesUri;
     char* batchUri;
+    char* unregisterUri;
     char* watchMakeUri;
     char* watchPollChangesFullUri;
     char* watchAddUri;
@@ -61,9 +72,33 @@ typedef struct _Http_Connection
     char* watchDeleteUri;
 
     Table* watchTable;
+    /** Copies of objects received by #http_read, which are revalidated
+     * using their entity tags instead of downloading them again. Created on
+     * first use. */
+    Table* readCache;
+    /** Most recently used item of #readCache. */
+    struct _Read_Cache_Item* readCacheHead;
+    /** Least recently used item of #readCache, which is dropped first. */
+    struct _Read_Cache_Item* readCacheTail;
+    /** Maximum number of objects in #readCache; 0 disables the cache. */
+    long readCacheSize;
     pthread_mutex_t watchMutex;
-    int watchPollTaskId;
     int watchPollErrorCount;
+
+    /** Handle used for polling Watch object of this connection. */
+    CURL_EXT* watchPollHandle;
+    /** Current state of the Watch polling (one of WATCH_POLL_* values). */
+    int watchPollState;
+    /** Set when polling of the Watch object should be stopped. */
+    BOOL watchPollCancel;
+    /** Set when the connection is freed while it is still polled by the
+     * polling thread (e.g. by a listener). The thread releases it when the
+     * polling is stopped. */
+    BOOL watchPollRelease;
+    /** Time when the next poll request should be sent. */
+    struct timespec watchPollTime;
+    /** Next connection in the list of polled connections. */
+    struct _Http_Connection* watchPollNext;
 }
 Http_Connection;
 
@@ -103,6 +138,29 @@ int http_dispose();
  */
 int http_initConnection(IXML_Element* connItem,
                         Connection** connection);
+
+/**
+ * Prototype of a function, which creates request handle with custom
+ * transport.
+ *
+ * @param address Server address, taken from the connection settings.
+ * @param handle Created handle is returned here.
+ * @return #OBIX_SUCCESS, or one of error codes defined by #OBIX_ERRORCODE.
+ */
+typedef int (*http_create_handle)(const char* address, CURL_EXT** handle);
+
+/**
+ * Initializes connection, which sends HTTP stack requests through a custom
+ * transport instead of HTTP. Server address from the connection settings is
+ * passed to @a createHandle, and all URIs are sent relative to the server
+ * root.
+ *
+ * @param createHandle Function which creates handles of the connection.
+ * @see http_initConnection
+ */
+int http_initCustomConnection(IXML_Element* connItem,
+                              Connection** connection,
+                              http_create_handle createHandle);
 /**
  * Implements #comm_openConnection prototype.
  */
@@ -114,13 +172,21 @@ int http_closeConnection(Connection* connection);
 /**
  * Implements #comm_freeConnection prototype.
  */
-void http_freeConnection(Connection* connection);
+int http_freeConnection(Connection* connection);
 /**
  * Implements #comm_registerDevice prototype.
  */
 int http_registerDevice(Connection* connection,
                         Device** device,
                         const char* data);
+/**
+ * Implements #comm_registerDevices prototype.
+ */
+int http_registerDevices(Connection* connection,
+                         Device** devices,
+                         const char** data,
+                         int count,
+                         int* results);
 /**
  * Implements #comm_unregisterDevice prototype.
  */
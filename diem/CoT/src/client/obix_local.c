@@ -0,0 +1,637 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of local communication layer.
+ *
+ * @see obix_local.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <log_utils.h>
+#include <obix_utils.h>
+#include <xml_config.h>
+#include <ptask.h>
+#include <local_server.h>
+#include "obix_batch.h"
+#include "obix_client_local.h"
+#include "obix_local.h"
+
+/** Name of configuration tag, which defines server resource folder. */
+static const char* CT_SERVER_RES_DIR = "server-res-dir";
+
+/** Address which is returned for local connections. */
+static const char* LOCAL_SERVER_ADDRESS = "local";
+
+const Comm_Stack OBIX_LOCAL_COMM_STACK =
+    {
+        &local_initConnection,
+        &local_openConnection,
+        &local_closeConnection,
+        &local_freeConnection,
+        &local_registerDevice,
+        &local_registerDevices,
+        &local_unregisterDevice,
+        &local_registerListener,
+        &local_unregisterListener,
+        &local_read,
+        &local_readValue,
+        &local_writeValue,
+        &local_invoke,
+        &local_sendBatch,
+        &local_getServerAddress
+    };
+
+void obix_enableLocalConnections()
+{
+    obix_setLocalCommStack(&OBIX_LOCAL_COMM_STACK);
+}
+
+/** Connection to the server running in the same process. */
+typedef struct _Local_Connection
+{
+    /** Parent object. */
+    Connection c;
+    /** Folder with server resources. */
+    char* resourceDir;
+    /** Thread in which listeners are notified. */
+    Task_Thread* listenerThread;
+}
+Local_Connection;
+
+/** Device registered at the local server. */
+typedef struct _Local_Device
+{
+    /** Parent object. */
+    Device d;
+    /** URI of the device data at the server. */
+    char* uri;
+}
+Local_Device;
+
+/** Listener subscribed at the local server. */
+typedef struct _Local_Listener
+{
+    /** Parent object. */
+    Listener l;
+    /** Id of the listener at the server. */
+    int serverId;
+    /** Thread in which the listener is notified. */
+    Task_Thread* thread;
+}
+Local_Listener;
+
+/** Update of a parameter, which should be delivered to the listener. */
+typedef struct _Local_Notification
+{
+    obix_update_listener listener;
+    int connectionId;
+    int deviceId;
+    int listenerId;
+    char* value;
+}
+Local_Notification;
+
+static Local_Connection* getLocalConnection(Connection* connection)
+{
+    return (Local_Connection*) connection;
+}
+
+/**
+ * Combines device URI and parameter URI (one of them can be empty).
+ * @note Returned URI should be freed after usage.
+ */
+static char* getUri(Device* device, const char* paramUri)
+{
+    const char* deviceUri = "";
+    if (device != NULL)
+    {
+        deviceUri = ((Local_Device*) device)->uri;
+    }
+    if (paramUri == NULL)
+    {
+        paramUri = "";
+    }
+
+    char* uri = (char*) malloc(strlen(deviceUri) + strlen(paramUri) + 1);
+    if (uri == NULL)
+    {
+        log_error("Not enough memory.");
+        return NULL;
+    }
+    strcpy(uri, deviceUri);
+    strcat(uri, paramUri);
+    return uri;
+}
+
+/** Delivers update to the listener. Executed in the listener thread. */
+static void deliverNotification(void* arg)
+{
+    Local_Notification* n = (Local_Notification*) arg;
+    (n->listener)(n->connectionId, n->deviceId, n->listenerId, n->value);
+    ixmlFreeDOMString(n->value);
+    free(n);
+}
+
+/**
+ * Handles update of a monitored object. It is called while the server is
+ * locked, so the listener is notified later in a separate thread.
+ */
+static void onObjectUpdate(IXML_Element* object, void* arg)
+{
+    Local_Listener* listener = (Local_Listener*) arg;
+
+    Local_Notification* n =
+        (Local_Notification*) malloc(sizeof(Local_Notification));
+    if (n == NULL)
+    {
+        log_error("Unable to notify listener: Not enough memory.");
+        return;
+    }
+
+    // if there is 'val' attribute in the object - return it,
+    // otherwise, return the whole object
+    const char* attrValue = ixmlElement_getAttribute(object, OBIX_ATTR_VAL);
+    if (attrValue != NULL)
+    {
+        n->value = ixmlCloneDOMString(attrValue);
+    }
+    else
+    {
+        n->value = obixLocal_printObject(object);
+    }
+    if (n->value == NULL)
+    {
+        log_error("Unable to notify listener: Not enough memory.");
+        free(n);
+        return;
+    }
+
+    n->listener = listener->l.paramListener;
+    n->connectionId = listener->l.connectionId;
+    n->deviceId = listener->l.deviceId;
+    n->listenerId = listener->l.id;
+
+    if (ptask_schedule(listener->thread, &deliverNotification, n, 0, 1) < 0)
+    {
+        log_error("Unable to schedule listener notification.");
+        ixmlFreeDOMString(n->value);
+        free(n);
+    }
+}
+
+/** Converts error code of #obixLocal_write to #OBIX_ERRORCODE. */
+static int checkWriteError(int error, const char* uri)
+{
+    switch (error)
+    {
+    case 0:
+        return OBIX_SUCCESS;
+    case -1:
+        log_warning("Unable to write to \"%s\": Wrong input.", uri);
+        return OBIX_ERR_INVALID_ARGUMENT;
+    case -2:
+        log_warning("Unable to write to \"%s\": Object is not found.", uri);
+        return OBIX_ERR_SERVER_ERROR;
+    case -3:
+        log_warning("Unable to write to \"%s\": Object is not writable.", uri);
+        return OBIX_ERR_SERVER_ERROR;
+    default:
+        log_warning("Unable to write to \"%s\": Server error (%d).",
+                    uri, error);
+        return OBIX_ERR_SERVER_ERROR;
+    }
+}
+
+int local_initConnection(IXML_Element* connItem, Connection** connection)
+{
+    const char* resourceDir = config_getChildTagValue(connItem,
+                              CT_SERVER_RES_DIR,
+                              TRUE);
+    if (resourceDir == NULL)
+    {
+        return OBIX_ERR_INVALID_ARGUMENT;
+    }
+
+    Local_Connection* c = (Local_Connection*) realloc(*connection,
+                          sizeof(Local_Connection));
+    if (c == NULL)
+    {
+        log_error("Unable to initialize local connection: "
+                  "Not enough memory.");
+        return OBIX_ERR_NO_MEMORY;
+    }
+    *connection = &(c->c);
+
+    c->listenerThread = NULL;
+    c->resourceDir = (char*) malloc(strlen(resourceDir) + 1);
+    if (c->resourceDir == NULL)
+    {
+        log_error("Unable to initialize local connection: "
+                  "Not enough memory.");
+        return OBIX_ERR_NO_MEMORY;
+    }
+    strcpy(c->resourceDir, resourceDir);
+
+    return OBIX_SUCCESS;
+}
+
+int local_freeConnection(Connection* connection)
+{
+    Local_Connection* c = getLocalConnection(connection);
+    if (c->resourceDir != NULL)
+    {
+        free(c->resourceDir);
+    }
+    return 0;
+}
+
+int local_openConnection(Connection* connection)
+{
+    Local_Connection* c = getLocalConnection(connection);
+
+    log_debug("Starting local server with resources at \"%s\"...",
+              c->resourceDir);
+    if (obixLocal_init(c->resourceDir) != 0)
+    {
+        return OBIX_ERR_BAD_CONNECTION;
+    }
+
+    c->listenerThread = ptask_init();
+    if (c->listenerThread == NULL)
+    {
+        log_error("Unable to start thread for listener notifications.");
+        obixLocal_dispose();
+        return OBIX_ERR_NO_MEMORY;
+    }
+
+    return OBIX_SUCCESS;
+}
+
+int local_closeConnection(Connection* connection)
+{
+    Local_Connection* c = getLocalConnection(connection);
+
+    log_debug("Closing local connection...");
+    // all listeners are already unregistered
+    if (c->listenerThread != NULL)
+    {
+        ptask_dispose(c->listenerThread, TRUE);
+        c->listenerThread = NULL;
+    }
+    obixLocal_dispose();
+
+    return OBIX_SUCCESS;
+}
+
+int local_registerDevice(Connection* connection,
+                         Device** device,
+                         const char* data)
+{
+    log_debug("Registering device at the local server...");
+    IXML_Element* element = ixmlElement_parseBuffer(data);
+    if (element == NULL)
+    {
+        log_error("Unable to register device: Device data is corrupted.");
+        return OBIX_ERR_INVALID_ARGUMENT;
+    }
+
+    int error = obixLocal_signUp(element);
+    if (error < 0)
+    {
+        log_error("Unable to register device at the local server.");
+        ixmlElement_freeOwnerDocument(element);
+        return OBIX_ERR_SERVER_ERROR;
+    }
+
+    // the storage adds default prefix to the URI of device data
+    const char* uri = ixmlElement_getAttribute(element, OBIX_ATTR_HREF);
+    if (error == 1)
+    {
+        log_warning("Object with URI \"%s\" already exists at the server. "
+                    "Trying to proceed with it.", uri);
+    }
+
+    // create device object
+    Local_Device* d = (Local_Device*) realloc(*device, sizeof(Local_Device));
+    if (d == NULL)
+    {
+        ixmlElement_freeOwnerDocument(element);
+        log_error("Unable to create device: Not enough memory.");
+        return OBIX_ERR_NO_MEMORY;
+    }
+    *device = &(d->d);
+
+    d->uri = (char*) malloc(strlen(uri) + 1);
+    if (d->uri == NULL)
+    {
+        ixmlElement_freeOwnerDocument(element);
+        log_error("Unable to create device: Not enough memory.");
+        return OBIX_ERR_NO_MEMORY;
+    }
+    strcpy(d->uri, uri);
+    ixmlElement_freeOwnerDocument(element);
+
+    return OBIX_SUCCESS;
+}
+
+int local_registerDevices(Connection* connection,
+                          Device** devices,
+                          const char** data,
+                          int count,
+                          int* results)
+{
+    // there is no network overhead, so devices are added one by one
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        results[i] = local_registerDevice(connection, &(devices[i]), data[i]);
+    }
+
+    return OBIX_SUCCESS;
+}
+
+int local_unregisterDevice(Connection* connection, Device* device)
+{
+    Local_Device* d = (Local_Device*) device;
+    log_debug("Unregistering device \"%s\" from the local server...",
+              d->uri);
+
+    int error = obixLocal_unregister(d->uri);
+    if (error != 0)
+    {
+        log_error("Unable to unregister device \"%s\" at the local server.",
+                  d->uri);
+    }
+
+    free(d->uri);
+    return (error == 0) ? OBIX_SUCCESS : OBIX_ERR_SERVER_ERROR;
+}
+
+int local_registerListener(Connection* connection,
+                           Device* device,
+                           Listener** listener)
+{
+    if ((*listener)->opHandler != NULL)
+    {
+        log_error("Operation handlers are not supported by local "
+                  "connection.");
+        return OBIX_ERR_INVALID_ARGUMENT;
+    }
+
+    Local_Listener* l = (Local_Listener*) realloc(*listener,
+                        sizeof(Local_Listener));
+    if (l == NULL)
+    {
+        log_error("Unable to register listener: Not enough memory.");
+        return OBIX_ERR_NO_MEMORY;
+    }
+    *listener = &(l->l);
+    l->thread = getLocalConnection(connection)->listenerThread;
+
+    char* uri = getUri(device, l->l.paramUri);
+    if (uri == NULL)
+    {
+        return OBIX_ERR_NO_MEMORY;
+    }
+
+    log_debug("Registering listener of object \"%s\" at the local server...",
+              uri);
+    // current value is delivered to the listener immediately
+    l->serverId = obixLocal_addListener(uri, &onObjectUpdate, l);
+    free(uri);
+    if (l->serverId < 0)
+    {
+        return OBIX_ERR_SERVER_ERROR;
+    }
+
+    return OBIX_SUCCESS;
+}
+
+int local_unregisterListener(Connection* connection,
+                             Device* device,
+                             Listener* listener)
+{
+    log_debug("Removing listener of parameter \"%s\" at the local server...",
+              listener->paramUri);
+
+    if (obixLocal_removeListener(((Local_Listener*) listener)->serverId) != 0)
+    {
+        // server removes listeners together with the monitored objects, e.g.
+        // when the device is unregistered. Listener ids are never reused, so
+        // there is nothing else to remove.
+        log_debug("Listener of \"%s\" is already removed by the local "
+                  "server.", listener->paramUri);
+    }
+    return OBIX_SUCCESS;
+}
+
+int local_read(Connection* connection,
+               Device* device,
+               const char* paramUri,
+               IXML_Element** output)
+{
+    char* uri = getUri(device, paramUri);
+    if (uri == NULL)
+    {
+        return OBIX_ERR_NO_MEMORY;
+    }
+
+    *output = obixLocal_read(uri);
+    if (*output == NULL)
+    {
+        log_error("Unable to get object \"%s\" from the local server.", uri);
+        free(uri);
+        return OBIX_ERR_SERVER_ERROR;
+    }
+
+    free(uri);
+    return OBIX_SUCCESS;
+}
+
+int local_readValue(Connection* connection,
+                    Device* device,
+                    const char* paramUri,
+                    char** output)
+{
+    IXML_Element* element;
+    int error = local_read(connection, device, paramUri, &element);
+    if (error != OBIX_SUCCESS)
+    {
+        return error;
+    }
+
+    const char* attrValue = ixmlElement_getAttribute(element, OBIX_ATTR_VAL);
+    if (attrValue == NULL)
+    {
+        log_warning("Object \"%s\" doesn't have \"%s\" attribute.",
+                    paramUri, OBIX_ATTR_VAL);
+        ixmlElement_freeOwnerDocument(element);
+        return OBIX_ERR_INVALID_ARGUMENT;
+    }
+
+    *output = (char*) malloc(strlen(attrValue) + 1);
+    if (*output == NULL)
+    {
+        log_error("Unable to allocate enough memory.");
+        ixmlElement_freeOwnerDocument(element);
+        return OBIX_ERR_NO_MEMORY;
+    }
+    strcpy(*output, attrValue);
+    ixmlElement_freeOwnerDocument(element);
+    return OBIX_SUCCESS;
+}
+
+int local_writeValue(Connection* connection,
+                     Device* device,
+                     const char* paramUri,
+                     const char* newValue,
+                     OBIX_DATA_TYPE dataType)
+{
+    char* uri = getUri(device, paramUri);
+    if (uri == NULL)
+    {
+        return OBIX_ERR_NO_MEMORY;
+    }
+
+    // generate input object without serializing it
+    IXML_Element* input;
+    if ((obix_obj_create(obix_getDataTypeName(dataType),
+                         uri, NULL, NULL, NULL, &input) != 0)
+            || (ixmlElement_setAttributeWithLog(input,
+                                                OBIX_ATTR_VAL,
+                                                newValue) != IXML_SUCCESS))
+    {
+        log_error("Unable to generate write request.");
+        free(uri);
+        return OBIX_ERR_NO_MEMORY;
+    }
+
+    log_debug("Performing write operation...");
+    int error = checkWriteError(obixLocal_write(uri, input), uri);
+    ixmlElement_freeOwnerDocument(input);
+    free(uri);
+    return error;
+}
+
+int local_invoke(Connection* connection,
+                 Device* device,
+                 const char* operationUri,
+                 const char* input,
+                 char** output)
+{
+    IXML_Element* element = NULL;
+    if (input != NULL)
+    {
+        element = ixmlElement_parseBuffer(input);
+        if (element == NULL)
+        {
+            log_error("Unable to invoke operation: Input is corrupted.");
+            return OBIX_ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    char* uri = getUri(device, operationUri);
+    if (uri == NULL)
+    {
+        if (element != NULL)
+        {
+            ixmlElement_freeOwnerDocument(element);
+        }
+        return OBIX_ERR_NO_MEMORY;
+    }
+
+    *output = obixLocal_invoke(uri, element);
+    if (element != NULL)
+    {
+        ixmlElement_freeOwnerDocument(element);
+    }
+    free(uri);
+
+    return (*output != NULL) ? OBIX_SUCCESS : OBIX_ERR_NO_MEMORY;
+}
+
+int local_sendBatch(oBIX_Batch* batch)
+{
+    // commands are executed one by one, there is nothing to be gained from
+    // generating a Batch object
+    Connection* connection = batch->connection;
+    oBIX_BatchCmd* command;
+    for (command = batch->command; command != NULL; command = command->next)
+    {
+        oBIX_BatchResult* result = &(batch->result[command->id]);
+
+        switch (command->type)
+        {
+        case OBIX_BATCH_READ:
+            result->status = local_read(connection, command->device,
+                                        command->uri, &(result->obj));
+            if (result->status != OBIX_SUCCESS)
+            {
+                result->obj = NULL;
+            }
+            break;
+        case OBIX_BATCH_READ_VALUE:
+            result->status = local_readValue(connection, command->device,
+                                             command->uri, &(result->value));
+            if (result->status != OBIX_SUCCESS)
+            {
+                result->value = NULL;
+            }
+            break;
+        case OBIX_BATCH_WRITE_VALUE:
+            result->status = local_writeValue(connection, command->device,
+                                              command->uri, command->input,
+                                              command->dataType);
+            break;
+        case OBIX_BATCH_INVOKE:
+            result->status = local_invoke(connection, command->device,
+                                          command->uri, command->input,
+                                          &(result->value));
+            if (result->status != OBIX_SUCCESS)
+            {
+                result->value = NULL;
+                break;
+            }
+            result->obj = ixmlElement_parseBuffer(result->value);
+            if (result->obj == NULL)
+            {
+                result->status = OBIX_ERR_UNKNOWN_BUG;
+            }
+            else if (strcmp(ixmlElement_getTagName(result->obj),
+                            OBIX_OBJ_ERR) == 0)
+            {
+                result->status = OBIX_ERR_SERVER_ERROR;
+            }
+            break;
+        }
+    }
+
+    return OBIX_SUCCESS;
+}
+
+const char* local_getServerAddress(Connection* connection)
+{
+    return LOCAL_SERVER_ADDRESS;
+}
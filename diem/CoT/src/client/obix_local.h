@@ -0,0 +1,157 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Local communication layer.
+ *
+ * Provides stack of functions, which access oBIX server running in the same
+ * process (see local_server.h). Objects are read and written as DOM
+ * structures without any serialization, and listeners are notified directly
+ * by the Watch engine of the server, so no polling is performed. Listeners
+ * are invoked in a separate thread, thus they are allowed to call other
+ * functions of oBIX client library.
+ *
+ * Operation handlers (#obix_operation_handler) are not supported, because
+ * local server can't delay the response of an operation.
+ *
+ * The connection is configured with the folder containing server resources:
+ * @code
+ * <connection id="0" type="local">
+ *   <server-res-dir val="/usr/share/obix/res/server/"/>
+ * </connection>
+ * @endcode
+ *
+ * The layer is built as a separate library (libcot-local), which registers
+ * the stack in the client library with #obix_enableLocalConnections.
+ *
+ * @see obix_comm.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef OBIX_LOCAL_H_
+#define OBIX_LOCAL_H_
+
+#include <obix_comm.h>
+
+/** Stack of local communication functions. */
+extern const Comm_Stack OBIX_LOCAL_COMM_STACK;
+
+/**
+ * Implements #comm_initConnection prototype.
+ */
+int local_initConnection(IXML_Element* connItem, Connection** connection);
+
+/**
+ * Implements #comm_openConnection prototype.
+ */
+int local_openConnection(Connection* connection);
+
+/**
+ * Implements #comm_closeConnection prototype.
+ */
+int local_closeConnection(Connection* connection);
+
+/**
+ * Implements #comm_freeConnection prototype.
+ */
+int local_freeConnection(Connection* connection);
+
+/**
+ * Implements #comm_registerDevice prototype.
+ */
+int local_registerDevice(Connection* connection,
+                         Device** device,
+                         const char* data);
+
+/**
+ * Implements #comm_registerDevices prototype.
+ */
+int local_registerDevices(Connection* connection,
+                          Device** devices,
+                          const char** data,
+                          int count,
+                          int* results);
+
+/**
+ * Implements #comm_unregisterDevice prototype.
+ */
+int local_unregisterDevice(Connection* connection, Device* device);
+
+/**
+ * Implements #comm_registerListener prototype.
+ */
+int local_registerListener(Connection* connection,
+                           Device* device,
+                           Listener** listener);
+
+/**
+ * Implements #comm_unregisterListener prototype.
+ */
+int local_unregisterListener(Connection* connection,
+                             Device* device,
+                             Listener* listener);
+
+/**
+ * Implements #comm_read prototype.
+ */
+int local_read(Connection* connection,
+               Device* device,
+               const char* paramUri,
+               IXML_Element** output);
+
+/**
+ * Implements #comm_readValue prototype.
+ */
+int local_readValue(Connection* connection,
+                    Device* device,
+                    const char* paramUri,
+                    char** output);
+
+/**
+ * Implements #comm_writeValue prototype.
+ */
+int local_writeValue(Connection* connection,
+                     Device* device,
+                     const char* paramUri,
+                     const char* newValue,
+                     OBIX_DATA_TYPE dataType);
+
+/**
+ * Implements #comm_invoke prototype.
+ */
+int local_invoke(Connection* connection,
+                 Device* device,
+                 const char* operationUri,
+                 const char* input,
+                 char** output);
+
+/**
+ * Implements #comm_sendBatch prototype.
+ */
+int local_sendBatch(oBIX_Batch* batch);
+
+/**
+ * Implements #comm_getServerAddress prototype.
+ */
+const char* local_getServerAddress(Connection* connection);
+
+#endif /* OBIX_LOCAL_H_ */
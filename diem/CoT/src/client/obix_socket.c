@@ -0,0 +1,262 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of local socket communication layer.
+ *
+ * Implements custom transport for CURL_EXT handles, which delivers requests
+ * through a Unix domain socket. Each handle has its own socket connection,
+ * which is opened on the first request and reopened after errors.
+ *
+ * @see obix_socket.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <log_utils.h>
+#include <obix_utils.h>
+#include <local_socket.h>
+#include "obix_http.h"
+#include "obix_socket.h"
+
+/** Size of the buffer used for receiving response body. */
+#define RECEIVE_BUFFER_SIZE 4096
+
+/**
+ * Defines local socket communication stack. All functions except
+ * initialization are shared with HTTP stack.
+ * @see Comm_Stack
+ */
+const Comm_Stack OBIX_SOCKET_COMM_STACK =
+    {
+        &socket_initConnection,
+        &http_openConnection,
+        &http_closeConnection,
+        &http_freeConnection,
+        &http_registerDevice,
+        &http_registerDevices,
+        &http_unregisterDevice,
+        &http_registerListener,
+        &http_unregisterListener,
+        &http_read,
+        &http_readValue,
+        &http_writeValue,
+        &http_invoke,
+        &http_sendBatch,
+        &http_getServerAddress
+    };
+
+/** Transport data of a handle. */
+typedef struct _Socket_Transport
+{
+    /** Path to the socket file. */
+    char* path;
+}
+Socket_Transport;
+
+/** Closes socket connection of the handle. */
+static void socketAbort(CURL_EXT* handle)
+{
+    if (handle->transportFd >= 0)
+    {
+        close(handle->transportFd);
+        handle->transportFd = -1;
+    }
+}
+
+static int socketSend(CURL_EXT* handle,
+                      CURL_EXT_METHOD method,
+                      const char* uri)
+{
+    Socket_Transport* transport = (Socket_Transport*) handle->transportData;
+    LSOCKET_FRAME_TYPE type;
+
+    switch (method)
+    {
+    case CURL_EXT_GET:
+        type = LSOCKET_GET;
+        break;
+    case CURL_EXT_PUT:
+        type = LSOCKET_PUT;
+        break;
+    default:
+        type = LSOCKET_POST;
+        break;
+    }
+
+    if (handle->transportFd < 0)
+    {
+        handle->transportFd = lsocket_connect(transport->path);
+        if (handle->transportFd < 0)
+        {
+            return -1;
+        }
+    }
+
+    int error;
+    if ((handle->outputBuffer == NULL) || (type == LSOCKET_GET))
+    {
+        error = lsocket_writeFrame(handle->transportFd, type, uri,
+                                   NULL, NULL, 0);
+    }
+    else
+    {
+        error = lsocket_writeFrame(handle->transportFd, type, uri,
+                                   &(handle->outputBuffer),
+                                   &(handle->outputSize), 1);
+    }
+
+    if (error != 0)
+    {
+        // connection could be closed by the server - reconnect next time
+        socketAbort(handle);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int socketReceive(CURL_EXT* handle)
+{
+    Local_Socket_Header header;
+    char buffer[RECEIVE_BUFFER_SIZE];
+    int fd = handle->transportFd;
+
+    // helper function for closing the connection on error
+    int fail()
+    {
+        socketAbort(handle);
+        return -1;
+    }
+
+    if ((fd < 0) || (lsocket_readHeader(fd, &header) != 0))
+    {
+        return fail();
+    }
+
+    // skip URI of the returned object, client does not need it
+    while (header.uriLength > 0)
+    {
+        int size = (header.uriLength > RECEIVE_BUFFER_SIZE) ?
+                   RECEIVE_BUFFER_SIZE : header.uriLength;
+        if (lsocket_read(fd, buffer, size) != 0)
+        {
+            return fail();
+        }
+        header.uriLength -= size;
+    }
+
+    int error = 0;
+    while (header.bodyLength > 0)
+    {
+        int size = (header.bodyLength > RECEIVE_BUFFER_SIZE) ?
+                   RECEIVE_BUFFER_SIZE : header.bodyLength;
+        if (lsocket_read(fd, buffer, size) != 0)
+        {
+            return fail();
+        }
+        // read the whole frame even if the buffer can't be extended, so that
+        // next response can be received correctly
+        if (error == 0)
+        {
+            error = curl_ext_appendInput(handle, buffer, size);
+        }
+        header.bodyLength -= size;
+    }
+
+    if (header.type == LSOCKET_ERROR)
+    {
+        log_error("Server was unable to process the request: %s",
+                  handle->inputBuffer);
+        return -1;
+    }
+    if (header.type != LSOCKET_RESPONSE)
+    {
+        log_error("Received unexpected frame (type %d) from local socket.",
+                  header.type);
+        return fail();
+    }
+
+    return error;
+}
+
+static void socketFree(CURL_EXT* handle)
+{
+    Socket_Transport* transport = (Socket_Transport*) handle->transportData;
+    socketAbort(handle);
+    if (transport != NULL)
+    {
+        if (transport->path != NULL)
+        {
+            free(transport->path);
+        }
+        free(transport);
+        handle->transportData = NULL;
+    }
+}
+
+/** Transport, which delivers requests through a local socket. */
+static const CURL_EXT_Transport SOCKET_TRANSPORT =
+    {
+        &socketSend,
+        &socketReceive,
+        &socketAbort,
+        &socketFree
+    };
+
+/** Creates request handle, which uses local socket transport. */
+static int createSocketHandle(const char* path, CURL_EXT** handle)
+{
+    Socket_Transport* transport =
+        (Socket_Transport*) malloc(sizeof(Socket_Transport));
+    if (transport == NULL)
+    {
+        log_error("Unable to create socket handle: Not enough memory.");
+        return OBIX_ERR_NO_MEMORY;
+    }
+    transport->path = (char*) malloc(strlen(path) + 1);
+    if (transport->path == NULL)
+    {
+        log_error("Unable to create socket handle: Not enough memory.");
+        free(transport);
+        return OBIX_ERR_NO_MEMORY;
+    }
+    strcpy(transport->path, path);
+
+    if (curl_ext_createCustom(handle, &SOCKET_TRANSPORT, transport) != 0)
+    {
+        free(transport->path);
+        free(transport);
+        return OBIX_ERR_NO_MEMORY;
+    }
+
+    return OBIX_SUCCESS;
+}
+
+int socket_initConnection(IXML_Element* connItem, Connection** connection)
+{
+    return http_initCustomConnection(connItem,
+                                     connection,
+                                     &createSocketHandle);
+}
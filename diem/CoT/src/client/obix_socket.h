@@ -0,0 +1,57 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Local socket communication layer.
+ *
+ * Provides stack of functions, which communicate with oBIX server running at
+ * the same machine through a Unix domain socket. Requests are sent as compact
+ * binary frames (see local_socket.h), so that HTTP and FastCGI processing is
+ * avoided. All oBIX logic (Watch objects, Batch, etc.) is shared with the HTTP
+ * communication layer.
+ *
+ * The connection is configured in the same way as HTTP one, but attribute
+ * @a val of the <server-address/> tag contains path to the socket file:
+ * @code
+ * <connection id="0" type="socket">
+ *   <server-address val="/tmp/obix.sock" lobby="/obix/"/>
+ * </connection>
+ * @endcode
+ *
+ * @see obix_comm.h, obix_http.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef OBIX_SOCKET_H_
+#define OBIX_SOCKET_H_
+
+#include <obix_comm.h>
+
+/** Stack of local socket communication functions. */
+extern const Comm_Stack OBIX_SOCKET_COMM_STACK;
+
+/**
+ * Implements #comm_initConnection prototype.
+ */
+int socket_initConnection(IXML_Element* connItem, Connection** connection);
+
+#endif /* OBIX_SOCKET_H_ */
@@ -0,0 +1,299 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of the local socket frame exchange.
+ *
+ * @see local_socket.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include "log_utils.h"
+#include "local_socket.h"
+
+/** Maximum number of body parts sent with one system call. */
+#define WRITE_PARTS_MAX 64
+
+/** Fills socket address structure. */
+static int getAddress(const char* path, struct sockaddr_un* address)
+{
+    if (strlen(path) >= sizeof(address->sun_path))
+    {
+        log_error("Local socket path is too long: %s", path);
+        return -1;
+    }
+
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, path);
+    return 0;
+}
+
+int lsocket_connect(const char* path)
+{
+    struct sockaddr_un address;
+    if (getAddress(path, &address) != 0)
+    {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        log_error("Unable to create local socket: %s", strerror(errno));
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr*) &address,
+                sizeof(struct sockaddr_un)) != 0)
+    {
+        log_error("Unable to connect to local socket %s: %s",
+                  path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int lsocket_listen(const char* path, mode_t mode)
+{
+    struct sockaddr_un address;
+    if (getAddress(path, &address) != 0)
+    {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        log_error("Unable to create local socket: %s", strerror(errno));
+        return -1;
+    }
+
+    // remove socket file which could be left from the previous run, but
+    // never anything else which happens to have the same name
+    struct stat fileStat;
+    if (lstat(path, &fileStat) == 0)
+    {
+        if (!S_ISSOCK(fileStat.st_mode))
+        {
+            log_error("Unable to listen at local socket %s: File exists and "
+                      "is not a socket.", path);
+            close(fd);
+            return -1;
+        }
+        unlink(path);
+    }
+    // permissions are set before listening, so that nobody can connect
+    // while the file has default ones
+    if ((bind(fd, (struct sockaddr*) &address,
+              sizeof(struct sockaddr_un)) != 0)
+            || (chmod(path, mode) != 0)
+            || (listen(fd, SOMAXCONN) != 0))
+    {
+        log_error("Unable to listen at local socket %s: %s",
+                  path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/** Writes all provided buffers, repeating the call if only part of the data
+ * was sent. SIGPIPE is suppressed, so that a closed connection is reported as
+ * an error instead of terminating the process. */
+static int writeAll(int fd, struct iovec* vector, int count)
+{
+    struct msghdr message;
+    memset(&message, 0, sizeof(struct msghdr));
+
+    while (count > 0)
+    {
+        message.msg_iov = vector;
+        message.msg_iovlen = count;
+        ssize_t written = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            log_error("Unable to write to local socket: %s", strerror(errno));
+            return -1;
+        }
+
+        // skip buffers which were sent completely
+        while ((count > 0) && ((size_t) written >= vector->iov_len))
+        {
+            written -= vector->iov_len;
+            vector++;
+            count--;
+        }
+        if (count > 0)
+        {
+            vector->iov_base = (char*) vector->iov_base + written;
+            vector->iov_len -= written;
+        }
+    }
+
+    return 0;
+}
+
+int lsocket_writeFrame(int fd,
+                       LSOCKET_FRAME_TYPE type,
+                       const char* uri,
+                       const char** parts,
+                       const int* lengths,
+                       int partCount)
+{
+    unsigned char header[LSOCKET_HEADER_SIZE];
+    struct iovec vector[WRITE_PARTS_MAX + 2];
+    int uriLength = (uri == NULL) ? 0 : strlen(uri);
+    uint32_t bodyLength = 0;
+    int i;
+
+    if (uriLength > LSOCKET_URI_MAX_LENGTH)
+    {
+        log_error("URI is too long to be sent through local socket.");
+        return -1;
+    }
+
+    for (i = 0; i < partCount; i++)
+    {
+        bodyLength += lengths[i];
+    }
+    if (bodyLength > LSOCKET_BODY_MAX_LENGTH)
+    {
+        log_error("Message is too big to be sent through local socket.");
+        return -1;
+    }
+
+    header[0] = (unsigned char) type;
+    header[1] = 0;
+    uint16_t netUriLength = htons((uint16_t) uriLength);
+    uint32_t netBodyLength = htonl(bodyLength);
+    memcpy(header + 2, &netUriLength, 2);
+    memcpy(header + 4, &netBodyLength, 4);
+
+    vector[0].iov_base = header;
+    vector[0].iov_len = LSOCKET_HEADER_SIZE;
+    int count = 1;
+    if (uriLength > 0)
+    {
+        vector[count].iov_base = (char*) uri;
+        vector[count].iov_len = uriLength;
+        count++;
+    }
+
+    for (i = 0; i < partCount; i++)
+    {
+        if (lengths[i] == 0)
+        {
+            continue;
+        }
+        if (count == (WRITE_PARTS_MAX + 2))
+        {   // vector is full - send collected parts
+            if (writeAll(fd, vector, count) != 0)
+            {
+                return -1;
+            }
+            count = 0;
+        }
+        vector[count].iov_base = (char*) parts[i];
+        vector[count].iov_len = lengths[i];
+        count++;
+    }
+
+    return writeAll(fd, vector, count);
+}
+
+int lsocket_read(int fd, char* buffer, int size)
+{
+    while (size > 0)
+    {
+        ssize_t bytesRead = read(fd, buffer, size);
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            log_error("Unable to read from local socket: %s", strerror(errno));
+            return -1;
+        }
+        if (bytesRead == 0)
+        {   // connection is closed
+            return -1;
+        }
+        buffer += bytesRead;
+        size -= bytesRead;
+    }
+
+    return 0;
+}
+
+int lsocket_readHeader(int fd, Local_Socket_Header* header)
+{
+    unsigned char buffer[LSOCKET_HEADER_SIZE];
+    uint16_t netUriLength;
+    uint32_t netBodyLength;
+
+    if (lsocket_read(fd, (char*) buffer, LSOCKET_HEADER_SIZE) != 0)
+    {
+        return -1;
+    }
+
+    memcpy(&netUriLength, buffer + 2, 2);
+    memcpy(&netBodyLength, buffer + 4, 4);
+    header->type = (LSOCKET_FRAME_TYPE) buffer[0];
+    header->uriLength = ntohs(netUriLength);
+    header->bodyLength = ntohl(netBodyLength);
+
+    if ((header->type < LSOCKET_GET) || (header->type > LSOCKET_ERROR)
+            || (header->bodyLength < 0))
+    {
+        log_error("Received malformed frame from local socket.");
+        return -1;
+    }
+
+    if (header->bodyLength > LSOCKET_BODY_MAX_LENGTH)
+    {
+        log_error("Received frame from local socket is too big (%d bytes, "
+                  "maximum is %d).", header->bodyLength,
+                  LSOCKET_BODY_MAX_LENGTH);
+        return -1;
+    }
+
+    return 0;
+}
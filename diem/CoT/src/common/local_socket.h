@@ -0,0 +1,134 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Defines helper functions for exchanging oBIX messages over a local (Unix
+ * domain) socket.
+ *
+ * When client and server run on the same machine, requests can be delivered
+ * directly through a Unix domain socket instead of HTTP and FastCGI. Every
+ * message is sent as a frame, consisting of a fixed size binary header
+ * followed by the message URI and body:
+ * @code
+ * | type (1) | reserved (1) | URI length (2) | body length (4) | URI | body |
+ * @endcode
+ * All numbers are sent in network byte order. Requests use frame types
+ * #LSOCKET_GET, #LSOCKET_PUT and #LSOCKET_POST and contain the requested URI.
+ * Server answers with a single #LSOCKET_RESPONSE frame. Its URI is set only
+ * if the address of the returned object differs from the requested one (the
+ * same as Content-Location HTTP header). Frame #LSOCKET_ERROR is sent instead
+ * if the request could not be processed at all.
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef LOCAL_SOCKET_H_
+#define LOCAL_SOCKET_H_
+
+#include <sys/types.h>
+
+/** Size of the frame header in bytes. */
+#define LSOCKET_HEADER_SIZE 8
+/** Maximum length of URI which can be sent in one frame. */
+#define LSOCKET_URI_MAX_LENGTH 0xFFFF
+/** Maximum length of a frame body. Bigger frames are rejected, so that a
+ * peer can't make the other side allocate unlimited amount of memory. */
+#define LSOCKET_BODY_MAX_LENGTH (16 * 1024 * 1024)
+
+/** Types of frames. */
+typedef enum
+{
+    LSOCKET_GET = 1,
+    LSOCKET_PUT = 2,
+    LSOCKET_POST = 3,
+    LSOCKET_RESPONSE = 4,
+    LSOCKET_ERROR = 5
+} LSOCKET_FRAME_TYPE;
+
+/** Parsed header of the received frame. */
+typedef struct _Local_Socket_Header
+{
+    /** Type of the frame. */
+    LSOCKET_FRAME_TYPE type;
+    /** Length of the URI which follows the header. */
+    int uriLength;
+    /** Length of the body which follows the URI. */
+    int bodyLength;
+}
+Local_Socket_Header;
+
+/**
+ * Connects to the local socket.
+ *
+ * @param path Path to the socket file.
+ * @return Descriptor of the connected socket, or @a -1 on error.
+ */
+int lsocket_connect(const char* path);
+
+/**
+ * Creates local socket, which listens for incoming connections. Socket file
+ * left from the previous run is removed.
+ *
+ * @param path Path to the socket file.
+ * @param mode Access permissions of the socket file. Only processes which
+ *             are allowed to write to the file can connect.
+ * @return Descriptor of the listening socket, or @a -1 on error.
+ */
+int lsocket_listen(const char* path, mode_t mode);
+
+/**
+ * Sends one frame. The body can be provided in several parts, which are sent
+ * with one system call without copying them to a single buffer.
+ *
+ * @param fd Socket descriptor.
+ * @param type Type of the frame.
+ * @param uri URI to be sent in the frame. Can be @a NULL.
+ * @param parts Parts of the frame body.
+ * @param lengths Lengths of the body parts.
+ * @param partCount Number of body parts. Can be @a 0.
+ * @return @a 0 on success, @a -1 on error.
+ */
+int lsocket_writeFrame(int fd,
+                       LSOCKET_FRAME_TYPE type,
+                       const char* uri,
+                       const char** parts,
+                       const int* lengths,
+                       int partCount);
+
+/**
+ * Receives and parses header of the next frame.
+ *
+ * @param fd Socket descriptor.
+ * @param header Parsed header is written here.
+ * @return @a 0 on success, @a -1 on error or if the other side closed the
+ *         connection.
+ */
+int lsocket_readHeader(int fd, Local_Socket_Header* header);
+
+/**
+ * Reads exactly @a size bytes from the socket. Used for receiving URI and
+ * body of the frame after its header.
+ *
+ * @return @a 0 on success, @a -1 on error.
+ */
+int lsocket_read(int fd, char* buffer, int size);
+
+#endif /* LOCAL_SOCKET_H_ */
@@ -32,6 +32,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <syslog.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "bool.h"
 #include "log_utils.h"
@@ -47,6 +49,12 @@ static void log_errorPrintf(char* fmt, ...);
 static void log_debugSyslog(char* fmt, ...);
 static void log_warningSyslog(char* fmt, ...);
 static void log_errorSyslog(char* fmt, ...);
+/** @}
+ * @name Asynchronous logging
+ * @{ */
+static void log_debugAsync(char* fmt, ...);
+static void log_warningAsync(char* fmt, ...);
+static void log_errorAsync(char* fmt, ...);
 /** @} */
 
 /** @name Log handlers.
@@ -58,11 +66,63 @@ log_function log_errorHandler = &log_errorPrintf;
 /** @} */
 
 /** Defines global log level. */
-static int _log_level = LOG_LEVEL_DEBUG;
+LOG_LEVEL log_currentLevel = LOG_LEVEL_DEBUG;
 
 /** Logging mode. */
 static BOOL _use_syslog = FALSE;
 
+/** Maximum length of a message in asynchronous mode. Longer messages are
+ * truncated. */
+#define ASYNC_MESSAGE_SIZE 512
+/** How long the writer thread sleeps when there are no new messages
+ * (in microseconds). */
+#define ASYNC_IDLE_PERIOD 20000
+
+/** Message stored in the ring buffer. */
+typedef struct
+{
+    LOG_LEVEL level;
+    char text[ASYNC_MESSAGE_SIZE];
+}
+Async_Message;
+
+/**
+ * Ring buffer of one thread. Only the owner thread moves @a head and only the
+ * writer thread moves @a tail, thus no locks are needed.
+ */
+typedef struct Async_Buffer
+{
+    Async_Message* messages;
+    /** Number of messages in the buffer (power of two). */
+    unsigned int size;
+    /** Counter of messages put to the buffer. */
+    volatile unsigned int head;
+    /** Counter of messages printed by the writer thread. */
+    volatile unsigned int tail;
+    /** Number of messages dropped because the buffer was full. */
+    volatile unsigned int lost;
+    /** Set when the owner thread exits. Such buffer is freed by the writer
+     * thread when all messages are printed. */
+    volatile BOOL orphaned;
+    struct Async_Buffer* next;
+}
+Async_Buffer;
+
+/** Tells whether asynchronous mode is on. */
+static volatile BOOL _async = FALSE;
+/** Size of new ring buffers. */
+static unsigned int _asyncSize = LOG_ASYNC_SIZE_DEFAULT;
+/** All ring buffers. The mutex is used only to add and remove buffers. */
+static Async_Buffer* _asyncBuffers = NULL;
+static pthread_mutex_t _asyncBuffersMutex = PTHREAD_MUTEX_INITIALIZER;
+/** Ring buffer of the current thread. */
+static __thread Async_Buffer* _threadBuffer = NULL;
+/** Is used to get notified when a thread with ring buffer exits. */
+static pthread_key_t _asyncBufferKey;
+static BOOL _asyncInitialized = FALSE;
+/** Thread which prints buffered messages. */
+static pthread_t _asyncWriter;
+
 /** Logs debug message using printf. */
 static void log_debugPrintf(char* fmt, ...)
 {
@@ -123,6 +183,204 @@ static void log_errorSyslog(char* fmt, ...)
     va_end(args);
 }
 
+/** Prints a message, which was formatted earlier. */
+static void printMessage(LOG_LEVEL level, const char* text)
+{
+    if (_use_syslog)
+    {
+        int priority = (level == LOG_LEVEL_DEBUG) ? LOG_DEBUG :
+                       (level == LOG_LEVEL_WARNING) ? LOG_WARNING : LOG_ERR;
+        syslog(priority, "%s", text);
+    }
+    else
+    {
+        const char* prefix = (level == LOG_LEVEL_DEBUG) ? "DEBUG" :
+                             (level == LOG_LEVEL_WARNING) ? "WARNING" : "ERROR";
+        printf("%s %s\n", prefix, text);
+    }
+}
+
+/** Marks ring buffer of the exited thread as orphaned. */
+static void releaseThreadBuffer(void* arg)
+{
+    Async_Buffer* buffer = (Async_Buffer*) arg;
+    __sync_synchronize();
+    buffer->orphaned = TRUE;
+}
+
+/** Returns ring buffer of the current thread creating it if needed. */
+static Async_Buffer* getThreadBuffer()
+{
+    if (_threadBuffer != NULL)
+    {
+        return _threadBuffer;
+    }
+
+    Async_Buffer* buffer = (Async_Buffer*) malloc(sizeof(Async_Buffer));
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+    buffer->size = _asyncSize;
+    buffer->messages =
+        (Async_Message*) malloc(buffer->size * sizeof(Async_Message));
+    if (buffer->messages == NULL)
+    {
+        free(buffer);
+        return NULL;
+    }
+    buffer->head = 0;
+    buffer->tail = 0;
+    buffer->lost = 0;
+    buffer->orphaned = FALSE;
+
+    pthread_mutex_lock(&_asyncBuffersMutex);
+    buffer->next = _asyncBuffers;
+    _asyncBuffers = buffer;
+    pthread_mutex_unlock(&_asyncBuffersMutex);
+
+    pthread_setspecific(_asyncBufferKey, buffer);
+    _threadBuffer = buffer;
+    return buffer;
+}
+
+/** Puts message to the ring buffer of the current thread. */
+static void writeAsync(LOG_LEVEL level, const char* fmt, va_list args)
+{
+    Async_Buffer* buffer = getThreadBuffer();
+    if (buffer == NULL)
+    {
+        // not enough memory for the buffer, print the message directly
+        char text[ASYNC_MESSAGE_SIZE];
+        vsnprintf(text, ASYNC_MESSAGE_SIZE, fmt, args);
+        printMessage(level, text);
+        return;
+    }
+
+    unsigned int head = buffer->head;
+    if (head - buffer->tail >= buffer->size)
+    {
+        __sync_add_and_fetch(&(buffer->lost), 1);
+        return;
+    }
+
+    Async_Message* message = &(buffer->messages[head & (buffer->size - 1)]);
+    message->level = level;
+    vsnprintf(message->text, ASYNC_MESSAGE_SIZE, fmt, args);
+    // the message should be completely written before it is published
+    __sync_synchronize();
+    buffer->head = head + 1;
+}
+
+/** Logs debug message to the ring buffer. */
+static void log_debugAsync(char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    writeAsync(LOG_LEVEL_DEBUG, fmt, args);
+    va_end(args);
+}
+
+/** Logs warning message to the ring buffer. */
+static void log_warningAsync(char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    writeAsync(LOG_LEVEL_WARNING, fmt, args);
+    va_end(args);
+}
+
+/** Logs error message to the ring buffer. */
+static void log_errorAsync(char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    writeAsync(LOG_LEVEL_ERROR, fmt, args);
+    va_end(args);
+}
+
+/**
+ * Prints all messages of the ring buffer.
+ * @return Number of printed messages.
+ */
+static int drainBuffer(Async_Buffer* buffer)
+{
+    unsigned int head = buffer->head;
+    // messages are read only after the head is read
+    __sync_synchronize();
+    int count = 0;
+    while (buffer->tail != head)
+    {
+        Async_Message* message =
+            &(buffer->messages[buffer->tail & (buffer->size - 1)]);
+        printMessage(message->level, message->text);
+        __sync_synchronize();
+        buffer->tail++;
+        count++;
+    }
+
+    unsigned int lost = buffer->lost;
+    if (lost > 0)
+    {
+        __sync_sub_and_fetch(&(buffer->lost), lost);
+        char text[64];
+        sprintf(text, "%u log messages are lost: buffer is full.", lost);
+        printMessage(LOG_LEVEL_WARNING, text);
+    }
+
+    if (!_use_syslog)
+    {
+        fflush(stdout);
+    }
+    return count;
+}
+
+/**
+ * Prints messages of all ring buffers and frees buffers of exited threads.
+ * @return Number of printed messages.
+ */
+static int drainAll()
+{
+    int count = 0;
+    pthread_mutex_lock(&_asyncBuffersMutex);
+    Async_Buffer** link = &_asyncBuffers;
+    while (*link != NULL)
+    {
+        Async_Buffer* buffer = *link;
+        BOOL orphaned = buffer->orphaned;
+        count += drainBuffer(buffer);
+        if (orphaned)
+        {
+            // the owner thread exited before the buffer was drained, so
+            // nothing can be added there anymore
+            *link = buffer->next;
+            free(buffer->messages);
+            free(buffer);
+        }
+        else
+        {
+            link = &(buffer->next);
+        }
+    }
+    pthread_mutex_unlock(&_asyncBuffersMutex);
+    return count;
+}
+
+/** Body of the thread, which prints buffered messages. */
+static void* asyncWriterThread(void* arg)
+{
+    while (_async)
+    {
+        if (drainAll() == 0)
+        {
+            usleep(ASYNC_IDLE_PERIOD);
+        }
+    }
+    // print messages which were added before the mode was switched
+    drainAll();
+    return NULL;
+}
+
 /** Does not log anything.
  * Used to ignore messages of some priorities according to the global log level.
  */
@@ -131,45 +389,43 @@ static void log_nothing(char* fmt, ...)
     // dismiss the log message
 }
 
-/** Configures logging system in printf mode according to global log level. */
-static void setPrintf()
+/** Sets log handlers according to global log level. */
+static void setHandlers(log_function debug,
+                        log_function warning,
+                        log_function error)
 {
     // drop all log functions
     log_debugHandler = &log_nothing;
     log_warningHandler = &log_nothing;
     log_errorHandler = &log_nothing;
     // set corresponding log functions
-    switch(_log_level)
+    switch(log_currentLevel)
     {
     case LOG_LEVEL_DEBUG:
-        log_debugHandler = &log_debugPrintf;
+        log_debugHandler = debug;
     case LOG_LEVEL_WARNING:
-        log_warningHandler = &log_warningPrintf;
+        log_warningHandler = warning;
     case LOG_LEVEL_ERROR:
-        log_errorHandler = &log_errorPrintf;
+        log_errorHandler = error;
     default:
     	break;
     }
 }
 
-/** Configures logging system in syslog mode according to global log level. */
-static void setSyslog()
+/** Configures logging system according to the current mode. */
+static void updateHandlers()
 {
-    // drop all log functions
-    log_debugHandler = &log_nothing;
-    log_warningHandler = &log_nothing;
-    log_errorHandler = &log_nothing;
-    // set corresponding log functions
-    switch(_log_level)
+    if (_async)
     {
-    case LOG_LEVEL_DEBUG:
-        log_debugHandler = &log_debugSyslog;
-    case LOG_LEVEL_WARNING:
-        log_warningHandler = &log_warningSyslog;
-    case LOG_LEVEL_ERROR:
-        log_errorHandler = &log_errorSyslog;
-    default:
-    	break;
+        setHandlers(&log_debugAsync, &log_warningAsync, &log_errorAsync);
+    }
+    else if (_use_syslog)
+    {
+        setHandlers(&log_debugSyslog, &log_warningSyslog, &log_errorSyslog);
+    }
+    else
+    {
+        setHandlers(&log_debugPrintf, &log_warningPrintf, &log_errorPrintf);
     }
 }
 
@@ -178,25 +434,69 @@ void log_usePrintf()
     _use_syslog = FALSE;
     // close syslog connection if it was opened
     closelog();
-    setPrintf();
+    updateHandlers();
 }
 
 void log_useSyslog(int facility)
 {
     _use_syslog = TRUE;
     openlog(NULL, LOG_NDELAY, facility);
-    setSyslog();
+    updateHandlers();
 }
 
 void log_setLevel(LOG_LEVEL level)
 {
-    _log_level = level;
-    if (_use_syslog)
+    log_currentLevel = level;
+    updateHandlers();
+}
+
+int log_startAsync(int size)
+{
+    if (_async)
     {
-        setSyslog();
+        return 0;
     }
-    else
+
+    if (!_asyncInitialized)
+    {
+        if (pthread_key_create(&_asyncBufferKey, &releaseThreadBuffer) != 0)
+        {
+            log_error("Unable to start asynchronous logging: "
+                      "pthread_key_create() failed.");
+            return -1;
+        }
+        // buffered messages should not be lost on exit
+        atexit(&log_stopAsync);
+        _asyncInitialized = TRUE;
+    }
+
+    // only buffers created after this call get the new size
+    _asyncSize = 1;
+    while (_asyncSize < size)
+    {
+        _asyncSize <<= 1;
+    }
+
+    _async = TRUE;
+    if (pthread_create(&_asyncWriter, NULL, &asyncWriterThread, NULL) != 0)
     {
-        setPrintf();
+        _async = FALSE;
+        log_error("Unable to start asynchronous logging: "
+                  "pthread_create() failed.");
+        return -1;
     }
+    updateHandlers();
+    return 0;
+}
+
+void log_stopAsync()
+{
+    if (!_async)
+    {
+        return;
+    }
+
+    _async = FALSE;
+    updateHandlers();
+    pthread_join(_asyncWriter, NULL);
 }
@@ -29,12 +29,22 @@
  *
  * The default mode is @a printf, but it can be switched at any time.
  *
+ * In both modes messages can be written asynchronously (see
+ * #log_startAsync()): each thread puts its messages to its own ring buffer
+ * and a background thread prints them, so that slow console or @a syslog
+ * output doesn't block request handling.
+ *
  * Library provides three simple methods for logging messages with different
  * priority levels:
  * - #log_debug()
  * - #log_warning()
  * - #log_error()
  *
+ * Arguments of a message are evaluated only if the message is going to be
+ * printed according to the current log level. If @a LOG_NO_DEBUG is defined
+ * at compile time (@a --disable-debug-log configure option), debug messages
+ * are removed from the code completely.
+ *
  * @author Andrey Litvinov
  */
 
@@ -69,11 +79,42 @@ extern log_function log_warningHandler;
 extern log_function log_errorHandler;
 /** @} */
 
+/**
+ * Defines possible log levels.
+ */
+typedef enum
+{
+	/** Debug log level. */
+	LOG_LEVEL_DEBUG,
+	/** Warning log level. */
+	LOG_LEVEL_WARNING,
+	/** Error log level. */
+	LOG_LEVEL_ERROR,
+	/** 'No' log level. */
+	LOG_LEVEL_NO
+} LOG_LEVEL;
+
+/**
+ * Contains the minimum priority level of the messages which are processed.
+ * Normally #log_setLevel() should be used to change it.
+ */
+extern LOG_LEVEL log_currentLevel;
+
 /**@name Logging utilities
  * @{*/
 // A trick with define is done in order to auto-add filename and line number
 // into the log message.
 
+/**
+ * Tells whether @a debug messages are printed. Can be used to skip
+ * preparation of debug output, which is expensive to generate.
+ */
+#ifdef LOG_NO_DEBUG
+#define log_isDebugEnabled() (0)
+#else
+#define log_isDebugEnabled() (log_currentLevel <= LOG_LEVEL_DEBUG)
+#endif
+
 /**
  * Prints @a debug message to the configured output.
  * Automatically adds filename and string number of the place from where the log
@@ -81,8 +122,10 @@ extern log_function log_errorHandler;
  *
  * @param fmt Message format (used in the same way as with @a printf()).
  */
-#define log_debug(fmt, ...) (*log_debugHandler)("%s(%d): " fmt, __FILE__, \
- __LINE__, ## __VA_ARGS__)
+#define log_debug(fmt, ...) \
+    do { if (log_isDebugEnabled()) \
+        (*log_debugHandler)("%s(%d): " fmt, __FILE__, \
+                            __LINE__, ## __VA_ARGS__); } while (0)
 
 /**
  * Prints @a warning message to the configured output.
@@ -91,8 +134,10 @@ extern log_function log_errorHandler;
  *
  * @param fmt Message format (used in the same way as with @a printf()).
  */
-#define log_warning(fmt, ...) (*log_warningHandler)("%s(%d): " fmt, __FILE__, \
- __LINE__, ## __VA_ARGS__)
+#define log_warning(fmt, ...) \
+    do { if (log_currentLevel <= LOG_LEVEL_WARNING) \
+        (*log_warningHandler)("%s(%d): " fmt, __FILE__, \
+                              __LINE__, ## __VA_ARGS__); } while (0)
 
 /**
  * Prints @a error message to the configured output.
@@ -101,25 +146,12 @@ extern log_function log_errorHandler;
  *
  * @param fmt Message format (used in the same way as with @a printf()).
  */
-#define log_error(fmt, ...) (*log_errorHandler)("%s(%d): " fmt, __FILE__, \
- __LINE__, ## __VA_ARGS__)
+#define log_error(fmt, ...) \
+    do { if (log_currentLevel <= LOG_LEVEL_ERROR) \
+        (*log_errorHandler)("%s(%d): " fmt, __FILE__, \
+                            __LINE__, ## __VA_ARGS__); } while (0)
 /**@}*/
 
-/**
- * Defines possible log levels.
- */
-typedef enum
-{
-	/** Debug log level. */
-	LOG_LEVEL_DEBUG,
-	/** Warning log level. */
-	LOG_LEVEL_WARNING,
-	/** Error log level. */
-	LOG_LEVEL_ERROR,
-	/** 'No' log level. */
-	LOG_LEVEL_NO
-} LOG_LEVEL;
-
 /**
  * Switches library to use @a syslog for handling messages.
  *
@@ -145,4 +177,29 @@ void log_usePrintf();
  */
 void log_setLevel(LOG_LEVEL level);
 
+/** Default number of messages, which can be buffered by each thread in
+ * asynchronous mode. */
+#define LOG_ASYNC_SIZE_DEFAULT 256
+
+/**
+ * Switches library to asynchronous mode: messages are put to ring buffers
+ * (one per thread) and printed by a background thread. When a buffer is
+ * full, new messages of that thread are dropped and the number of dropped
+ * messages is reported later.
+ *
+ * Buffered messages are printed when #log_stopAsync() is called or when the
+ * program exits.
+ *
+ * @param size Number of messages which can be buffered by each thread. It is
+ *             rounded up to a power of two.
+ * @return @a 0 on success, @a -1 on error.
+ */
+int log_startAsync(int size);
+
+/**
+ * Prints all buffered messages and switches library back to synchronous
+ * mode.
+ */
+void log_stopAsync();
+
 #endif /* LOG_UTILS_H_ */
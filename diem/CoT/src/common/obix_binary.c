@@ -0,0 +1,681 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of binary encoding of oBIX messages.
+ *
+ * @see obix_binary.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "log_utils.h"
+#include "obix_binary.h"
+
+const char* OBIX_BINARY_CONTENT_TYPE = "application/x-obix-binary";
+
+/** Maximum nesting level of decoded objects. Protects decoder from corrupted
+ * messages. */
+#define MAX_DEPTH 256
+
+/** Names of oBIX objects, which are encoded with one byte. Code of a name is
+ * its index plus one. New names can be added only to the end of the list,
+ * otherwise encoding becomes incompatible with older versions. */
+static const char* TAG_NAMES[] =
+    {
+        "obj", "ref", "op", "list", "err", "bool", "int", "real", "str",
+        "enum", "abstime", "reltime", "uri", "feed", "date", "time"
+    };
+
+/** Names of attributes, which are encoded with one byte. The same rules as
+ * for #TAG_NAMES apply. */
+static const char* ATTR_NAMES[] =
+    {
+        "href", "val", "is", "name", "null", "writable", "display",
+        "displayName", "min", "max", "in", "out", "of", "unit", "range",
+        "precision", "status", "icon", "tz", "xmlns", "xmlns:xsi",
+        "xsi:schemaLocation"
+    };
+
+#define TAG_COUNT ((int) (sizeof(TAG_NAMES) / sizeof(TAG_NAMES[0])))
+#define ATTR_COUNT ((int) (sizeof(ATTR_NAMES) / sizeof(ATTR_NAMES[0])))
+
+/** State of the decoder. */
+typedef struct _Decoder
+{
+    const unsigned char* data;
+    int length;
+    int pos;
+    /** Temporary storage for the decoded name. */
+    String_Buffer* name;
+    /** Temporary storage for the decoded attribute value. */
+    String_Buffer* value;
+}
+Decoder;
+
+/**
+ * Returns code of the name, or #OBIX_BINARY_CUSTOM if there is no such name in
+ * the list.
+ * @param length Length of the name (it is not necessarily terminated).
+ */
+static int getCode(const char** names, int count, const char* name, int length)
+{
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        if ((strncmp(names[i], name, length) == 0)
+                && (names[i][length] == '\0'))
+        {
+            return i + 1;
+        }
+    }
+
+    return OBIX_BINARY_CUSTOM;
+}
+
+static int appendCode(String_Buffer* buffer, int code)
+{
+    char byte = (char) code;
+    return strbuf_appendLength(buffer, &byte, 1);
+}
+
+/** Appends variable length integer. */
+static int appendLength(String_Buffer* buffer, unsigned int length)
+{
+    char bytes[5];
+    int count = 0;
+
+    do
+    {
+        bytes[count] = length & 0x7F;
+        length >>= 7;
+        if (length != 0)
+        {
+            bytes[count] |= 0x80;
+        }
+        count++;
+    }
+    while (length != 0);
+
+    return strbuf_appendLength(buffer, bytes, count);
+}
+
+static int appendString(String_Buffer* buffer, const char* str, int length)
+{
+    if (appendLength(buffer, length) != 0)
+    {
+        return -1;
+    }
+    return strbuf_appendLength(buffer, str, length);
+}
+
+/** Appends code of the name, followed by the name itself if it is custom. */
+static int appendName(String_Buffer* buffer,
+                      const char** names,
+                      int count,
+                      const char* name,
+                      int length)
+{
+    int code = getCode(names, count, name, length);
+    if (appendCode(buffer, code) != 0)
+    {
+        return -1;
+    }
+    if (code == OBIX_BINARY_CUSTOM)
+    {
+        return appendString(buffer, name, length);
+    }
+    return 0;
+}
+
+/** Appends character with provided code in UTF-8. */
+static int appendUtf8(String_Buffer* buffer, long code)
+{
+    char bytes[4];
+    int count;
+
+    if (code < 0x80)
+    {
+        bytes[0] = (char) code;
+        count = 1;
+    }
+    else if (code < 0x800)
+    {
+        bytes[0] = 0xC0 | (code >> 6);
+        bytes[1] = 0x80 | (code & 0x3F);
+        count = 2;
+    }
+    else if (code < 0x10000)
+    {
+        bytes[0] = 0xE0 | (code >> 12);
+        bytes[1] = 0x80 | ((code >> 6) & 0x3F);
+        bytes[2] = 0x80 | (code & 0x3F);
+        count = 3;
+    }
+    else if (code < 0x110000)
+    {
+        bytes[0] = 0xF0 | (code >> 18);
+        bytes[1] = 0x80 | ((code >> 12) & 0x3F);
+        bytes[2] = 0x80 | ((code >> 6) & 0x3F);
+        bytes[3] = 0x80 | (code & 0x3F);
+        count = 4;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return strbuf_appendLength(buffer, bytes, count);
+}
+
+/**
+ * Writes XML attribute value to the buffer replacing entities with
+ * corresponding characters.
+ * @return @a 0 on success; @a -1 if value contains wrong entity or there is
+ *         not enough memory.
+ */
+static int unescapeXml(String_Buffer* buffer, const char* str, int length)
+{
+    const char* end = str + length;
+    const char* start = str;
+
+    strbuf_reset(buffer);
+    while (str < end)
+    {
+        if (*str != '&')
+        {
+            str++;
+            continue;
+        }
+
+        // copy unescaped part at once
+        if (strbuf_appendLength(buffer, start, str - start) != 0)
+        {
+            return -1;
+        }
+
+        const char* entity = str + 1;
+        const char* semicolon = memchr(entity, ';', end - entity);
+        if (semicolon == NULL)
+        {
+            return -1;
+        }
+
+        int entityLength = semicolon - entity;
+        int error;
+        if ((entityLength == 3) && (strncmp(entity, "amp", 3) == 0))
+        {
+            error = strbuf_append(buffer, "&");
+        }
+        else if ((entityLength == 2) && (strncmp(entity, "lt", 2) == 0))
+        {
+            error = strbuf_append(buffer, "<");
+        }
+        else if ((entityLength == 2) && (strncmp(entity, "gt", 2) == 0))
+        {
+            error = strbuf_append(buffer, ">");
+        }
+        else if ((entityLength == 4) && (strncmp(entity, "quot", 4) == 0))
+        {
+            error = strbuf_append(buffer, "\"");
+        }
+        else if ((entityLength == 4) && (strncmp(entity, "apos", 4) == 0))
+        {
+            error = strbuf_append(buffer, "'");
+        }
+        else if ((entityLength > 1) && (*entity == '#'))
+        {
+            // numeric character reference
+            char* numberEnd;
+            long code;
+            if ((entity[1] == 'x') || (entity[1] == 'X'))
+            {
+                code = strtol(entity + 2, &numberEnd, 16);
+            }
+            else
+            {
+                code = strtol(entity + 1, &numberEnd, 10);
+            }
+            if (numberEnd != semicolon)
+            {
+                return -1;
+            }
+            error = appendUtf8(buffer, code);
+        }
+        else
+        {
+            return -1;
+        }
+
+        if (error != 0)
+        {
+            return -1;
+        }
+        str = semicolon + 1;
+        start = str;
+    }
+
+    return strbuf_appendLength(buffer, start, str - start);
+}
+
+/** Returns pointer to the first character after XML name. */
+static const char* skipName(const char* str)
+{
+    while ((*str != '\0') && (strchr(" \t\r\n=/>", *str) == NULL))
+    {
+        str++;
+    }
+    return str;
+}
+
+static const char* skipSpaces(const char* str)
+{
+    while ((*str == ' ') || (*str == '\t') || (*str == '\r') || (*str == '\n'))
+    {
+        str++;
+    }
+    return str;
+}
+
+/**
+ * Converts attributes of XML start tag to binary tokens.
+ * @param str Pointer to the first character after the tag name.
+ * @return Pointer to the first character after the tag, or @a NULL on error.
+ */
+static const char* encodeXmlAttributes(const char* str,
+                                       String_Buffer* buffer,
+                                       String_Buffer* value)
+{
+    while (TRUE)
+    {
+        str = skipSpaces(str);
+        if (*str == '>')
+        {
+            // children follow
+            return (appendCode(buffer, OBIX_BINARY_END) == 0) ? str + 1 : NULL;
+        }
+        if (*str == '/')
+        {
+            // empty tag: close both attributes and children lists
+            if ((str[1] != '>')
+                    || (appendCode(buffer, OBIX_BINARY_END) != 0)
+                    || (appendCode(buffer, OBIX_BINARY_END) != 0))
+            {
+                return NULL;
+            }
+            return str + 2;
+        }
+
+        const char* name = str;
+        str = skipName(str);
+        int nameLength = str - name;
+        str = skipSpaces(str);
+        if ((nameLength == 0) || (*str != '='))
+        {
+            return NULL;
+        }
+        str = skipSpaces(str + 1);
+        if ((*str != '"') && (*str != '\''))
+        {
+            return NULL;
+        }
+        const char* valueEnd = strchr(str + 1, *str);
+        if (valueEnd == NULL)
+        {
+            return NULL;
+        }
+
+        if ((unescapeXml(value, str + 1, valueEnd - str - 1) != 0)
+                || (appendName(buffer, ATTR_NAMES, ATTR_COUNT,
+                               name, nameLength) != 0)
+                || (appendString(buffer, value->data, value->length) != 0))
+        {
+            return NULL;
+        }
+        str = valueEnd + 1;
+    }
+}
+
+int obixBinary_appendHeader(String_Buffer* buffer)
+{
+    if ((appendCode(buffer, OBIX_BINARY_MAGIC) != 0)
+            || (appendCode(buffer, OBIX_BINARY_VERSION) != 0))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int obixBinary_appendTag(String_Buffer* buffer, const char* tagName)
+{
+    return appendName(buffer, TAG_NAMES, TAG_COUNT, tagName, strlen(tagName));
+}
+
+int obixBinary_appendAttr(String_Buffer* buffer,
+                          const char* name,
+                          const char* value)
+{
+    if (value == NULL)
+    {
+        value = "";
+    }
+    if (appendName(buffer, ATTR_NAMES, ATTR_COUNT, name, strlen(name)) != 0)
+    {
+        return -1;
+    }
+    return appendString(buffer, value, strlen(value));
+}
+
+int obixBinary_appendEnd(String_Buffer* buffer)
+{
+    return appendCode(buffer, OBIX_BINARY_END);
+}
+
+int obixBinary_encode(IXML_Element* element, String_Buffer* buffer)
+{
+    IXML_Node* node = ixmlElement_getNode(element);
+    int error = obixBinary_appendTag(buffer, ixmlElement_getTagName(element));
+
+    // attributes are walked directly, so that no IXML_NamedNodeMap is
+    // allocated for every encoded object
+    IXML_Node* attr;
+    for (attr = node->firstAttr;
+            (attr != NULL) && (error == 0);
+            attr = attr->nextSibling)
+    {
+        error = obixBinary_appendAttr(buffer,
+                                      ixmlNode_getNodeName(attr),
+                                      ixmlNode_getNodeValue(attr));
+    }
+    if (error == 0)
+    {
+        error = appendCode(buffer, OBIX_BINARY_END);
+    }
+
+    IXML_Node* child;
+    for (child = ixmlNode_getFirstChild(node);
+            (child != NULL) && (error == 0);
+            child = ixmlNode_getNextSibling(child))
+    {
+        IXML_Element* childElement = ixmlNode_convertToElement(child);
+        if (childElement != NULL)
+        {
+            error = obixBinary_encode(childElement, buffer);
+        }
+    }
+    if (error == 0)
+    {
+        error = appendCode(buffer, OBIX_BINARY_END);
+    }
+
+    return (error == 0) ? 0 : -1;
+}
+
+int obixBinary_encodeXml(const char* xml, String_Buffer* buffer)
+{
+    // decoded attribute values are stored here
+    String_Buffer* value = strbuf_create(64);
+    if (value == NULL)
+    {
+        return -1;
+    }
+
+    // xml is set to NULL on error
+    while ((xml != NULL) && (*xml != '\0'))
+    {
+        if (*xml != '<')
+        {
+            // text between tags is not encoded
+            xml++;
+            continue;
+        }
+        xml++;
+
+        if (*xml == '?')
+        {
+            // XML declaration
+            xml = strstr(xml, "?>");
+            if (xml != NULL)
+            {
+                xml += 2;
+            }
+        }
+        else if (strncmp(xml, "!--", 3) == 0)
+        {
+            xml = strstr(xml + 3, "-->");
+            if (xml != NULL)
+            {
+                xml += 3;
+            }
+        }
+        else if (*xml == '!')
+        {
+            // doctype is skipped
+            xml = strchr(xml, '>');
+            if (xml != NULL)
+            {
+                xml++;
+            }
+        }
+        else if (*xml == '/')
+        {
+            // end tag closes children list
+            xml = strchr(xml, '>');
+            if ((xml != NULL) && (appendCode(buffer, OBIX_BINARY_END) == 0))
+            {
+                xml++;
+            }
+            else
+            {
+                xml = NULL;
+            }
+        }
+        else
+        {
+            // start tag
+            const char* name = xml;
+            xml = skipName(xml);
+            if ((xml == name)
+                    || (appendName(buffer, TAG_NAMES, TAG_COUNT,
+                                   name, xml - name) != 0))
+            {
+                xml = NULL;
+            }
+            else
+            {
+                xml = encodeXmlAttributes(xml, buffer, value);
+            }
+        }
+    }
+
+    strbuf_free(value);
+    if (xml == NULL)
+    {
+        log_warning("Unable to convert XML to binary encoding.");
+        return -1;
+    }
+    return 0;
+}
+
+/** Reads one byte. @return Read byte, or @a -1 if message is over. */
+static int readByte(Decoder* d)
+{
+    if (d->pos >= d->length)
+    {
+        return -1;
+    }
+    return d->data[d->pos++];
+}
+
+/** Reads string to the provided buffer. */
+static int readString(Decoder* d, String_Buffer* buffer)
+{
+    unsigned int length = 0;
+    int shift = 0;
+    int byte;
+
+    do
+    {
+        byte = readByte(d);
+        if ((byte < 0) || (shift > 28))
+        {
+            return -1;
+        }
+        length |= (unsigned int) (byte & 0x7F) << shift;
+        shift += 7;
+    }
+    while ((byte & 0x80) != 0);
+
+    if (length > (unsigned int) (d->length - d->pos))
+    {
+        return -1;
+    }
+
+    strbuf_reset(buffer);
+    if (strbuf_appendLength(buffer,
+                            (const char*) d->data + d->pos,
+                            length) != 0)
+    {
+        return -1;
+    }
+    d->pos += length;
+    return 0;
+}
+
+/**
+ * Reads name with provided code.
+ * @return Name, or @a NULL if the code is unknown.
+ */
+static const char* readName(Decoder* d,
+                            int code,
+                            const char** names,
+                            int count)
+{
+    if (code == OBIX_BINARY_CUSTOM)
+    {
+        return (readString(d, d->name) == 0) ? d->name->data : NULL;
+    }
+    if ((code < 1) || (code > count))
+    {
+        return NULL;
+    }
+    return names[code - 1];
+}
+
+/** Decodes object and appends it to the parent node. */
+static IXML_Element* decodeElement(Decoder* d,
+                                   IXML_Document* doc,
+                                   IXML_Node* parent,
+                                   int depth)
+{
+    const char* tagName = readName(d, readByte(d), TAG_NAMES, TAG_COUNT);
+    if ((tagName == NULL) || (depth > MAX_DEPTH))
+    {
+        return NULL;
+    }
+
+    IXML_Element* element;
+    if (ixmlDocument_createElementEx(doc, tagName, &element) != IXML_SUCCESS)
+    {
+        return NULL;
+    }
+    if (ixmlNode_appendChild(parent, ixmlElement_getNode(element))
+            != IXML_SUCCESS)
+    {
+        ixmlElement_free(element);
+        return NULL;
+    }
+
+    // read attributes
+    int code;
+    while ((code = readByte(d)) != OBIX_BINARY_END)
+    {
+        const char* name = readName(d, code, ATTR_NAMES, ATTR_COUNT);
+        if ((name == NULL)
+                || (readString(d, d->value) != 0)
+                || (ixmlElement_setAttribute(element, name, d->value->data)
+                    != IXML_SUCCESS))
+        {
+            return NULL;
+        }
+    }
+
+    // read children
+    while (TRUE)
+    {
+        if (d->pos >= d->length)
+        {
+            return NULL;
+        }
+        if (d->data[d->pos] == OBIX_BINARY_END)
+        {
+            d->pos++;
+            return element;
+        }
+        if (decodeElement(d, doc, ixmlElement_getNode(element), depth + 1)
+                == NULL)
+        {
+            return NULL;
+        }
+    }
+}
+
+IXML_Element* obixBinary_decode(const char* data, int length)
+{
+    if ((length < 2)
+            || ((unsigned char) data[0] != OBIX_BINARY_MAGIC)
+            || ((unsigned char) data[1] != OBIX_BINARY_VERSION))
+    {
+        log_warning("Unable to decode binary message: Wrong header.");
+        return NULL;
+    }
+
+    Decoder d;
+    d.data = (const unsigned char*) data;
+    d.length = length;
+    d.pos = 2;
+    d.name = strbuf_create(32);
+    d.value = strbuf_create(64);
+
+    IXML_Document* doc = NULL;
+    IXML_Element* element = NULL;
+    if ((d.name != NULL) && (d.value != NULL)
+            && (ixmlDocument_createDocumentEx(&doc) == IXML_SUCCESS))
+    {
+        element = decodeElement(&d, doc, ixmlDocument_getNode(doc), 0);
+        if (element == NULL)
+        {
+            log_warning("Unable to decode binary message: "
+                        "Message is corrupted.");
+            ixmlDocument_free(doc);
+        }
+    }
+    else
+    {
+        log_error("Unable to decode binary message: Not enough memory.");
+    }
+
+    strbuf_free(d.name);
+    strbuf_free(d.value);
+    return element;
+}
@@ -0,0 +1,140 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Defines compact binary encoding of oBIX messages.
+ *
+ * Binary encoding is an alternative to XML, which is much cheaper to generate
+ * and to parse. It is negotiated using HTTP headers: a client which
+ * understands it adds #OBIX_BINARY_CONTENT_TYPE to the @a Accept header, and
+ * the server marks binary responses with the same @a Content-Type. Request
+ * bodies can be sent in binary form too.
+ *
+ * A message starts with a two bytes header (#OBIX_BINARY_MAGIC and
+ * #OBIX_BINARY_VERSION) followed by one encoded oBIX object. An object is
+ * encoded as a sequence of tokens:
+ * @code
+ * object    := tag attribute* END object* END
+ * tag       := tagCode | CUSTOM string
+ * attribute := attrCode string | CUSTOM string string
+ * string    := length bytes
+ * @endcode
+ * Names of oBIX objects (@a obj, @a int, @a ref, etc.) and of the common
+ * attributes (@a href, @a val, @a is, etc.) are replaced with one byte codes;
+ * other names are sent as strings after #OBIX_BINARY_CUSTOM code. Lengths are
+ * written as unsigned variable length integers (7 bits per byte, least
+ * significant bits first, highest bit set when more bytes follow). Strings are
+ * not escaped and not terminated. Text contents of XML elements is not
+ * encoded, because oBIX objects keep all data in attributes.
+ *
+ * The tokens are self-contained, thus an encoded message can be produced
+ * piece by piece, e.g. from server response parts which are encoded
+ * separately (see #obixBinary_appendTag). Parts which exist only as XML text
+ * (e.g. static templates) can be converted with #obixBinary_encodeXml.
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef OBIX_BINARY_H_
+#define OBIX_BINARY_H_
+
+#include <ixml_ext.h>
+#include <str_buffer.h>
+
+/** First byte of every binary encoded message. */
+#define OBIX_BINARY_MAGIC 0xB0
+/** Version of the binary encoding (second byte of every message). */
+#define OBIX_BINARY_VERSION 0x01
+/** Code which closes list of attributes or children of an object. */
+#define OBIX_BINARY_END 0x00
+/** Code of a tag or an attribute, whose name is sent as a string. */
+#define OBIX_BINARY_CUSTOM 0xFF
+
+/** MIME type of binary encoded oBIX messages. */
+extern const char* OBIX_BINARY_CONTENT_TYPE;
+
+/**
+ * Appends message header to the buffer. Should be called before encoding the
+ * object.
+ *
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+int obixBinary_appendHeader(String_Buffer* buffer);
+
+/**
+ * Encodes provided object with all its children and appends the result to
+ * the buffer.
+ *
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+int obixBinary_encode(IXML_Element* element, String_Buffer* buffer);
+
+/**
+ * Appends start of an object with provided tag name. It should be followed
+ * by attributes of the object (see #obixBinary_appendAttr), #OBIX_BINARY_END,
+ * children of the object and one more #OBIX_BINARY_END (see
+ * #obixBinary_appendEnd). Used to encode objects which are not stored as
+ * DOM.
+ *
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+int obixBinary_appendTag(String_Buffer* buffer, const char* tagName);
+
+/**
+ * Appends attribute of an object, which was started by
+ * #obixBinary_appendTag.
+ *
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+int obixBinary_appendAttr(String_Buffer* buffer,
+                          const char* name,
+                          const char* value);
+
+/**
+ * Appends #OBIX_BINARY_END code, which closes list of attributes or children
+ * of an object.
+ *
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+int obixBinary_appendEnd(String_Buffer* buffer);
+
+/**
+ * Converts XML text to binary tokens and appends them to the buffer. The text
+ * is not parsed to DOM, thus it can be a fragment of a message (e.g. contain
+ * only opening tag of an object, whose children are encoded separately).
+ * XML declarations, comments and text between tags are skipped.
+ *
+ * @return @a 0 on success; @a -1 if the text is not correct XML or there is
+ *         not enough memory.
+ */
+int obixBinary_encodeXml(const char* xml, String_Buffer* buffer);
+
+/**
+ * Decodes binary message to a DOM structure.
+ *
+ * @param data Binary message (including header).
+ * @param length Length of the message.
+ * @return Decoded object, or @a NULL if the message is corrupted. The object
+ *         should be freed using #ixmlElement_freeOwnerDocument.
+ */
+IXML_Element* obixBinary_decode(const char* data, int length);
+
+#endif /* OBIX_BINARY_H_ */
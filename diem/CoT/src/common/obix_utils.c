@@ -67,7 +67,9 @@ const char* OBIX_OBJ_FEED = "feed";
  * @{
  */
 const char* OBIX_NAME_SIGN_UP = "signUp";
+const char* OBIX_NAME_SIGN_UP_DEVICES = "signUpDevices";
 const char* OBIX_NAME_BATCH = "batch";
+const char* OBIX_NAME_UNREGISTER = "unregister";
 const char* OBIX_NAME_WATCH_SERVICE = "watchService";
 const char* OBIX_NAME_WATCH_SERVICE_MAKE = "make";
 const char* OBIX_NAME_WATCH_ADD = "add";
@@ -92,8 +92,12 @@ extern const char* OBIX_OBJ_FEED;
  */
 /** Name of @a signUp operation in the Lobby object. */
 extern const char* OBIX_NAME_SIGN_UP;
+/** Name of @a signUpDevices operation in the Lobby object. */
+extern const char* OBIX_NAME_SIGN_UP_DEVICES;
 /** Name of @a batch operation in the Lobby object. */
 extern const char* OBIX_NAME_BATCH;
+/** Name of @a unregister operation in the Lobby object. */
+extern const char* OBIX_NAME_UNREGISTER;
 /** Name of the Watch Service in the Lobby object. */
 extern const char* OBIX_NAME_WATCH_SERVICE;
 /** Name of the @a watchService.make operation. */
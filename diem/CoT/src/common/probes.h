@@ -0,0 +1,89 @@
+/* *****************************************************************************
+ * Copyright (c) 2009 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Static tracepoints (USDT probes) of the server and client hot paths.
+ *
+ * When the library is configured with <sys/sdt.h> available (see
+ * @c --disable-tracepoints option of configure), every probe is compiled
+ * into a single @c nop instruction plus a note in the ELF file, which is
+ * turned into a breakpoint only while some tracer (SystemTap, bpftrace,
+ * perf) is attached. Otherwise probes are removed completely.
+ *
+ * All probes belong to the @c obix provider. Probe names use double
+ * underscore, which tracers show as a dash (e.g. @c request__accept becomes
+ * @c request-accept). Example:
+ * @code
+ * bpftrace -e 'usdt:./obix.fcgi:obix:response__flush
+ *              { printf("%s %d\n", str(arg0), arg1); }'
+ * @endcode
+ *
+ * Server probes:
+ * - @c request__accept (requestId) - new request is accepted;
+ * - @c request__dispatch (method, uri) - request is passed to the server;
+ * - @c handler__dispatch (handlerId, uri) - request is passed to a handler;
+ * - @c storage__lookup__start (href), @c storage__lookup__done (href, found) -
+ *   search of an object in the storage;
+ * - @c storage__update__start (href), @c storage__update__done (href, error) -
+ *   writing a new value to the storage;
+ * - @c watch__notify (watchId, href) - changed object is reported to a watch
+ *   client;
+ * - @c longpoll__park (watchId, waitTime) - poll request is put on hold;
+ * - @c longpoll__complete (watchId, uri) - held poll request is answered;
+ * - @c response__flush (uri, bytes) - response is written to the client.
+ *
+ * Client probes:
+ * - @c http__request__start (uri),
+ *   @c http__request__done (uri, error, bytes) - HTTP request to the server,
+ *   including Watch polls performed by the @a curl_multi handle;
+ * - @c watch__poll__start (uri), @c watch__poll__done (uri, result) - Watch
+ *   poll cycle.
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef PROBES_H_
+#define PROBES_H_
+
+#ifdef OBIX_TRACEPOINTS
+
+#include <sys/sdt.h>
+
+#define OBIX_PROBE0(name) \
+    DTRACE_PROBE(obix, name)
+#define OBIX_PROBE1(name, a1) \
+    DTRACE_PROBE1(obix, name, a1)
+#define OBIX_PROBE2(name, a1, a2) \
+    DTRACE_PROBE2(obix, name, a1, a2)
+#define OBIX_PROBE3(name, a1, a2, a3) \
+    DTRACE_PROBE3(obix, name, a1, a2, a3)
+
+#else
+
+// arguments are not evaluated when tracepoints are disabled
+#define OBIX_PROBE0(name) do {} while (0)
+#define OBIX_PROBE1(name, a1) do {} while (0)
+#define OBIX_PROBE2(name, a1, a2) do {} while (0)
+#define OBIX_PROBE3(name, a1, a2, a3) do {} while (0)
+
+#endif /* OBIX_TRACEPOINTS */
+
+#endif /* PROBES_H_ */
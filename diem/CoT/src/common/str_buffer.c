@@ -0,0 +1,174 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of the growable string buffer.
+ *
+ * @see str_buffer.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "str_buffer.h"
+
+String_Buffer* strbuf_create(int initialSize)
+{
+    if (initialSize < 1)
+    {
+        initialSize = 1;
+    }
+
+    String_Buffer* buffer = (String_Buffer*) malloc(sizeof(String_Buffer));
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    buffer->data = (char*) malloc(initialSize);
+    if (buffer->data == NULL)
+    {
+        free(buffer);
+        return NULL;
+    }
+
+    *(buffer->data) = '\0';
+    buffer->length = 0;
+    buffer->size = initialSize;
+
+    return buffer;
+}
+
+void strbuf_free(String_Buffer* buffer)
+{
+    if (buffer != NULL)
+    {
+        free(buffer->data);
+        free(buffer);
+    }
+}
+
+void strbuf_reset(String_Buffer* buffer)
+{
+    *(buffer->data) = '\0';
+    buffer->length = 0;
+}
+
+/**
+ * Makes sure that the buffer can hold @a length more characters (plus
+ * terminating @a '\0'). Size of the buffer is doubled until it is enough.
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+static int strbuf_reserve(String_Buffer* buffer, int length)
+{
+    int required = buffer->length + length + 1;
+    if (required <= buffer->size)
+    {
+        return 0;
+    }
+
+    int newSize = buffer->size;
+    while (newSize < required)
+    {
+        newSize <<= 1;
+    }
+
+    char* data = (char*) realloc(buffer->data, newSize);
+    if (data == NULL)
+    {
+        return -1;
+    }
+
+    buffer->data = data;
+    buffer->size = newSize;
+    return 0;
+}
+
+int strbuf_appendLength(String_Buffer* buffer, const char* str, int length)
+{
+    if (strbuf_reserve(buffer, length) != 0)
+    {
+        return -1;
+    }
+
+    memcpy(buffer->data + buffer->length, str, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+    return 0;
+}
+
+int strbuf_append(String_Buffer* buffer, const char* str)
+{
+    return strbuf_appendLength(buffer, str, strlen(str));
+}
+
+int strbuf_appendXml(String_Buffer* buffer, const char* str)
+{
+    const char* start = str;
+    const char* entity;
+
+    for (; *str != '\0'; str++)
+    {
+        switch (*str)
+        {
+        case '&':
+            entity = "&amp;";
+            break;
+        case '<':
+            entity = "&lt;";
+            break;
+        case '>':
+            entity = "&gt;";
+            break;
+        case '"':
+            entity = "&quot;";
+            break;
+        case '\'':
+            entity = "&apos;";
+            break;
+        default:
+            continue;
+        }
+
+        // copy unescaped part at once and then the entity
+        if ((strbuf_appendLength(buffer, start, str - start) != 0)
+                || (strbuf_append(buffer, entity) != 0))
+        {
+            return -1;
+        }
+        start = str + 1;
+    }
+
+    return strbuf_appendLength(buffer, start, str - start);
+}
+
+const char* strbuf_getString(String_Buffer* buffer)
+{
+    return buffer->data;
+}
+
+char* strbuf_release(String_Buffer* buffer)
+{
+    char* data = buffer->data;
+    free(buffer);
+    return data;
+}
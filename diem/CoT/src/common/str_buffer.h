@@ -0,0 +1,107 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Defines a growable string buffer, which is used for composing messages.
+ *
+ * The buffer grows automatically when appended data does not fit to it. The
+ * memory is kept when the buffer is reset, thus a buffer which is reused for
+ * composing similar messages stops allocating memory after first few calls.
+ *
+ * Besides appending plain strings, the buffer can escape XML special
+ * characters of the appended data, which is required when arbitrary strings
+ * are put into XML attribute values.
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef STR_BUFFER_H_
+#define STR_BUFFER_H_
+
+/** Growable string buffer. */
+typedef struct _String_Buffer
+{
+    /** Buffer contents. Always terminated with @a '\0'. */
+    char* data;
+    /** Length of the string stored in the buffer. */
+    int length;
+    /** Size of the allocated memory. */
+    int size;
+}
+String_Buffer;
+
+/**
+ * Creates new buffer.
+ *
+ * @param initialSize Size of memory allocated for the buffer at once. It is
+ *                    doubled every time when appended data does not fit.
+ * @return New buffer, or @a NULL if there is not enough memory.
+ */
+String_Buffer* strbuf_create(int initialSize);
+
+/**
+ * Releases memory allocated for the buffer.
+ */
+void strbuf_free(String_Buffer* buffer);
+
+/**
+ * Empties the buffer. Allocated memory is kept for the next use.
+ */
+void strbuf_reset(String_Buffer* buffer);
+
+/**
+ * Appends a string to the end of the buffer.
+ *
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+int strbuf_append(String_Buffer* buffer, const char* str);
+
+/**
+ * Appends first @a length characters of a string to the end of the buffer.
+ *
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+int strbuf_appendLength(String_Buffer* buffer, const char* str, int length);
+
+/**
+ * Appends a string to the end of the buffer replacing XML special characters
+ * (@a &, @a <, @a >, @a " and @a ') with corresponding entities. The result
+ * can be safely used as a value of XML attribute.
+ *
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+int strbuf_appendXml(String_Buffer* buffer, const char* str);
+
+/**
+ * Returns contents of the buffer. The returned string stays valid until the
+ * buffer is modified.
+ */
+const char* strbuf_getString(String_Buffer* buffer);
+
+/**
+ * Releases the buffer object, but keeps its contents, so that they can be
+ * used without copying.
+ *
+ * @return Contents of the buffer. Should be freed after usage.
+ */
+char* strbuf_release(String_Buffer* buffer);
+
+#endif /* STR_BUFFER_H_ */
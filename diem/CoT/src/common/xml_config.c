@@ -54,6 +54,7 @@ const char* CTA_LOG_FACILITY = "facility";
 const char* CTAV_LOG_FACILITY_USER = "user";
 const char* CTAV_LOG_FACILITY_DAEMON = "daemon";
 const char* CTAV_LOG_FACILITY_LOCAL0 = "local0";
+const char* CT_LOG_ASYNC = "async";
 /** @} */
 
 /** Stores address of resource folder. */
@@ -319,6 +320,13 @@ void config_setResourceDir(char* path)
     if (resourceFolder != NULL)
     {
         free(resourceFolder);
+        resourceFolder = NULL;
+    }
+
+    if (path == NULL)
+    {
+        log_debug("Resource folder path is reset to the current folder.");
+        return;
     }
 
     int length = strlen(path);
@@ -347,6 +355,11 @@ void config_setResourceDir(char* path)
     }
 }
 
+const char* config_getResourceDir()
+{
+    return resourceFolder;
+}
+
 int config_log(IXML_Element* configTag)
 {
     IXML_Element* logTag = config_getChildTag(configTag, CT_LOG, TRUE);
@@ -461,6 +474,22 @@ int config_log(IXML_Element* configTag)
         log_useSyslog(facility);
     }
 
+    tempTag = config_getChildTag(logTag, CT_LOG_ASYNC, FALSE);
+    if (tempTag == NULL)
+    {
+        log_stopAsync();
+    }
+    else
+    {
+        int size = config_getTagAttrIntValue(tempTag,
+                                             CTA_VALUE,
+                                             FALSE,
+                                             LOG_ASYNC_SIZE_DEFAULT);
+        if (log_startAsync(size) != 0)
+        {
+            return -1;
+        }
+    }
 
     log_debug("Log is configured ...");
 
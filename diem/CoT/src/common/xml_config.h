@@ -79,6 +79,10 @@ extern const char* CTAV_LOG_FACILITY_USER;
 extern const char* CTAV_LOG_FACILITY_DAEMON;
 /** Log facility 'local0'. */
 extern const char* CTAV_LOG_FACILITY_LOCAL0;
+/** Defines whether messages should be printed asynchronously. Its
+ * @ref CTA_VALUE "val" attribute defines how many messages can be buffered
+ * by each thread. */
+extern const char* CT_LOG_ASYNC;
 /** @} */
 
 /**
@@ -87,10 +91,18 @@ extern const char* CTAV_LOG_FACILITY_LOCAL0;
  * only once in the application. After that all resources (including
  * configuration file) can be reached using #config_getResFullPath().
  *
- * @param path Path to the application's resource folder.
+ * @param path Path to the application's resource folder. If @a NULL, the
+ *             current folder is used.
  */
 void config_setResourceDir(char* path);
 
+/**
+ * Returns the address of the resource folder, set by #config_setResourceDir.
+ *
+ * @return Path to the resource folder, or @a NULL if it is not set.
+ */
+const char* config_getResourceDir();
+
 /**
  * Returns the address of the resource file by adding resource folder path to
  * the filename.
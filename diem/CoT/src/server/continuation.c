@@ -0,0 +1,511 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of continuations of remote operation invocations.
+ *
+ * @see continuation.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <log_utils.h>
+#include <ptask.h>
+#include <table.h>
+#include "watch.h"
+#include "server.h"
+#include "metrics.h"
+#include "continuation.h"
+
+/** How often expired continuations are checked (in milliseconds). */
+#define CONTINUATION_CHECK_PERIOD 1000
+
+/** Pending invocation of remote operation. */
+typedef struct Continuation
+{
+    /** Response, which waits for results, or @a NULL if nobody waits for
+     * them anymore. */
+    Response* response;
+    /** Copy of the input, while the invocation is queued. */
+    IXML_Element* input;
+    /** Tells whether the input is forwarded to the subscriber. */
+    BOOL forwarded;
+    /** Time (in milliseconds) when the invocation expires. */
+    long long deadline;
+    struct Continuation* next;
+}
+Continuation;
+
+/** Queue of invocations of one operation. Only the first invocation can be
+ * forwarded to the subscriber. */
+typedef struct Continuation_Queue
+{
+    Continuation* first;
+    Continuation* last;
+    /** URI of the operation; it is set only when the queue is canceled. */
+    char* uri;
+    /** Next canceled queue. */
+    struct Continuation_Queue* next;
+}
+Continuation_Queue;
+
+/** Queues of pending invocations. Key of the table is URI of the operation. */
+static Table* _continuations = NULL;
+static pthread_mutex_t _continuationsMutex = PTHREAD_MUTEX_INITIALIZER;
+/** Queues of removed operations, whose invocations are not answered yet. */
+static Continuation_Queue* _canceledQueues = NULL;
+/** Number of pending invocations in all queues. */
+static int _continuationCount = 0;
+/** Thread, which handles expired continuations. */
+static Task_Thread* _threadTimeout = NULL;
+static int _timeoutTaskId;
+
+static long _timeout = CONTINUATION_TIMEOUT_DEFAULT;
+static int _maxCount = CONTINUATION_MAX_COUNT_DEFAULT;
+
+/** Returns current time in milliseconds from some unspecified point. The
+ * monotonic clock is used, so deadlines are not shifted by changes of the
+ * system time. */
+static long long getTimeMillis()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return ((long long) time.tv_sec * 1000) + (time.tv_nsec / 1000000);
+}
+
+/**
+ * Completes invocation with an error message. Nothing is done if nobody waits
+ * for the results anymore.
+ */
+static void completeWithError(Continuation* continuation,
+                              const char* uri,
+                              const char* message)
+{
+    Response* response = continuation->response;
+    if (response == NULL)
+    {
+        return;
+    }
+    continuation->response = NULL;
+
+    obix_server_generateObixErrorMessage(response,
+                                         uri,
+                                         NULL,
+                                         "Remote Operation Invocation Error",
+                                         message);
+    obixResponse_complete(response);
+}
+
+/** Removes the first invocation from the queue and releases it. */
+static void removeFirst(Continuation_Queue* queue)
+{
+    Continuation* continuation = queue->first;
+    queue->first = continuation->next;
+    if (queue->first == NULL)
+    {
+        queue->last = NULL;
+    }
+
+    if (continuation->input != NULL)
+    {
+        ixmlElement_freeOwnerDocument(continuation->input);
+    }
+    free(continuation);
+    _continuationCount--;
+    obixMetrics_set(METRICS_REMOTE_CALLS, _continuationCount);
+}
+
+/**
+ * Forwards the first queued invocation of the operation to the subscriber.
+ * Invocations, which can't be forwarded, are answered with an error.
+ */
+static void forwardNext(Continuation_Queue* queue, const char* uri)
+{
+    while ((queue->first != NULL) && !queue->first->forwarded)
+    {
+        Continuation* continuation = queue->first;
+        if (continuation->response == NULL)
+        {
+            // nobody waits for results, so the operation is not executed
+            removeFirst(queue);
+            continue;
+        }
+
+        if (obixWatch_forwardOperationInput(uri, continuation->input) == 0)
+        {
+            continuation->forwarded = TRUE;
+            ixmlElement_freeOwnerDocument(continuation->input);
+            continuation->input = NULL;
+            // subscriber gets the whole timeout to answer
+            continuation->deadline = getTimeMillis() + _timeout;
+            return;
+        }
+
+        completeWithError(continuation, uri,
+                          "Unable to forward invocation to the subscriber.");
+        removeFirst(queue);
+    }
+}
+
+/**
+ * Handles expired invocations of one operation.
+ * Queued invocations are answered with an error and removed. Forwarded
+ * invocation is removed only if the subscriber has not received it yet.
+ * Otherwise, it stays in the queue for one more timeout period, waiting for
+ * the late answer, which should not be matched with the next invocation.
+ */
+static void checkQueue(Continuation_Queue* queue,
+                       const char* uri,
+                       long long now)
+{
+    Continuation* first = queue->first;
+    if ((first != NULL) && first->forwarded && (first->deadline <= now))
+    {
+        if (first->response != NULL)
+        {
+            log_warning("Remote operation \"%s\" is not answered in time.",
+                        uri);
+            completeWithError(first, uri,
+                              "Remote operation is not answered in time.");
+        }
+
+        if ((obixWatch_cancelOperationInput(uri) != 0)
+                || (first->deadline + _timeout <= now))
+        {
+            removeFirst(queue);
+            forwardNext(queue, uri);
+        }
+    }
+
+    // queued invocations are ordered by their deadlines
+    Continuation* previous = queue->first;
+    while ((previous != NULL) && (previous->next != NULL)
+            && (previous->next->deadline <= now))
+    {
+        Continuation* continuation = previous->next;
+        completeWithError(continuation, uri,
+                          "Remote operation is not answered in time: "
+                          "Subscriber is busy with previous invocations.");
+        previous->next = continuation->next;
+        if (queue->last == continuation)
+        {
+            queue->last = previous;
+        }
+        ixmlElement_freeOwnerDocument(continuation->input);
+        free(continuation);
+        _continuationCount--;
+        obixMetrics_set(METRICS_REMOTE_CALLS, _continuationCount);
+    }
+}
+
+/** Answers all invocations of canceled queues with an error and releases the
+ * queues. */
+static void answerCanceledQueues(const char* message)
+{
+    while (_canceledQueues != NULL)
+    {
+        Continuation_Queue* queue = _canceledQueues;
+        _canceledQueues = queue->next;
+        while (queue->first != NULL)
+        {
+            completeWithError(queue->first,
+                              (queue->uri == NULL) ? "" : queue->uri,
+                              message);
+            removeFirst(queue);
+        }
+        free(queue->uri);
+        free(queue);
+    }
+}
+
+/** Periodic task, which handles expired and canceled continuations. */
+static void taskCheckTimeouts(void* arg)
+{
+    // forwarding of invocations modifies the storage
+    obix_server_lock();
+    pthread_mutex_lock(&_continuationsMutex);
+    answerCanceledQueues("Operation subscriber is removed.");
+    if (_continuationCount > 0)
+    {
+        long long now = getTimeMillis();
+        const char** uris;
+        const void** queues;
+        int count = table_getKeys(_continuations, &uris);
+        table_getValues(_continuations, &queues);
+        int i;
+        for (i = 0; i < count; i++)
+        {
+            checkQueue((Continuation_Queue*) queues[i], uris[i], now);
+        }
+    }
+    pthread_mutex_unlock(&_continuationsMutex);
+    obix_server_unlock();
+}
+
+int obixContinuation_init()
+{
+    _continuations = table_create(20);
+    if (_continuations == NULL)
+    {
+        log_error("Unable to allocate memory for remote operation "
+                  "continuations table.");
+        return -1;
+    }
+
+    _threadTimeout = ptask_init();
+    if (_threadTimeout == NULL)
+    {
+        log_error("Unable to start thread for remote operation timeouts.");
+        return -1;
+    }
+
+    _timeoutTaskId = ptask_schedule(_threadTimeout,
+                                    &taskCheckTimeouts,
+                                    NULL,
+                                    CONTINUATION_CHECK_PERIOD,
+                                    EXECUTE_INDEFINITE);
+    if (_timeoutTaskId < 0)
+    {
+        log_error("Unable to schedule remote operation timeout checking: "
+                  "ptask_schedule() returned %d.", _timeoutTaskId);
+        return -1;
+    }
+
+    return 0;
+}
+
+void obixContinuation_dispose()
+{
+    if (_threadTimeout != NULL)
+    {
+        ptask_dispose(_threadTimeout, TRUE);
+        _threadTimeout = NULL;
+    }
+
+    if (_continuations == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&_continuationsMutex);
+    answerCanceledQueues("Server is shutting down.");
+    const char** uris;
+    const void** queues;
+    int count = table_getKeys(_continuations, &uris);
+    table_getValues(_continuations, &queues);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        Continuation_Queue* queue = (Continuation_Queue*) queues[i];
+        while (queue->first != NULL)
+        {
+            completeWithError(queue->first, uris[i],
+                              "Server is shutting down.");
+            removeFirst(queue);
+        }
+        free(queue);
+    }
+    table_free(_continuations);
+    _continuations = NULL;
+    pthread_mutex_unlock(&_continuationsMutex);
+}
+
+void obixContinuation_setTimeout(long timeout)
+{
+    _timeout = timeout;
+}
+
+void obixContinuation_setMaxCount(int maxCount)
+{
+    _maxCount = maxCount;
+}
+
+int obixContinuation_add(Response* response,
+                         const char* uri,
+                         IXML_Element* input)
+{
+    pthread_mutex_lock(&_continuationsMutex);
+    if (_continuationCount >= _maxCount)
+    {
+        pthread_mutex_unlock(&_continuationsMutex);
+        log_warning("Unable to invoke remote operation \"%s\": Maximum "
+                    "number of pending invocations (%d) is reached.",
+                    uri, _maxCount);
+        return -2;
+    }
+
+    Continuation_Queue* queue =
+        (Continuation_Queue*) table_get(_continuations, uri);
+    if (queue == NULL)
+    {
+        queue = (Continuation_Queue*) malloc(sizeof(Continuation_Queue));
+        if ((queue == NULL) || (table_put(_continuations, uri, queue) != 0))
+        {
+            pthread_mutex_unlock(&_continuationsMutex);
+            free(queue);
+            log_error("Unable to create queue of remote operation "
+                      "invocations: Not enough memory.");
+            return -3;
+        }
+        queue->first = NULL;
+        queue->last = NULL;
+        queue->uri = NULL;
+        queue->next = NULL;
+    }
+
+    Continuation* continuation = (Continuation*) malloc(sizeof(Continuation));
+    if (continuation == NULL)
+    {
+        pthread_mutex_unlock(&_continuationsMutex);
+        log_error("Unable to save remote operation invocation: "
+                  "Not enough memory.");
+        return -3;
+    }
+    continuation->response = response;
+    continuation->input = NULL;
+    continuation->forwarded = FALSE;
+    continuation->deadline = getTimeMillis() + _timeout;
+    continuation->next = NULL;
+
+    if (queue->first == NULL)
+    {
+        // nothing is pending, so the invocation is forwarded at once
+        int error = obixWatch_forwardOperationInput(uri, input);
+        if (error != 0)
+        {
+            pthread_mutex_unlock(&_continuationsMutex);
+            free(continuation);
+            return (error == -1) ? -1 : -3;
+        }
+        continuation->forwarded = TRUE;
+        queue->first = continuation;
+    }
+    else
+    {
+        continuation->input = ixmlElement_cloneWithLog(input, TRUE);
+        if (continuation->input == NULL)
+        {
+            pthread_mutex_unlock(&_continuationsMutex);
+            free(continuation);
+            return -3;
+        }
+        queue->last->next = continuation;
+    }
+    queue->last = continuation;
+    _continuationCount++;
+    obixMetrics_set(METRICS_REMOTE_CALLS, _continuationCount);
+    pthread_mutex_unlock(&_continuationsMutex);
+
+    obixResponse_hold(response);
+    return 0;
+}
+
+int obixContinuation_complete(const char* uri, char* output)
+{
+    pthread_mutex_lock(&_continuationsMutex);
+    Continuation_Queue* queue =
+        (Continuation_Queue*) table_get(_continuations, uri);
+    if ((queue == NULL) || (queue->first == NULL) || !queue->first->forwarded)
+    {
+        pthread_mutex_unlock(&_continuationsMutex);
+        free(output);
+        return -1;
+    }
+
+    Response* response = queue->first->response;
+    if (response != NULL)
+    {
+        obixResponse_setText(response, output, FALSE);
+        obixResponse_complete(response);
+    }
+    else
+    {
+        log_debug("Results of remote operation \"%s\" came too late.", uri);
+        free(output);
+    }
+
+    removeFirst(queue);
+    forwardNext(queue, uri);
+    pthread_mutex_unlock(&_continuationsMutex);
+    return 0;
+}
+
+void obixContinuation_cancelAll(const char* uri)
+{
+    pthread_mutex_lock(&_continuationsMutex);
+    Continuation_Queue* queue = (_continuations == NULL) ? NULL :
+                                (Continuation_Queue*) table_remove(
+                                    _continuations, uri);
+    if (queue != NULL)
+    {
+        // responses can be completed only while the server is locked, but the
+        // subscriber can be removed by the Watch lease thread, so the
+        // invocations are answered later by the timeout thread
+        queue->uri = strdup(uri);
+        queue->next = _canceledQueues;
+        _canceledQueues = queue;
+    }
+    pthread_mutex_unlock(&_continuationsMutex);
+}
+
+/** Forgets continuations of the queue, which belong to the response. */
+static void cancelQueueResponse(Continuation_Queue* queue, Response* response)
+{
+    Continuation* continuation = queue->first;
+    for (; continuation != NULL; continuation = continuation->next)
+    {
+        Response* part = continuation->response;
+        if ((part != NULL) && (part->arena == response->arena))
+        {
+            continuation->response = NULL;
+            obixResponse_complete(part);
+        }
+    }
+}
+
+void obixContinuation_cancelResponse(Response* response)
+{
+    pthread_mutex_lock(&_continuationsMutex);
+    if (_continuations == NULL)
+    {
+        pthread_mutex_unlock(&_continuationsMutex);
+        return;
+    }
+
+    const void** queues;
+    int count = table_getValues(_continuations, &queues);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        cancelQueueResponse((Continuation_Queue*) queues[i], response);
+    }
+    Continuation_Queue* queue = _canceledQueues;
+    for (; queue != NULL; queue = queue->next)
+    {
+        cancelQueueResponse(queue, response);
+    }
+    pthread_mutex_unlock(&_continuationsMutex);
+}
@@ -0,0 +1,123 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Defines continuations of remote operation invocations.
+ *
+ * Operations added to a Watch with @a Watch.addOperation are executed by the
+ * subscribed client. When such operation is invoked, the response is parked
+ * as a continuation, and the invocation input is forwarded to the subscriber.
+ * The continuation is completed when the subscriber sends results with
+ * @a Watch.operationResponse, or when its deadline passes.
+ *
+ * Invocations of the same operation are queued: the subscriber receives the
+ * next input only when the previous one is answered, so that its answers
+ * are always matched to the right invocation. Any part of a response can be
+ * parked (see #obixResponse_hold), thus remote operations can be invoked
+ * from a Batch too.
+ *
+ * All functions except #obixContinuation_cancelAll should be called while
+ * the server is locked (see #obix_server_lock). The latter can be called from
+ * any thread, because canceled invocations are answered later by the thread,
+ * which checks deadlines.
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef CONTINUATION_H_
+#define CONTINUATION_H_
+
+#include <ixml_ext.h>
+#include "response.h"
+
+/** Default time in milliseconds, given to the subscriber to answer remote
+ * operation invocation. */
+#define CONTINUATION_TIMEOUT_DEFAULT 30000
+/** Default maximum number of pending remote operation invocations. */
+#define CONTINUATION_MAX_COUNT_DEFAULT 1000
+
+/**
+ * Initializes the continuations table and starts the thread, which handles
+ * expired continuations.
+ * @return @a 0 on success; @a -1 on error.
+ */
+int obixContinuation_init();
+
+/**
+ * Answers all pending invocations with an error and releases the table.
+ */
+void obixContinuation_dispose();
+
+/**
+ * Sets how long invocation can wait for the answer of the subscriber.
+ * @param timeout Time in milliseconds.
+ */
+void obixContinuation_setTimeout(long timeout);
+
+/**
+ * Sets maximum number of pending remote operation invocations.
+ */
+void obixContinuation_setMaxCount(int maxCount);
+
+/**
+ * Parks the response until the subscriber of the operation sends results.
+ * Input is forwarded to the subscriber immediately, or after all previous
+ * invocations of the same operation are answered.
+ *
+ * @param response Response (or its part), which will contain the results.
+ * @param uri URI of invoked operation.
+ * @param input Input arguments of the operation. They are copied.
+ * @return @li @a 0 on success;
+ *         @li @a -1 if nobody is subscribed for the operation;
+ *         @li @a -2 if maximum number of pending invocations is reached;
+ *         @li @a -3 on internal error.
+ */
+int obixContinuation_add(Response* response,
+                         const char* uri,
+                         IXML_Element* input);
+
+/**
+ * Completes the oldest forwarded invocation of the operation with results
+ * received from the subscriber, and forwards the next queued invocation.
+ *
+ * @param uri URI of the operation.
+ * @param output Text of the operation results. It is owned by the response
+ *               after the call, or freed if it is not needed anymore.
+ * @return @a 0 on success; @a -1 if the operation was not invoked (or all
+ *         invocations are already handled).
+ */
+int obixContinuation_complete(const char* uri, char* output);
+
+/**
+ * Answers all pending invocations of the operation with an error. Should be
+ * called when the subscriber is removed. The invocations are answered
+ * asynchronously, in less than a second.
+ */
+void obixContinuation_cancelAll(const char* uri);
+
+/**
+ * Forgets all continuations, which belong to the provided response. It is
+ * used when the response is sent before remote operations are answered
+ * (e.g. with an error message).
+ */
+void obixContinuation_cancelResponse(Response* response);
+
+#endif /* CONTINUATION_H_ */
@@ -0,0 +1,209 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of the interface for running oBIX server in the same process
+ * with its clients.
+ *
+ * @see local_server.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <log_utils.h>
+#include <obix_utils.h>
+#include "xml_storage.h"
+#include "watch.h"
+#include "response.h"
+#include "server.h"
+#include "local_server.h"
+
+/** Amount of clients, which use the server. */
+static int _initCount = 0;
+
+int obixLocal_init(const char* resourceDir)
+{
+    obix_server_lock();
+    if (_initCount > 0)
+    {
+        _initCount++;
+        obix_server_unlock();
+        return 0;
+    }
+
+    // server resources are loaded from its own folder, which can differ from
+    // the resource folder of the client
+    int error = obix_server_init(resourceDir);
+    if (error != 0)
+    {
+        log_error("Unable to start local oBIX server.");
+        obix_server_unlock();
+        return -1;
+    }
+
+    _initCount++;
+    log_debug("Local oBIX server is started.");
+    obix_server_unlock();
+    return 0;
+}
+
+void obixLocal_dispose()
+{
+    obix_server_lock();
+    if (_initCount > 0)
+    {
+        _initCount--;
+        if (_initCount == 0)
+        {
+            obix_server_shutdown();
+        }
+    }
+    obix_server_unlock();
+}
+
+IXML_Element* obixLocal_read(const char* uri)
+{
+    obix_server_lock();
+    IXML_Element* object = obix_server_readDOM(uri);
+    obix_server_unlock();
+    return object;
+}
+
+int obixLocal_write(const char* uri, IXML_Element* input)
+{
+    obix_server_lock();
+    int error = obix_server_writeDOM(uri, input);
+    obix_server_unlock();
+    return error;
+}
+
+char* obixLocal_invoke(const char* uri, IXML_Element* input)
+{
+    // response without request is not sent anywhere by handlers and can't
+    // wait, so it is completely generated when obix_server_invoke returns
+    Response* response = obixResponse_create(NULL);
+    if (response == NULL)
+    {
+        log_error("Unable to invoke operation: Not enough memory.");
+        return NULL;
+    }
+
+    obix_server_lock();
+    obix_server_invoke(response, uri, input);
+    obix_server_unlock();
+
+    // join all parts of the response
+    Response* part;
+    int length = 1;
+    for (part = response; part != NULL; part = part->next)
+    {
+        if (part->body != NULL)
+        {
+            length += strlen(part->body);
+        }
+    }
+
+    char* output = (char*) malloc(length);
+    if (output == NULL)
+    {
+        log_error("Unable to invoke operation: Not enough memory.");
+        obixResponse_free(response);
+        return NULL;
+    }
+
+    char* end = output;
+    for (part = response; part != NULL; part = part->next)
+    {
+        if (part->body != NULL)
+        {
+            end = stpcpy(end, part->body);
+        }
+    }
+    *end = '\0';
+
+    obixResponse_free(response);
+    return output;
+}
+
+int obixLocal_signUp(IXML_Element* device)
+{
+    obix_server_lock();
+    int error = obix_server_signUp(device);
+    obix_server_unlock();
+
+    switch (error)
+    {
+    case 0:
+        return 0;
+    case -2:
+        // data was published before (e.g. the client was restarted)
+        return 1;
+    default:
+        log_warning("Unable to publish device data at the local server "
+                    "(error %d).", error);
+        return -1;
+    }
+}
+
+int obixLocal_unregister(const char* uri)
+{
+    obix_server_lock();
+    int error = obix_server_unregisterDevice(uri);
+    obix_server_unlock();
+    return (error == 0) ? 0 : -1;
+}
+
+int obixLocal_addListener(const char* uri,
+                          obixLocal_listener listener,
+                          void* arg)
+{
+    obix_server_lock();
+    int listenerId = obixWatch_addLocalListener(uri, listener, arg);
+    if (listenerId >= 0)
+    {
+        // notify about current state
+        (*listener)(xmldb_getDOM(uri, NULL), arg);
+    }
+    obix_server_unlock();
+    return listenerId;
+}
+
+int obixLocal_removeListener(int listenerId)
+{
+    return obixWatch_removeLocalListener(listenerId);
+}
+
+char* obixLocal_printObject(IXML_Element* object)
+{
+    IXML_Element* copy = ixmlElement_cloneWithLog(object, TRUE);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+
+    xmldb_deleteMetaInfo(copy);
+    char* text = ixmlPrintNode(ixmlElement_getNode(copy));
+    ixmlElement_freeOwnerDocument(copy);
+    return text;
+}
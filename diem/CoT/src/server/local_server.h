@@ -0,0 +1,143 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Defines interface for running oBIX server in the same process with its
+ * clients.
+ *
+ * Server modules are built as a library (libcot-server), so that small
+ * installations can run the server together with adapters in one process.
+ * Clients use this interface (see obix_local.h) in order to access the storage
+ * directly: objects are passed as DOM structures without serialization and
+ * updates are delivered to listeners immediately by the Watch engine.
+ *
+ * All functions are serialized with other requests using #obix_server_lock.
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef LOCAL_SERVER_H_
+#define LOCAL_SERVER_H_
+
+#include <ixml_ext.h>
+
+/**
+ * Prototype of a function, which is notified about object updates.
+ * It is called while the server is locked, so it should not access the server
+ * and should return as soon as possible.
+ *
+ * @param object Updated object in the storage. It should not be modified or
+ *               stored by the listener.
+ * @param arg Argument, which was provided when listener was added.
+ */
+typedef void (*obixLocal_listener)(IXML_Element* object, void* arg);
+
+/**
+ * Starts the server, if it is not started yet. Each call of this function
+ * should be followed by #obixLocal_dispose when server is not needed anymore.
+ *
+ * @param resourceDir Folder with server resource files (storage contents).
+ * @return @a 0 on success; @a -1 on error.
+ */
+int obixLocal_init(const char* resourceDir);
+
+/**
+ * Stops the server when it is not used by anybody.
+ */
+void obixLocal_dispose();
+
+/**
+ * Returns a copy of the object from the storage.
+ *
+ * @return Copy of the object, or @a NULL if it is not found. Should be freed
+ *         with #ixmlElement_freeOwnerDocument.
+ */
+IXML_Element* obixLocal_read(const char* uri);
+
+/**
+ * Writes new value to the object in the storage.
+ *
+ * @param input New state of the object, which should contain @a val
+ *              attribute.
+ * @return @a 0 on success; negative error code of #obix_server_writeDOM
+ *         otherwise.
+ */
+int obixLocal_write(const char* uri, IXML_Element* input);
+
+/**
+ * Invokes operation at the server.
+ * Operations which are handled by remote clients are not supported, because
+ * there is no request which could wait for their result.
+ *
+ * @param input Operation input. Can be @a NULL.
+ * @return Operation output (which can also be an error object), or @a NULL if
+ *         there is not enough memory. Should be freed after usage.
+ */
+char* obixLocal_invoke(const char* uri, IXML_Element* input);
+
+/**
+ * Publishes new device data at the server.
+ *
+ * @param device Device data. On success its @a href attribute contains the
+ *               URI of the object in the storage.
+ * @return @li @a 0 on success;
+ *         @li @a 1 if object with the same URI already exists at the server;
+ *         @li @a -1 on error.
+ */
+int obixLocal_signUp(IXML_Element* device);
+
+/**
+ * Removes device data, published with #obixLocal_signUp, from the server.
+ *
+ * @param uri URI of the device data.
+ * @return @a 0 on success, @a -1 on error.
+ */
+int obixLocal_unregister(const char* uri);
+
+/**
+ * Subscribes listener for updates of the object and all its children.
+ * The listener is called once immediately with the current state of the
+ * object.
+ *
+ * @return Listener id (>= 0), or @a -1 if object is not found.
+ */
+int obixLocal_addListener(const char* uri,
+                          obixLocal_listener listener,
+                          void* arg);
+
+/**
+ * Removes listener. After the function returns, the listener is not called
+ * anymore.
+ *
+ * @return @a 0 on success; @a -1 if listener is not found.
+ */
+int obixLocal_removeListener(int listenerId);
+
+/**
+ * Returns string representation of the object received by a listener, which
+ * does not contain server meta data.
+ *
+ * @return Object string, or @a NULL on error. Should be freed with
+ *         #ixmlFreeDOMString.
+ */
+char* obixLocal_printObject(IXML_Element* object);
+
+#endif /* LOCAL_SERVER_H_ */
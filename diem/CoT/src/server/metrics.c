@@ -0,0 +1,458 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of server metrics.
+ *
+ * @see metrics.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <str_buffer.h>
+#include "post_handler.h"
+#include "metrics.h"
+
+/** Histogram of operation durations (in microseconds). 64-bit fields are
+ * used, because the sum of durations overflows 32 bits after 72 minutes. */
+typedef struct
+{
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long buckets[METRICS_HISTOGRAM_BUCKETS];
+}
+Histogram;
+
+/** Names of a counter or gauge in both output formats. */
+typedef struct
+{
+    const char* obixName;
+    const char* prometheusName;
+    const char* prometheusType;
+    const char* help;
+}
+Value_Description;
+
+/** Names of a measured operation in both output formats. */
+typedef struct
+{
+    const char* obixName;
+    const char* prometheusName;
+    /** Prometheus labels, which distinguish the operation, or @a NULL. */
+    const char* prometheusLabels;
+}
+Timer_Description;
+
+/** Descriptions of #Metrics_Value items, in the same order. */
+static const Value_Description VALUE_DESCRIPTION[METRICS_VALUES_COUNT] =
+    {
+        {"bytesIn", "obix_received_bytes_total", "counter",
+         "Total size of received request bodies."},
+        {"bytesOut", "obix_sent_bytes_total", "counter",
+         "Total size of sent response bodies."},
+        {"watches", "obix_watches", "gauge",
+         "Number of existing Watch objects."},
+        {"longPolls", "obix_long_polls", "gauge",
+         "Number of held long poll requests."},
+        {"remoteCalls", "obix_remote_calls", "gauge",
+         "Number of remote operation invocations waiting for results."},
+        {"requestsInUse", "obix_requests_in_use", "gauge",
+         "Number of request objects in use."},
+        {"requestsCreated", "obix_requests_created", "gauge",
+         "Number of created request objects."},
+        {"deviceBytes", "obix_device_memory_bytes", "gauge",
+         "Estimated memory used by registered devices."},
+        {"deviceObjects", "obix_device_objects", "gauge",
+         "Number of objects of registered devices."}
+    };
+
+/** Descriptions of #Metrics_Timer items, in the same order. */
+static const Timer_Description TIMER_DESCRIPTION[METRICS_TIMERS_COUNT] =
+    {
+        {"GET", "obix_request_duration_seconds", "method=\"GET\""},
+        {"PUT", "obix_request_duration_seconds", "method=\"PUT\""},
+        {"storageLookup", "obix_storage_lookup_duration_seconds", NULL},
+        {"serialization", "obix_serialization_duration_seconds", NULL}
+    };
+
+/** Percentiles (in per mille), which are reported in oBIX format. */
+static const int PERCENTILES[] = {500, 900, 990};
+/** Names of #PERCENTILES. */
+static const char* PERCENTILE_NAMES[] = {"p50", "p90", "p99"};
+#define PERCENTILES_COUNT 3
+
+/** Maximum length of one generated line. */
+#define LINE_SIZE 256
+
+static long long _values[METRICS_VALUES_COUNT];
+static Histogram _timers[METRICS_TIMERS_COUNT];
+static Histogram _postTimers[METRICS_POST_HANDLERS_MAX];
+
+/** Returns index of the histogram bucket for the value. */
+static int getBucket(unsigned long long value)
+{
+    if (value < METRICS_HISTOGRAM_SUB_COUNT)
+    {
+        return (int) value;
+    }
+
+    // position of the highest bit
+    int exp = (sizeof(unsigned long long) * 8 - 1) - __builtin_clzll(value);
+    if (exp > METRICS_HISTOGRAM_MAX_EXP)
+    {
+        return METRICS_HISTOGRAM_BUCKETS - 1;
+    }
+
+    return (exp - METRICS_HISTOGRAM_SUB_BITS + 1) * METRICS_HISTOGRAM_SUB_COUNT
+           + ((value >> (exp - METRICS_HISTOGRAM_SUB_BITS))
+              & (METRICS_HISTOGRAM_SUB_COUNT - 1));
+}
+
+/** Returns the biggest value, which is put to the bucket. */
+static unsigned long long getBucketUpperBound(int bucket)
+{
+    if (bucket < METRICS_HISTOGRAM_SUB_COUNT)
+    {
+        return bucket;
+    }
+
+    int shift = bucket / METRICS_HISTOGRAM_SUB_COUNT - 1;
+    return ((unsigned long long) (METRICS_HISTOGRAM_SUB_COUNT
+                                  + bucket % METRICS_HISTOGRAM_SUB_COUNT
+                                  + 1) << shift) - 1;
+}
+
+static void histogramAdd(Histogram* histogram, unsigned long long value)
+{
+    __sync_add_and_fetch(&(histogram->buckets[getBucket(value)]), 1);
+    __sync_add_and_fetch(&(histogram->sum), value);
+    __sync_add_and_fetch(&(histogram->count), 1);
+}
+
+/**
+ * Copies buckets of the histogram.
+ * @return Number of values in the copied buckets.
+ */
+static unsigned long long histogramCopy(const Histogram* histogram,
+                                        unsigned long long* buckets)
+{
+    unsigned long long count = 0;
+    int i;
+    for (i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+        buckets[i] = histogram->buckets[i];
+        count += buckets[i];
+    }
+    return count;
+}
+
+void obixMetrics_add(Metrics_Value value, long delta)
+{
+    __sync_add_and_fetch(&(_values[value]), delta);
+}
+
+void obixMetrics_set(Metrics_Value value, long newValue)
+{
+    _values[value] = newValue;
+}
+
+long long obixMetrics_get(Metrics_Value value)
+{
+    return _values[value];
+}
+
+unsigned long long obixMetrics_startTimer()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return ((unsigned long long) time.tv_sec * 1000000)
+           + (time.tv_nsec / 1000);
+}
+
+void obixMetrics_stopTimer(Metrics_Timer timer, unsigned long long start)
+{
+    histogramAdd(&(_timers[timer]), obixMetrics_startTimer() - start);
+}
+
+void obixMetrics_stopPostTimer(int handlerId, unsigned long long start)
+{
+    if ((handlerId < 0) || (handlerId >= METRICS_POST_HANDLERS_MAX))
+    {
+        handlerId = 0;
+    }
+    histogramAdd(&(_postTimers[handlerId]), obixMetrics_startTimer() - start);
+}
+
+/** Appends time given in microseconds as @a reltime object. */
+static int appendReltime(String_Buffer* buffer,
+                         const char* indent,
+                         const char* name,
+                         unsigned long long time)
+{
+    char line[LINE_SIZE];
+    sprintf(line, "%s  <reltime name=\"%s\" val=\"PT%llu.%06lluS\"/>\r\n",
+            indent, name, time / 1000000, time % 1000000);
+    return strbuf_append(buffer, line);
+}
+
+/** Appends histogram summary in oBIX format. Empty histograms are skipped. */
+static int appendHistogramObix(String_Buffer* buffer,
+                               const char* indent,
+                               const char* name,
+                               const Histogram* histogram)
+{
+    unsigned long long buckets[METRICS_HISTOGRAM_BUCKETS];
+    unsigned long long count = histogramCopy(histogram, buckets);
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    char line[LINE_SIZE];
+    snprintf(line, LINE_SIZE, "%s<obj name=\"%s\">\r\n"
+             "%s  <int name=\"count\" val=\"%llu\"/>\r\n",
+             indent, name, indent, count);
+    int error = strbuf_append(buffer, line);
+    error += appendReltime(buffer, indent, "mean", histogram->sum / count);
+
+    int bucket = 0;
+    unsigned long long cumulative = buckets[0];
+    int i;
+    for (i = 0; i < PERCENTILES_COUNT; i++)
+    {
+        unsigned long long target = (count * PERCENTILES[i] + 999) / 1000;
+        while (cumulative < target)
+        {
+            cumulative += buckets[++bucket];
+        }
+        error += appendReltime(buffer, indent, PERCENTILE_NAMES[i],
+                               getBucketUpperBound(bucket));
+    }
+
+    error += strbuf_append(buffer, indent);
+    error += strbuf_append(buffer, "</obj>\r\n");
+    return error;
+}
+
+char* obixMetrics_toObix(const char* href)
+{
+    String_Buffer* buffer = strbuf_create(2048);
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    char line[LINE_SIZE];
+    snprintf(line, LINE_SIZE,
+             "<obj href=\"%s\" displayName=\"Server Metrics\">\r\n", href);
+    int error = strbuf_append(buffer, line);
+
+    int i;
+    for (i = 0; i < METRICS_VALUES_COUNT; i++)
+    {
+        sprintf(line, "  <int name=\"%s\" val=\"%lld\"/>\r\n",
+                VALUE_DESCRIPTION[i].obixName, _values[i]);
+        error += strbuf_append(buffer, line);
+    }
+
+    for (i = 0; i < METRICS_TIMERS_COUNT; i++)
+    {
+        error += appendHistogramObix(buffer, "  ",
+                                     TIMER_DESCRIPTION[i].obixName,
+                                     &(_timers[i]));
+    }
+
+    // POST requests are measured separately for each handler
+    error += strbuf_append(buffer, "  <obj name=\"POST\">\r\n");
+    const char* handlerName;
+    for (i = 0;
+            (i < METRICS_POST_HANDLERS_MAX)
+            && ((handlerName = obix_server_getPostHandlerName(i)) != NULL);
+            i++)
+    {
+        error += appendHistogramObix(buffer, "    ", handlerName,
+                                     &(_postTimers[i]));
+    }
+
+    error += strbuf_append(buffer, "  </obj>\r\n</obj>\r\n");
+    if (error != 0)
+    {
+        strbuf_free(buffer);
+        return NULL;
+    }
+    return strbuf_release(buffer);
+}
+
+/** Appends Prometheus help and type lines of the metric. */
+static int appendPrometheusHeader(String_Buffer* buffer,
+                                  const char* name,
+                                  const char* type,
+                                  const char* help)
+{
+    char line[LINE_SIZE];
+    sprintf(line, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    return strbuf_append(buffer, line);
+}
+
+/**
+ * Appends histogram in Prometheus format. Cumulative buckets are reported
+ * only at powers of two. Empty histograms are skipped.
+ */
+static int appendHistogramPrometheus(String_Buffer* buffer,
+                                     const char* name,
+                                     const char* labels,
+                                     const Histogram* histogram)
+{
+    unsigned long long buckets[METRICS_HISTOGRAM_BUCKETS];
+    unsigned long long count = histogramCopy(histogram, buckets);
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    const char* separator = (labels == NULL) ? "" : ",";
+    if (labels == NULL)
+    {
+        labels = "";
+    }
+
+    char line[LINE_SIZE];
+    int error = 0;
+    unsigned long long cumulative = 0;
+    int i;
+    for (i = 0; i < METRICS_HISTOGRAM_BUCKETS - 1; i++)
+    {
+        cumulative += buckets[i];
+        unsigned long long bound = getBucketUpperBound(i) + 1;
+        if ((bound & (bound - 1)) == 0)
+        {
+            sprintf(line, "%s_bucket{%s%sle=\"%llu.%06llu\"} %llu\n",
+                    name, labels, separator,
+                    bound / 1000000, bound % 1000000, cumulative);
+            error += strbuf_append(buffer, line);
+        }
+    }
+
+    const char* braceOpen = (*labels == '\0') ? "" : "{";
+    const char* braceClose = (*labels == '\0') ? "" : "}";
+    unsigned long long sum = histogram->sum;
+    sprintf(line, "%s_bucket{%s%sle=\"+Inf\"} %llu\n"
+            "%s_sum%s%s%s %llu.%06llu\n"
+            "%s_count%s%s%s %llu\n",
+            name, labels, separator, count,
+            name, braceOpen, labels, braceClose,
+            sum / 1000000, sum % 1000000,
+            name, braceOpen, labels, braceClose, count);
+    error += strbuf_append(buffer, line);
+    return error;
+}
+
+char* obixMetrics_toPrometheus()
+{
+    String_Buffer* buffer = strbuf_create(4096);
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    char line[LINE_SIZE];
+    int error = 0;
+    int i;
+    for (i = 0; i < METRICS_VALUES_COUNT; i++)
+    {
+        const Value_Description* description = &(VALUE_DESCRIPTION[i]);
+        error += appendPrometheusHeader(buffer,
+                                        description->prometheusName,
+                                        description->prometheusType,
+                                        description->help);
+        sprintf(line, "%s %lld\n", description->prometheusName, _values[i]);
+        error += strbuf_append(buffer, line);
+    }
+
+    // all request durations belong to the same metric family, thus POST
+    // handlers are reported right after other request types
+    error += appendPrometheusHeader(buffer,
+                                    "obix_request_duration_seconds",
+                                    "histogram",
+                                    "Time of request handling.");
+    for (i = 0; i < METRICS_TIMERS_COUNT; i++)
+    {
+        const Timer_Description* description = &(TIMER_DESCRIPTION[i]);
+        if (description->prometheusLabels == NULL)
+        {
+            continue;
+        }
+        error += appendHistogramPrometheus(buffer,
+                                           description->prometheusName,
+                                           description->prometheusLabels,
+                                           &(_timers[i]));
+    }
+
+    const char* handlerName;
+    for (i = 0;
+            (i < METRICS_POST_HANDLERS_MAX)
+            && ((handlerName = obix_server_getPostHandlerName(i)) != NULL);
+            i++)
+    {
+        snprintf(line, LINE_SIZE, "method=\"POST\",handler=\"%s\"",
+                 handlerName);
+        error += appendHistogramPrometheus(buffer,
+                                           "obix_request_duration_seconds",
+                                           line,
+                                           &(_postTimers[i]));
+    }
+
+    for (i = 0; i < METRICS_TIMERS_COUNT; i++)
+    {
+        const Timer_Description* description = &(TIMER_DESCRIPTION[i]);
+        if (description->prometheusLabels != NULL)
+        {
+            continue;
+        }
+        error += appendPrometheusHeader(buffer,
+                                        description->prometheusName,
+                                        "histogram",
+                                        "Time of server internal operation.");
+        error += appendHistogramPrometheus(buffer,
+                                           description->prometheusName,
+                                           NULL,
+                                           &(_timers[i]));
+    }
+
+    if (error != 0)
+    {
+        strbuf_free(buffer);
+        return NULL;
+    }
+    return strbuf_release(buffer);
+}
+
+void obixMetrics_reset()
+{
+    _values[METRICS_BYTES_IN] = 0;
+    _values[METRICS_BYTES_OUT] = 0;
+    memset(_timers, 0, sizeof(_timers));
+    memset(_postTimers, 0, sizeof(_postTimers));
+}
@@ -0,0 +1,154 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Defines run-time metrics of the server.
+ *
+ * Metrics consist of counters, gauges and latency histograms. All of them
+ * are updated with atomic operations without any locks, so they can be
+ * updated from any thread at any time with small overhead.
+ *
+ * Histograms are log-linear: every power of two (in microseconds) is split
+ * into #METRICS_HISTOGRAM_SUB_COUNT equal buckets, thus the relative error
+ * of the reported percentiles doesn't exceed 25%.
+ *
+ * Collected metrics are available at @a /obix-metrics/ URI in oBIX format and
+ * at @a /obix-metrics/prometheus in Prometheus text format.
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+/** Logarithm of #METRICS_HISTOGRAM_SUB_COUNT. */
+#define METRICS_HISTOGRAM_SUB_BITS 2
+/** Number of histogram buckets per each power of two. */
+#define METRICS_HISTOGRAM_SUB_COUNT (1 << METRICS_HISTOGRAM_SUB_BITS)
+/** Logarithm of the biggest value, which is distinguished by histograms.
+ * Bigger values (more than 35 minutes) are put to the last bucket. */
+#define METRICS_HISTOGRAM_MAX_EXP 30
+/** Number of buckets in each histogram. */
+#define METRICS_HISTOGRAM_BUCKETS \
+    ((METRICS_HISTOGRAM_MAX_EXP - METRICS_HISTOGRAM_SUB_BITS + 2) \
+     * METRICS_HISTOGRAM_SUB_COUNT)
+
+/** Maximum number of POST handlers, which are measured separately. */
+#define METRICS_POST_HANDLERS_MAX 32
+
+/** Counters and gauges of the server. */
+typedef enum
+{
+    /** Total size of request bodies received by the server. */
+    METRICS_BYTES_IN,
+    /** Total size of response bodies sent by the server. */
+    METRICS_BYTES_OUT,
+    /** Number of existing Watch objects. */
+    METRICS_WATCHES,
+    /** Number of long poll requests, which are currently held. */
+    METRICS_LONG_POLLS,
+    /** Number of remote operation invocations waiting for results. */
+    METRICS_REMOTE_CALLS,
+    /** Number of request objects, which are currently in use. */
+    METRICS_REQUESTS_IN_USE,
+    /** Number of created request objects. */
+    METRICS_REQUESTS_CREATED,
+    /** Estimated memory used by registered devices (see storage_usage.h). */
+    METRICS_DEVICE_BYTES,
+    /** Number of objects of registered devices. */
+    METRICS_DEVICE_OBJECTS,
+    /** Number of elements in this enumeration. */
+    METRICS_VALUES_COUNT
+} Metrics_Value;
+
+/** Measured operations, except POST handlers (see
+ * #obixMetrics_stopPostTimer). */
+typedef enum
+{
+    /** Handling of GET requests. */
+    METRICS_TIMER_GET,
+    /** Handling of PUT requests. */
+    METRICS_TIMER_PUT,
+    /** Search of objects in the storage. */
+    METRICS_TIMER_STORAGE_LOOKUP,
+    /** Generation of response text from oBIX objects. */
+    METRICS_TIMER_SERIALIZATION,
+    /** Number of elements in this enumeration. */
+    METRICS_TIMERS_COUNT
+} Metrics_Timer;
+
+/**
+ * Adds @a delta to the counter or gauge.
+ */
+void obixMetrics_add(Metrics_Value value, long delta);
+
+/**
+ * Sets new value of the gauge.
+ */
+void obixMetrics_set(Metrics_Value value, long newValue);
+
+/**
+ * Returns current value of the counter or gauge.
+ */
+long long obixMetrics_get(Metrics_Value value);
+
+/**
+ * Returns current time, which should be passed later to
+ * #obixMetrics_stopTimer or #obixMetrics_stopPostTimer.
+ * @return Time in microseconds from some unspecified point.
+ */
+unsigned long long obixMetrics_startTimer();
+
+/**
+ * Puts the time passed since @a start to the histogram of the operation.
+ * @param start Value returned by #obixMetrics_startTimer.
+ */
+void obixMetrics_stopTimer(Metrics_Timer timer, unsigned long long start);
+
+/**
+ * Puts the time passed since @a start to the histogram of the POST handler.
+ * @param handlerId Id of the handler (see #obix_server_getPostHandler).
+ * @param start Value returned by #obixMetrics_startTimer.
+ */
+void obixMetrics_stopPostTimer(int handlerId, unsigned long long start);
+
+/**
+ * Generates oBIX object, which contains current values of all metrics.
+ * Percentiles of the histograms are given as @a reltime values.
+ * @param href URI of the generated object.
+ * @return Text of the object, which should be freed by the caller, or
+ *         @a NULL if there is not enough memory.
+ */
+char* obixMetrics_toObix(const char* href);
+
+/**
+ * Generates Prometheus text exposition of all metrics.
+ * @return Generated text, which should be freed by the caller, or @a NULL
+ *         if there is not enough memory.
+ */
+char* obixMetrics_toPrometheus();
+
+/**
+ * Resets all counters and histograms. Gauges are not changed.
+ */
+void obixMetrics_reset();
+
+#endif /* METRICS_H_ */
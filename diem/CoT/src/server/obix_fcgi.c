@@ -31,16 +31,26 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include <syslog.h>
 #include <fcgiapp.h>
+#include <zlib.h>
 
 #include <log_utils.h>
 #include <obix_utils.h>
 #include <xml_config.h>
 #include <ptask.h>
+#include <obix_binary.h>
+#include <probes.h>
 #include "xml_storage.h"
 #include "server.h"
 #include "request.h"
+#include "continuation.h"
+#include "metrics.h"
+#include "object_stats.h"
+#include "storage_usage.h"
+#include "socket_server.h"
+#include "trace.h"
 #include "obix_fcgi.h"
 
 /** Name of server's main configuration file. */
@@ -49,17 +59,105 @@ static const char* CONFIG_FILE = "server_config.xml";
 /** Name of configuration parameter, which defines value of #_requestMaxCount.*/
 static const char* CT_HOLD_REQUEST_MAX = "hold-request-max";
 
+/** Name of configuration parameter, which defines value of
+ * #_compressMinSize. */
+static const char* CT_COMPRESS_MIN_SIZE = "compress-min-size";
+
+/** Name of configuration parameter, which defines value of
+ * #_requestSizeMax. */
+static const char* CT_REQUEST_SIZE_MAX = "request-size-max";
+
+/** @name Names of configuration parameters of remote operation calls
+ * (see continuation.h).
+ * @{ */
+static const char* CT_REMOTE_CALL_TIMEOUT = "remote-call-timeout";
+static const char* CT_REMOTE_CALL_MAX = "remote-call-max";
+/** @} */
+
+/** Name of configuration parameter, which enables capturing of requests
+ * (see trace.h). */
+static const char* CT_TRACE_FILE = "trace-file";
+
+/** @name Names of configuration parameters of object statistics
+ * (see object_stats.h).
+ * @{ */
+static const char* CT_OBJECT_STATS_SAMPLE = "object-stats-sample";
+static const char* CT_OBJECT_STATS_MAX = "object-stats-max";
+/** @} */
+
+/** @name Names of configuration parameters of device memory limits
+ * (see storage_usage.h).
+ * @{ */
+static const char* CT_DEVICE_MEMORY_MAX = "device-memory-max";
+static const char* CT_TOTAL_MEMORY_MAX = "total-memory-max";
+/** @} */
+
+/** Default value of #_compressMinSize. */
+#define COMPRESS_MIN_SIZE_DEFAULT 1024
+
+/** Responses smaller than this size are never compressed, because it doesn't
+ * give much gain. Negative value disables compression at all. */
+static int _compressMinSize = COMPRESS_MIN_SIZE_DEFAULT;
+
+/** Default value of #_requestSizeMax. */
+#define REQUEST_SIZE_MAX_DEFAULT (1024 * 1024)
+
+/** Maximum size of request body in bytes. Bigger requests are rejected
+ * before anything is allocated for them. */
+static int _requestSizeMax = REQUEST_SIZE_MAX_DEFAULT;
+
 /** Standard header of any server answer. */
 static const char* HTTP_STATUS_OK = "Status: 200 OK\r\n"
-                                    "Content-Type: text/xml\r\n";
+                                    "Content-Type: %s\r\n"
+                                    "Content-Length: %d\r\n";
+
+/** Answer to conditional request, when client already has the object. */
+static const char* HTTP_STATUS_NOT_MODIFIED = "Status: 304 Not Modified\r\n";
+
+/** Answer to request with malformed body length. */
+static const char* HTTP_STATUS_BAD_REQUEST = "Status: 400 Bad Request\r\n"
+                                             "Content-Length: 0\r\n\r\n";
+
+/** Answer to request whose body is bigger than #_requestSizeMax. */
+static const char* HTTP_STATUS_TOO_LARGE =
+    "Status: 413 Request Entity Too Large\r\n"
+    "Content-Length: 0\r\n\r\n";
+
+/** Entity tag of the object in the answer. */
+static const char* HTTP_ETAG = "ETag: %s\r\n";
+
+/** Header of compressed answers. */
+static const char* HTTP_CONTENT_ENCODING = "Content-Encoding: %s\r\n";
+
+/** Request headers which select representation of the answer: binary or XML
+ * encoding is chosen by @a Accept, compression by @a Accept-Encoding. */
+static const char* HTTP_VARY = "Vary: Accept\r\n";
+static const char* HTTP_VARY_COMPRESSED = "Vary: Accept, Accept-Encoding\r\n";
+
+/** Content type of XML answers. */
+static const char* CONTENT_TYPE_XML = "text/xml";
+
+/** Content type of metrics in Prometheus text format. */
+static const char* CONTENT_TYPE_PROMETHEUS = "text/plain; version=0.0.4";
+
+/** @name URIs of server metrics (see metrics.h)
+ * @{ */
+static const char* METRICS_URI = "/obix-metrics/";
+static const char* METRICS_PROMETHEUS_URI = "/obix-metrics/prometheus";
+static const char* METRICS_OBJECTS_URI = "/obix-metrics/objects";
+static const char* METRICS_DEVICES_URI = "/obix-metrics/devices";
+/** @} */
 
 /** HTTP attribute, which is added when URI requested by user differs from
  * real object's URI by a trailing slash. */
 static const char* HTTP_CONTENT_LOCATION = "Content-Location: %s\r\n";
-static const char* XML_HEADER = "\r\n<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n";
+static const char* XML_HEADER = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n";
 // TODO think about stylesheet:
 // "<?xml-stylesheet type=\'text/xsl\' href=\'/obix/xsl\'?>\r\n";
 
+/** Size of the portions, in which request input of unknown size is read. */
+#define DEFAULT_INPUT_PORTION 2048
+
 /** Static error message. */
 static const char* ERROR_STATIC = "<err displayName=\"Internal Server Error\" "
                                   "display=\"Unable to process the request. "
@@ -166,7 +264,11 @@ int main(int argc, char** argv)
         }
 
         log_debug("Request accepted.. (handler #%d)", request->id);
+        OBIX_PROBE1(request__accept, request->id);
+        // requests from local socket clients are handled in parallel
+        obix_server_lock();
         obix_fcgi_handleRequest(request);
+        obix_server_unlock();
         log_debug("Request handled. (handler #%d)", request->id);
     }
 
@@ -207,13 +309,134 @@ IXML_Element* obix_fcgi_loadConfig(char* resourceDir)
         obixRequest_setMaxCount(requestMaxCount);
     }
 
+    // load optional parameter defining minimum size of compressed responses
+    configTag = config_getChildTag(settings, CT_COMPRESS_MIN_SIZE, FALSE);
+    if (configTag != NULL)
+    {
+        _compressMinSize = config_getTagAttrIntValue(configTag,
+                           CTA_VALUE,
+                           FALSE,
+                           COMPRESS_MIN_SIZE_DEFAULT);
+    }
+
+    // load optional parameter defining maximum size of request body; a bit
+    // of space is left, so that the size of read data never overflows
+    configTag = config_getChildTag(settings, CT_REQUEST_SIZE_MAX, FALSE);
+    if (configTag != NULL)
+    {
+        long requestSizeMax = config_getTagAttrLongValue(
+                                  configTag,
+                                  CTA_VALUE,
+                                  FALSE,
+                                  REQUEST_SIZE_MAX_DEFAULT);
+        if ((requestSizeMax <= 0)
+                || (requestSizeMax > INT_MAX - 2 * DEFAULT_INPUT_PORTION))
+        {
+            log_warning("Configuration parameter <%s/> should be a positive "
+                        "number less than %d. Default value %d is used.",
+                        CT_REQUEST_SIZE_MAX,
+                        INT_MAX - 2 * DEFAULT_INPUT_PORTION,
+                        REQUEST_SIZE_MAX_DEFAULT);
+            requestSizeMax = REQUEST_SIZE_MAX_DEFAULT;
+        }
+        _requestSizeMax = requestSizeMax;
+    }
+
+    // load optional parameters of remote operation calls
+    configTag = config_getChildTag(settings, CT_REMOTE_CALL_TIMEOUT, FALSE);
+    if (configTag != NULL)
+    {
+        obixContinuation_setTimeout(
+            config_getTagAttrLongValue(configTag,
+                                       CTA_VALUE,
+                                       FALSE,
+                                       CONTINUATION_TIMEOUT_DEFAULT));
+    }
+    configTag = config_getChildTag(settings, CT_REMOTE_CALL_MAX, FALSE);
+    if (configTag != NULL)
+    {
+        obixContinuation_setMaxCount(
+            config_getTagAttrIntValue(configTag,
+                                      CTA_VALUE,
+                                      FALSE,
+                                      CONTINUATION_MAX_COUNT_DEFAULT));
+    }
+
+    // load optional parameters of object statistics
+    configTag = config_getChildTag(settings, CT_OBJECT_STATS_SAMPLE, FALSE);
+    if (configTag != NULL)
+    {
+        obixObjectStats_setSampleRate(
+            config_getTagAttrIntValue(configTag,
+                                      CTA_VALUE,
+                                      FALSE,
+                                      OBJECT_STATS_SAMPLE_RATE_DEFAULT));
+    }
+    configTag = config_getChildTag(settings, CT_OBJECT_STATS_MAX, FALSE);
+    if (configTag != NULL)
+    {
+        obixObjectStats_setMaxObjects(
+            config_getTagAttrIntValue(configTag,
+                                      CTA_VALUE,
+                                      FALSE,
+                                      OBJECT_STATS_MAX_OBJECTS_DEFAULT));
+    }
+
+    // load optional memory limits of devices
+    long deviceMemoryMax = 0;
+    long totalMemoryMax = 0;
+    configTag = config_getChildTag(settings, CT_DEVICE_MEMORY_MAX, FALSE);
+    if (configTag != NULL)
+    {
+        deviceMemoryMax = config_getTagAttrLongValue(configTag,
+                          CTA_VALUE,
+                          FALSE,
+                          0);
+    }
+    configTag = config_getChildTag(settings, CT_TOTAL_MEMORY_MAX, FALSE);
+    if (configTag != NULL)
+    {
+        totalMemoryMax = config_getTagAttrLongValue(configTag,
+                         CTA_VALUE,
+                         FALSE,
+                         0);
+    }
+    obixUsage_setLimits(deviceMemoryMax, totalMemoryMax);
+
+    // load optional parameter enabling capturing of requests
+    configTag = config_getChildTag(settings, CT_TRACE_FILE, FALSE);
+    if (configTag != NULL)
+    {
+        const char* traceFile =
+            config_getTagAttributeValue(configTag, CTA_VALUE, TRUE);
+        if ((traceFile == NULL) || (obixTrace_open(traceFile) != 0))
+        {
+            ixmlElement_freeOwnerDocument(settings);
+            return NULL;
+        }
+    }
+
     return settings;
 }
 
+/**
+ * Is called when a response starts waiting for a remote operation result.
+ * Request of such response is detached from the request pool, so that
+ * waiting invocations do not block handling of other requests.
+ */
+static void obix_fcgi_holdResponse(Response* response)
+{
+    if (response->request->responseListener == NULL)
+    {
+        obixRequest_detach(response->request);
+    }
+}
+
 int obix_fcgi_init(char* resourceDir)
 {
     // register callback for handling responses
     obixResponse_setListener(&obix_fcgi_sendResponse);
+    obixResponse_setHoldListener(&obix_fcgi_holdResponse);
 
     IXML_Element* settings = obix_fcgi_loadConfig(resourceDir);
     if (settings == NULL)
@@ -231,18 +454,451 @@ int obix_fcgi_init(char* resourceDir)
     }
 
     // initialize server
-    error = obix_server_init();
+    error = obix_server_init(NULL);
+    if (error == 0)
+    {
+        // start local socket interface if it is enabled
+        error = obixSocket_init(settings);
+    }
     config_finishInit(settings, error == 0);
     return error;
 }
 
 void obix_fcgi_shutdown(FCGX_Request* request)
 {
+    obixSocket_shutdown();
     obix_server_shutdown();
+    obixTrace_close();
     obixRequest_freeAll();
     FCGX_ShutdownPending();
 }
 
+/**
+ * Writes HTTP headers of the answer, including the empty line which
+ * separates them from the body.
+ * @param response Response whose object attributes (location, entity tag)
+ *                 should be added to the headers; can be @a NULL. Answers
+ *                 with a response (also 304 ones) are negotiated and thus
+ *                 get @a Vary header, even if the body is not compressed.
+ * @param contentEncoding Compression of the body, or @a NULL.
+ */
+static void writeHeaders(FCGX_Stream* out,
+                         const char* contentType,
+                         Response* response,
+                         int contentLength,
+                         const char* contentEncoding)
+{
+    if ((response != NULL) && response->notModified)
+    {
+        FCGX_PutS(HTTP_STATUS_NOT_MODIFIED, out);
+    }
+    else
+    {
+        FCGX_FPrintF(out, HTTP_STATUS_OK, contentType, contentLength);
+    }
+
+    if (response != NULL)
+    {
+        // check whether we should specify the correct address of the object
+        if (response->uri != NULL)
+        {
+            FCGX_FPrintF(out, HTTP_CONTENT_LOCATION, response->uri);
+        }
+        if (response->etag != NULL)
+        {
+            FCGX_FPrintF(out, HTTP_ETAG, response->etag);
+        }
+        // caches should not give this answer to clients with other
+        // preferences
+        FCGX_PutS((_compressMinSize >= 0) ? HTTP_VARY_COMPRESSED : HTTP_VARY,
+                  out);
+    }
+    if (contentEncoding != NULL)
+    {
+        FCGX_FPrintF(out, HTTP_CONTENT_ENCODING, contentEncoding);
+    }
+    FCGX_PutS("\r\n", out);
+}
+
+/**
+ * Finds quality value of the content coding in @a Accept-Encoding header.
+ * Wildcard "*" matches codings, which are not listed explicitly.
+ * @return Quality value multiplied by 1000 (@a 0 means that the coding is
+ *         not acceptable), or @a -1 if the coding is not mentioned.
+ */
+static int getEncodingQuality(const char* accept, const char* coding)
+{
+    int codingLength = strlen(coding);
+    int quality = -1;
+    int wildcardQuality = -1;
+
+    while (*accept != '\0')
+    {
+        accept += strspn(accept, " \t,");
+        const char* end = accept + strcspn(accept, ",");
+        int nameLength = strcspn(accept, " \t;,");
+
+        // the only parameter defined for content codings is q
+        int q = 1000;
+        const char* param = memchr(accept, ';', end - accept);
+        while (param != NULL)
+        {
+            param += 1 + strspn(param + 1, " \t");
+            if (((*param == 'q') || (*param == 'Q')) && (param[1] == '='))
+            {
+                q = (int) (strtod(param + 2, NULL) * 1000 + 0.5);
+            }
+            param = memchr(param, ';', end - param);
+        }
+
+        if ((nameLength == codingLength)
+                && (strncasecmp(accept, coding, codingLength) == 0))
+        {
+            quality = q;
+        }
+        else if ((nameLength == 1) && (*accept == '*'))
+        {
+            wildcardQuality = q;
+        }
+        accept = end;
+    }
+
+    return (quality >= 0) ? quality : wildcardQuality;
+}
+
+/**
+ * Chooses compression of the response body, which is supported by the
+ * client (@a Accept-Encoding header). Codings with zero quality value are
+ * never used; gzip is preferred when both codings are equally acceptable.
+ * @return Name of the content coding, or @a NULL if the response should not
+ *         be compressed.
+ */
+static const char* getContentEncoding(Request* request, int contentLength)
+{
+    if ((_compressMinSize < 0) || (contentLength < _compressMinSize))
+    {
+        return NULL;
+    }
+
+    const char* accept =
+        FCGX_GetParam("HTTP_ACCEPT_ENCODING", request->r.envp);
+    if (accept == NULL)
+    {
+        return NULL;
+    }
+
+    int gzipQuality = getEncodingQuality(accept, "gzip");
+    int deflateQuality = getEncodingQuality(accept, "deflate");
+    if ((gzipQuality > 0) && (gzipQuality >= deflateQuality))
+    {
+        return "gzip";
+    }
+    if (deflateQuality > 0)
+    {
+        return "deflate";
+    }
+    return NULL;
+}
+
+/**
+ * Compresses all parts of the response body into one buffer.
+ * @param contentEncoding Either "gzip" or "deflate".
+ * @param length Length of the compressed data is returned here.
+ * @return Compressed data, or @a NULL if compression failed or doesn't make
+ *         the body smaller.
+ */
+static char* compressBody(const char* contentEncoding,
+                          const char** parts,
+                          const int* lengths,
+                          int count,
+                          int contentLength,
+                          int* length)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(z_stream));
+    // adding 16 to the window size makes zlib write gzip wrapper instead of
+    // the zlib one
+    int windowBits = (strcmp(contentEncoding, "gzip") == 0) ? (15 + 16) : 15;
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits,
+                     8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        log_warning("Unable to compress the response: deflateInit2() failed.");
+        return NULL;
+    }
+
+    // the buffer is big enough to compress everything with single calls
+    int size = deflateBound(&stream, contentLength) + 32;
+    char* output = (char*) malloc(size);
+    if (output == NULL)
+    {
+        deflateEnd(&stream);
+        return NULL;
+    }
+    stream.next_out = (Bytef*) output;
+    stream.avail_out = size;
+
+    int error = Z_OK;
+    int i;
+    for (i = 0; (i < count) && (error == Z_OK); i++)
+    {
+        if ((lengths[i] == 0) && (i < (count - 1)))
+        {   // deflate() fails when there is nothing to do
+            continue;
+        }
+        stream.next_in = (Bytef*) parts[i];
+        stream.avail_in = lengths[i];
+        error = deflate(&stream, (i == (count - 1)) ? Z_FINISH : Z_NO_FLUSH);
+    }
+    *length = stream.total_out;
+    deflateEnd(&stream);
+
+    if ((error != Z_STREAM_END) || (*length >= contentLength))
+    {
+        free(output);
+        return NULL;
+    }
+    return output;
+}
+
+/**
+ * Sends the response body, compressing it if the client allows, and
+ * releases the response.
+ */
+static void sendBody(Response* response,
+                     const char* contentType,
+                     const char** parts,
+                     const int* lengths,
+                     int count,
+                     int contentLength)
+{
+    FCGX_Request* request = &(response->request->r);
+
+    const char* contentEncoding =
+        getContentEncoding(response->request, contentLength);
+    char* compressed = NULL;
+    int compressedLength = 0;
+    if (contentEncoding != NULL)
+    {
+        compressed = compressBody(contentEncoding, parts, lengths, count,
+                                  contentLength, &compressedLength);
+    }
+
+    if (compressed != NULL)
+    {
+        obixMetrics_add(METRICS_BYTES_OUT, compressedLength);
+        writeHeaders(request->out, contentType, response, compressedLength,
+                     contentEncoding);
+        FCGX_PutStr(compressed, compressedLength, request->out);
+        OBIX_PROBE2(response__flush, response->uri, compressedLength);
+        free(compressed);
+    }
+    else
+    {
+        obixMetrics_add(METRICS_BYTES_OUT, contentLength);
+        writeHeaders(request->out, contentType, response, contentLength, NULL);
+        // send all parts of the response without any formatting
+        int i;
+        for (i = 0; i < count; i++)
+        {
+            FCGX_PutStr(parts[i], lengths[i], request->out);
+        }
+        OBIX_PROBE2(response__flush, response->uri, contentLength);
+    }
+
+    // everything is flushed at once when the request is finished
+    FCGX_Finish_r(request);
+    obixRequest_release(response->request);
+    obixResponse_free(response);
+}
+
+/**
+ * Reads request input. Binary encoded input (see obix_binary.h) is decoded
+ * directly to DOM, so that it is not converted to XML text and parsed again.
+ * @param data Raw request input (XML text or binary), or @a NULL if the input
+ *             is empty.
+ * @param length Length of the raw input in bytes.
+ * @param text XML text of the request input, stored at the input buffer of
+ *             the request, is returned here. @a NULL if the input is empty
+ *             or binary.
+ * @param element Decoded binary input is returned here. @a NULL if the input
+ *                is not binary or can't be decoded. Should be freed with
+ *                #ixmlElement_freeOwnerDocument.
+ * @param binary Returns whether the input is binary encoded.
+ * @return @a 0 on success, or error of #obix_fcgi_readRequestInput.
+ */
+static int readInput(Request* request,
+                     const char** data,
+                     int* length,
+                     const char** text,
+                     IXML_Element** element,
+                     BOOL* binary)
+{
+    const char* input;
+    int error = obix_fcgi_readRequestInput(request, &input, length);
+    *data = input;
+    *text = input;
+    *element = NULL;
+    *binary = FALSE;
+    if ((error != 0) || (input == NULL))
+    {
+        return error;
+    }
+
+    const char* contentType = FCGX_GetParam("CONTENT_TYPE", request->r.envp);
+    if ((contentType == NULL) ||
+            (strstr(contentType, OBIX_BINARY_CONTENT_TYPE) == NULL))
+    {
+        return 0;
+    }
+
+    // invalid input is passed to the handler as empty one, which answers
+    // with an error
+    *text = NULL;
+    *binary = TRUE;
+    *element = obixBinary_decode(input, *length);
+    if (*element == NULL)
+    {
+        log_warning("Unable to decode binary request input.");
+    }
+    return 0;
+}
+
+/**
+ * Sends binary encoded response. Parts which were generated as XML text
+ * (templates, error messages, etc.) are converted on the fly.
+ */
+static void sendBinaryResponse(Response* response)
+{
+    String_Buffer* buffer = strbuf_create(256);
+    if ((buffer == NULL) || (obixBinary_appendHeader(buffer) != 0))
+    {
+        log_error("Not enough memory to encode the response.");
+        strbuf_free(buffer);
+        obix_fcgi_sendStaticErrorMessage(response->request);
+        obixResponse_free(response);
+        return;
+    }
+
+    Response* iterator = response;
+    int error = 0;
+    while ((iterator != NULL) && (error == 0))
+    {
+        if (iterator->binaryLength >= 0)
+        {
+            error = strbuf_appendLength(buffer,
+                                        iterator->body,
+                                        iterator->binaryLength);
+        }
+        else
+        {
+            error = obixBinary_encodeXml(iterator->body, buffer);
+        }
+        iterator = iterator->next;
+    }
+
+    if (error != 0)
+    {
+        log_error("Unable to encode the response.");
+        strbuf_free(buffer);
+        obix_fcgi_sendStaticErrorMessage(response->request);
+        obixResponse_free(response);
+        return;
+    }
+
+    const char* parts[] = {buffer->data};
+    int lengths[] = {buffer->length};
+    sendBody(response, OBIX_BINARY_CONTENT_TYPE, parts, lengths, 1,
+             buffer->length);
+    strbuf_free(buffer);
+}
+
+/**
+ * Sends statistics of the most used objects. Number of reported objects is
+ * defined by @a limit query parameter.
+ */
+static void sendObjectStats(Response* response)
+{
+    int count = response->request->limit;
+    char* text = obixObjectStats_toObix(
+                     METRICS_OBJECTS_URI,
+                     (count >= 0) ? count : OBJECT_STATS_TOP_DEFAULT);
+    if (text == NULL)
+    {
+        obixResponse_setError(response,
+                              "Unable to generate object statistics.");
+    }
+    else
+    {
+        obixResponse_setText(response, text, FALSE);
+    }
+    obixResponse_send(response);
+}
+
+/**
+ * Sends memory usage of the biggest devices. Number of reported devices is
+ * defined by @a limit query parameter.
+ */
+static void sendDeviceUsage(Response* response)
+{
+    int count = response->request->limit;
+    char* text = obixUsage_toObix(
+                     METRICS_DEVICES_URI,
+                     (count >= 0) ? count : STORAGE_USAGE_TOP_DEFAULT);
+    if (text == NULL)
+    {
+        obixResponse_setError(response,
+                              "Unable to generate device memory usage.");
+    }
+    else
+    {
+        obixResponse_setText(response, text, FALSE);
+    }
+    obixResponse_send(response);
+}
+
+/**
+ * Sends current server metrics either as oBIX object or in Prometheus text
+ * format.
+ */
+static void sendMetrics(Response* response, BOOL prometheus)
+{
+    if (!prometheus)
+    {
+        char* text = obixMetrics_toObix(METRICS_URI);
+        if (text == NULL)
+        {
+            obixResponse_setError(response, "Unable to generate metrics.");
+        }
+        else
+        {
+            obixResponse_setText(response, text, FALSE);
+        }
+        obixResponse_send(response);
+        return;
+    }
+
+    char* text = obixMetrics_toPrometheus();
+    if (text == NULL)
+    {
+        obixResponse_setError(response, "Unable to generate metrics.");
+        obixResponse_send(response);
+        return;
+    }
+
+    const char* parts[] = {text};
+    int lengths[] = {strlen(text)};
+    sendBody(response, CONTENT_TYPE_PROMETHEUS, parts, lengths, 1, lengths[0]);
+    free(text);
+}
+
+/** Answers the request with HTTP status only, without any body. */
+static void sendStatus(Request* request, const char* status)
+{
+    FCGX_PutS(status, request->r.out);
+    FCGX_Finish_r(&(request->r));
+    obixRequest_release(request);
+}
+
 void obix_fcgi_handleRequest(Request* request)
 {
 	// check that request has correct URI attributes
@@ -271,6 +927,38 @@ void obix_fcgi_handleRequest(Request* request)
         return;
     }
 
+    // input is parsed directly from the request buffer
+    const char* data = NULL;
+    int length = 0;
+    const char* input = NULL;
+    IXML_Element* element = NULL;
+    BOOL binary = FALSE;
+    if (!strcmp(requestType, "PUT") || !strcmp(requestType, "POST"))
+    {
+        int error = readInput(request, &data, &length,
+                              &input, &element, &binary);
+        if (error != 0)
+        {
+            obixResponse_free(response);
+            if (error == OBIX_FCGI_INPUT_TOO_LARGE)
+            {
+                sendStatus(request, HTTP_STATUS_TOO_LARGE);
+            }
+            else if (error == OBIX_FCGI_INPUT_BAD_LENGTH)
+            {
+                sendStatus(request, HTTP_STATUS_BAD_REQUEST);
+            }
+            else
+            {
+                obix_fcgi_sendStaticErrorMessage(request);
+            }
+            return;
+        }
+    }
+    obixTrace_write(requestType, uri, request->query, request->r.envp,
+                    data, length);
+    OBIX_PROBE2(request__dispatch, requestType, uri);
+
     // call corresponding request handler
     if (!strcmp(requestType, "GET"))
     {
@@ -279,6 +967,22 @@ void obix_fcgi_handleRequest(Request* request)
         {
             obix_fcgi_dumpEnvironment(response);
         }
+        else if (strcmp(uri, METRICS_URI) == 0)
+        {
+            sendMetrics(response, FALSE);
+        }
+        else if (strcmp(uri, METRICS_PROMETHEUS_URI) == 0)
+        {
+            sendMetrics(response, TRUE);
+        }
+        else if (strcmp(uri, METRICS_OBJECTS_URI) == 0)
+        {
+            sendObjectStats(response);
+        }
+        else if (strcmp(uri, METRICS_DEVICES_URI) == 0)
+        {
+            sendDeviceUsage(response);
+        }
         else
         {
             obix_server_handleGET(response, uri);
@@ -287,21 +991,25 @@ void obix_fcgi_handleRequest(Request* request)
     else if (!strcmp(requestType, "PUT"))
     {
         // handle PUT request
-        char* input = obix_fcgi_readRequestInput(request);
-        obix_server_handlePUT(response, uri, input);
-        if (input != NULL)
+        if (binary)
         {
-            free(input);
+            obix_server_handlePUTDOM(response, uri, element);
+        }
+        else
+        {
+            obix_server_handlePUT(response, uri, input);
         }
     }
     else if (!strcmp(requestType, "POST"))
     {
         // handle POST request
-        char* input = obix_fcgi_readRequestInput(request);
-        obix_server_handlePOST(response, uri, input);
-        if (input != NULL)
+        if (binary)
+        {
+            obix_server_invoke(response, uri, element);
+        }
+        else
         {
-            free(input);
+            obix_server_handlePOST(response, uri, input);
         }
     }
     else
@@ -320,24 +1028,57 @@ void obix_fcgi_handleRequest(Request* request)
         free(message);
         obix_fcgi_sendResponse(response);
     }
+
+    if (element != NULL)
+    {
+        ixmlElement_freeOwnerDocument(element);
+    }
 }
 
 void obix_fcgi_sendStaticErrorMessage(Request* request)
 {
     // send HTTP reply
-    FCGX_FPrintF(request->r.out, HTTP_STATUS_OK);
-    FCGX_FPrintF(request->r.out, XML_HEADER);
-    FCGX_FPrintF(request->r.out, ERROR_STATIC);
+    int headerLength = strlen(XML_HEADER);
+    int bodyLength = strlen(ERROR_STATIC);
+    writeHeaders(request->r.out,
+                 CONTENT_TYPE_XML,
+                 NULL,
+                 headerLength + bodyLength,
+                 NULL);
+    FCGX_PutStr(XML_HEADER, headerLength, request->r.out);
+    FCGX_PutStr(ERROR_STATIC, bodyLength, request->r.out);
     FCGX_Finish_r(&(request->r));
     obixRequest_release(request);
 }
 
 void obix_fcgi_sendResponse(Response* response)
 {
-    // prepare all parts of the response
-    Response* iterator = response;
+    Response* iterator;
+    int count = 0;
 
-    while (iterator != NULL)
+    if (response->notModified)
+    {   // client already has the object, so there is no body
+        writeHeaders(response->request->r.out, NULL, response, 0, NULL);
+        FCGX_Finish_r(&(response->request->r));
+        obixRequest_release(response->request);
+        obixResponse_free(response);
+        return;
+    }
+
+    for (iterator = response; iterator != NULL; iterator = iterator->next)
+    {
+        count++;
+    }
+
+    // prepare all parts of the response, so that the total length is known
+    // before anything is sent. The first part is the XML declaration.
+    const char* parts[count + 1];
+    int lengths[count + 1];
+    parts[0] = XML_HEADER;
+    lengths[0] = strlen(XML_HEADER);
+    int contentLength = lengths[0];
+    count = 1;
+    for (iterator = response; iterator != NULL; iterator = iterator->next)
     {
         if (iterator->body == NULL)
         {
@@ -352,80 +1093,113 @@ void obix_fcgi_sendResponse(Response* response)
                 return;
             }
         }
-        iterator = iterator->next;
-    }
-
-    FCGX_Request* request = &(response->request->r);
-
-    // send HTTP header
-    FCGX_FPrintF(request->out, HTTP_STATUS_OK);
-    // check whether we should specify the correct address of the object
-    if (response->uri != NULL)
-    {
-        FCGX_FPrintF(request->out, HTTP_CONTENT_LOCATION, response->uri);
+        parts[count] = iterator->body;
+        lengths[count] = (iterator->binaryLength >= 0) ?
+                         iterator->binaryLength : strlen(iterator->body);
+        contentLength += lengths[count];
+        count++;
     }
-    FCGX_FPrintF(request->out, XML_HEADER);
 
-    // send all parts of the response
-    iterator = response;
-    while (iterator != NULL)
+    if (response->binary)
     {
-        FCGX_FPrintF(request->out, iterator->body);
-        iterator = iterator->next;
+        sendBinaryResponse(response);
+        return;
     }
 
-    FCGX_Finish_r(request);
-    obixRequest_release(response->request);
-    obixResponse_free(response);
+    sendBody(response, CONTENT_TYPE_XML, parts, lengths, count, contentLength);
 }
 
-char* obix_fcgi_readRequestInput(Request* request)
+int obix_fcgi_readRequestInput(Request* request,
+                               const char** input,
+                               int* length)
 {
-    char* buffer = NULL;
-    int bufferSize = 1024;
+    *input = NULL;
+    // size of the body is usually known in advance
+    const char* contentLength =
+        FCGX_GetParam("CONTENT_LENGTH", request->r.envp);
+    long expected = 0;
+    if ((contentLength != NULL) && (*contentLength != '\0'))
+    {
+        char* end;
+        expected = strtol(contentLength, &end, 10);
+        if ((*end != '\0') || (expected < 0))
+        {
+            log_warning("Request has wrong CONTENT_LENGTH: \"%s\".",
+                        contentLength);
+            return OBIX_FCGI_INPUT_BAD_LENGTH;
+        }
+        if (expected > _requestSizeMax)
+        {
+            log_warning("Request body (%ld bytes) is bigger than allowed "
+                        "(%d bytes).", expected, _requestSizeMax);
+            return OBIX_FCGI_INPUT_TOO_LARGE;
+        }
+    }
+    // read by portions of this size if the size is unknown
+    int portion = (expected > 0) ? expected : DEFAULT_INPUT_PORTION;
     int bytesRead = 0;
-    int error;
+    int received;
 
     do
     {
-        // we start from buffer 2KB
-        // and than double it's size on every iteration
-        bufferSize = bufferSize << 1;
-
-        buffer = (char*) realloc(buffer, bufferSize);
-        if (buffer == NULL)
+        // size is checked before growing the buffer, so the sum can't
+        // overflow
+        if (bytesRead > _requestSizeMax)
         {
-            log_error("Not enough memory to read the contents of the request.");
-            return NULL;
+            log_warning("Request body is bigger than allowed (%d bytes).",
+                        _requestSizeMax);
+            return OBIX_FCGI_INPUT_TOO_LARGE;
         }
-
-        bytesRead += FCGX_GetStr(buffer + bytesRead,
-                                 bufferSize - bytesRead,
-                                 request->r.in);
-
-        if (bytesRead == 0)
+        char* buffer = obixRequest_getInputBuffer(request, bytesRead + portion);
+        if (buffer == NULL)
         {
-            //empty input
-            free(buffer);
-            return NULL;
+            return OBIX_FCGI_INPUT_ERROR;
         }
 
-        error = FCGX_GetError(request->r.in);
+        received = FCGX_GetStr(buffer + bytesRead, portion, request->r.in);
+        bytesRead += received;
+
+        int error = FCGX_GetError(request->r.in);
         if (error != 0)
         {
-            log_error("Error occurred while reading request input (code %d).", error);
-            free(buffer);
-            return NULL;
+            log_error("Error occurred while reading request input (code %d).",
+                      error);
+            return OBIX_FCGI_INPUT_ERROR;
         }
+        // body of the known size is read at once, otherwise repeat until
+        // the input ends
+    }
+    while((expected <= 0) && (received == portion));
 
-        // repeat until buffer is big enough to store whole input
+    if ((expected > 0) && (bytesRead != expected))
+    {
+        log_error("Request input is truncated: received %d bytes instead of "
+                  "%ld.", bytesRead, expected);
+        return OBIX_FCGI_INPUT_ERROR;
+    }
+    if (bytesRead > _requestSizeMax)
+    {
+        log_warning("Request body is bigger than allowed (%d bytes).",
+                    _requestSizeMax);
+        return OBIX_FCGI_INPUT_TOO_LARGE;
+    }
+    if (bytesRead == 0)
+    {
+        //empty input
+        return 0;
     }
-    while(bytesRead == bufferSize);
+
     // finalize input string
-    buffer[bytesRead] = '\0';
-    log_debug("Received request input (size = %d):\n%s\n", bytesRead, buffer);
+    request->input[bytesRead] = '\0';
+    if (length != NULL)
+    {
+        *length = bytesRead;
+    }
+    log_debug("Received request input (size = %d).", bytesRead);
+    obixMetrics_add(METRICS_BYTES_IN, bytesRead);
 
-    return buffer;
+    *input = request->input;
+    return 0;
 }
 
 void obix_fcgi_dumpEnvironment(Response* response)
@@ -482,7 +1256,7 @@ void obix_fcgi_dumpEnvironment(Response* response)
     char* storageDump = xmldb_getDump();
     if (storageDump != NULL)
     {
-        nextPart->body = storageDump;
+        obixResponse_setText(nextPart, storageDump, FALSE);
         obixResponse_getNewPart(nextPart);
         if (nextPart->next == NULL)
         {
@@ -494,7 +1268,7 @@ void obix_fcgi_dumpEnvironment(Response* response)
     }
 
     // finalize output
-    if (obixResponse_setText(nextPart, "\r\n  </obj>\r\n</obj>", TRUE) != 0)
+    if (obixResponse_setStaticText(nextPart, "\r\n  </obj>\r\n</obj>") != 0)
     {
         log_error("Unable to create multipart response. Answer is not complete.");
         obixResponse_send(response);
@@ -61,11 +61,31 @@ void obix_fcgi_sendResponse(Response* response);
  */
 void obix_fcgi_sendStaticErrorMessage(Request* request);
 
+/** @name Errors returned by #obix_fcgi_readRequestInput
+ * @{ */
+/** Request body could not be read completely. */
+#define OBIX_FCGI_INPUT_ERROR -1
+/** @a CONTENT_LENGTH parameter is not a valid number. */
+#define OBIX_FCGI_INPUT_BAD_LENGTH -2
+/** Request body is bigger than allowed by @a request-size-max
+ * configuration parameter. */
+#define OBIX_FCGI_INPUT_TOO_LARGE -3
+/** @} */
+
 /**
- * Reads request input message into character buffer.
- * @return Full input message in a buffer, or @a NULL if error occurred.
+ * Reads request input message into the input buffer of the request (see
+ * #obixRequest_getInputBuffer). The buffer is allocated according to
+ * @a CONTENT_LENGTH parameter, so that the whole body is read at once.
+ * @param input Full input message is returned here, or @a NULL if the body
+ *              is empty. It should not be freed and is valid until the
+ *              request object is released.
+ * @param length If not @a NULL, the size of the read input is returned here.
+ *               Needed for binary input, which can contain zero bytes.
+ * @return @a 0 on success, or one of @a OBIX_FCGI_INPUT_* errors.
  */
-char* obix_fcgi_readRequestInput(Request* request);
+int obix_fcgi_readRequestInput(Request* request,
+                               const char** input,
+                               int* length);
 
 /**
  * Generates a response object with full dump of server database.
@@ -0,0 +1,502 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of object statistics.
+ *
+ * Tracked objects are kept in a fixed array of entries, which is allocated
+ * at the first sampled event together with two indexes: an open addressing
+ * hash table with capacity twice the maximum number of tracked objects, and
+ * a binary min-heap of the entries ordered by their activity. The heap gives
+ * the least active entry in constant time, which is replaced when a new
+ * object comes to the full table (Space-Saving algorithm).
+ *
+ * @see object_stats.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <str_buffer.h>
+#include "object_stats.h"
+
+/** Maximum length of one line of the generated report (without URI). */
+#define LINE_SIZE 128
+
+/** Counters of one object. */
+typedef struct
+{
+    char* uri;
+    unsigned int hash;
+    /** Activity of the object, which was replaced by this one. The object
+     * could be active before it was tracked, so its activity is estimated
+     * as at least the activity of the replaced one. */
+    long error;
+    /** Position of the entry in #_heap. */
+    int heapIndex;
+    long counters[OBJECT_STATS_COUNT];
+}
+Object_Entry;
+
+/** Names of the counters in the report. */
+static const char* COUNTER_NAME[OBJECT_STATS_COUNT] =
+    {"reads", "writes", "notifications", "bytes"};
+
+static int _sampleRate = OBJECT_STATS_SAMPLE_RATE_DEFAULT;
+static int _maxObjects = OBJECT_STATS_MAX_OBJECTS_DEFAULT;
+
+/** Tracked objects; the first #_objectCount entries are used. */
+static Object_Entry* _entries = NULL;
+/** Hash table with indexes of #_entries increased by one; @a 0 marks free
+ * slots. */
+static int* _table = NULL;
+/** Size of #_table; always a power of two. */
+static int _capacity = 0;
+/** Min-heap of indexes of #_entries, ordered by activity. */
+static int* _heap = NULL;
+/** Number of entries allocated for the current table. */
+static int _entryCount = 0;
+static int _objectCount = 0;
+/** Counters of objects, which were not tracked or were replaced. */
+static long _untracked[OBJECT_STATS_COUNT];
+
+static pthread_mutex_t _mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** State of random generator of each thread. */
+static __thread unsigned int _random = 0;
+
+/** Decides randomly whether the current event should be counted. */
+static int isSampled()
+{
+    int rate = _sampleRate;
+    if (rate <= 1)
+    {
+        return rate == 1;
+    }
+
+    // xorshift generator; address of the thread local variable gives
+    // different seeds to different threads
+    unsigned int x = _random;
+    if (x == 0)
+    {
+        x = ((unsigned int) (unsigned long) &_random) | 1;
+    }
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    _random = x;
+
+    return (x % rate) == 0;
+}
+
+/** FNV-1a hash of the string. */
+static unsigned int getHash(const char* str)
+{
+    unsigned int hash = 2166136261u;
+    for (; *str != '\0'; str++)
+    {
+        hash ^= (unsigned char) *str;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Returns estimated number of events of the object: the sum of reads, writes
+ * and notifications plus the error inherited from the replaced object.
+ */
+static long getActivity(const Object_Entry* entry)
+{
+    return entry->error
+           + entry->counters[OBJECT_STATS_READS]
+           + entry->counters[OBJECT_STATS_WRITES]
+           + entry->counters[OBJECT_STATS_NOTIFICATIONS];
+}
+
+/** Puts entry with provided index to the position of the heap. */
+static void heapSet(int position, int index)
+{
+    _heap[position] = index;
+    _entries[index].heapIndex = position;
+}
+
+/** Moves the entry down the heap after its activity is increased. */
+static void heapSiftDown(int position)
+{
+    int index = _heap[position];
+    long activity = getActivity(&(_entries[index]));
+    for (;;)
+    {
+        int child = position * 2 + 1;
+        if (child >= _objectCount)
+        {
+            break;
+        }
+        if ((child + 1 < _objectCount)
+                && (getActivity(&(_entries[_heap[child + 1]]))
+                    < getActivity(&(_entries[_heap[child]]))))
+        {
+            child++;
+        }
+        if (getActivity(&(_entries[_heap[child]])) >= activity)
+        {
+            break;
+        }
+        heapSet(position, _heap[child]);
+        position = child;
+    }
+    heapSet(position, index);
+}
+
+/** Moves the entry up the heap after it is appended. */
+static void heapSiftUp(int position)
+{
+    int index = _heap[position];
+    long activity = getActivity(&(_entries[index]));
+    while (position > 0)
+    {
+        int parent = (position - 1) / 2;
+        if (getActivity(&(_entries[_heap[parent]])) <= activity)
+        {
+            break;
+        }
+        heapSet(position, _heap[parent]);
+        position = parent;
+    }
+    heapSet(position, index);
+}
+
+/**
+ * Finds slot of the hash table, which refers to the object, or free slot
+ * where the object should be put.
+ */
+static int findSlot(const char* uri, unsigned int hash)
+{
+    int mask = _capacity - 1;
+    int i;
+    for (i = hash & mask; _table[i] != 0; i = (i + 1) & mask)
+    {
+        Object_Entry* entry = &(_entries[_table[i] - 1]);
+        if ((entry->hash == hash) && (strcmp(entry->uri, uri) == 0))
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * Removes the slot from the hash table. Following slots of the same cluster
+ * are shifted back, so that lookups never need deleted markers.
+ */
+static void removeSlot(int slot)
+{
+    int mask = _capacity - 1;
+    int i = slot;
+    for (;;)
+    {
+        _table[slot] = 0;
+        int home;
+        do
+        {
+            i = (i + 1) & mask;
+            if (_table[i] == 0)
+            {
+                return;
+            }
+            home = _entries[_table[i] - 1].hash & mask;
+        }
+        // entry stays if its home slot lies cyclically in (slot, i]
+        while ((slot <= i) ? ((slot < home) && (home <= i))
+                : ((slot < home) || (home <= i)));
+        _table[slot] = _table[i];
+        slot = i;
+    }
+}
+
+/** Allocates the table when the first event is counted. */
+static int allocateTable()
+{
+    if (_maxObjects <= 0)
+    {
+        return -1;
+    }
+    _capacity = 2;
+    while (_capacity < _maxObjects * 2)
+    {
+        _capacity <<= 1;
+    }
+    _entryCount = _maxObjects;
+    _entries = (Object_Entry*) calloc(_entryCount, sizeof(Object_Entry));
+    _table = (int*) calloc(_capacity, sizeof(int));
+    _heap = (int*) malloc(_entryCount * sizeof(int));
+    if ((_entries == NULL) || (_table == NULL) || (_heap == NULL))
+    {
+        free(_entries);
+        free(_table);
+        free(_heap);
+        _entries = NULL;
+        _table = NULL;
+        _heap = NULL;
+        _capacity = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Finds entry of the object, adding it if it is not tracked yet. When all
+ * entries are used, the least active object is replaced: its counters are
+ * moved to the untracked ones and its activity becomes the error of the new
+ * object.
+ * @return @a NULL if the object can't be tracked.
+ */
+static Object_Entry* getEntry(const char* uri)
+{
+    if ((_entries == NULL) && (allocateTable() != 0))
+    {
+        return NULL;
+    }
+
+    unsigned int hash = getHash(uri);
+    int slot = findSlot(uri, hash);
+    if (_table[slot] != 0)
+    {
+        return &(_entries[_table[slot] - 1]);
+    }
+
+    // the object is not tracked yet
+    char* copy = strdup(uri);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+
+    int index;
+    long error = 0;
+    int appended = (_objectCount < _entryCount);
+    if (appended)
+    {
+        index = _objectCount++;
+        _heap[index] = index;
+    }
+    else
+    {
+        index = _heap[0];
+        Object_Entry* victim = &(_entries[index]);
+        error = getActivity(victim);
+        int i;
+        for (i = 0; i < OBJECT_STATS_COUNT; i++)
+        {
+            _untracked[i] += victim->counters[i];
+        }
+        removeSlot(findSlot(victim->uri, victim->hash));
+        free(victim->uri);
+        // the free slot could be moved by the removal
+        slot = findSlot(uri, hash);
+    }
+
+    Object_Entry* entry = &(_entries[index]);
+    entry->uri = copy;
+    entry->hash = hash;
+    entry->error = error;
+    memset(entry->counters, 0, sizeof(entry->counters));
+    _table[slot] = index + 1;
+    if (appended)
+    {
+        heapSiftUp(index);
+    }
+    // otherwise the new entry is as active as the replaced one, so it stays
+    // at the top of the heap until it is counted
+    return entry;
+}
+
+void obixObjectStats_setSampleRate(int rate)
+{
+    _sampleRate = (rate > 0) ? rate : 0;
+}
+
+void obixObjectStats_setMaxObjects(int count)
+{
+    _maxObjects = count;
+}
+
+void obixObjectStats_count(const char* uri,
+                           Object_Stats_Counter counter,
+                           long value)
+{
+    if ((uri == NULL) || !isSampled())
+    {
+        return;
+    }
+
+    // counted event represents all events which were skipped
+    value *= _sampleRate;
+
+    pthread_mutex_lock(&_mutex);
+    Object_Entry* entry = getEntry(uri);
+    if (entry != NULL)
+    {
+        entry->counters[counter] += value;
+        if (counter != OBJECT_STATS_BYTES)
+        {
+            heapSiftDown(entry->heapIndex);
+        }
+    }
+    else
+    {
+        _untracked[counter] += value;
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+/** Sorts entries by counted activity in descending order. */
+static int compareEntries(const void* a, const void* b)
+{
+    const Object_Entry* entryA = *((const Object_Entry**) a);
+    const Object_Entry* entryB = *((const Object_Entry**) b);
+    // only events counted since the object is tracked are compared, so that
+    // recently added objects with big inherited error don't hide others
+    long diff = (getActivity(entryB) - entryB->error)
+                - (getActivity(entryA) - entryA->error);
+    if (diff == 0)
+    {
+        diff = entryB->counters[OBJECT_STATS_BYTES]
+               - entryA->counters[OBJECT_STATS_BYTES];
+    }
+    return (diff > 0) - (diff < 0);
+}
+
+/** Appends counters of one object to the report. */
+static int appendCounters(String_Buffer* buffer,
+                          const char* indent,
+                          const long* counters)
+{
+    char line[LINE_SIZE];
+    int error = 0;
+    int i;
+    for (i = 0; i < OBJECT_STATS_COUNT; i++)
+    {
+        sprintf(line, "%s<int name=\"%s\" val=\"%ld\"/>\r\n",
+                indent, COUNTER_NAME[i], counters[i]);
+        error += strbuf_append(buffer, line);
+    }
+    return error;
+}
+
+char* obixObjectStats_toObix(const char* href, int count)
+{
+    String_Buffer* buffer = strbuf_create(4096);
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&_mutex);
+
+    // sort references to the tracked entries
+    const Object_Entry** sorted = NULL;
+    if (_objectCount > 0)
+    {
+        sorted = (const Object_Entry**) malloc(
+                     _objectCount * sizeof(Object_Entry*));
+        if (sorted == NULL)
+        {
+            pthread_mutex_unlock(&_mutex);
+            strbuf_free(buffer);
+            return NULL;
+        }
+    }
+    int tracked = _objectCount;
+    int i;
+    for (i = 0; i < tracked; i++)
+    {
+        sorted[i] = &(_entries[i]);
+    }
+    if (tracked > 1)
+    {
+        qsort(sorted, tracked, sizeof(Object_Entry*), &compareEntries);
+    }
+    if (count > tracked)
+    {
+        count = tracked;
+    }
+
+    char line[LINE_SIZE];
+    int error = strbuf_append(buffer, "<obj href=\"");
+    error += strbuf_appendXml(buffer, href);
+    error += strbuf_append(buffer, "\" displayName=\"Most Used Objects\">\r\n");
+    sprintf(line, "  <int name=\"sampleRate\" val=\"%d\"/>\r\n"
+            "  <int name=\"tracked\" val=\"%d\"/>\r\n", _sampleRate, tracked);
+    error += strbuf_append(buffer, line);
+    error += strbuf_append(buffer, "  <obj name=\"untracked\">\r\n");
+    error += appendCounters(buffer, "    ", _untracked);
+    error += strbuf_append(buffer, "  </obj>\r\n"
+                           "  <list name=\"top\" of=\"obix:obj\">\r\n");
+
+    for (i = 0; (i < count) && (error == 0); i++)
+    {
+        error += strbuf_append(buffer, "    <obj>\r\n"
+                               "      <uri name=\"uri\" val=\"");
+        error += strbuf_appendXml(buffer, sorted[i]->uri);
+        error += strbuf_append(buffer, "\"/>\r\n");
+        error += appendCounters(buffer, "      ", sorted[i]->counters);
+        sprintf(line, "      <int name=\"error\" val=\"%ld\"/>\r\n",
+                sorted[i]->error);
+        error += strbuf_append(buffer, line);
+        error += strbuf_append(buffer, "    </obj>\r\n");
+    }
+    pthread_mutex_unlock(&_mutex);
+    free(sorted);
+
+    error += strbuf_append(buffer, "  </list>\r\n</obj>\r\n");
+    if (error != 0)
+    {
+        strbuf_free(buffer);
+        return NULL;
+    }
+    return strbuf_release(buffer);
+}
+
+void obixObjectStats_reset()
+{
+    pthread_mutex_lock(&_mutex);
+    int i;
+    for (i = 0; i < _objectCount; i++)
+    {
+        free(_entries[i].uri);
+    }
+    free(_entries);
+    free(_table);
+    free(_heap);
+    _entries = NULL;
+    _table = NULL;
+    _heap = NULL;
+    _capacity = 0;
+    _entryCount = 0;
+    _objectCount = 0;
+    memset(_untracked, 0, sizeof(_untracked));
+    pthread_mutex_unlock(&_mutex);
+}
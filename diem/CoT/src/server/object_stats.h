@@ -0,0 +1,114 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Defines statistics of the most used objects of the server.
+ *
+ * For every object the server counts reads, writes, Watch notifications and
+ * the size of generated responses. The counters are sampled: only randomly
+ * chosen events (one of #OBJECT_STATS_SAMPLE_RATE_DEFAULT on average) are
+ * counted, each with the weight of the sampling rate. Events which are not
+ * chosen cost only one random number, so statistics can stay enabled under
+ * full load, and the most used objects still get accurate estimates.
+ *
+ * Objects are identified by the URI used in requests. At most
+ * #OBJECT_STATS_MAX_OBJECTS_DEFAULT objects are tracked. When a new object
+ * comes and all of them are used, the least active tracked object is
+ * replaced (Space-Saving algorithm): its counters are moved to a separate
+ * 'untracked' entry, and its activity becomes the @a error of the new
+ * object, because the new object could be active before it was tracked.
+ * Thus objects which are really hot stay tracked, while rarely used ones
+ * replace each other. Top objects are sorted by events counted since they
+ * are tracked; the error tells how much the activity could be higher.
+ *
+ * Report of the top objects is available at @a /obix-metrics/objects URI;
+ * the number of reported objects is set by @a limit query parameter.
+ * Sampling is configured by optional tags of the server configuration:
+ * @code
+ * <object-stats-sample val="16"/>
+ * <object-stats-max val="10000"/>
+ * @endcode
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef OBJECT_STATS_H_
+#define OBJECT_STATS_H_
+
+/** Default sampling rate. */
+#define OBJECT_STATS_SAMPLE_RATE_DEFAULT 16
+/** Default maximum number of tracked objects. */
+#define OBJECT_STATS_MAX_OBJECTS_DEFAULT 10000
+/** Default number of objects in the report. */
+#define OBJECT_STATS_TOP_DEFAULT 20
+
+/** Counted events of an object. */
+typedef enum
+{
+    /** Object is read by GET or Batch. */
+    OBJECT_STATS_READS,
+    /** Object is written by PUT or Batch. */
+    OBJECT_STATS_WRITES,
+    /** Updated object is sent to a Watch. */
+    OBJECT_STATS_NOTIFICATIONS,
+    /** Size of generated responses with the object. */
+    OBJECT_STATS_BYTES,
+    /** Number of elements in this enumeration. */
+    OBJECT_STATS_COUNT
+} Object_Stats_Counter;
+
+/**
+ * Sets sampling rate: one of @a rate events is counted on average.
+ * @a 1 counts all events, @a 0 disables statistics.
+ */
+void obixObjectStats_setSampleRate(int rate);
+
+/**
+ * Sets maximum number of tracked objects. Is applied after statistics are
+ * reset.
+ */
+void obixObjectStats_setMaxObjects(int count);
+
+/**
+ * Counts event of the object.
+ * @param value Increment of the counter: @a 1 for events, size for
+ *              #OBJECT_STATS_BYTES.
+ */
+void obixObjectStats_count(const char* uri,
+                           Object_Stats_Counter counter,
+                           long value);
+
+/**
+ * Generates oBIX object with counters of the most used objects, sorted by
+ * the total number of reads, writes and notifications counted since the
+ * objects are tracked.
+ *
+ * @param href URI of the generated object.
+ * @param count Maximum number of reported objects.
+ * @return Text of the object, which should be freed by the caller, or
+ *         @a NULL if there is not enough memory.
+ */
+char* obixObjectStats_toObix(const char* href, int count);
+
+/** Forgets all tracked objects and releases their memory. */
+void obixObjectStats_reset();
+
+#endif /* OBJECT_STATS_H_ */
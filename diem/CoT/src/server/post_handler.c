@@ -36,6 +36,8 @@
  * - @a Watch.pollRefresh	Returns all objects from the watch list.
  * - @a Watch.delete		Deletes the Watch object.
  * - @a signUp*				Adds new device data to the server.
+ * - @a unregister*			Removes device data from the server.
+ * - @a signUpDevices*		Adds data of several devices at once.
  * - @a Batch				Combines several requests to oBIX server.
  *
  * Commands marked with *, are extensions, which are not included to the
@@ -48,8 +50,12 @@
 #include <string.h>
 #include <log_utils.h>
 #include <obix_utils.h>
+#include <probes.h>
+#include <obix_binary.h>
 #include "xml_storage.h"
 #include "watch.h"
+#include "continuation.h"
+#include "object_stats.h"
 #include "server.h"
 #include "post_handler.h"
 
@@ -60,11 +66,13 @@
 #define WATCH_OUT_POSTFIX "\r\n  </list>\r\n</obj>\r\n"
 /** @} */
 
-/** @name Constants for quick oBIX BatchOut object generation.
- * @{ */
-#define BATCH_OUT_PREFIX "<list is=\"obix:BatchOut\" of=\"obix:obj\">\r\n"
-#define BATCH_OUT_POSTFIX "\r\n</list>\r\n"
-/** @} */
+/** Binary encoded WatchOut footer: closes the list and the object. */
+static const char WATCH_OUT_POSTFIX_BINARY[] =
+    {OBIX_BINARY_END, OBIX_BINARY_END};
+
+/** Maximum number of devices which can be registered with one
+ * signUpDevices request. */
+#define SIGN_UP_DEVICES_MAX 1024
 
 // handler definitions. See their description near implementation.
 void handlerError(Response* response,
@@ -103,6 +111,12 @@ void handlerWatchOperationResponse(Response* response,
 void handlerRemoteOperation(Response* response,
                             const char* uri,
                             IXML_Element* input);
+void handlerUnregister(Response* response,
+                       const char* uri,
+                       IXML_Element* input);
+void handlerSignUpDevices(Response* response,
+                          const char* uri,
+                          IXML_Element* input);
 
 /** Array of all available post handlers. */
 static const obix_server_postHandler POST_HANDLER[] =
@@ -118,12 +132,34 @@ static const obix_server_postHandler POST_HANDLER[] =
         &handlerBatch,					//8  Batch
         &handlerWatchAddOperation,  	//9  Watch.addOperation
         &handlerWatchOperationResponse,	//10 Watch.operationResponse
-        &handlerRemoteOperation			//11 Handler of operations, which are
+        &handlerRemoteOperation,		//11 Handler of operations, which are
         //   added by someone to Watch
+        &handlerUnregister,				//12 unregister
+        &handlerSignUpDevices			//13 signUpDevices
     };
 
 /** Amount of available post handlers. */
-static const int POST_HANDLERS_COUNT = 12;
+static const int POST_HANDLERS_COUNT = 14;
+
+/** Names of the operations, which are executed by post handlers. Indexes are
+ * the same as in #POST_HANDLER. */
+static const char* POST_HANDLER_NAME[] =
+    {
+        "error",
+        "watchService.make",
+        "Watch.add",
+        "Watch.remove",
+        "Watch.pollChanges",
+        "Watch.pollRefresh",
+        "Watch.delete",
+        "signUp",
+        "Batch",
+        "Watch.addOperation",
+        "Watch.operationResponse",
+        "remoteOperation",
+        "unregister",
+        "signUpDevices"
+    };
 
 obix_server_postHandler obix_server_getPostHandler(int id)
 {
@@ -137,6 +173,16 @@ obix_server_postHandler obix_server_getPostHandler(int id)
     }
 }
 
+const char* obix_server_getPostHandlerName(int id)
+{
+    if ((id < 0) || (id >= POST_HANDLERS_COUNT))
+    {
+        return NULL;
+    }
+
+    return POST_HANDLER_NAME[id];
+}
+
 /**
  * Default handler, which sends error message telling that this operation
  * is not supported.
@@ -364,6 +410,52 @@ static Response* addResponsePart(Response* respHead,
     return newPart;
 }
 
+/**
+ * Sets WatchOut header as the body of the response. Binary responses get it
+ * already encoded, so that it is not converted from XML when sent.
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+static int setWatchOutPrefix(Response* response)
+{
+    if (!response->binary)
+    {
+        return obixResponse_setStaticText(response, WATCH_OUT_PREFIX);
+    }
+
+    String_Buffer* buffer = strbuf_create(64);
+    if (buffer == NULL)
+    {
+        return -1;
+    }
+    int error = obixBinary_appendTag(buffer, OBIX_OBJ);
+    error += obixBinary_appendAttr(buffer, OBIX_ATTR_IS, "obix:WatchOut");
+    error += obixBinary_appendEnd(buffer);
+    error += obixBinary_appendTag(buffer, OBIX_OBJ_LIST);
+    error += obixBinary_appendAttr(buffer, OBIX_ATTR_NAME, "values");
+    error += obixBinary_appendAttr(buffer, OBIX_ATTR_OF, "obix:obj");
+    error += obixBinary_appendEnd(buffer);
+    if (error != 0)
+    {
+        strbuf_free(buffer);
+        return -1;
+    }
+
+    int length = buffer->length;
+    return obixResponse_setBinary(response, strbuf_release(buffer), length);
+}
+
+/** Sets WatchOut footer as the body of the response. */
+static int setWatchOutPostfix(Response* response)
+{
+    if (!response->binary)
+    {
+        return obixResponse_setStaticText(response, WATCH_OUT_POSTFIX);
+    }
+    return obixResponse_setStaticBinary(response,
+                                        WATCH_OUT_POSTFIX_BINARY,
+                                        sizeof(WATCH_OUT_POSTFIX_BINARY));
+}
+
 static void watchAddHelper(Response* response,
                            const char* uri,
                            IXML_Element* input,
@@ -388,7 +480,12 @@ static void watchAddHelper(Response* response,
     obixWatch_resetLeaseTimer(watch);
 
     // prepare response header
-    obixResponse_setText(response, WATCH_OUT_PREFIX, TRUE);
+    if (setWatchOutPrefix(response) != 0)
+    {
+        sendErrorMessage(response, uri, operationName,
+                         "Internal server error.");
+        return;
+    }
 
     // iterate through all URIs which should be added to the watch
     const char** uriSet = NULL;
@@ -516,7 +613,7 @@ static void watchAddHelper(Response* response,
     {   // error message is already sent
         return;
     }
-    obixResponse_setText(rItem, WATCH_OUT_POSTFIX, TRUE);
+    setWatchOutPostfix(rItem);
     obixResponse_send(response);
 }
 
@@ -583,38 +680,30 @@ void handlerWatchOperationResponse(Response* response,
     // remove name attribute (ignore error, if any - it is logged)
     ixmlElement_removeAttributeWithLog(remoteOperationOutput, OBIX_ATTR_NAME);
 
-    // get saved response object of the original remote operation call
-    Response* remoteOperationResponse =
-        obixWatchItem_getSavedRemoteOperationResponse(remoteOperationUri);
-    if (remoteOperationResponse == NULL)
+    // send output to the client, who has invoked the operation
+    char* textResponse =
+        ixmlPrintNode(ixmlElement_getNode(remoteOperationOutput));
+    if (textResponse == NULL)
     {
         sendErrorMessage(response,
                          uri,
                          "Watch.operationResponse",
-                         "The operation with provided URI was not invoked (or "
-                         "is already handled).");
+                         "Internal Server Error. Operation results were not "
+                         "sent to the client.");
         return;
     }
 
-    // send input as a response of the remote operation
-    char* textResponse =
-        ixmlPrintNode(ixmlElement_getNode(remoteOperationOutput));
-    if (textResponse == NULL)
+    if (obixContinuation_complete(remoteOperationUri, textResponse) != 0)
     {
         sendErrorMessage(response,
                          uri,
                          "Watch.operationResponse",
-                         "Internal Server Error. Operation results were not "
-                         "sent to the client.");
-        // save remote operation response back: may be user will try once again
-        obixWatchItem_saveRemoteOperationResponse(remoteOperationUri,
-                remoteOperationResponse);
+                         "The operation with provided URI was not invoked (or "
+                         "is already handled).");
         return;
     }
-    obixResponse_setText(remoteOperationResponse, textResponse, FALSE);
-    obixResponse_send(remoteOperationResponse);
     // send answer to the client who invoked this operation
-    obixResponse_setText(response, OBIX_OBJ_NULL_TEMPLATE, TRUE);
+    obixResponse_setStaticText(response, OBIX_OBJ_NULL_TEMPLATE);
     obixResponse_send(response);
 }
 
@@ -685,7 +774,7 @@ void handlerWatchRemove(Response* response,
     free(uriSet);
 
     // return empty answer
-    obixResponse_setText(response, OBIX_OBJ_NULL_TEMPLATE, TRUE);
+    obixResponse_setStaticText(response, OBIX_OBJ_NULL_TEMPLATE);
     obixResponse_send(response);
 }
 
@@ -704,7 +793,7 @@ static void completeWatchPollResponse(const char* operationName,
     {   // error message is already sent
         return;
     }
-    obixResponse_setText(respTail, WATCH_OUT_POSTFIX, TRUE);
+    setWatchOutPostfix(respTail);
 
     // send response
     obixResponse_send(respHead);
@@ -745,6 +834,12 @@ static Response* generateWatchOutBody(const char* operationName,
                                          watchItem->uri,
                                          0,
                                          FALSE);
+            if (changedOnly)
+            {
+                obixObjectStats_count(watchItem->uri,
+                                      OBJECT_STATS_NOTIFICATIONS, 1);
+                OBIX_PROBE2(watch__notify, watch->id, watchItem->uri);
+            }
 
             if (watchItem->isOperation && (watchItem->input != NULL))
             {
@@ -802,6 +897,7 @@ void handlerWatchLongPoll(oBIX_Watch* watch,
         //complete response
         completeWatchPollResponse("Watch.pollChanges", response, respTail, uri);
     }
+    OBIX_PROBE2(longpoll__complete, watch->id, uri);
 }
 
 /**
@@ -831,7 +927,12 @@ static void handlerWatchPollHelper(Response* response,
     obixWatch_resetLeaseTimer(watch);
 
     // prepare response header
-    obixResponse_setText(response, WATCH_OUT_PREFIX, TRUE);
+    if (setWatchOutPrefix(response) != 0)
+    {
+        sendErrorMessage(response, uri, operationName,
+                         "Internal server error.");
+        return;
+    }
 
     //iterate through all watch items and generate response
     Response* respTail = generateWatchOutBody(
@@ -968,7 +1069,7 @@ void handlerWatchDelete(Response* response,
     case 0:
         {	// everything was OK
             // return empty object
-            obixResponse_setText(response, OBIX_OBJ_NULL_TEMPLATE, TRUE);
+            obixResponse_setStaticText(response, OBIX_OBJ_NULL_TEMPLATE);
             obixResponse_send(response);
         }
         break;
@@ -1004,45 +1105,41 @@ void handlerSignUp(Response* response, const char* uri, IXML_Element* input)
         return;
     }
 
-    int error = xmldb_putDOM(input);
+    int error = obix_server_signUp(input);
     const char* href = ixmlElement_getAttribute(input, OBIX_ATTR_HREF);
-    if (error != 0)
-    {
-        // TODO return different description of different errors
-        if (error == -2)
-        {
-            // it means that object with the same URI already exists in the
-            // database. return specific error
-            sendErrorMessage(response,
-                             href,
-                             "Sign Up",
-                             "Unable to save device data: "
-                             "Object with the same URI already exists.");
-            return;
-        }
-        else
-        {
-            sendErrorMessage(response,
-                             uri,
-                             "Sign Up",
-                             "Unable to save device data.");
-            return;
-        }
-    }
-
-    // add reference to the new device
-    error = xmldb_putDeviceReference(input);
-    if (error != 0)
+    switch (error)
     {
-        xmldb_delete(href);
+    case 0:
+        break;
+    case -2:
+        // object with the same URI already exists in the database. return
+        // specific error
+        sendErrorMessage(response,
+                         href,
+                         "Sign Up",
+                         "Unable to save device data: "
+                         "Object with the same URI already exists.");
+        return;
+    case -3:
+        sendErrorMessage(response, uri, "Sign Up",
+                         "Unable to save device data: "
+                         "Device exceeds memory limits of the server.");
+        return;
+    case -4:
         sendErrorMessage(response,
                          uri,
                          "Sign Up",
                          "Unable to add device to the device list.");
         return;
+    case -1:
+    default:
+        sendErrorMessage(response,
+                         uri,
+                         "Sign Up",
+                         "Unable to save device data.");
+        return;
     }
 
-    log_debug("New object is successfully registered at \"%s\"", href);
     // return saved object
     obix_server_generateResponse(response,
                                  input,
@@ -1053,8 +1150,8 @@ void handlerSignUp(Response* response, const char* uri, IXML_Element* input)
     if (obixResponse_isError(response))
     {
         // we return error, thus we need to roll back all changes
+        xmldb_deleteDeviceReference(href);
         xmldb_delete(href);
-        // TODO delete also record from device list
     }
 
     // send response
@@ -1062,177 +1159,267 @@ void handlerSignUp(Response* response, const char* uri, IXML_Element* input)
 }
 
 /**
- * Handles Batch operation.
+ * Adds result of a device registration to the output of signUpDevices
+ * operation: a reference to the stored device, or an error object.
+ * @return @a 0 on success, @a -1 on error.
+ */
+static int addSignUpResult(IXML_Element* output,
+                           IXML_Element* device,
+                           int result)
+{
+    IXML_Element* item = ixmlElement_createChildElementWithLog(
+                             output,
+                             (result == 0) ? OBIX_OBJ_REF : OBIX_OBJ_ERR);
+    if (item == NULL)
+    {
+        return -1;
+    }
+
+    // for errors href shows which device failed (or which object already
+    // exists)
+    int error = ixmlElement_copyAttributeWithLog(device, item,
+                OBIX_ATTR_HREF, FALSE);
+    if ((error != IXML_SUCCESS) && (error != IXML_NOT_FOUND_ERR))
+    {
+        return -1;
+    }
+
+    const char* message;
+    switch (result)
+    {
+    case 0:
+        return 0;
+    case -1:
+        message = "Device data is corrupted.";
+        break;
+    case -2:
+        message = "Object with the same URI already exists.";
+        break;
+    case -4:
+        message = "Device exceeds memory limits of the server.";
+        break;
+    default:
+        message = "Unable to save device data.";
+        break;
+    }
+
+    return ixmlElement_setAttributeWithLog(item, OBIX_ATTR_DISPLAY, message);
+}
+
+/**
+ * Handles signUpDevices operation. Adds data of several devices to the
+ * server. Input is a list of device objects; output is a list with a
+ * reference to each stored device, or an error object for each device which
+ * failed, in the same order.
  *
  * @see obix_server_postHandler
  */
-void handlerBatch(Response* response,
-                  const char* uri,
-                  IXML_Element* input)
+void handlerSignUpDevices(Response* response,
+                          const char* uri,
+                          IXML_Element* input)
 {
-    // check input
     if (input == NULL)
     {
-        sendErrorMessage(response, uri, "Batch",
-                         "Input is empty or broken.");
+        sendErrorMessage(response, uri, "Sign Up Devices",
+                         "Device data is corrupted.");
         return;
     }
 
-    // prepare response
-    obixResponse_setText(response, BATCH_OUT_PREFIX, TRUE);
-    Response* rItem = addResponsePart(response, response, uri, "Batch");
-    if (rItem == NULL)
-    {   // error message is already sent
-        return;
-    }
-
-    // iterate through the list of commands
+    // count device objects
+    int count = 0;
     IXML_Node* node = ixmlNode_getFirstChild(ixmlElement_getNode(input));
-
-    while (node != NULL)
+    for ( ; node != NULL; node = ixmlNode_getNextSibling(node))
     {
-        IXML_Element* command = ixmlNode_convertToElement(node);
-        if (command == NULL)
+        if (ixmlNode_convertToElement(node) != NULL)
         {
-            // this is not a tag, go to the next node in batch command
-            node = ixmlNode_getNextSibling(node);
-            continue;
+            count++;
         }
+    }
 
-        // get uri of the command
-        const char* commandUri = ixmlElement_getAttribute(command,
-                                 OBIX_ATTR_VAL);
-        if (commandUri == NULL)
-        {
-            // this is some error in the user command, because there should be
-            // always some uri
-            sendErrorMessage(response, uri, "Batch",
-                             "Input contains illegal tag(s).");
-            return;
-        }
+    if (count > SIGN_UP_DEVICES_MAX)
+    {
+        log_warning("Unable to sign up %d devices at once: the limit is %d.",
+                    count, SIGN_UP_DEVICES_MAX);
+        sendErrorMessage(response, uri, "Sign Up Devices",
+                         "Too many devices in one request.");
+        return;
+    }
 
-        // find out type of command (read, write or invoke)
-        if (obix_obj_implementsContract(command, "Read"))
-        {
-            obix_server_read(rItem, commandUri);
+    int* results = (int*) malloc((count + 1) * sizeof(int));
+    if (results == NULL)
+    {
+        log_error("Unable to sign up devices: Not enough memory.");
+        sendErrorMessage(response, uri, "Sign Up Devices",
+                         "Internal server error.");
+        return;
+    }
 
-        }
-        else if (obix_obj_implementsContract(command, "Write"))
-        {
-            obix_server_write(rItem,
-                              commandUri,
-                              ixmlNode_convertToElement(
-                                  ixmlNode_getFirstChild(node)));
-        }
-        else if (obix_obj_implementsContract(command, "Invoke"))
-        {
-            obix_server_invoke(rItem,
-                               commandUri,
-                               ixmlNode_convertToElement(
-                                   ixmlNode_getFirstChild(node)));
-        }
-        else
-        {
-            // unknown tag
-            sendErrorMessage(response, uri, "Batch",
-                             "Input contains illegal tag(s).");
-            return;
-        }
+    int stored = xmldb_putDevices(input, results, count);
+    if (stored < 0)
+    {
+        free(results);
+        sendErrorMessage(response, uri, "Sign Up Devices",
+                         "Unable to add devices to the device list.");
+        return;
+    }
+    log_debug("%d of %d devices are successfully registered.", stored, count);
+
+    IXML_Element* output;
+    if (obix_obj_create(OBIX_OBJ_LIST, uri, NULL, NULL, NULL, &output) != 0)
+    {
+        free(results);
+        sendErrorMessage(response, uri, "Sign Up Devices",
+                         "Internal server error.");
+        return;
+    }
+    ixmlElement_setAttributeWithLog(output, OBIX_ATTR_OF, "obix:obj");
 
-        // the command handler could generate more than one response part, find
-        // current response tail
-        while (rItem->next != NULL)
+    int i = 0;
+    node = ixmlNode_getFirstChild(ixmlElement_getNode(input));
+    for ( ; (node != NULL) && (i < count); node = ixmlNode_getNextSibling(node))
+    {
+        IXML_Element* device = ixmlNode_convertToElement(node);
+        if ((device != NULL)
+                && (addSignUpResult(output, device, results[i++]) != 0))
         {
-            rItem = rItem->next;
-        }
-        // create new response part for the next command response
-        rItem = addResponsePart(response, rItem, uri, "Batch");
-        if (rItem == NULL)
-        {   // error message is already sent
+            free(results);
+            ixmlElement_freeOwnerDocument(output);
+            sendErrorMessage(response, uri, "Sign Up Devices",
+                             "Internal server error.");
             return;
         }
-        node = ixmlNode_getNextSibling(node);
     }
+    free(results);
 
-    // finish and send the response object
-    obixResponse_setText(rItem, BATCH_OUT_POSTFIX, TRUE);
+    obix_server_generateResponse(response, output, uri, 0, TRUE);
+    ixmlElement_freeOwnerDocument(output);
     obixResponse_send(response);
 }
 
-void handlerRemoteOperation(Response* response,
-                            const char* uri,
-                            IXML_Element* input)
+/**
+ * Handles unregister operation. Removes device data, which was added with
+ * signUp operation, from the server. Input is an @a <uri/> object with the
+ * address of the device data.
+ *
+ * @see obix_server_postHandler
+ */
+void handlerUnregister(Response* response,
+                       const char* uri,
+                       IXML_Element* input)
 {
-    log_debug("Handling remote operation \"%s\".", uri);
-
-    if (!obixResponse_canWait(response))
+    const char* deviceUri = (input == NULL) ? NULL :
+                            ixmlElement_getAttribute(input, OBIX_ATTR_VAL);
+    if (deviceUri == NULL)
     {
-        log_warning("Operation \"%s\" is called, but response object cannot be"
-                    "used for waiting of remote operation execution.", uri);
-        sendErrorMessage(response, uri, "Remote Operation Invocation",
-                         "Unable to hold the request for remote operation "
-                         "processing: Check that you are not trying to call "
-                         "remote operation from Batch request. If not, than "
-                         "maximum number of requests on hold is reached: "
-                         "Ask administrator to increase "
-                         "hold-request-max parameter in server settings.");
+        sendErrorMessage(response, uri, "Unregister",
+                         "Input should contain URI of the device.");
         return;
     }
 
-    // check that there is some input
+    int error = obix_server_unregisterDevice(deviceUri);
+    switch (error)
+    {
+    case 0:
+        obixResponse_setStaticText(response, OBIX_OBJ_NULL_TEMPLATE);
+        obixResponse_send(response);
+        break;
+    case -1:
+        sendErrorMessage(response, uri, "Unregister",
+                         "Device URI is not found.");
+        break;
+    case -2:
+        sendErrorMessage(response, uri, "Unregister",
+                         "Object is not a registered device.");
+        break;
+    case -3:
+    default:
+        sendErrorMessage(response, uri, "Unregister",
+                         "Internal server error.");
+        break;
+    }
+}
+
+/**
+ * Handles Batch operation.
+ *
+ * @see obix_server_postHandler
+ */
+void handlerBatch(Response* response,
+                  const char* uri,
+                  IXML_Element* input)
+{
+    // check input
     if (input == NULL)
     {
-        log_warning("Operation \"%s\" is called with no input at all. At least "
-                    "Null object is expected.", uri);
-        sendErrorMessage(response, uri, "Remote Operation Invocation",
-                         "Operation can not be invoked without any arguments. "
-                         "At least Null object is expected.");
+        sendErrorMessage(response, uri, "Batch",
+                         "Input is empty or broken.");
         return;
     }
 
-    // find watch item address from meta variable
-    int slashFlag = 0;
-    IXML_Element* operation = xmldb_getDOM(uri, &slashFlag);
-    if (operation == NULL)
+    switch (obix_server_batch(response, input))
     {
-        // it can never happen, because the object was already retrieved earlier
-        log_error("Unable to get object with URI \"%s\". But it should be "
-                  "there! It was definitely retrieved earlier!", uri);
-        sendErrorMessage(response, uri, "Remote Operation Invocation",
+    case 0:
+        obixResponse_send(response);
+        break;
+    case -1:
+        sendErrorMessage(response, uri, "Batch",
+                         "Input contains illegal tag(s).");
+        break;
+    default:
+        sendErrorMessage(response, uri, "Batch",
                          "Internal server error.");
-        return;
+        break;
     }
+}
 
-    const char* watchItemAddress =
-        xmldb_getMetaVariableValue(operation, OBIX_META_VAR_WATCHITEM_P);
-    if (watchItemAddress == NULL)
+void handlerRemoteOperation(Response* response,
+                            const char* uri,
+                            IXML_Element* input)
+{
+    log_debug("Handling remote operation \"%s\".", uri);
+
+    // check that there is some input
+    if (input == NULL)
     {
-        log_error("Unable to find watch item meta variable at URI \"%s\".",
-                  uri);
+        log_warning("Operation \"%s\" is called with no input at all. At least "
+                    "Null object is expected.", uri);
         sendErrorMessage(response, uri, "Remote Operation Invocation",
-                         "Internal server error.");
+                         "Operation can not be invoked without any arguments. "
+                         "At least Null object is expected.");
         return;
     }
 
-    // parse watch item address
-    oBIX_Watch_Item* watchItem = (oBIX_Watch_Item*) atoi(watchItemAddress);
-
-    // update watch item: save operation's input parameters
-    if (watchItem->input != NULL)
+    if (!obixResponse_canHold(response))
     {
-        log_warning("WatchItem input field is not empty when someone tries to "
-                    "invoke watched operation. Probably last request is not "
-                    "yet processed (URI \"%s\").", uri);
+        log_warning("Remote operation \"%s\" is invoked without a request "
+                    "object, which could wait for results.", uri);
         sendErrorMessage(response, uri, "Remote Operation Invocation",
-                         "Previous request is not completed.");
+                         "Remote operations can't be invoked locally.");
         return;
     }
 
-    int error =
-        obixWatchItem_saveOperationInvocation(watchItem, uri, response, input);
-    if (error != 0)
+    // response is parked until the subscriber sends results, so that it
+    // doesn't occupy the request handler
+    switch (obixContinuation_add(response, uri, input))
     {
+    case 0:
+        // the response is sent as soon as results are received
+        obixResponse_send(response);
+        break;
+    case -1:
+        sendErrorMessage(response, uri, "Remote Operation Invocation",
+                         "Nobody is subscribed for the operation.");
+        break;
+    case -2:
+        sendErrorMessage(response, uri, "Remote Operation Invocation",
+                         "Maximum number of pending remote operation "
+                         "invocations is reached: Ask administrator to "
+                         "increase remote-call-max parameter in server "
+                         "settings.");
+        break;
+    default:
         sendErrorMessage(response, uri, "Remote Operation Invocation",
                          "Internal server error.");
+        break;
     }
 }
@@ -56,4 +56,11 @@ typedef void (*obix_server_postHandler)(Response* response,
  */
 obix_server_postHandler obix_server_getPostHandler(int id);
 
+/**
+ * Returns name of the operation, which is executed by the handler with
+ * specified id (e.g. "Watch.pollChanges").
+ * @return Name of the handler, or @a NULL if there is no handler with such id.
+ */
+const char* obix_server_getPostHandlerName(int id);
+
 #endif /* POST_HANDLER_H_ */
@@ -30,8 +30,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include <pthread.h>
 #include <log_utils.h>
+#include <obix_binary.h>
+#include "metrics.h"
 #include "request.h"
 
 /** @name FastCGI connection constants
@@ -41,10 +44,27 @@
 #define LISTENSOCK_FLAGS 0
 /** @} */
 
+/** @name Query parameters which limit size of the response
+ * @{ */
+static const char* QUERY_DEPTH = "depth";
+static const char* QUERY_OFFSET = "offset";
+static const char* QUERY_LIMIT = "limit";
+/** @} */
+
+/** Input buffers bigger than this size are freed when the request is
+ * released, so that a single big request doesn't keep its memory for the
+ * whole life of the server. */
+#define INPUT_BUFFER_KEEP_MAX (64 * 1024)
+
+/** Server address of requests, which come not through FastCGI. */
+static char _localServerAddress[] = "";
+
 /** Storage for request objects. */
 static Request* _requestList;
 /** Number of request objects which are currently use for request processing. */
 static int _requestsInUse = 0;
+/** Number of created request objects, including detached ones. */
+static int _requestCount = 0;
 /** Is used for unique request id generation. */
 static int _requestIds = 0;
 /** Defines maximum request objects, which can be created.
@@ -61,6 +81,15 @@ pthread_mutex_t _requestListMutex = PTHREAD_MUTEX_INITIALIZER;
  * and thus is returned back to the request list. */
 pthread_cond_t _requestListNew = PTHREAD_COND_INITIALIZER;
 
+/** Resets response limits of the request to default (unlimited) values. */
+static void resetQuery(Request* request)
+{
+    request->query = NULL;
+    request->depth = -1;
+    request->offset = 0;
+    request->limit = -1;
+}
+
 /** Returns head element from request list.
  * Should be called from synchronized context only. */
 static Request* obixRequest_getHead()
@@ -79,6 +108,7 @@ static Request* obixRequest_getHead()
     {
         request->canWait = TRUE;
     }
+    obixMetrics_set(METRICS_REQUESTS_IN_USE, _requestsInUse);
     return request;
 }
 
@@ -115,14 +145,34 @@ static int obixRequest_create()
     }
 
     request->serverAddress = NULL;
+    request->binaryResponse = FALSE;
+    request->ifNoneMatch = NULL;
+    resetQuery(request);
+    request->input = NULL;
+    request->inputSize = 0;
+    request->responseListener = NULL;
+    request->detached = FALSE;
 
     // store request at head
     request->next = _requestList;
     request->id = _requestIds++;
     _requestList = request;
+    _requestCount++;
+    obixMetrics_set(METRICS_REQUESTS_CREATED, _requestCount);
     return 0;
 }
 
+/** Deletes single request object. */
+static void obixRequest_free(Request* request)
+{
+    FCGX_Free(&(request->r), TRUE);
+    if (request->input != NULL)
+    {
+        free(request->input);
+    }
+    free(request);
+}
+
 /** Deletes recursively list of request objects. */
 static void obixRequest_freeRecursive(Request* request)
 {
@@ -135,8 +185,7 @@ static void obixRequest_freeRecursive(Request* request)
     obixRequest_freeRecursive(request->next);
 
     // clear this request
-    FCGX_Free(&(request->r), TRUE);
-    free(request);
+    obixRequest_free(request);
 }
 
 // put request to the head of the list
@@ -147,14 +196,53 @@ void obixRequest_release(Request* request)
         free(request->serverAddress);
         request->serverAddress = NULL;
     }
+    if (request->inputSize > INPUT_BUFFER_KEEP_MAX)
+    {
+        free(request->input);
+        request->input = NULL;
+        request->inputSize = 0;
+    }
     pthread_mutex_lock(&_requestListMutex);
+    if (request->detached)
+    {
+        // detached request is not counted as used already
+        request->detached = FALSE;
+        if (_requestCount > _requestMaxCount)
+        {
+            // it was replaced by a new object while waiting
+            _requestCount--;
+            obixMetrics_set(METRICS_REQUESTS_CREATED, _requestCount);
+            pthread_mutex_unlock(&_requestListMutex);
+            obixRequest_free(request);
+            return;
+        }
+    }
+    else
+    {
+        _requestsInUse--;
+        obixMetrics_set(METRICS_REQUESTS_IN_USE, _requestsInUse);
+    }
     request->next = _requestList;
     _requestList = request;
-    _requestsInUse--;
     pthread_cond_signal(&_requestListNew);
     pthread_mutex_unlock(&_requestListMutex);
 }
 
+void obixRequest_detach(Request* request)
+{
+    if ((request->id < 0) || request->detached)
+    {
+        // local requests are not taken from the list
+        return;
+    }
+
+    pthread_mutex_lock(&_requestListMutex);
+    request->detached = TRUE;
+    _requestsInUse--;
+    obixMetrics_set(METRICS_REQUESTS_IN_USE, _requestsInUse);
+    pthread_mutex_unlock(&_requestListMutex);
+}
+
 Request* obixRequest_get()
 {
     Request* request;
@@ -248,10 +336,77 @@ static int obixRequest_parseServerAddress(Request* request)
     return 0;
 }
 
+/**
+ * Parses value of a numeric query parameter.
+ * @return Parsed value, or @a -1 if the value is not a non-negative number.
+ */
+static int parseQueryValue(const char* name, const char* value, int length)
+{
+    char* end;
+    long result = strtol(value, &end, 10);
+    if ((length == 0) || (end != value + length)
+            || (result < 0) || (result > INT_MAX))
+    {
+        log_warning("Wrong value of query parameter \"%s\" is ignored: "
+                    "\"%.*s\".", name, length, value);
+        return -1;
+    }
+
+    return (int) result;
+}
+
+/**
+ * Parses query parameters which limit size of the response.
+ * Unknown parameters are ignored.
+ *
+ * @param query Query string (part of the URI after '?').
+ */
+static void parseQuery(Request* request, const char* query)
+{
+    while (*query != '\0')
+    {
+        const char* end = strchr(query, '&');
+        if (end == NULL)
+        {
+            end = query + strlen(query);
+        }
+
+        const char* value = memchr(query, '=', end - query);
+        if (value != NULL)
+        {
+            int nameLength = value - query;
+            value++;
+            int length = end - value;
+
+            if ((nameLength == strlen(QUERY_DEPTH))
+                    && (strncmp(query, QUERY_DEPTH, nameLength) == 0))
+            {
+                request->depth = parseQueryValue(QUERY_DEPTH, value, length);
+            }
+            else if ((nameLength == strlen(QUERY_OFFSET))
+                     && (strncmp(query, QUERY_OFFSET, nameLength) == 0))
+            {
+                request->offset = parseQueryValue(QUERY_OFFSET, value, length);
+                if (request->offset < 0)
+                {
+                    request->offset = 0;
+                }
+            }
+            else if ((nameLength == strlen(QUERY_LIMIT))
+                     && (strncmp(query, QUERY_LIMIT, nameLength) == 0))
+            {
+                request->limit = parseQueryValue(QUERY_LIMIT, value, length);
+            }
+        }
+
+        query = (*end == '&') ? end + 1 : end;
+    }
+}
+
 const char* obixRequest_parseAttributes(Request* request)
 {
     // get request URI
-    const char* uri = FCGX_GetParam("REQUEST_URI", request->r.envp);
+    char* uri = FCGX_GetParam("REQUEST_URI", request->r.envp);
     if (uri == NULL)
     {
         log_error("Unable to retrieve URI from the request.");
@@ -270,9 +425,68 @@ const char* obixRequest_parseAttributes(Request* request)
     	return NULL;
     }
 
+    // cut the query from the URI; the parameter string belongs to this
+    // request, so it can be modified
+    resetQuery(request);
+    char* query = strchr(uri, '?');
+    if (query != NULL)
+    {
+        *query = '\0';
+        request->query = query + 1;
+        parseQuery(request, request->query);
+    }
+
+    // check whether client wants binary encoded response
+    const char* accept = FCGX_GetParam("HTTP_ACCEPT", request->r.envp);
+    request->binaryResponse =
+        ((accept != NULL) && (strstr(accept, OBIX_BINARY_CONTENT_TYPE) != NULL))
+        ? TRUE : FALSE;
+    // entity tag of the object which client already has
+    request->ifNoneMatch = FCGX_GetParam("HTTP_IF_NONE_MATCH", request->r.envp);
+
     return uri;
 }
 
+char* obixRequest_getInputBuffer(Request* request, int size)
+{
+    if (size < request->inputSize)
+    {
+        return request->input;
+    }
+
+    // allocate a bit more to avoid reallocation on slightly bigger inputs
+    int newSize = size + 1 + (size >> 2);
+    char* newInput = (char*) realloc(request->input, newSize);
+    if (newInput == NULL)
+    {
+        log_error("Unable to allocate %d bytes for the request input.", newSize);
+        return NULL;
+    }
+
+    request->input = newInput;
+    request->inputSize = newSize;
+    return newInput;
+}
+
+void obixRequest_initLocal(Request* request,
+                           void (*listener)(struct Response* response))
+{
+    memset(&(request->r), 0, sizeof(FCGX_Request));
+    request->id = -1;
+    // long poll requests block only the client which sent them
+    request->canWait = TRUE;
+    request->serverAddress = _localServerAddress;
+    request->serverAddressLength = 0;
+    request->binaryResponse = FALSE;
+    request->ifNoneMatch = NULL;
+    resetQuery(request);
+    request->input = NULL;
+    request->inputSize = 0;
+    request->responseListener = listener;
+    request->detached = FALSE;
+    request->next = NULL;
+}
+
 void obixRequest_freeAll()
 {
     pthread_mutex_lock(&_requestListMutex);
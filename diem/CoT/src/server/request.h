@@ -34,6 +34,8 @@
 #include <fcgiapp.h>
 #include <bool.h>
 
+struct Response;
+
 /** Default value of maximum amount of request instances in the system. */
 #define REQUEST_MAX_COUNT_DEFAULT 20
 
@@ -52,6 +54,36 @@ typedef struct _Request
     char* serverAddress;
     /** Length of the server address string. */
     int serverAddressLength;
+    /** Tells whether client accepts binary encoded responses
+     * (see obix_binary.h). */
+    BOOL binaryResponse;
+    /** Value of @a If-None-Match header of the request, or @a NULL. */
+    const char* ifNoneMatch;
+    /** Query of the requested URI (without '?'), or @a NULL if there is no
+     * query. It is cut from the URI by #obixRequest_parseAttributes. */
+    const char* query;
+    /** Value of @a depth query parameter: how many levels of child objects
+     * are returned in full, deeper objects are replaced with references.
+     * @a -1 if not limited. */
+    int depth;
+    /** Value of @a offset query parameter: how many child objects of the
+     * requested list are skipped. */
+    int offset;
+    /** Value of @a limit query parameter: maximum number of child objects of
+     * the requested list which are returned. @a -1 if not limited. */
+    int limit;
+    /** Buffer for the request body. It is kept when the request object is
+     * released, so that the memory is reused by next requests. Only big
+     * buffers are freed then. */
+    char* input;
+    /** Size of the allocated input buffer. */
+    int inputSize;
+    /** Function which sends responses to this request. If @a NULL, the
+     * global listener (see #obixResponse_setListener) is used. */
+    void (*responseListener)(struct Response* response);
+    /** Tells whether the request waits for a remote operation result and is
+     * not counted as used anymore (see #obixRequest_detach). */
+    BOOL detached;
 
     /** Next request instance in the list. For internal usage only. */
     struct _Request* next;
@@ -65,6 +97,15 @@ typedef struct _Request
  */
 void obixRequest_release(Request* request);
 
+/**
+ * Stops counting the request as used, while its response is not sent yet.
+ * It is used for requests which wait for results of remote operations:
+ * such requests may stay unanswered for long time, but should not block
+ * the server from handling other requests. Detached request is still
+ * released with #obixRequest_release.
+ */
+void obixRequest_detach(Request* request);
+
 /**
  * Returns free request object.
  * If there are no free objects at the moment, creates a new one.
@@ -75,10 +116,35 @@ Request* obixRequest_get();
 
 /**
  * Parses requested URI and server address.
+ * Query parameters @a depth, @a offset and @a limit are stored in the request
+ * object and the query part is cut from the URI. The query itself stays
+ * available as @a Request.query.
  * @return Requested URI
  */
 const char* obixRequest_parseAttributes(Request* request);
 
+/**
+ * Returns input buffer of the request, which is able to hold at least
+ * @a size bytes plus terminating @a '\0'. The buffer grows when needed and
+ * is reused by next requests, thus its contents are valid only until the
+ * request object is released.
+ * @return Input buffer, or @a NULL if there is not enough memory.
+ */
+char* obixRequest_getInputBuffer(Request* request, int size);
+
+/**
+ * Initializes request object which does not come through FastCGI interface
+ * (e.g. from a local socket). Such objects are not taken from the request
+ * list and should not be released with #obixRequest_release. Server address
+ * of the request is empty, thus all URIs in the response are relative to the
+ * server root.
+ *
+ * @param request Request object to initialize.
+ * @param listener Function which will send response to the request.
+ */
+void obixRequest_initLocal(Request* request,
+                           void (*listener)(struct Response* response));
+
 /**
  * Releases memory allocated for all request objects.
  * Note that it is not possible to delete one request object separately (it
@@ -41,24 +41,161 @@ const char* OBIX_OBJ_ERR_TEMPLATE = "<err displayName=\"Internal Server Error\""
 /** Function which sends server responses to client is stored here. */
 static obix_response_listener _responseListener = NULL;
 
+/** Function which is notified when a response gets held. */
+static obix_response_listener _holdListener = NULL;
+
 void obixResponse_setListener(obix_response_listener listener)
 {
 	_responseListener = listener;
 }
 
-Response* obixResponse_create(Request* request)
+void obixResponse_setHoldListener(obix_response_listener listener)
 {
-    Response* response = (Response*) malloc(sizeof(Response));
-    if (response == NULL)
+    _holdListener = listener;
+}
+
+/** Size of the first arena block, which is enough for most responses. */
+#define ARENA_BLOCK_SIZE 1024
+/** Alignment of the memory allocated from the arena. */
+#define ARENA_ALIGN(size) (((size) + 7) & ~7)
+
+/** Block of the response memory arena. */
+typedef struct Arena_Block
+{
+    struct Arena_Block* next;
+    /** Size of the data. */
+    int size;
+    /** Amount of the used data. */
+    int used;
+    /** Memory of the block. */
+    double data[];
+}
+Arena_Block;
+
+/** Memory arena, which owns all parts of one response message. */
+typedef struct Response_Arena
+{
+    /** The first part of the message. Arena is released with it. */
+    Response* head;
+    /** Block from which memory is currently allocated. Full blocks follow
+     * it in the list. */
+    Arena_Block* blocks;
+}
+Response_Arena;
+
+/** Creates new arena block, which has at least @a size bytes of memory. */
+static Arena_Block* arenaBlock_create(int size)
+{
+    if (size < ARENA_BLOCK_SIZE)
+    {
+        size = ARENA_BLOCK_SIZE;
+    }
+    Arena_Block* block = (Arena_Block*) malloc(sizeof(Arena_Block) + size);
+    if (block == NULL)
     {
         return NULL;
     }
-    // init all values with default values;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+/** Allocates memory from the arena. */
+static void* arena_alloc(Response_Arena* arena, int size)
+{
+    size = ARENA_ALIGN(size);
+    Arena_Block* block = arena->blocks;
+    if ((block->size - block->used) < size)
+    {
+        block = arenaBlock_create(size);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    void* memory = ((char*) block->data) + block->used;
+    block->used += size;
+    return memory;
+}
+
+/** Releases all blocks of the arena. */
+static void arena_free(Response_Arena* arena)
+{
+    Arena_Block* block = arena->blocks;
+    while (block != NULL)
+    {
+        Arena_Block* next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+/** Copies a string to the arena. */
+static char* arena_strdup(Response_Arena* arena, const char* text)
+{
+    int length = strlen(text) + 1;
+    char* copy = (char*) arena_alloc(arena, length);
+    if (copy != NULL)
+    {
+        memcpy(copy, text, length);
+    }
+    return copy;
+}
+
+/** Initializes response part with default values. */
+static void initResponse(Response* response,
+                         Request* request,
+                         Response_Arena* arena)
+{
     response->request = request;
+    response->arena = arena;
     response->body = NULL;
+    response->freeBody = FALSE;
+    response->binaryLength = -1;
+    response->binary = (request != NULL) ? request->binaryResponse : FALSE;
     response->uri = NULL;
+    response->etag = NULL;
+    response->notModified = FALSE;
     response->next = NULL;
     response->error = FALSE;
+    response->held = FALSE;
+    response->heldParts = 0;
+    response->sendPending = FALSE;
+}
+
+/** Releases body of the response, if it is owned by the response. */
+static void freeBody(Response* response)
+{
+    if (response->freeBody)
+    {
+        free(response->body);
+    }
+    response->body = NULL;
+    response->freeBody = FALSE;
+    response->binaryLength = -1;
+}
+
+Response* obixResponse_create(Request* request)
+{
+    // the arena and the head of the response share the first block
+    Arena_Block* block = arenaBlock_create(ARENA_BLOCK_SIZE);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    Response_Arena arenaOnStack = {NULL, block};
+    Response_Arena* arena =
+        (Response_Arena*) arena_alloc(&arenaOnStack, sizeof(Response_Arena));
+    *arena = arenaOnStack;
+
+    Response* response = (Response*) arena_alloc(arena, sizeof(Response));
+    // init all values with default values;
+    initResponse(response, request, arena);
+    arena->head = response;
 
     return response;
 }
@@ -67,7 +204,13 @@ Response* obixResponse_getNewPart(Response* response)
 {
     // create new response part. Request object is stored only in the head
     // element
-    Response* newPart = obixResponse_create(NULL);
+    Response* newPart =
+        (Response*) arena_alloc(response->arena, sizeof(Response));
+    if (newPart != NULL)
+    {
+        initResponse(newPart, NULL, response->arena);
+        newPart->binary = response->binary;
+    }
 
     response->next = newPart;
     return newPart;
@@ -75,23 +218,22 @@ Response* obixResponse_getNewPart(Response* response)
 
 void obixResponse_free(Response* response)
 {
-    // free recursively the whole response chain
-    if (response->next != NULL)
+    Response* iterator;
+    for (iterator = response; iterator != NULL; iterator = iterator->next)
     {
-        obixResponse_free(response->next);
-    }
-
-    if (response->body != NULL)
-    {
-        free(response->body);
+        freeBody(iterator);
+        if (iterator->uri != NULL)
+        {
+            free(iterator->uri);
+            iterator->uri = NULL;
+        }
     }
 
-    if (response->uri != NULL)
+    // parts of the response are released together with the arena
+    if (response->arena->head == response)
     {
-        free(response->uri);
+        arena_free(response->arena);
     }
-
-    free(response);
 }
 
 int obixResponse_setError(Response* response, char* description)
@@ -102,19 +244,15 @@ int obixResponse_setError(Response* response, char* description)
     }
 
     response->error = TRUE;
+    freeBody(response);
 
-    if (response->body != NULL)
-    {
-        free(response->body);
-    }
-
-    char* errorMessage = malloc(strlen(OBIX_OBJ_ERR_TEMPLATE) +
-                                strlen(response->body) + 1);
+    char* errorMessage = arena_alloc(response->arena,
+                                     strlen(OBIX_OBJ_ERR_TEMPLATE) +
+                                     strlen(description) + 1);
     if (errorMessage == NULL)
     {
         // fail generation of the error message
         log_error("Unable to allocate memory for error message generation.");
-        response->body = NULL;
         return -1;
     }
 
@@ -125,6 +263,12 @@ int obixResponse_setError(Response* response, char* description)
     return 0;
 }
 
+int obixResponse_setETag(Response* response, const char* etag)
+{
+    response->etag = arena_strdup(response->arena, etag);
+    return (response->etag != NULL) ? 0 : -1;
+}
+
 void obixResponse_setErrorFlag(Response* response, BOOL error)
 {
     response->error = error;
@@ -149,25 +293,21 @@ int obixResponse_setText(Response* response, const char* text, BOOL copy)
         return -1;
     }
 
-    if (response->body != NULL)
-    {
-        free(response->body);
-    }
+    freeBody(response);
 
     if (!copy)
     {
         response->body = (char*) text;
+        response->freeBody = TRUE;
     }
     else
     {
-        char* newBody = (char*) malloc(strlen(text) + 1);
+        char* newBody = arena_strdup(response->arena, text);
         if (newBody == NULL)
         {
             log_error("Unable to allocate memory for the response body.");
-            response->body = NULL;
             return -1;
         }
-        strcpy(newBody, text);
 
         response->body = newBody;
     }
@@ -175,6 +315,47 @@ int obixResponse_setText(Response* response, const char* text, BOOL copy)
     return 0;
 }
 
+int obixResponse_setStaticText(Response* response, const char* text)
+{
+    if (response == NULL)
+    {
+        return -1;
+    }
+
+    freeBody(response);
+    response->body = (char*) text;
+    return 0;
+}
+
+int obixResponse_setBinary(Response* response, char* data, int length)
+{
+    if (response == NULL)
+    {
+        return -1;
+    }
+
+    freeBody(response);
+    response->body = data;
+    response->freeBody = TRUE;
+    response->binaryLength = length;
+    return 0;
+}
+
+int obixResponse_setStaticBinary(Response* response,
+                                 const char* data,
+                                 int length)
+{
+    if (response == NULL)
+    {
+        return -1;
+    }
+
+    freeBody(response);
+    response->body = (char*) data;
+    response->binaryLength = length;
+    return 0;
+}
+
 void obixResponse_setRightUri(Response* response,
                               const char* requestUri,
                               int slashFlag)
@@ -206,7 +387,20 @@ int obixResponse_send(Response* response)
 	// if it is not a response head than it should not be sent.
 	if (obixResponse_isHead(response))
 	{
-		(*_responseListener)(response);
+		if (response->heldParts > 0)
+		{	// some parts still wait for remote operation results
+			response->sendPending = TRUE;
+			return 0;
+		}
+
+		if (response->request->responseListener != NULL)
+		{	// request came from another interface than FastCGI
+			(*(response->request->responseListener))(response);
+		}
+		else
+		{
+			(*_responseListener)(response);
+		}
 		return 0;
 	}
 
@@ -219,3 +413,36 @@ BOOL obixResponse_canWait(Response* response)
 	// without remaining parts and thus can't wait.
 	return (response->request == NULL) ? FALSE : response->request->canWait;
 }
+
+BOOL obixResponse_canHold(Response* response)
+{
+    return (response->arena->head->request != NULL);
+}
+
+void obixResponse_hold(Response* response)
+{
+    Response* head = response->arena->head;
+    response->held = TRUE;
+    if ((head->heldParts++ == 0) && (_holdListener != NULL))
+    {
+        (*_holdListener)(head);
+    }
+}
+
+int obixResponse_complete(Response* response)
+{
+    Response* head = response->arena->head;
+    if (!response->held || (head->heldParts <= 0))
+    {
+        log_error("Response part is completed, but it was not held.");
+        return -1;
+    }
+    response->held = FALSE;
+
+    if ((--head->heldParts == 0) && head->sendPending)
+    {
+        head->sendPending = FALSE;
+        return obixResponse_send(head);
+    }
+    return 0;
+}
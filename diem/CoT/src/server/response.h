@@ -33,16 +33,47 @@
 #include "bool.h"
 #include "request.h"
 
+struct Response_Arena;
+
 /** Response structure.
  * Contains server's response message.
  * A message can consist of several chained response instances
- * (see #obixResponse_getNewPart). */
+ * (see #obixResponse_getNewPart). All parts of the message and copies of their
+ * texts are allocated from one memory arena, which is released at once
+ * together with the first part. */
 typedef struct Response
 {
     char* body;
+    /** Tells whether @a body was allocated with malloc() and should be freed
+     * separately. Texts copied to the arena or borrowed static strings are
+     * not freed. */
+    BOOL freeBody;
+    /** Length of the body if it contains binary encoded object (see
+     * #obixResponse_setBinary), or @a -1 if the body is XML text. */
+    int binaryLength;
+    /** Tells whether response should be binary encoded. Request handlers
+     * can generate parts of such response directly in binary form. */
+    BOOL binary;
     char* uri;
+    /** Entity tag of the object in the response (see
+     * #obixResponse_setETag), or @a NULL. */
+    char* etag;
+    /** Tells whether the client already has the requested object, so that
+     * only the HTTP header should be sent. */
+    BOOL notModified;
     BOOL error;
+    /** Tells whether this part waits for results of a remote operation (see
+     * #obixResponse_hold). */
+    BOOL held;
+    /** Number of parts, which wait for results of remote operations (see
+     * #obixResponse_hold). It is used only in the first part. */
+    int heldParts;
+    /** Tells whether the response should be sent as soon as all held parts
+     * are completed. It is used only in the first part. */
+    BOOL sendPending;
     Request* request;
+    /** Memory arena which owns this part of the response. */
+    struct Response_Arena* arena;
     struct Response* next;
 }
 Response;
@@ -79,6 +110,42 @@ Response* obixResponse_getNewPart(Response* response);
  */
 int obixResponse_setText(Response* response, const char* text, BOOL copy);
 
+/**
+ * Sets body of the response to a string which is not changed or deleted
+ * while the response exists (usually a string constant). The string is used
+ * as is, without making a copy.
+ *
+ * @return @a 0 on success; @a -1 on error.
+ */
+int obixResponse_setStaticText(Response* response, const char* text);
+
+/**
+ * Sets binary encoded body of the provided response object (see
+ * obix_binary.h). The data is deleted together with response object.
+ *
+ * @param length Length of the data.
+ * @return @a 0 on success; @a -1 on error.
+ */
+int obixResponse_setBinary(Response* response, char* data, int length);
+
+/**
+ * Sets binary encoded body of the response to data, which is not changed or
+ * deleted while the response exists (see #obixResponse_setStaticText).
+ *
+ * @param length Length of the data.
+ * @return @a 0 on success; @a -1 on error.
+ */
+int obixResponse_setStaticBinary(Response* response,
+                                 const char* data,
+                                 int length);
+
+/**
+ * Sets entity tag of the object which is sent in the response. The tag is
+ * copied.
+ * @return @a 0 on success; @a -1 on error.
+ */
+int obixResponse_setETag(Response* response, const char* etag);
+
 /**
  * Sets an error message for the response.
  * @param Description Text description of the error. This description is copied
@@ -98,6 +165,10 @@ BOOL obixResponse_isError(Response* response);
 
 /**
  * Releases memory allocated for the response.
+ * If @a response is the first part of the message, the whole message is
+ * released together with its memory arena. Otherwise, only bodies of the
+ * provided part and all following parts are released, while the memory of the
+ * parts themselves is kept in the arena until the whole message is freed.
  * Note that it doesn't release corresponding request object.
  */
 void obixResponse_free(Response* response);
@@ -140,4 +211,35 @@ int obixResponse_send(Response* response);
  */
 BOOL obixResponse_canWait(Response* response);
 
+/**
+ * Tells whether response part can be held by #obixResponse_hold. Responses
+ * without request objects (e.g. created by #obixLocal_invoke) are not sent
+ * anywhere after handlers return, and thus can't be held.
+ */
+BOOL obixResponse_canHold(Response* response);
+
+/**
+ * Marks response part as waiting for results of a remote operation. The whole
+ * response is not sent by #obixResponse_send until all held parts are
+ * completed with #obixResponse_complete. Unlike #obixResponse_canWait, any
+ * part of the response can be held.
+ */
+void obixResponse_hold(Response* response);
+
+/**
+ * Completes response part, which was held by #obixResponse_hold. If it was the
+ * last held part and the response was already sent by the request handler,
+ * the response is sent now.
+ * @return @a 0 on success, @a -1 on error.
+ */
+int obixResponse_complete(Response* response);
+
+/**
+ * Assigns global listener, which is invoked when the first part of the
+ * response gets held (see #obixResponse_hold). Such response can wait for
+ * a long time, so that the request object could be released from the pool
+ * of requests which are handled at the moment.
+ */
+void obixResponse_setHoldListener(obix_response_listener listener);
+
 #endif /* RESPONSE_H_ */
@@ -27,20 +27,38 @@
  * @author Andrey Litvinov
  */
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <obix_utils.h>
 #include <xml_config.h>
 #include <log_utils.h>
+#include <obix_binary.h>
+#include <probes.h>
 #include "xml_storage.h"
 #include "post_handler.h"
 #include "watch.h"
+#include "continuation.h"
+#include "metrics.h"
+#include "object_stats.h"
 #include "server.h"
 
-int obix_server_init()
+/** Initial size of the buffer, used for binary encoding of an object. */
+#define DEFAULT_BINARY_BUFFER_SIZE 256
+
+/** Time of the server start. It is a part of all entity tags, so that tags
+ * generated before restart are never valid. */
+static long _serverEpoch;
+
+/** Serializes handling of requests, coming from different threads. */
+static pthread_mutex_t _serverMutex = PTHREAD_MUTEX_INITIALIZER;
+
+int obix_server_init(const char* resourceDir)
 {
     //initialize server storage
-    int error = xmldb_init();
+    int error = xmldb_init(resourceDir);
     if (error != 0)
     {
         log_error("Unable to start the server. xmldb_init returned: %d", error);
@@ -49,6 +67,8 @@ int obix_server_init()
 
     // initialize Watch mechanism
     // TODO load max watch count from config file
+    _serverEpoch = (long) time(NULL);
+
     error = obixWatch_init();
     if (error != 0)
     {
@@ -57,6 +77,15 @@ int obix_server_init()
         return -1;
     }
 
+    // initialize table of remote operation invocations
+    error = obixContinuation_init();
+    if (error != 0)
+    {
+        log_error("Unable to start the server. obixContinuation_init "
+                  "returned: %d", error);
+        return -1;
+    }
+
     return 0;
 }
 //TODO create global function for memory allocation with error logging
@@ -111,6 +140,182 @@ void obix_server_generateObixErrorMessage(
     ixmlElement_freeOwnerDocument(errorDOM);
 }
 
+/**
+ * Appends a copy of @a source element to @a parent. If @a deep is @a FALSE,
+ * only the element itself with its attributes is copied.
+ * @return Created copy, or @a NULL on error.
+ */
+static IXML_Element* importChild(IXML_Element* parent,
+                                 IXML_Element* source,
+                                 BOOL deep)
+{
+    IXML_Node* node;
+    int error = ixmlDocument_importNode(
+                    ixmlNode_getOwnerDocument(ixmlElement_getNode(parent)),
+                    ixmlElement_getNode(source),
+                    deep,
+                    &node);
+    if (error != IXML_SUCCESS)
+    {
+        log_error("Unable to copy object: ixmlDocument_importNode() "
+                  "returned %d.", error);
+        return NULL;
+    }
+
+    error = ixmlNode_appendChild(ixmlElement_getNode(parent), node);
+    if (error != IXML_SUCCESS)
+    {
+        log_error("Unable to copy object: ixmlNode_appendChild() "
+                  "returned %d.", error);
+        ixmlNode_free(node);
+        return NULL;
+    }
+
+    return ixmlNode_convertToElement(node);
+}
+
+/**
+ * Creates a reference to @a source object, copying its @a href, @a name,
+ * @a display and @a displayName attributes.
+ * @return @a 0 on success, @a -1 on error.
+ */
+static int appendReference(IXML_Element* parent, IXML_Element* source)
+{
+    IXML_Element* ref =
+        ixmlElement_createChildElementWithLog(parent, OBIX_OBJ_REF);
+    if (ref == NULL)
+    {
+        return -1;
+    }
+
+    if (ixmlElement_copyAttributeWithLog(source, ref, OBIX_ATTR_HREF, TRUE)
+            != IXML_SUCCESS)
+    {
+        return -1;
+    }
+
+    // other attributes are optional
+    const char* attributes[] =
+        {OBIX_ATTR_NAME, OBIX_ATTR_DISPLAY, OBIX_ATTR_DISPLAY_NAME};
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        int error = ixmlElement_copyAttributeWithLog(source, ref,
+                    attributes[i], FALSE);
+        if ((error != IXML_SUCCESS) && (error != IXML_NOT_FOUND_ERR))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Copies child objects of @a source to @a target.
+ *
+ * @param depth Number of levels of child objects, which are copied
+ *              completely. Deeper objects, which have @a href attribute, are
+ *              replaced with references. @a -1 means no limit.
+ * @param offset Number of child objects to be skipped.
+ * @param limit Maximum number of child objects to be copied, or @a -1.
+ * @return @a 0 on success, @a -1 on error.
+ */
+static int copyLimitedChildren(IXML_Element* target,
+                               IXML_Element* source,
+                               int depth,
+                               int offset,
+                               int limit)
+{
+    IXML_Node* node = ixmlNode_getFirstChild(ixmlElement_getNode(source));
+    int index = 0;
+
+    for (; (node != NULL) && (limit != 0); node = ixmlNode_getNextSibling(node))
+    {
+        IXML_Element* child = ixmlNode_convertToElement(node);
+        if ((child == NULL)
+                || (strcmp(ixmlElement_getTagName(child), OBIX_META) == 0))
+        {
+            continue;
+        }
+
+        if (index++ < offset)
+        {
+            continue;
+        }
+
+        if (limit > 0)
+        {
+            limit--;
+        }
+
+        if (depth < 0)
+        {
+            if (importChild(target, child, TRUE) == NULL)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        if ((depth == 0)
+                && (ixmlElement_getAttribute(child, OBIX_ATTR_HREF) != NULL))
+        {
+            if (appendReference(target, child) != 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        // objects without href can't be referenced, thus they are copied,
+        // but their children are still checked
+        IXML_Element* copy = importChild(target, child, FALSE);
+        if ((copy == NULL)
+                || (copyLimitedChildren(copy,
+                                        child,
+                                        (depth > 0) ? depth - 1 : 0,
+                                        0,
+                                        -1) != 0))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Creates a copy of the object, limited according to the @a depth,
+ * @a offset and @a limit query parameters of the request. Paging parameters
+ * are applied only to list objects.
+ *
+ * @return Copy of the object, which should be freed with
+ *         #ixmlElement_freeOwnerDocument, or @a NULL on error.
+ */
+static IXML_Element* cloneLimited(IXML_Element* source, const Request* request)
+{
+    IXML_Element* clone = ixmlElement_cloneWithLog(source, FALSE);
+    if (clone == NULL)
+    {
+        return NULL;
+    }
+
+    BOOL isList = (strcmp(ixmlElement_getTagName(source), OBIX_OBJ_LIST) == 0);
+    if (copyLimitedChildren(clone,
+                            source,
+                            request->depth,
+                            isList ? request->offset : 0,
+                            isList ? request->limit : -1) != 0)
+    {
+        log_error("Unable to copy limited object.");
+        ixmlElement_freeOwnerDocument(clone);
+        return NULL;
+    }
+
+    return clone;
+}
+
 void obix_server_read(Response* response, const char* uri)
 {
     // try to get requested URI from the database
@@ -127,6 +332,7 @@ void obix_server_read(Response* response, const char* uri)
             "Requested URI is not found on the server.");
         return;
     }
+    obixObjectStats_count(uri, OBJECT_STATS_READS, 1);
 
     // if it is a Watch object than we should reset it's lease timer
     oBIX_Watch* watch = obixWatch_getByUri(uri);
@@ -135,17 +341,62 @@ void obix_server_read(Response* response, const char* uri)
         obixWatch_resetLeaseTimer(watch);
     }
 
+    // version of the object is used as a validator for conditional requests
+    if (obixResponse_isHead(response))
+    {
+        char etag[64];
+        sprintf(etag, "W/\"%lx-%lx%s\"",
+                _serverEpoch,
+                xmldb_getVersion(oBIXdoc),
+                response->binary ? "b" : "");
+        obixResponse_setETag(response, etag);
+
+        const char* ifNoneMatch = response->request->ifNoneMatch;
+        if ((ifNoneMatch != NULL) && (strstr(ifNoneMatch, etag) != NULL))
+        {
+            log_debug("Object \"%s\" is not modified.", uri);
+            response->notModified = TRUE;
+            return;
+        }
+    }
+
+    // big objects can be requested partially, in that case a limited copy
+    // is created instead of cloning the whole subtree
+    IXML_Element* limitedDoc = NULL;
+    const Request* request = response->request;
+    if ((request != NULL)
+            && ((request->depth >= 0)
+                || (request->offset > 0)
+                || (request->limit >= 0)))
+    {
+        limitedDoc = cloneLimited(oBIXdoc, request);
+        if (limitedDoc == NULL)
+        {
+            obixResponse_setError(response,
+                                  "Unable to generate limited object.");
+            return;
+        }
+        oBIXdoc = limitedDoc;
+    }
+
     obix_server_generateResponse(response,
                                  oBIXdoc,
                                  uri,
                                  slashFlag,
-                                 FALSE);
+                                 limitedDoc != NULL);
+
+    if (limitedDoc != NULL)
+    {
+        ixmlElement_freeOwnerDocument(limitedDoc);
+    }
 }
 
 void obix_server_handleGET(Response* response, const char* uri)
 {
+    unsigned long long start = obixMetrics_startTimer();
     obix_server_read(response, uri);
     obixResponse_send(response);
+    obixMetrics_stopTimer(METRICS_TIMER_GET, start);
 }
 
 /**
@@ -172,60 +423,52 @@ static void updateMetaWatch(IXML_Node* node)
     }
 }
 
-void obix_server_write(Response* response,
-                       const char* uri,
-                       IXML_Element* input)
+/**
+ * Updates object in the storage and notifies everybody, who monitors it.
+ * @param element Updated object is returned here.
+ * @return Error code of #xmldb_updateDOM, or @a -5 if the object is a Watch
+ *         parameter which was not applied.
+ */
+static int writeObject(const char* uri,
+                       IXML_Element* input,
+                       IXML_Element** element,
+                       int* slashFlag)
 {
-    if (input == NULL)
+    // update node in the storage
+    OBIX_PROBE1(storage__update__start, uri);
+    int error = xmldb_updateDOM(input, uri, element, slashFlag);
+    OBIX_PROBE2(storage__update__done, uri, error);
+    if (error < 0)
     {
-        log_warning("Unable to process write request. Wrong input: %s", input);
-        obix_server_generateObixErrorMessage(response,
-                                             uri,
-                                             NULL,
-                                             "Write Error",
-                                             "Unable to read request input.");
-        return;
+        return error;
     }
+    obixObjectStats_count(uri, OBJECT_STATS_WRITES, 1);
 
-    // update node in the storage
-    IXML_Element* element = NULL;
-    int slashFlag = 0;
-    int error = xmldb_updateDOM(input, uri, &element, &slashFlag);
-
-    // parse error code
-    switch(error)
+    if (error == 0)
     {
-    case 0: //everything is ok
         // update meta tags for the object and its parents
-        updateMetaWatch(ixmlElement_getNode(element));
-    case 1: //ok, but new value is the same as the old one
-        {
-            // check whether it is request for overwriting Watch.lease value.
-            error = obixWatch_processTimeUpdates(uri, element);
-            if (error < 0)
-            {
-                // it was new value for some Watch parameter which failed to
-                // be processed
-                obix_server_generateObixErrorMessage(
-                    response,
-                    uri,
-                    NULL,
-                    "Write Error",
-                    "Unable to update Watch parameter. Note: Value is updated "
-                    "in storage, but did not affect the behavior of the Watch "
-                    "object. That is a known issue. Please check that you have "
-                    "provided correct reltime value and try again.");
-                return;
-            }
+        updateMetaWatch(ixmlElement_getNode(*element));
+        // local listeners do not need meta tags, they are notified directly
+        obixWatch_notifyLocalListeners(*element);
+    }
 
-            // reply with the updated object
-            obix_server_generateResponse(response,
-                                         element,
-                                         uri,
-                                         slashFlag,
-                                         FALSE);
-        }
-        break;
+    // check whether it is request for overwriting Watch.lease value.
+    if (obixWatch_processTimeUpdates(uri, *element) < 0)
+    {
+        return -5;
+    }
+
+    return error;
+}
+
+/**
+ * Generates error message for a failed write request.
+ * @param error Error code returned by #writeObject.
+ */
+static void generateWriteError(Response* response, const char* uri, int error)
+{
+    switch(error)
+    {
     case -1: // wrong format of the request
         obix_server_generateObixErrorMessage(response,
                                              uri,
@@ -247,7 +490,28 @@ void obix_server_write(Response* response,
                                              "Write Error",
                                              "Object is not writable.");
         break;
-    case -4:
+    case -5:
+        // it was new value for some Watch parameter which failed to
+        // be processed
+        obix_server_generateObixErrorMessage(
+            response,
+            uri,
+            NULL,
+            "Write Error",
+            "Unable to update Watch parameter. Note: Value is updated "
+            "in storage, but did not affect the behavior of the Watch "
+            "object. That is a known issue. Please check that you have "
+            "provided correct reltime value and try again.");
+        break;
+    case -6: // device would exceed its memory limit
+        obix_server_generateObixErrorMessage(
+            response,
+            uri,
+            NULL,
+            "Write Error",
+            "New value exceeds memory limits of the device.");
+        break;
+    default:
         obix_server_generateObixErrorMessage(response,
                                              uri,
                                              NULL,
@@ -256,24 +520,187 @@ void obix_server_write(Response* response,
     }
 }
 
+void obix_server_write(Response* response,
+                       const char* uri,
+                       IXML_Element* input)
+{
+    if (input == NULL)
+    {
+        log_warning("Unable to process write request. Wrong input: %s", input);
+        obix_server_generateObixErrorMessage(response,
+                                             uri,
+                                             NULL,
+                                             "Write Error",
+                                             "Unable to read request input.");
+        return;
+    }
+
+    IXML_Element* element = NULL;
+    int slashFlag = 0;
+    int error = writeObject(uri, input, &element, &slashFlag);
+
+    if (error >= 0)
+    {
+        // reply with the updated object (error code 1 means that the new
+        // value is the same as the old one)
+        obix_server_generateResponse(response,
+                                     element,
+                                     uri,
+                                     slashFlag,
+                                     FALSE);
+    }
+    else
+    {
+        generateWriteError(response, uri, error);
+    }
+}
+
+int obix_server_writeDOM(const char* uri, IXML_Element* input)
+{
+    IXML_Element* element = NULL;
+    int slashFlag = 0;
+    int error = writeObject(uri, input, &element, &slashFlag);
+    return (error == 1) ? 0 : error;
+}
+
+int obix_server_signUp(IXML_Element* input)
+{
+    if (input == NULL)
+    {
+        return -1;
+    }
+
+    // oversized devices are rejected before anything is stored. Data
+    // published before is not checked, it is already accounted (and the
+    // client gets a better answer below)
+    const char* href = ixmlElement_getAttribute(input, OBIX_ATTR_HREF);
+    if (((href == NULL) || (xmldb_getDOM(href, NULL) == NULL))
+            && (xmldb_checkDeviceQuota(input) != 0))
+    {
+        return -3;
+    }
+
+    int error = xmldb_putDOM(input);
+    if (error != 0)
+    {
+        // -2 means that object with the same URI already exists
+        return (error == -2) ? -2 : -1;
+    }
+
+    // add reference to the new device
+    // href could be changed by the storage (default prefix is inserted)
+    href = ixmlElement_getAttribute(input, OBIX_ATTR_HREF);
+    if (xmldb_putDeviceReference(input) != 0)
+    {
+        xmldb_delete(href);
+        return -4;
+    }
+
+    log_debug("New object is successfully registered at \"%s\"", href);
+    return 0;
+}
+
+int obix_server_unregisterDevice(const char* uri)
+{
+    IXML_Element* device = xmldb_getDOM(uri, NULL);
+    if (device == NULL)
+    {
+        log_warning("Unable to unregister device: "
+                    "URI \"%s\" is not found.", uri);
+        return -1;
+    }
+
+    // only objects from the device list can be removed, otherwise anybody
+    // could delete e.g. the Lobby
+    const char* href = ixmlElement_getAttribute(device, OBIX_ATTR_HREF);
+    if ((href == NULL) || (xmldb_deleteDeviceReference(href) != 0))
+    {
+        log_warning("Unable to unregister device: "
+                    "\"%s\" is not a registered device.", uri);
+        return -2;
+    }
+
+    // watch items keep links to the objects which are going to be deleted
+    int count = obixWatch_deleteSubtreeItems(device);
+    if (count > 0)
+    {
+        log_debug("%d watch item(s) of device \"%s\" are removed.",
+                  count, uri);
+    }
+
+    if (xmldb_delete(uri) != 0)
+    {
+        log_error("Unable to delete device \"%s\" from the storage.", uri);
+        return -3;
+    }
+
+    log_debug("Device \"%s\" is unregistered.", uri);
+    return 0;
+}
+
+IXML_Element* obix_server_readDOM(const char* uri)
+{
+    IXML_Element* oBIXdoc = xmldb_getDOM(uri, NULL);
+    if (oBIXdoc == NULL)
+    {
+        log_warning("Requested URI \"%s\" is not found in the storage", uri);
+        return NULL;
+    }
+
+    // if it is a Watch object than we should reset it's lease timer
+    oBIX_Watch* watch = obixWatch_getByUri(uri);
+    if (watch != NULL)
+    {
+        obixWatch_resetLeaseTimer(watch);
+    }
+
+    // return a copy without server meta data
+    IXML_Element* copy = ixmlElement_cloneWithLog(oBIXdoc, TRUE);
+    if (copy != NULL)
+    {
+        xmldb_deleteMetaInfo(copy);
+    }
+    return copy;
+}
+
+/**
+ * Executes write request and sends the response.
+ * @param start Time when handling of the request was started.
+ */
+static void handlePUT(Response* response,
+                      const char* uri,
+                      IXML_Element* input,
+                      unsigned long long start)
+{
+    // process write request
+    obix_server_write(response, uri, input);
+
+    // send response
+    obixResponse_send(response);
+    obixMetrics_stopTimer(METRICS_TIMER_PUT, start);
+}
+
 void obix_server_handlePUT(Response* response,
                            const char* uri,
                            const char* input)
 {
+    unsigned long long start = obixMetrics_startTimer();
 
     // parse request input
     IXML_Element* element = ixmlElement_parseBuffer(input);
 
-    // process write request
-    obix_server_write(response, uri, element);
+    handlePUT(response, uri, element, start);
     if (element != NULL)
     {
         ixmlElement_freeOwnerDocument(element);
     }
+}
 
-    // send response
-    obixResponse_send(response);
-    return;
+void obix_server_handlePUTDOM(Response* response,
+                              const char* uri,
+                              IXML_Element* input)
+{
+    handlePUT(response, uri, input, obixMetrics_startTimer());
 }
 
 void obix_server_invoke(Response* response,
@@ -328,7 +755,10 @@ void obix_server_invoke(Response* response,
     obix_server_postHandler handler = obix_server_getPostHandler(handlerId);
 
     // execute corresponding request handler
+    OBIX_PROBE2(handler__dispatch, handlerId, uri);
+    unsigned long long start = obixMetrics_startTimer();
     (*handler)(response, uri, input);
+    obixMetrics_stopPostTimer(handlerId, start);
 }
 
 void obix_server_handlePOST(Response* response,
@@ -346,12 +776,606 @@ void obix_server_handlePOST(Response* response,
     }
 }
 
+/** Header of the Batch response. */
+#define BATCH_OUT_PREFIX "<list is=\"obix:BatchOut\" of=\"obix:obj\">\r\n"
+/** Footer of the Batch response. */
+#define BATCH_OUT_POSTFIX "\r\n</list>\r\n"
+/** Expected size of one command result in the Batch response. Used to
+ * estimate initial size of the output buffer. */
+#define BATCH_RESULT_SIZE 128
+
+/** Types of Batch commands. */
+typedef enum
+{
+    BATCH_READ,
+    BATCH_WRITE,
+    BATCH_INVOKE
+} Batch_Command_Type;
+
+/** Single command of a Batch request. */
+typedef struct
+{
+    Batch_Command_Type type;
+    /** URI of the object addressed by the command. */
+    const char* uri;
+    /** Input of write and invoke commands. */
+    IXML_Element* input;
+    /** Object in the storage, or @a NULL if URI is not found. */
+    IXML_Element* target;
+}
+Batch_Command;
+
+/** Appends header of the Batch response in the encoding of the response. */
+static int appendBatchPrefix(String_Buffer* buffer, BOOL binary)
+{
+    if (!binary)
+    {
+        return strbuf_append(buffer, BATCH_OUT_PREFIX);
+    }
+
+    int error = obixBinary_appendTag(buffer, OBIX_OBJ_LIST);
+    error += obixBinary_appendAttr(buffer, OBIX_ATTR_IS, "obix:BatchOut");
+    error += obixBinary_appendAttr(buffer, OBIX_ATTR_OF, "obix:obj");
+    error += obixBinary_appendEnd(buffer);
+    return (error == 0) ? 0 : -1;
+}
+
+/**
+ * Parses the list of Batch commands.
+ * @param commands Array, which is big enough to hold all input elements.
+ * @return Number of parsed commands, or @a -1 if input contains illegal tags.
+ */
+static int parseBatchCommands(IXML_Element* input, Batch_Command* commands)
+{
+    int count = 0;
+    IXML_Node* node = ixmlNode_getFirstChild(ixmlElement_getNode(input));
+    for (; node != NULL; node = ixmlNode_getNextSibling(node))
+    {
+        IXML_Element* element = ixmlNode_convertToElement(node);
+        if (element == NULL)
+        {
+            // this is not a tag, go to the next node in batch command
+            continue;
+        }
+
+        Batch_Command* command = &(commands[count++]);
+        // there should be always some uri in the command
+        command->uri = ixmlElement_getAttribute(element, OBIX_ATTR_VAL);
+        if (command->uri == NULL)
+        {
+            return -1;
+        }
+
+        // find out type of command (read, write or invoke)
+        if (obix_obj_implementsContract(element, "Read"))
+        {
+            command->type = BATCH_READ;
+        }
+        else if (obix_obj_implementsContract(element, "Write"))
+        {
+            command->type = BATCH_WRITE;
+        }
+        else if (obix_obj_implementsContract(element, "Invoke"))
+        {
+            command->type = BATCH_INVOKE;
+        }
+        else
+        {
+            return -1;
+        }
+
+        command->input = ixmlNode_convertToElement(ixmlNode_getFirstChild(node));
+        command->target = NULL;
+    }
+
+    return count;
+}
+
+/**
+ * Finds storage objects of all commands starting from @a first one until the
+ * next invoke command. Operations can change the storage structure (e.g.
+ * create or delete Watch objects), so commands after them are resolved only
+ * when the operation is executed.
+ * @return Index of the next invoke command, or @a count if there is no one.
+ */
+static int resolveBatchCommands(Batch_Command* commands, int first, int count)
+{
+    int i;
+    for (i = first; (i < count) && (commands[i].type != BATCH_INVOKE); i++)
+    {
+        commands[i].target = xmldb_getDOM(commands[i].uri, NULL);
+    }
+    return i;
+}
+
+/**
+ * Appends XML representation of the storage object to the buffer without
+ * making a copy of it. Meta tags are skipped.
+ * @param href If not @a NULL, replaces URI of the object.
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+static int appendObject(String_Buffer* buffer,
+                        IXML_Element* element,
+                        const char* href)
+{
+    IXML_Node* node = ixmlElement_getNode(element);
+    const char* tagName = ixmlElement_getTagName(element);
+    int error = strbuf_append(buffer, "<");
+    error += strbuf_append(buffer, tagName);
+    if (href != NULL)
+    {
+        error += strbuf_append(buffer, " ");
+        error += strbuf_append(buffer, OBIX_ATTR_HREF);
+        error += strbuf_append(buffer, "=\"");
+        error += strbuf_appendXml(buffer, href);
+        error += strbuf_append(buffer, "\"");
+    }
+
+    // attributes are walked directly, so that no IXML_NamedNodeMap is
+    // allocated for every object
+    IXML_Node* attr;
+    for (attr = node->firstAttr; attr != NULL; attr = attr->nextSibling)
+    {
+        const char* name = ixmlNode_getNodeName(attr);
+        const char* value = ixmlNode_getNodeValue(attr);
+        if ((href != NULL) && (strcmp(name, OBIX_ATTR_HREF) == 0))
+        {
+            continue;
+        }
+        error += strbuf_append(buffer, " ");
+        error += strbuf_append(buffer, name);
+        error += strbuf_append(buffer, "=\"");
+        error += strbuf_appendXml(buffer, (value != NULL) ? value : "");
+        error += strbuf_append(buffer, "\"");
+    }
+
+    BOOL empty = TRUE;
+    IXML_Node* child;
+    for (child = ixmlNode_getFirstChild(node);
+            (child != NULL) && (error == 0);
+            child = ixmlNode_getNextSibling(child))
+    {
+        IXML_Element* childElement = ixmlNode_convertToElement(child);
+        if ((childElement == NULL) ||
+                (strcmp(ixmlElement_getTagName(childElement), OBIX_META) == 0))
+        {
+            continue;
+        }
+
+        if (empty)
+        {
+            error += strbuf_append(buffer, ">");
+            empty = FALSE;
+        }
+        error += appendObject(buffer, childElement, NULL);
+    }
+
+    if (empty)
+    {
+        error += strbuf_append(buffer, "/>");
+    }
+    else
+    {
+        error += strbuf_append(buffer, "</");
+        error += strbuf_append(buffer, tagName);
+        error += strbuf_append(buffer, ">");
+    }
+
+    return (error == 0) ? 0 : -1;
+}
+
+/**
+ * Appends binary encoding of the storage object to the buffer (see
+ * obix_binary.h). Works like #appendObject, but without an XML step between.
+ * @param href If not @a NULL, replaces URI of the object.
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+static int appendObjectBinary(String_Buffer* buffer,
+                              IXML_Element* element,
+                              const char* href)
+{
+    IXML_Node* node = ixmlElement_getNode(element);
+    int error = obixBinary_appendTag(buffer, ixmlElement_getTagName(element));
+    if (href != NULL)
+    {
+        error += obixBinary_appendAttr(buffer, OBIX_ATTR_HREF, href);
+    }
+
+    IXML_Node* attr;
+    for (attr = node->firstAttr; attr != NULL; attr = attr->nextSibling)
+    {
+        const char* name = ixmlNode_getNodeName(attr);
+        if ((href != NULL) && (strcmp(name, OBIX_ATTR_HREF) == 0))
+        {
+            continue;
+        }
+        error += obixBinary_appendAttr(buffer, name,
+                                       ixmlNode_getNodeValue(attr));
+    }
+    error += obixBinary_appendEnd(buffer);
+
+    IXML_Node* child;
+    for (child = ixmlNode_getFirstChild(node);
+            (child != NULL) && (error == 0);
+            child = ixmlNode_getNextSibling(child))
+    {
+        IXML_Element* childElement = ixmlNode_convertToElement(child);
+        if ((childElement == NULL) ||
+                (strcmp(ixmlElement_getTagName(childElement), OBIX_META) == 0))
+        {
+            continue;
+        }
+        error += appendObjectBinary(buffer, childElement, NULL);
+    }
+    error += obixBinary_appendEnd(buffer);
+
+    return (error == 0) ? 0 : -1;
+}
+
+/**
+ * Appends the storage object to the Batch results in the encoding of the
+ * response.
+ */
+static int appendBatchObject(String_Buffer* buffer,
+                             BOOL binary,
+                             IXML_Element* element,
+                             const char* href)
+{
+    return binary ? appendObjectBinary(buffer, element, href) :
+           appendObject(buffer, element, href);
+}
+
+/**
+ * Sets Batch results collected so far as a body of the response part and
+ * empties the buffer.
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+static int setBatchResults(Response* part, String_Buffer* buffer)
+{
+    int error;
+    if (part->binary)
+    {
+        char* data = (char*) malloc(buffer->length + 1);
+        if (data == NULL)
+        {
+            return -1;
+        }
+        memcpy(data, buffer->data, buffer->length);
+        error = obixResponse_setBinary(part, data, buffer->length);
+    }
+    else
+    {
+        error = obixResponse_setText(part, strbuf_getString(buffer), TRUE);
+    }
+    strbuf_reset(buffer);
+    return error;
+}
+
+/**
+ * Executes Batch command using generic request handlers and appends the
+ * generated response to the buffer. It is used for operations and errors,
+ * which are rare in comparison with reads and writes.
+ *
+ * If the command is a remote operation, its response part waits for the
+ * results (see #obixResponse_hold). In that case text collected so far is
+ * moved to the current tail of the response, and the part is kept in the
+ * response chain.
+ * @param tail The last part of the response. Its body is set only when some
+ *             part is held, the new tail is returned then.
+ * @param writeError If not @a 0, error message for the failed write command
+ *                   is generated instead of executing the command.
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+static int appendGenericResult(String_Buffer* buffer,
+                               Response** tail,
+                               Batch_Command* command,
+                               int writeError)
+{
+    // temporary response part is attached to the response, so that
+    // handlers treat it as a part of multi-part message. It inherits the
+    // encoding of the response, so that its body can be copied as is.
+    Response* part = obixResponse_getNewPart(*tail);
+    if (part == NULL)
+    {
+        return -1;
+    }
+
+    if (writeError != 0)
+    {
+        generateWriteError(part, command->uri, writeError);
+    }
+    else if (command->type == BATCH_READ)
+    {
+        obix_server_read(part, command->uri);
+    }
+    else if (command->type == BATCH_WRITE)
+    {
+        obix_server_write(part, command->uri, command->input);
+    }
+    else
+    {
+        obix_server_invoke(part, command->uri, command->input);
+    }
+
+    // handler could generate more than one response part
+    BOOL held = FALSE;
+    Response* last = part;
+    Response* iterator;
+    for (iterator = part; iterator != NULL; iterator = iterator->next)
+    {
+        held = held || iterator->held;
+        last = iterator;
+    }
+
+    int error = 0;
+    if (held)
+    {
+        error = setBatchResults(*tail, buffer);
+        *tail = obixResponse_getNewPart(last);
+        if (*tail == NULL)
+        {
+            return -1;
+        }
+        return error;
+    }
+
+    for (iterator = part; iterator != NULL; iterator = iterator->next)
+    {
+        if (iterator->body == NULL)
+        {
+            continue;
+        }
+        if (iterator->binaryLength >= 0)
+        {
+            error += strbuf_appendLength(buffer, iterator->body,
+                                         iterator->binaryLength);
+        }
+        else if (part->binary)
+        {
+            // error messages are generated from text templates
+            error += obixBinary_encodeXml(iterator->body, buffer);
+        }
+        else
+        {
+            error += strbuf_append(buffer, iterator->body);
+        }
+    }
+
+    obixResponse_free(part);
+    (*tail)->next = NULL;
+    return (error == 0) ? 0 : -1;
+}
+
+/**
+ * Executes write command of a Batch. Only the value of the object is changed:
+ * versions, Watches and local listeners are updated later for all written
+ * objects at once (see #commitBatchWrites).
+ * @param updated Array of changed objects. Written object is added there if
+ *                its value has changed.
+ */
+static int executeBatchWrite(String_Buffer* buffer,
+                             Response** tail,
+                             Batch_Command* command,
+                             IXML_Element** updated,
+                             int* updatedCount)
+{
+    if ((command->target == NULL) || (command->input == NULL))
+    {
+        // let generic handler generate correct error message
+        return appendGenericResult(buffer, tail, command, 0);
+    }
+
+    OBIX_PROBE1(storage__update__start, command->uri);
+    int error = xmldb_updateObject(command->target, command->input);
+    OBIX_PROBE2(storage__update__done, command->uri, error);
+    if (error == 0)
+    {
+        updated[(*updatedCount)++] = command->target;
+    }
+    if (error >= 0)
+    {
+        obixObjectStats_count(command->uri, OBJECT_STATS_WRITES, 1);
+    }
+
+    // check whether it is request for overwriting Watch.lease value.
+    if ((error >= 0) &&
+            (obixWatch_processTimeUpdates(command->uri, command->target) < 0))
+    {
+        error = -5;
+    }
+
+    if (error < 0)
+    {
+        return appendGenericResult(buffer, tail, command, error);
+    }
+
+    return appendBatchObject(buffer, (*tail)->binary,
+                             command->target, command->uri);
+}
+
+/** Sets Watch attributes of the object's meta tag to "updated" state. */
+static void updateObjectMetaWatch(IXML_Element* element)
+{
+    IXML_Element* meta = xmldb_getMetaInfo(element);
+    if (meta != NULL)
+    {
+        obixWatch_updateMeta(meta);
+    }
+}
+
+/**
+ * Finishes all writes of a Batch: updates versions and Watch meta tags of
+ * written objects and their parents, visiting every parent only once, and
+ * notifies local listeners.
+ */
+static void commitBatchWrites(IXML_Element** updated, int count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    xmldb_updateVersions(updated, count, &updateObjectMetaWatch);
+    obixWatch_notifyLocalListenersOnce(updated, count);
+}
+
+/**
+ * Executes parsed Batch commands in their order and puts all results to the
+ * buffer.
+ * @param tail The last part of the response (see #appendGenericResult).
+ * @param updated Array, which is big enough to hold all commands.
+ * @return @a 0 on success; @a -1 if there is not enough memory.
+ */
+static int executeBatchCommands(String_Buffer* buffer,
+                                Response** tail,
+                                Batch_Command* commands,
+                                int count,
+                                IXML_Element** updated)
+{
+    int error = 0;
+    int i = 0;
+    while ((i < count) && (error == 0))
+    {
+        int updatedCount = 0;
+        int end = resolveBatchCommands(commands, i, count);
+        for (; (i < end) && (error == 0); i++)
+        {
+            Batch_Command* command = &(commands[i]);
+            if (command->type == BATCH_WRITE)
+            {
+                error = executeBatchWrite(buffer, tail, command,
+                                          updated, &updatedCount);
+            }
+            else if (command->target == NULL)
+            {
+                error = appendGenericResult(buffer, tail, command, 0);
+            }
+            else
+            {
+                // if it is a Watch object than we should reset its lease timer
+                oBIX_Watch* watch = obixWatch_getByUri(command->uri);
+                if (watch != NULL)
+                {
+                    obixWatch_resetLeaseTimer(watch);
+                }
+                int length = buffer->length;
+                error = appendBatchObject(buffer, (*tail)->binary,
+                                          command->target, command->uri);
+                obixObjectStats_count(command->uri, OBJECT_STATS_READS, 1);
+                obixObjectStats_count(command->uri, OBJECT_STATS_BYTES,
+                                      buffer->length - length);
+            }
+        }
+
+        // operation should see results of all previous writes
+        commitBatchWrites(updated, updatedCount);
+
+        if ((i < count) && (error == 0))
+        {
+            error = appendGenericResult(buffer, tail, &(commands[i]), 0);
+            i++;
+        }
+    }
+
+    return error;
+}
+
+int obix_server_batch(Response* response, IXML_Element* input)
+{
+    int count = 0;
+    IXML_Node* node = ixmlNode_getFirstChild(ixmlElement_getNode(input));
+    for (; node != NULL; node = ixmlNode_getNextSibling(node))
+    {
+        if (ixmlNode_convertToElement(node) != NULL)
+        {
+            count++;
+        }
+    }
+
+    // the list of updated objects can't be longer than the list of commands
+    Batch_Command* commands =
+        (Batch_Command*) malloc((count + 1) * sizeof(Batch_Command));
+    IXML_Element** updated =
+        (IXML_Element**) malloc((count + 1) * sizeof(IXML_Element*));
+    if ((commands == NULL) || (updated == NULL))
+    {
+        log_error("Unable to handle Batch: not enough memory.");
+        free(commands);
+        free(updated);
+        return -2;
+    }
+
+    if (parseBatchCommands(input, commands) < 0)
+    {
+        free(commands);
+        free(updated);
+        return -1;
+    }
+
+    String_Buffer* buffer =
+        strbuf_create(BATCH_RESULT_SIZE * (count + 1));
+    int error = (buffer == NULL) ? -1 : 0;
+    if (error == 0)
+    {
+        error = appendBatchPrefix(buffer, response->binary);
+    }
+    Response* tail = response;
+    if (error == 0)
+    {
+        error = executeBatchCommands(buffer, &tail, commands, count,
+                                     updated);
+    }
+    if (error == 0)
+    {
+        error = response->binary ? obixBinary_appendEnd(buffer) :
+                strbuf_append(buffer, BATCH_OUT_POSTFIX);
+    }
+    free(commands);
+    free(updated);
+
+    if (error != 0)
+    {
+        log_error("Unable to handle Batch: not enough memory.");
+        strbuf_free(buffer);
+        // error message will be sent instead of remote operation results
+        obixContinuation_cancelResponse(response);
+        return -2;
+    }
+
+    // all results are sent as a single body, unless some remote operations
+    // split it into several parts
+    int length = buffer->length;
+    if (tail->binary)
+    {
+        obixResponse_setBinary(tail, strbuf_release(buffer), length);
+    }
+    else
+    {
+        obixResponse_setText(tail, strbuf_release(buffer), FALSE);
+    }
+    return 0;
+}
+
+void obix_server_lock()
+{
+    pthread_mutex_lock(&_serverMutex);
+}
+
+void obix_server_unlock()
+{
+    pthread_mutex_unlock(&_serverMutex);
+}
+
 void obix_server_shutdown()
 {
     //TODO release post handlers;
     log_debug("Stopping oBIX server...");
+    // pending remote operation invocations are answered before their
+    // subscribers are removed
+    obixContinuation_dispose();
     xmldb_dispose();
     obixWatch_dispose();
+    obixObjectStats_reset();
 }
 
 /**
@@ -409,7 +1433,7 @@ static char* normalizeUri(Response* response,
 
 /**
  * Adds standard attributes to the parent node of the document and
- * returns its string representation.
+ * returns its string or binary representation.
  * - Modifies 'href' attribute to contain full URI including server address
  * - Adds following attributes:
  *    - xmlns:xsi="http://www.w3.org/2001/XMLSchema-instance"
@@ -422,13 +1446,16 @@ static char* normalizeUri(Response* response,
  * @param addXmlns Defines whether XML namespace attributes would be added.
  * @param saveChanges If TRUE saves changes in the original DOM structure,
  *                    otherwise modifies a copy.
+ * @param binaryLength If not @a NULL, the document is binary encoded (see
+ *                    obix_binary.h) and length of the result is returned here.
  * @return string representation of the document. <b>Don't forget</b> to free
  *         memory after usage.
  */
 static char* normalizeObixDocument(IXML_Element* oBIXdoc,
                                    const char* fullUri,
                                    BOOL addXmlns,
-                                   BOOL saveChanges)
+                                   BOOL saveChanges,
+                                   int* binaryLength)
 {
     if (!saveChanges)
     {
@@ -469,7 +1496,24 @@ static char* normalizeObixDocument(IXML_Element* oBIXdoc,
 
     xmldb_deleteMetaInfo(oBIXdoc);
 
-    char* text = ixmlPrintNode(ixmlElement_getNode(oBIXdoc));
+    char* text = NULL;
+    if (binaryLength == NULL)
+    {
+        text = ixmlPrintNode(ixmlElement_getNode(oBIXdoc));
+    }
+    else
+    {
+        String_Buffer* buffer = strbuf_create(DEFAULT_BINARY_BUFFER_SIZE);
+        if ((buffer != NULL) && (obixBinary_encode(oBIXdoc, buffer) == 0))
+        {
+            *binaryLength = buffer->length;
+            text = strbuf_release(buffer);
+        }
+        else
+        {
+            strbuf_free(buffer);
+        }
+    }
 
     if (!saveChanges)
     {
@@ -511,8 +1555,16 @@ void obix_server_generateResponse(Response* response,
         fullUri = ixmlCloneDOMString(requestUri);
     }
 
+    // namespace attributes are not needed in binary encoding
+    int binaryLength = -1;
+    unsigned long long start = obixMetrics_startTimer();
     char* text =
-        normalizeObixDocument(doc, fullUri, responseIsHead, saveChanges);
+        normalizeObixDocument(doc,
+                              fullUri,
+                              responseIsHead && !response->binary,
+                              saveChanges,
+                              response->binary ? &binaryLength : NULL);
+    obixMetrics_stopTimer(METRICS_TIMER_SERIALIZATION, start);
     if (text == NULL)
     {
         log_error("Unable to normalize the output oBIX document.");
@@ -522,7 +1574,16 @@ void obix_server_generateResponse(Response* response,
         return;
     }
 
-    obixResponse_setText(response, text, FALSE);
+    obixObjectStats_count(requestUri, OBJECT_STATS_BYTES,
+                          (binaryLength >= 0) ? binaryLength : strlen(text));
+    if (binaryLength >= 0)
+    {
+        obixResponse_setBinary(response, text, binaryLength);
+    }
+    else
+    {
+        obixResponse_setText(response, text, FALSE);
+    }
 
     if (responseIsHead && (slashFlag != 0))
     {
@@ -35,15 +35,30 @@
 
 /**
  * Initializes request processing engine.
+ * @param resourceDir Folder with server resource files (storage contents), or
+ *                    @a NULL to use the resource folder of the configuration.
  * @return @a 0 on success; @a -1 on failure.
  */
-int obix_server_init();
+int obix_server_init(const char* resourceDir);
 
 /**
  * Stops request processing engine and releases all allocated memory.
  */
 void obix_server_shutdown();
 
+/**
+ * Locks request processing engine. Requests can come from several threads
+ * (FastCGI loop, local socket clients), but they are handled one by one:
+ * every request handler should be called between #obix_server_lock and
+ * #obix_server_unlock.
+ */
+void obix_server_lock();
+
+/**
+ * Unlocks request processing engine, locked by #obix_server_lock.
+ */
+void obix_server_unlock();
+
 /**
  * Generates oBIX error object with provided attributes as a response message.
  * @param uri URI, which was requested by client.
@@ -75,6 +90,17 @@ void obix_server_handleGET(Response* response, const char* uri);
  */
 void obix_server_read(Response* response, const char* uri);
 
+/**
+ * Returns a copy of the object from the storage. Unlike #obix_server_read,
+ * the object is not serialized, so it is used by clients running in the same
+ * process with the server.
+ *
+ * @param uri URI of the object.
+ * @return Copy of the object without server meta data, or @a NULL if URI is
+ *         not found. Should be freed with #ixmlElement_freeOwnerDocument.
+ */
+IXML_Element* obix_server_readDOM(const char* uri);
+
 /**
  * Handles PUT request and sends response back to the client.
  * @param response Response object, which should be used to generate an answer.
@@ -85,6 +111,15 @@ void obix_server_handlePUT(Response* response,
                            const char* uri,
                            const char* input);
 
+/**
+ * Handles PUT request, whose input is already parsed (e.g. it was binary
+ * encoded, see obix_binary.h), and sends response back to the client.
+ * @param input Clients message. It is not freed.
+ */
+void obix_server_handlePUTDOM(Response* response,
+                              const char* uri,
+                              IXML_Element* input);
+
 /**
  * Handles write request. Puts response into the provided response object.
  */
@@ -92,6 +127,61 @@ void obix_server_write(Response* response,
                        const char* uri,
                        IXML_Element* input);
 
+/**
+ * Writes new value to the object in the storage without generating any
+ * response. Used by clients running in the same process with the server.
+ *
+ * @param uri URI of the object to be updated.
+ * @param input New state of the object.
+ * @return @li @a 0 on success;
+ *         @li @a -1 if input has wrong format;
+ *         @li @a -2 if URI is not found;
+ *         @li @a -3 if the object is not writable;
+ *         @li @a -4 on internal server error;
+ *         @li @a -5 if Watch parameter was written, but not applied.
+ */
+int obix_server_writeDOM(const char* uri, IXML_Element* input);
+
+/**
+ * Publishes new device data at the server: stores it and adds it to the device
+ * list. This is the common part of signUp operation for all clients.
+ *
+ * @param input Device data. On success its @a href attribute contains the URI
+ *              of the object in the storage.
+ * @return @li @a 0 on success;
+ *         @li @a -1 if device data is corrupted or can't be stored;
+ *         @li @a -2 if object with the same URI already exists;
+ *         @li @a -3 if device exceeds memory limits of the server;
+ *         @li @a -4 if device can't be added to the device list.
+ */
+int obix_server_signUp(IXML_Element* input);
+
+/**
+ * Removes device data, which was published with signUp operation, from the
+ * storage together with its reference in the device list. All Watch Items
+ * and local listeners monitoring the device are removed too.
+ *
+ * @param uri URI of the device data.
+ * @return @li @a 0 on success;
+ *         @li @a -1 if URI is not found;
+ *         @li @a -2 if the object is not a registered device;
+ *         @li @a -3 on internal server error.
+ */
+int obix_server_unregisterDevice(const char* uri);
+
+/**
+ * Executes Batch request. Unlike generic handlers, it resolves URIs of all
+ * commands at once, updates versions and Watches of written objects and
+ * their parents once per Batch, and puts all results into one response body.
+ * The response is not sent.
+ *
+ * @param input List of Batch commands (@a obix:BatchIn).
+ * @return @li @a 0 on success;
+ *         @li @a -1 if input contains illegal tags;
+ *         @li @a -2 on internal server error.
+ */
+int obix_server_batch(Response* response, IXML_Element* input);
+
 /**
  * Handles POST request and sends response back to the client.
  * @param response Response object, which should be used to generate an answer.
@@ -0,0 +1,490 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of the local socket interface of the server.
+ *
+ * @see socket_server.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <log_utils.h>
+#include <obix_utils.h>
+#include <xml_config.h>
+#include <local_socket.h>
+#include "server.h"
+#include "request.h"
+#include "response.h"
+#include "metrics.h"
+#include "socket_server.h"
+
+/** Name of configuration tag, which defines path to the local socket. */
+static const char* CT_LOCAL_SOCKET = "local-socket";
+/** Attribute of the local socket tag with access permissions of the socket
+ * file. */
+static const char* CTA_MODE = "mode";
+/** Default access permissions of the socket file. */
+#define DEFAULT_SOCKET_MODE 0660
+
+/** Descriptor of the listening socket. */
+static int _listenFd = -1;
+/** Path to the socket file. */
+static char* _socketPath;
+/** Thread accepting new connections. */
+static pthread_t _acceptThread;
+/** Set when server is shutting down. */
+static BOOL _stopped;
+
+/** Connected client. */
+typedef struct _Socket_Client
+{
+    /** Request object, which is used for all requests of the client. It
+     * should be the first field, so that the client can be found by the
+     * request object. */
+    Request request;
+    /** Socket connection. */
+    int fd;
+    /** Set while the response to the current request is not sent. */
+    BOOL responsePending;
+    /** Synchronizes sending of responses, which can happen in another thread
+     * (e.g. for long poll requests). */
+    pthread_mutex_t mutex;
+    /** Signaled when response is sent. */
+    pthread_cond_t responseSent;
+    /** Set when the thread of the client has exited. If the response is
+     * still pending then, the client is released when it is sent. */
+    BOOL finished;
+    /** Previous client in the list of connected clients. */
+    struct _Socket_Client* prev;
+    /** Next client in the list of connected clients. */
+    struct _Socket_Client* next;
+}
+Socket_Client;
+
+/** List of clients whose threads are running. */
+static Socket_Client* _clients;
+/** Synchronizes access to the list of clients. */
+static pthread_mutex_t _clientsMutex = PTHREAD_MUTEX_INITIALIZER;
+/** Signaled when a client is removed from the list. */
+static pthread_cond_t _clientsChanged = PTHREAD_COND_INITIALIZER;
+
+/** Closes connection of the client and releases it. */
+static void freeClient(Socket_Client* client)
+{
+    close(client->fd);
+    pthread_mutex_destroy(&(client->mutex));
+    pthread_cond_destroy(&(client->responseSent));
+    free(client);
+}
+
+/** Sends error frame, which tells that the request was not processed. */
+static void sendErrorFrame(Socket_Client* client, const char* message)
+{
+    int length = strlen(message);
+    lsocket_writeFrame(client->fd, LSOCKET_ERROR, NULL, &message, &length, 1);
+}
+
+/**
+ * Sends response to the client. Implements #obix_response_listener
+ * prototype.
+ */
+static void sendSocketResponse(Response* response)
+{
+    Socket_Client* client = (Socket_Client*) response->request;
+    Response* iterator;
+    int count = 0;
+
+    for (iterator = response; iterator != NULL; iterator = iterator->next)
+    {
+        count++;
+    }
+
+    // all parts are sent with one call without copying
+    const char* parts[count];
+    int lengths[count];
+    long totalLength = 0;
+    count = 0;
+    for (iterator = response; iterator != NULL; iterator = iterator->next)
+    {
+        if (iterator->body == NULL)
+        {
+            log_error("Attempt to send empty response.");
+            obixResponse_setError(iterator,
+                                  "Request handler returned empty response.");
+            if (iterator->body == NULL)
+            {
+                continue;
+            }
+        }
+        parts[count] = iterator->body;
+        lengths[count] = strlen(iterator->body);
+        totalLength += lengths[count];
+        count++;
+    }
+    obixMetrics_add(METRICS_BYTES_OUT, totalLength);
+
+    if (lsocket_writeFrame(client->fd, LSOCKET_RESPONSE, response->uri,
+                           parts, lengths, count) != 0)
+    {
+        log_warning("Unable to send response to the local socket client.");
+    }
+    obixResponse_free(response);
+
+    pthread_mutex_lock(&(client->mutex));
+    client->responsePending = FALSE;
+    BOOL release = client->finished;
+    pthread_cond_signal(&(client->responseSent));
+    pthread_mutex_unlock(&(client->mutex));
+
+    if (release)
+    {   // client thread was stopped while the request was held
+        freeClient(client);
+    }
+}
+
+/**
+ * Handles one request of the client and waits until the response is sent.
+ */
+static void handleRequest(Socket_Client* client,
+                          LSOCKET_FRAME_TYPE type,
+                          const char* uri,
+                          const char* input)
+{
+    if (*uri != '/')
+    {
+        log_error("Request URI \"%s\" has wrong format: "
+                  "Should start with \'/\'.", uri);
+        sendErrorFrame(client, "Request URI should be absolute.");
+        return;
+    }
+
+    Response* response = obixResponse_create(&(client->request));
+    if (response == NULL)
+    {
+        log_error("Unable to create response object: Not enough memory.");
+        sendErrorFrame(client, "Not enough memory.");
+        return;
+    }
+
+    client->responsePending = TRUE;
+    obix_server_lock();
+    switch (type)
+    {
+    case LSOCKET_GET:
+        obix_server_handleGET(response, uri);
+        break;
+    case LSOCKET_PUT:
+        obix_server_handlePUT(response, uri, input);
+        break;
+    case LSOCKET_POST:
+        obix_server_handlePOST(response, uri, input);
+        break;
+    default:
+        log_warning("Unknown request type: %d. Request is ignored.", type);
+        obix_server_generateObixErrorMessage(response,
+                                             uri,
+                                             OBIX_CONTRACT_ERR_UNSUPPORTED,
+                                             "Unsupported Request",
+                                             "Request type is not supported "
+                                             "by oBIX server.");
+        obixResponse_send(response);
+        break;
+    }
+    obix_server_unlock();
+
+    // held requests (e.g. long poll) are answered later by another thread,
+    // unless the interface is stopped meanwhile
+    pthread_mutex_lock(&(client->mutex));
+    while (client->responsePending && !_stopped)
+    {
+        pthread_cond_wait(&(client->responseSent), &(client->mutex));
+    }
+    pthread_mutex_unlock(&(client->mutex));
+}
+
+/** Receives requests from one client until it closes the connection. */
+static void* clientCycle(void* arg)
+{
+    Socket_Client* client = (Socket_Client*) arg;
+    Local_Socket_Header header;
+
+    while (lsocket_readHeader(client->fd, &header) == 0)
+    {
+        char* uri = (char*) malloc(header.uriLength + 1);
+        char* input = NULL;
+        if (header.bodyLength > 0)
+        {
+            input = (char*) malloc(header.bodyLength + 1);
+        }
+        if ((uri == NULL) || ((header.bodyLength > 0) && (input == NULL)))
+        {
+            log_error("Unable to receive request from local socket: "
+                      "Not enough memory.");
+            if (uri != NULL)
+                free(uri);
+            if (input != NULL)
+                free(input);
+            break;
+        }
+
+        if ((lsocket_read(client->fd, uri, header.uriLength) != 0)
+                || ((input != NULL)
+                    && (lsocket_read(client->fd, input,
+                                     header.bodyLength) != 0)))
+        {
+            free(uri);
+            if (input != NULL)
+                free(input);
+            break;
+        }
+        uri[header.uriLength] = '\0';
+        if (input != NULL)
+        {
+            input[header.bodyLength] = '\0';
+        }
+        obixMetrics_add(METRICS_BYTES_IN, header.bodyLength);
+
+        handleRequest(client, header.type, uri, input);
+
+        free(uri);
+        if (input != NULL)
+            free(input);
+    }
+
+    log_debug("Local socket client disconnected.");
+    pthread_mutex_lock(&(client->mutex));
+    client->finished = TRUE;
+    BOOL release = !client->responsePending;
+    pthread_mutex_unlock(&(client->mutex));
+
+    pthread_mutex_lock(&_clientsMutex);
+    if (client->prev != NULL)
+    {
+        client->prev->next = client->next;
+    }
+    else
+    {
+        _clients = client->next;
+    }
+    if (client->next != NULL)
+    {
+        client->next->prev = client->prev;
+    }
+    pthread_cond_broadcast(&_clientsChanged);
+    pthread_mutex_unlock(&_clientsMutex);
+
+    if (release)
+    {
+        freeClient(client);
+    }
+    return NULL;
+}
+
+/** Starts serving new client connection. */
+static void startClient(int fd)
+{
+    Socket_Client* client = (Socket_Client*) malloc(sizeof(Socket_Client));
+    if (client == NULL)
+    {
+        log_error("Unable to accept local socket client: Not enough memory.");
+        close(fd);
+        return;
+    }
+
+    obixRequest_initLocal(&(client->request), &sendSocketResponse);
+    client->fd = fd;
+    client->responsePending = FALSE;
+    client->finished = FALSE;
+    client->prev = NULL;
+    pthread_mutex_init(&(client->mutex), NULL);
+    pthread_cond_init(&(client->responseSent), NULL);
+
+    // the client is added to the list before its thread is started, so that
+    // the thread can always remove it
+    pthread_mutex_lock(&_clientsMutex);
+    client->next = _clients;
+    if (_clients != NULL)
+    {
+        _clients->prev = client;
+    }
+    _clients = client;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &clientCycle, client) != 0)
+    {
+        log_error("Unable to start thread for local socket client.");
+        _clients = client->next;
+        if (_clients != NULL)
+        {
+            _clients->prev = NULL;
+        }
+        pthread_mutex_unlock(&_clientsMutex);
+        freeClient(client);
+        return;
+    }
+    pthread_mutex_unlock(&_clientsMutex);
+    pthread_detach(thread);
+    log_debug("Local socket client connected.");
+}
+
+/** Accepts new connections until the server is stopped. */
+static void* acceptCycle(void* arg)
+{
+    while (!_stopped)
+    {
+        int fd = accept(_listenFd, NULL, NULL);
+        if (fd < 0)
+        {
+            if ((errno == EINTR) || (errno == ECONNABORTED))
+            {
+                continue;
+            }
+            if (!_stopped)
+            {
+                log_error("Local socket interface is stopped: "
+                          "accept() failed: %s", strerror(errno));
+            }
+            break;
+        }
+
+        startClient(fd);
+    }
+
+    return NULL;
+}
+
+/** Stops threads of all connected clients and waits until they exit. */
+static void stopClients()
+{
+    Socket_Client* client;
+
+    pthread_mutex_lock(&_clientsMutex);
+    for (client = _clients; client != NULL; client = client->next)
+    {
+        // wakes up the thread either waiting for the next request, or for
+        // the response to a held one (_stopped is already set)
+        pthread_mutex_lock(&(client->mutex));
+        shutdown(client->fd, SHUT_RDWR);
+        pthread_cond_broadcast(&(client->responseSent));
+        pthread_mutex_unlock(&(client->mutex));
+    }
+    while (_clients != NULL)
+    {
+        pthread_cond_wait(&_clientsChanged, &_clientsMutex);
+    }
+    pthread_mutex_unlock(&_clientsMutex);
+}
+
+int obixSocket_init(IXML_Element* settings)
+{
+    IXML_Element* element = config_getChildTag(settings,
+                                               CT_LOCAL_SOCKET,
+                                               FALSE);
+    if (element == NULL)
+    {
+        log_debug("Local socket interface is disabled.");
+        return 0;
+    }
+    const char* path = config_getTagAttributeValue(element, CTA_VALUE, TRUE);
+    if (path == NULL)
+    {
+        return -1;
+    }
+
+    // access permissions are written as an octal number
+    long mode = DEFAULT_SOCKET_MODE;
+    const char* modeValue = config_getTagAttributeValue(element,
+                                                        CTA_MODE,
+                                                        FALSE);
+    if (modeValue != NULL)
+    {
+        char* end;
+        mode = strtol(modeValue, &end, 8);
+        if ((*modeValue == '\0') || (*end != '\0')
+                || (mode < 0) || (mode > 0777))
+        {
+            log_error("Attribute \"%s\" of configuration tag <%s/> should "
+                      "contain octal file permissions (e.g. \"660\").",
+                      CTA_MODE, CT_LOCAL_SOCKET);
+            return -1;
+        }
+    }
+
+    _socketPath = (char*) malloc(strlen(path) + 1);
+    if (_socketPath == NULL)
+    {
+        log_error("Unable to start local socket interface: "
+                  "Not enough memory.");
+        return -1;
+    }
+    strcpy(_socketPath, path);
+
+    _listenFd = lsocket_listen(_socketPath, (mode_t) mode);
+    if (_listenFd < 0)
+    {
+        free(_socketPath);
+        _socketPath = NULL;
+        return -1;
+    }
+
+    _stopped = FALSE;
+    if (pthread_create(&_acceptThread, NULL, &acceptCycle, NULL) != 0)
+    {
+        log_error("Unable to start local socket interface thread.");
+        // there is no thread to be stopped
+        _stopped = TRUE;
+        obixSocket_shutdown();
+        return -1;
+    }
+
+    log_debug("Listening for requests at local socket %s.", _socketPath);
+    return 0;
+}
+
+void obixSocket_shutdown()
+{
+    if (_listenFd < 0)
+    {
+        return;
+    }
+
+    if (!_stopped)
+    {
+        _stopped = TRUE;
+        // wake up the accepting thread
+        shutdown(_listenFd, SHUT_RDWR);
+        pthread_join(_acceptThread, NULL);
+    }
+    stopClients();
+    close(_listenFd);
+    _listenFd = -1;
+    unlink(_socketPath);
+    free(_socketPath);
+    _socketPath = NULL;
+}
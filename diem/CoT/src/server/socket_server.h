@@ -0,0 +1,63 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Defines local socket interface of the server.
+ *
+ * Clients running at the same machine can send requests to the server
+ * through a Unix domain socket, avoiding HTTP and FastCGI overhead. Messages
+ * are exchanged in binary frames defined at local_socket.h. Every connected
+ * client is served by its own thread, but requests are handled one by one
+ * together with FastCGI requests (see #obix_server_lock).
+ *
+ * The interface is enabled by optional tag of the server configuration file:
+ * @code
+ * <local-socket val="/tmp/obix.sock" mode="660"/>
+ * @endcode
+ * Optional attribute @a mode sets access permissions of the socket file
+ * (octal, @a 660 by default).
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef SOCKET_SERVER_H_
+#define SOCKET_SERVER_H_
+
+#include <ixml_ext.h>
+
+/**
+ * Starts listening at the local socket if it is defined in the server
+ * settings. Does nothing otherwise.
+ *
+ * @param settings Server configuration.
+ * @return @a 0 on success; @a -1 on error.
+ */
+int obixSocket_init(IXML_Element* settings);
+
+/**
+ * Stops accepting new connections at the local socket, disconnects all
+ * clients and removes the socket file. Waits until threads of all clients
+ * exit. Held requests of disconnected clients are dropped when they are
+ * answered, so the function should be called before #obix_server_shutdown.
+ */
+void obixSocket_shutdown();
+
+#endif /* SOCKET_SERVER_H_ */
@@ -0,0 +1,474 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of memory accounting of devices.
+ *
+ * Devices are kept in an open addressing hash table with their URI as a
+ * key, so that writes find their device in constant time regardless of the
+ * number of registered devices. The table grows twice when it becomes half
+ * full. The device of an updated object is found by walking up to the
+ * topmost object of the storage, which is the root of the device data.
+ *
+ * @see storage_usage.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <log_utils.h>
+#include <obix_utils.h>
+#include <str_buffer.h>
+#include "metrics.h"
+#include "storage_usage.h"
+
+/** Maximum length of one line of the generated report (without URI). */
+#define LINE_SIZE 128
+
+/** Estimated size of a node structure together with allocator overhead.
+ * Element and attribute nodes of IXML have nearly the same size. */
+#define NODE_OVERHEAD ((long) sizeof(IXML_Element) + 16)
+
+/** Initial size of the device table. */
+#define TABLE_SIZE_INITIAL 16
+
+/** Memory usage of one device. */
+typedef struct
+{
+    /** URI of the device, or @a NULL if the slot is free. */
+    char* href;
+    unsigned int hash;
+    long bytes;
+    long objects;
+}
+Device_Usage;
+
+/** Hash table of registered devices. */
+static Device_Usage* _devices = NULL;
+/** Size of #_devices; always a power of two. */
+static int _capacity = 0;
+static int _deviceCount = 0;
+
+static long _deviceMax = 0;
+static long _totalMax = 0;
+static long _totalBytes = 0;
+static long _totalObjects = 0;
+
+void obixUsage_setLimits(long deviceMax, long totalMax)
+{
+    _deviceMax = (deviceMax > 0) ? deviceMax : 0;
+    _totalMax = (totalMax > 0) ? totalMax : 0;
+}
+
+/** Estimates memory used by a string stored in a node. */
+static long getStringSize(const char* str)
+{
+    return (str == NULL) ? 0 : (long) strlen(str) + 1;
+}
+
+/** Recursive part of #obixUsage_measure. */
+static long measureNode(IXML_Node* node, long* objects)
+{
+    long size = NODE_OVERHEAD
+                + getStringSize(ixmlNode_getNodeName(node))
+                + getStringSize(ixmlNode_getNodeValue(node));
+    if (ixmlNode_convertToElement(node) != NULL)
+    {
+        (*objects)++;
+    }
+
+    // attributes are walked directly, without IXML_NamedNodeMap
+    IXML_Node* attr;
+    for (attr = node->firstAttr; attr != NULL; attr = attr->nextSibling)
+    {
+        size += NODE_OVERHEAD
+                + getStringSize(ixmlNode_getNodeName(attr))
+                + getStringSize(ixmlNode_getNodeValue(attr));
+    }
+
+    IXML_Node* child;
+    for (child = ixmlNode_getFirstChild(node);
+            child != NULL;
+            child = ixmlNode_getNextSibling(child))
+    {
+        size += measureNode(child, objects);
+    }
+
+    return size;
+}
+
+long obixUsage_measure(IXML_Element* element, long* objects)
+{
+    long count = 0;
+    long size = measureNode(ixmlElement_getNode(element), &count);
+    if (objects != NULL)
+    {
+        *objects = count;
+    }
+    return size;
+}
+
+/** Checks that a device can grow by @a delta bytes. */
+static int checkLimits(long deviceBytes, long delta)
+{
+    if ((_deviceMax > 0) && (deviceBytes + delta > _deviceMax))
+    {
+        return -1;
+    }
+    if ((_totalMax > 0) && (_totalBytes + delta > _totalMax))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/** Publishes totals to the server metrics. */
+static void updateMetrics()
+{
+    obixMetrics_set(METRICS_DEVICE_BYTES, _totalBytes);
+    obixMetrics_set(METRICS_DEVICE_OBJECTS, _totalObjects);
+}
+
+int obixUsage_checkDevice(long bytes)
+{
+    if (checkLimits(0, bytes) != 0)
+    {
+        log_warning("Device data (%ld bytes) exceeds memory limits of the "
+                    "storage: %ld bytes per device, %ld of %ld bytes in total "
+                    "are used.", bytes, _deviceMax, _totalBytes, _totalMax);
+        return -1;
+    }
+    return 0;
+}
+
+/** FNV-1a hash of the string. */
+static unsigned int getHash(const char* str)
+{
+    unsigned int hash = 2166136261u;
+    for (; *str != '\0'; str++)
+    {
+        hash ^= (unsigned char) *str;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Finds slot of the device in the table, or free slot where the device
+ * should be put.
+ */
+static Device_Usage* findSlot(const char* href, unsigned int hash)
+{
+    int mask = _capacity - 1;
+    int i;
+    for (i = hash & mask; _devices[i].href != NULL; i = (i + 1) & mask)
+    {
+        if ((_devices[i].hash == hash) && (strcmp(_devices[i].href, href) == 0))
+        {
+            break;
+        }
+    }
+    return &(_devices[i]);
+}
+
+/**
+ * Allocates the table of the provided size and moves all devices there.
+ * @return @a 0 on success, @a -1 if there is not enough memory.
+ */
+static int resizeTable(int capacity)
+{
+    Device_Usage* old = _devices;
+    int oldCapacity = _capacity;
+    _devices = (Device_Usage*) calloc(capacity, sizeof(Device_Usage));
+    if (_devices == NULL)
+    {
+        _devices = old;
+        return -1;
+    }
+    _capacity = capacity;
+
+    int i;
+    for (i = 0; i < oldCapacity; i++)
+    {
+        if (old[i].href != NULL)
+        {
+            *findSlot(old[i].href, old[i].hash) = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+/**
+ * Removes the device from the table. Following slots of the same cluster
+ * are shifted back, so that lookups never need deleted markers.
+ */
+static void removeSlot(Device_Usage* usage)
+{
+    int mask = _capacity - 1;
+    int slot = usage - _devices;
+    int i = slot;
+    for (;;)
+    {
+        _devices[slot].href = NULL;
+        int home;
+        do
+        {
+            i = (i + 1) & mask;
+            if (_devices[i].href == NULL)
+            {
+                return;
+            }
+            home = _devices[i].hash & mask;
+        }
+        // device stays if its home slot lies cyclically in (slot, i]
+        while ((slot <= i) ? ((slot < home) && (home <= i))
+                : ((slot < home) || (home <= i)));
+        _devices[slot] = _devices[i];
+        slot = i;
+    }
+}
+
+int obixUsage_addDevice(const char* href, long bytes, long objects)
+{
+    if ((_deviceCount + 1) * 2 > _capacity)
+    {
+        int capacity = (_capacity == 0) ? TABLE_SIZE_INITIAL : _capacity * 2;
+        if (resizeTable(capacity) != 0)
+        {
+            log_error("Unable to account device memory: "
+                      "Not enough memory.");
+            return -1;
+        }
+    }
+
+    unsigned int hash = getHash(href);
+    Device_Usage* usage = findSlot(href, hash);
+    if (usage->href != NULL)
+    {
+        // device is registered again (should not happen), replace old values
+        _totalBytes -= usage->bytes;
+        _totalObjects -= usage->objects;
+    }
+    else
+    {
+        usage->href = strdup(href);
+        if (usage->href == NULL)
+        {
+            log_error("Unable to account device memory: "
+                      "Not enough memory.");
+            return -1;
+        }
+        usage->hash = hash;
+        _deviceCount++;
+    }
+
+    usage->bytes = bytes;
+    usage->objects = objects;
+    _totalBytes += bytes;
+    _totalObjects += objects;
+    updateMetrics();
+    return 0;
+}
+
+void obixUsage_removeDevice(const char* href)
+{
+    if (_deviceCount == 0)
+    {
+        return;
+    }
+
+    Device_Usage* usage = findSlot(href, getHash(href));
+    if (usage->href == NULL)
+    {
+        return;
+    }
+
+    _totalBytes -= usage->bytes;
+    _totalObjects -= usage->objects;
+    free(usage->href);
+    removeSlot(usage);
+    _deviceCount--;
+    updateMetrics();
+}
+
+/**
+ * Returns the device, which contains the object, or @a NULL if the object
+ * doesn't belong to any registered device.
+ */
+static Device_Usage* getDevice(IXML_Element* object)
+{
+    if (_deviceCount == 0)
+    {
+        return NULL;
+    }
+
+    // device data is stored at the root of the storage document, thus the
+    // topmost object is the one, whose parent has no parent
+    IXML_Node* node = ixmlElement_getNode(object);
+    IXML_Node* parent = ixmlNode_getParentNode(node);
+    if (parent == NULL)
+    {   // object is not in the storage
+        return NULL;
+    }
+    IXML_Node* grandParent;
+    while ((grandParent = ixmlNode_getParentNode(parent)) != NULL)
+    {
+        node = parent;
+        parent = grandParent;
+    }
+
+    const char* href = ixmlElement_getAttribute(
+                           ixmlNode_convertToElement(node), OBIX_ATTR_HREF);
+    if (href == NULL)
+    {
+        return NULL;
+    }
+    Device_Usage* usage = findSlot(href, getHash(href));
+    return (usage->href != NULL) ? usage : NULL;
+}
+
+int obixUsage_resize(IXML_Element* object, long delta)
+{
+    Device_Usage* usage = getDevice(object);
+    if (usage == NULL)
+    {
+        return 0;
+    }
+
+    if ((delta > 0) && (checkLimits(usage->bytes, delta) != 0))
+    {
+        log_warning("Unable to grow device data by %ld bytes: The device "
+                    "uses %ld bytes (limit %ld), all devices use %ld bytes "
+                    "(limit %ld).", delta, usage->bytes, _deviceMax,
+                    _totalBytes, _totalMax);
+        return -1;
+    }
+
+    usage->bytes += delta;
+    _totalBytes += delta;
+    updateMetrics();
+    return 0;
+}
+
+/** Compares report entries by size, the biggest first. */
+static int compareEntries(const void* first, const void* second)
+{
+    long a = (*((const Device_Usage**) first))->bytes;
+    long b = (*((const Device_Usage**) second))->bytes;
+    return (a < b) ? 1 : ((a > b) ? -1 : 0);
+}
+
+char* obixUsage_toObix(const char* href, int count)
+{
+    String_Buffer* buffer = strbuf_create(4096);
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    int devices = _deviceCount;
+    const Device_Usage** sorted = NULL;
+    if (devices > 0)
+    {
+        sorted = (const Device_Usage**) malloc(
+                     devices * sizeof(Device_Usage*));
+        if (sorted == NULL)
+        {
+            strbuf_free(buffer);
+            return NULL;
+        }
+    }
+    int i;
+    int found = 0;
+    for (i = 0; (i < _capacity) && (found < devices); i++)
+    {
+        if (_devices[i].href != NULL)
+        {
+            sorted[found++] = &(_devices[i]);
+        }
+    }
+    if (devices > 1)
+    {
+        qsort(sorted, devices, sizeof(Device_Usage*), &compareEntries);
+    }
+    if (count > devices)
+    {
+        count = devices;
+    }
+
+    char line[LINE_SIZE];
+    int error = strbuf_append(buffer, "<obj href=\"");
+    error += strbuf_appendXml(buffer, href);
+    error += strbuf_append(buffer, "\" displayName=\"Device Memory\">\r\n");
+    sprintf(line, "  <int name=\"devices\" val=\"%d\"/>\r\n"
+            "  <int name=\"bytes\" val=\"%ld\"/>\r\n"
+            "  <int name=\"objects\" val=\"%ld\"/>\r\n",
+            devices, _totalBytes, _totalObjects);
+    error += strbuf_append(buffer, line);
+    sprintf(line, "  <int name=\"deviceMax\" val=\"%ld\"/>\r\n"
+            "  <int name=\"totalMax\" val=\"%ld\"/>\r\n",
+            _deviceMax, _totalMax);
+    error += strbuf_append(buffer, line);
+    error += strbuf_append(buffer, "  <list name=\"top\" of=\"obix:obj\">\r\n");
+
+    for (i = 0; (i < count) && (error == 0); i++)
+    {
+        error += strbuf_append(buffer, "    <obj>\r\n"
+                               "      <uri name=\"device\" val=\"");
+        error += strbuf_appendXml(buffer, sorted[i]->href);
+        sprintf(line, "\"/>\r\n"
+                "      <int name=\"bytes\" val=\"%ld\"/>\r\n"
+                "      <int name=\"objects\" val=\"%ld\"/>\r\n"
+                "    </obj>\r\n",
+                sorted[i]->bytes, sorted[i]->objects);
+        error += strbuf_append(buffer, line);
+    }
+    free(sorted);
+
+    error += strbuf_append(buffer, "  </list>\r\n</obj>\r\n");
+    if (error != 0)
+    {
+        strbuf_free(buffer);
+        return NULL;
+    }
+    return strbuf_release(buffer);
+}
+
+void obixUsage_reset()
+{
+    int i;
+    for (i = 0; i < _capacity; i++)
+    {
+        free(_devices[i].href);
+    }
+    free(_devices);
+    _devices = NULL;
+    _capacity = 0;
+    _deviceCount = 0;
+
+    _totalBytes = 0;
+    _totalObjects = 0;
+    updateMetrics();
+}
@@ -0,0 +1,117 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Defines memory accounting of devices, registered at the server.
+ *
+ * For every device added by signUp or signUpDevices operation the storage
+ * keeps the number of its objects and the estimated amount of memory used by
+ * them. The estimate includes IXML node structures and all strings of the
+ * device subtree; it is updated when a device is registered, unregistered
+ * and when values of its objects change length.
+ *
+ * Optional limits protect the server from running out of memory: a device
+ * which is bigger than the per-device limit, or which doesn't fit to the
+ * total limit of all devices, is rejected at sign up, and writes, which
+ * would grow a device over the limits, fail. Limits are set in bytes by
+ * optional tags of the server configuration (@a 0 means no limit):
+ * @code
+ * <device-memory-max val="1048576"/>
+ * <total-memory-max val="67108864"/>
+ * @endcode
+ *
+ * Usage of the biggest devices is available at @a /obix-metrics/devices URI;
+ * totals are also reported among other server metrics (see metrics.h).
+ *
+ * Functions of this module are not thread safe: they are called by the
+ * storage, which is always accessed under the server lock.
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef STORAGE_USAGE_H_
+#define STORAGE_USAGE_H_
+
+#include <ixml_ext.h>
+
+/** Default number of devices in the report. */
+#define STORAGE_USAGE_TOP_DEFAULT 20
+
+/**
+ * Sets memory limits in bytes. @a 0 disables the limit.
+ * @param deviceMax Maximum size of one device.
+ * @param totalMax Maximum size of all devices together.
+ */
+void obixUsage_setLimits(long deviceMax, long totalMax);
+
+/**
+ * Estimates memory, which is used by the object and all its children.
+ * @param objects If not @a NULL, number of objects in the subtree is
+ *                returned here.
+ * @return Estimated size in bytes.
+ */
+long obixUsage_measure(IXML_Element* element, long* objects);
+
+/**
+ * Checks whether a new device of the provided size can be stored.
+ * @return @a 0 if the device fits to the limits, @a -1 otherwise.
+ */
+int obixUsage_checkDevice(long bytes);
+
+/**
+ * Starts accounting of the registered device.
+ * @param href URI of the device.
+ * @param bytes Size of the device returned by #obixUsage_measure.
+ * @param objects Number of objects of the device.
+ * @return @a 0 on success, @a -1 if there is not enough memory.
+ */
+int obixUsage_addDevice(const char* href, long bytes, long objects);
+
+/**
+ * Stops accounting of the device, which is unregistered.
+ */
+void obixUsage_removeDevice(const char* href);
+
+/**
+ * Changes size of the device, which contains the object. Objects, which
+ * don't belong to registered devices, are ignored.
+ *
+ * @param object Object in the storage, which is going to be changed.
+ * @param delta Change of the object size in bytes.
+ * @return @a 0 on success, @a -1 if growth of the device is not allowed by
+ *         the limits. Shrinking always succeeds.
+ */
+int obixUsage_resize(IXML_Element* object, long delta);
+
+/**
+ * Generates oBIX object with the memory usage of the biggest devices.
+ *
+ * @param href URI of the generated object.
+ * @param count Maximum number of reported devices.
+ * @return Text of the object, which should be freed by the caller, or
+ *         @a NULL if there is not enough memory.
+ */
+char* obixUsage_toObix(const char* href, int count);
+
+/** Forgets all devices and releases memory of the accounting. */
+void obixUsage_reset();
+
+#endif /* STORAGE_USAGE_H_ */
@@ -0,0 +1,260 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Implementation of request capturing.
+ *
+ * @see trace.h
+ *
+ * @author Andrey Litvinov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <log_utils.h>
+#include "trace.h"
+
+/** Size of the file buffer. Records are flushed to the file when it is full. */
+#define TRACE_BUFFER_SIZE 65536
+
+/** Maximum size of encoded number. */
+#define NUMBER_MAX_LENGTH 10
+
+/** Names of FastCGI parameters which are recorded together with requests,
+ * because the response depends on them. */
+static const char* TRACE_PARAMS[] =
+    {
+        "CONTENT_TYPE",
+        "HTTP_ACCEPT",
+        "HTTP_ACCEPT_ENCODING",
+        "HTTP_IF_NONE_MATCH",
+        NULL
+    };
+
+/** Maximum amount of recorded parameters. */
+#define TRACE_PARAMS_MAX 8
+
+/** Opened trace file, or @a NULL if capturing is disabled. */
+static FILE* _file = NULL;
+
+/** Time of the previous record in microseconds. */
+static long long _lastTime;
+
+/** Returns current time in microseconds. */
+static long long getTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return ((long long) time.tv_sec * 1000000) + (time.tv_nsec / 1000);
+}
+
+/** Writes number to the buffer in LEB128 format and returns its length. */
+static int writeNumber(unsigned char* buffer, unsigned long long value)
+{
+    int length = 0;
+    do
+    {
+        buffer[length] = value & 0x7f;
+        value >>= 7;
+        if (value != 0)
+        {
+            buffer[length] |= 0x80;
+        }
+        length++;
+    }
+    while (value != 0);
+
+    return length;
+}
+
+/**
+ * Writes length of the string in LEB128 format followed by the string itself.
+ * @return @a 0 on success, @a -1 on error.
+ */
+static int writeString(const char* string, int length)
+{
+    unsigned char header[NUMBER_MAX_LENGTH];
+    int headerLength = writeNumber(header, length);
+    if ((fwrite(header, 1, headerLength, _file) != headerLength) ||
+            ((length > 0) && (fwrite(string, 1, length, _file) != length)))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Looks for the parameter in the list of "NAME=value" strings.
+ * @return Parameter value, or @a NULL if it is not found.
+ */
+static const char* getParam(char** envp, const char* name)
+{
+    if (envp == NULL)
+    {
+        return NULL;
+    }
+
+    int nameLength = strlen(name);
+    for ( ; *envp != NULL; envp++)
+    {
+        if ((strncmp(*envp, name, nameLength) == 0) &&
+                ((*envp)[nameLength] == '='))
+        {
+            return *envp + nameLength + 1;
+        }
+    }
+    return NULL;
+}
+
+static int getMethodCode(const char* method)
+{
+    if (strcmp(method, "GET") == 0)
+    {
+        return TRACE_METHOD_GET;
+    }
+    if (strcmp(method, "PUT") == 0)
+    {
+        return TRACE_METHOD_PUT;
+    }
+    if (strcmp(method, "POST") == 0)
+    {
+        return TRACE_METHOD_POST;
+    }
+    return 0;
+}
+
+int obixTrace_open(const char* fileName)
+{
+    obixTrace_close();
+
+    _file = fopen(fileName, "wb");
+    if (_file == NULL)
+    {
+        log_error("Unable to open trace file \"%s\".", fileName);
+        return -1;
+    }
+    setvbuf(_file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+    unsigned char version = TRACE_VERSION;
+    if ((fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LENGTH, _file) !=
+            TRACE_MAGIC_LENGTH) || (fwrite(&version, 1, 1, _file) != 1))
+    {
+        log_error("Unable to write to trace file \"%s\".", fileName);
+        fclose(_file);
+        _file = NULL;
+        return -1;
+    }
+
+    _lastTime = getTime();
+    log_debug("Requests are captured to \"%s\".", fileName);
+    return 0;
+}
+
+void obixTrace_write(const char* method,
+                     const char* uri,
+                     const char* query,
+                     char** envp,
+                     const char* body,
+                     int bodyLength)
+{
+    if (_file == NULL)
+    {
+        return;
+    }
+
+    int methodCode = getMethodCode(method);
+    if (methodCode == 0)
+    {
+        return;
+    }
+
+    long long now = getTime();
+    int pathLength = strlen(uri);
+    int queryLength = (query != NULL) ? strlen(query) : 0;
+    // query is written back to the URI, as it was received
+    int uriLength = (query != NULL) ? pathLength + 1 + queryLength : pathLength;
+    if (body == NULL)
+    {
+        bodyLength = 0;
+    }
+
+    // only parameters which are present are recorded
+    const char* paramNames[TRACE_PARAMS_MAX];
+    const char* paramValues[TRACE_PARAMS_MAX];
+    int paramCount = 0;
+    int i;
+    for (i = 0; (TRACE_PARAMS[i] != NULL) && (i < TRACE_PARAMS_MAX); i++)
+    {
+        const char* value = getParam(envp, TRACE_PARAMS[i]);
+        if (value != NULL)
+        {
+            paramNames[paramCount] = TRACE_PARAMS[i];
+            paramValues[paramCount] = value;
+            paramCount++;
+        }
+    }
+
+    // record header: method, delay and length of URI
+    unsigned char header[1 + NUMBER_MAX_LENGTH * 2];
+    int length = 0;
+    header[length++] = methodCode;
+    length += writeNumber(header + length, now - _lastTime);
+    length += writeNumber(header + length, uriLength);
+    _lastTime = now;
+
+    int failed = (fwrite(header, 1, length, _file) != length) ||
+                 (fwrite(uri, 1, pathLength, _file) != pathLength);
+    if (!failed && (query != NULL))
+    {
+        failed = (fputc('?', _file) == EOF) ||
+                 (fwrite(query, 1, queryLength, _file) != queryLength);
+    }
+
+    if (!failed)
+    {
+        unsigned char countHeader[NUMBER_MAX_LENGTH];
+        int countLength = writeNumber(countHeader, paramCount);
+        failed = (fwrite(countHeader, 1, countLength, _file) != countLength);
+    }
+    for (i = 0; (i < paramCount) && !failed; i++)
+    {
+        failed = (writeString(paramNames[i], strlen(paramNames[i])) != 0) ||
+                 (writeString(paramValues[i], strlen(paramValues[i])) != 0);
+    }
+
+    if (failed || (writeString(body, bodyLength) != 0))
+    {
+        log_error("Unable to write to trace file. Capturing is stopped.");
+        obixTrace_close();
+    }
+}
+
+void obixTrace_close()
+{
+    if (_file != NULL)
+    {
+        fclose(_file);
+        _file = NULL;
+    }
+}
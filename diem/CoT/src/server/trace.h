@@ -0,0 +1,98 @@
+/* *****************************************************************************
+ * Copyright (c) 2009, 2010 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Defines capturing of incoming requests to a trace file.
+ *
+ * When capturing is enabled, every request received through FastCGI is
+ * appended to the trace: its method, URI (including query), headers which
+ * affect the response, body and the time passed since the previous request. The trace can be replayed later
+ * against another server build by obix_fcgi_bench, which makes real traffic
+ * a repeatable benchmark.
+ *
+ * Capturing is enabled by optional tag of the server configuration file:
+ * @code
+ * <trace-file val="/tmp/obix.trace"/>
+ * @endcode
+ *
+ * The trace starts with #TRACE_MAGIC followed by a version byte. Each record
+ * then consists of:
+ * @li method code (one byte, see #Trace_Method);
+ * @li delay since the previous record in microseconds;
+ * @li URI length and URI;
+ * @li number of recorded FastCGI parameters followed by name length, name,
+ *     value length and value of each parameter. Parameters which affect the
+ *     response are recorded: @a CONTENT_TYPE, @a HTTP_ACCEPT,
+ *     @a HTTP_ACCEPT_ENCODING and @a HTTP_IF_NONE_MATCH;
+ * @li body length and body (which can be binary).
+ * Delays and lengths are written as unsigned LEB128 numbers: 7 bits per
+ * byte, the highest bit is set in all bytes except the last one.
+ *
+ * @author Andrey Litvinov
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/** Signature at the beginning of every trace file. */
+#define TRACE_MAGIC "OBXT"
+/** Length of #TRACE_MAGIC. */
+#define TRACE_MAGIC_LENGTH 4
+/** Version of the trace format. */
+#define TRACE_VERSION 2
+
+/** Codes of request methods in trace records. */
+typedef enum
+{
+    TRACE_METHOD_GET = 1,
+    TRACE_METHOD_PUT = 2,
+    TRACE_METHOD_POST = 3
+} Trace_Method;
+
+/**
+ * Opens the trace file for capturing. Existing file is overwritten.
+ * @return @a 0 on success; @a -1 on error.
+ */
+int obixTrace_open(const char* fileName);
+
+/**
+ * Appends request to the trace. Does nothing if capturing is not enabled or
+ * the method is not supported by the server.
+ *
+ * @param method Request method (GET, PUT or POST).
+ * @param uri Requested URI without query.
+ * @param query Query of the URI (without '?'), or @a NULL.
+ * @param envp FastCGI parameters of the request ("NAME=value" strings,
+ *             terminated by @a NULL).
+ * @param body Request body, or @a NULL.
+ * @param bodyLength Length of the body in bytes.
+ */
+void obixTrace_write(const char* method,
+                     const char* uri,
+                     const char* query,
+                     char** envp,
+                     const char* body,
+                     int bodyLength);
+
+/** Writes buffered records to the file and closes it. */
+void obixTrace_close();
+
+#endif /* TRACE_H_ */
@@ -36,7 +36,10 @@
 #include <log_utils.h>
 #include <obix_utils.h>
 #include <table.h>
+#include <probes.h>
 #include "xml_storage.h"
+#include "continuation.h"
+#include "metrics.h"
 #include "watch.h"
 
 /** Structure used to store parameters for delayed @a Watch.pollChanges request
@@ -50,6 +53,18 @@ typedef struct PollTaskParams
 }
 PollTaskParams;
 
+/** Listener of object updates, which runs in the same process. */
+typedef struct Local_Listener
+{
+    int id;
+    /** Monitored object in the storage. */
+    IXML_Element* watchedDoc;
+    obixWatch_localListener listener;
+    void* arg;
+    struct Local_Listener* next;
+}
+Local_Listener;
+
 const char* OBIX_META_WATCH_UPDATED_YES = "y";
 const char* OBIX_META_WATCH_UPDATED_NO  = "n";
 
@@ -65,8 +80,6 @@ static const int MAX_WATCH_COUNT = 50;
  */
 static const char* OBIX_META_VAR_WATCH_TEMPLATE = "wi-%d";
 
-const char* OBIX_META_VAR_WATCHITEM_P = "pwi";
-
 /** Template for Watch URI. */
 static const char* WATCH_URI_TEMPLATE = "/obix/watchService/watch%d/";
 /** Length of watch uri prefix from #WATCH_URI_TEMPLATE, but not of the whole
@@ -90,11 +103,17 @@ static Task_Thread* _threadLease;
 static Task_Thread* _threadLongPoll;
 
 /**
- * Stores invocation requests of operations, which are forwarded to subscribed
- * clients.
+ * Watch items subscribed for operations. Key of the table is URI of the
+ * operation.
  */
-static Table* _watchedOpInvocations;
-static pthread_mutex_t _watchedOpInvocationsMutex = PTHREAD_MUTEX_INITIALIZER;
+static Table* _watchedOperations;
+static pthread_mutex_t _watchedOperationsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** List of local listeners. */
+static Local_Listener* _localListeners;
+/** Is used for generating ids of local listeners. */
+static int _localListenerIds = 0;
+static pthread_mutex_t _localListenersMutex = PTHREAD_MUTEX_INITIALIZER;
 
 /**
  * Removes meta attributes which are added to operation object, when this object
@@ -102,6 +121,10 @@ static pthread_mutex_t _watchedOpInvocationsMutex = PTHREAD_MUTEX_INITIALIZER;
  */
 static void deleteMetaOperationTags(const char* uri)
 {
+    pthread_mutex_lock(&_watchedOperationsMutex);
+    table_remove(_watchedOperations, uri);
+    pthread_mutex_unlock(&_watchedOperationsMutex);
+
     IXML_Element* opInStorage = xmldb_getDOM(uri, NULL);
     if (opInStorage == NULL)
     {
@@ -117,13 +140,6 @@ static void deleteMetaOperationTags(const char* uri)
     {
         xmldb_deleteMetaVariable(metaVariable);
     }
-
-    // deleting pointer to the watch item
-    metaVariable = xmldb_getMetaVariable(opInStorage, OBIX_META_VAR_WATCHITEM_P);
-    if (metaVariable != NULL)
-    {
-        xmldb_deleteMetaVariable(metaVariable);
-    }
 }
 
 /**
@@ -173,9 +189,9 @@ static oBIX_Watch_Item* obixWatchItem_free(oBIX_Watch_Item* item)
         {
             deleteMetaOperationTags(item->uri);
             ixmlElement_freeOwnerDocument(item->watchedDoc);
+            // nobody will answer to the pending invocations anymore
+            obixContinuation_cancelAll(item->uri);
         }
-        // just in case if there was some failed remote operation request
-        obixWatchItem_getSavedRemoteOperationResponse(item->uri);
     }
     free(item->uri);
     free(item);
@@ -307,6 +323,7 @@ static int obixWatch_free(oBIX_Watch* watch)
 
     free(watch);
     _watchesCount--;
+    obixMetrics_set(METRICS_WATCHES, _watchesCount);
     _watches[watchId - 1] = NULL;
     return 0;
 }
@@ -557,6 +574,7 @@ int obixWatch_create(IXML_Element** watchDOM)
     // save watch reference
     _watches[watchId] = watch;
     _watchesCount++;
+    obixMetrics_set(METRICS_WATCHES, _watchesCount);
 
     // create watch object in the storage
     watchElement = xmldb_getObixSysObject(OBIX_SYS_WATCH_STUB);
@@ -735,10 +753,9 @@ static int putMetaWatchItemFlag(IXML_Node** metaAttr,
 }
 
 /**
- * Adds following meta attributes to the provided operation object in the
- * storage:
- *  @li Operation handler ID;
- *  @li Pointer to the WatchItem object, which is subscribed for this operation.
+ * Adds operation handler ID to meta attributes of the provided operation
+ * object in the storage, and saves the WatchItem object, which is subscribed
+ * for this operation, to the table of watched operations.
  *
  * @return  @li @a 0 - On success;
  * 			@li @a -3 - Internal server error;
@@ -769,21 +786,13 @@ static int putMetaOperationTags(IXML_Element* element,
         return -3;
     }
 
-    // ..and pointer to the watch item object
-    // generate string pointer
-    char pointer[16];
-    int error = sprintf(pointer, "%d", (int)watchItem);
-    if (error < 0)
-    {
-        log_error("Unable to create meta attribute. sprintf() returned %d.",
-                  error);
-        return -3;
-    }
-
-    metaTag =
-        xmldb_putMetaVariable(element, OBIX_META_VAR_WATCHITEM_P, pointer);
-    if (metaTag == NULL)
+    // ..and remember the watch item, which forwards invocations
+    pthread_mutex_lock(&_watchedOperationsMutex);
+    int error = table_put(_watchedOperations, watchItem->uri, watchItem);
+    pthread_mutex_unlock(&_watchedOperationsMutex);
+    if (error != 0)
     {
+        log_error("Unable to save watched operation into a table.");
         return -3;
     }
 
@@ -845,6 +854,13 @@ int obixWatch_createWatchItem(oBIX_Watch* watch,
         error = putMetaOperationTags(element, item);
         if (error != 0)
         {
+            if (error == -4)
+            {
+                // operation belongs to another subscriber, so its meta tags
+                // should not be removed together with this item
+                ixmlElement_freeOwnerDocument(item->watchedDoc);
+                item->watchedDoc = NULL;
+            }
             obixWatchItem_free(item);
             return error;
         }
@@ -953,6 +969,198 @@ void obixWatch_updateMeta(IXML_Element* meta)
     }
 }
 
+int obixWatch_addLocalListener(const char* uri,
+                               obixWatch_localListener listener,
+                               void* arg)
+{
+    IXML_Element* object = xmldb_getDOM(uri, NULL);
+    if (object == NULL)
+    {
+        log_warning("Unable to add local listener: "
+                    "URI \"%s\" is not found.", uri);
+        return -1;
+    }
+
+    Local_Listener* localListener =
+        (Local_Listener*) malloc(sizeof(Local_Listener));
+    if (localListener == NULL)
+    {
+        log_error("Unable to add local listener: Not enough memory.");
+        return -1;
+    }
+
+    localListener->watchedDoc = object;
+    localListener->listener = listener;
+    localListener->arg = arg;
+
+    pthread_mutex_lock(&_localListenersMutex);
+    localListener->id = _localListenerIds++;
+    localListener->next = _localListeners;
+    _localListeners = localListener;
+    pthread_mutex_unlock(&_localListenersMutex);
+
+    return localListener->id;
+}
+
+int obixWatch_removeLocalListener(int listenerId)
+{
+    pthread_mutex_lock(&_localListenersMutex);
+    Local_Listener** link = &_localListeners;
+    while (*link != NULL)
+    {
+        Local_Listener* localListener = *link;
+        if (localListener->id == listenerId)
+        {
+            *link = localListener->next;
+            pthread_mutex_unlock(&_localListenersMutex);
+            free(localListener);
+            return 0;
+        }
+        link = &(localListener->next);
+    }
+    pthread_mutex_unlock(&_localListenersMutex);
+
+    return -1;
+}
+
+void obixWatch_notifyLocalListeners(IXML_Element* object)
+{
+    pthread_mutex_lock(&_localListenersMutex);
+    if (_localListeners == NULL)
+    {
+        pthread_mutex_unlock(&_localListenersMutex);
+        return;
+    }
+
+    // listeners of the object itself and of all its parents are notified
+    IXML_Node* node = ixmlElement_getNode(object);
+    for ( ; node != NULL; node = ixmlNode_getParentNode(node))
+    {
+        IXML_Element* element = ixmlNode_convertToElement(node);
+        if (element == NULL)
+        {
+            continue;
+        }
+
+        Local_Listener* localListener;
+        for (localListener = _localListeners;
+                localListener != NULL;
+                localListener = localListener->next)
+        {
+            if (localListener->watchedDoc == element)
+            {
+                (*(localListener->listener))(element, localListener->arg);
+            }
+        }
+    }
+    pthread_mutex_unlock(&_localListenersMutex);
+}
+
+/** Checks whether @a node is @a root itself or one of its descendants. */
+static BOOL isInSubtree(IXML_Node* node, IXML_Node* root)
+{
+    for ( ; node != NULL; node = ixmlNode_getParentNode(node))
+    {
+        if (node == root)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+void obixWatch_notifyLocalListenersOnce(IXML_Element** objects, int count)
+{
+    pthread_mutex_lock(&_localListenersMutex);
+
+    Local_Listener* localListener;
+    for (localListener = _localListeners;
+            localListener != NULL;
+            localListener = localListener->next)
+    {
+        IXML_Node* root = ixmlElement_getNode(localListener->watchedDoc);
+        int i;
+        for (i = 0; i < count; i++)
+        {
+            if (isInSubtree(ixmlElement_getNode(objects[i]), root))
+            {
+                (*(localListener->listener))(localListener->watchedDoc,
+                                             localListener->arg);
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&_localListenersMutex);
+}
+
+/** Checks whether Watch Item monitors an object inside @a root subtree. */
+static BOOL isWatchItemInSubtree(oBIX_Watch_Item* item, IXML_Node* root)
+{
+    // operation items keep a copy of the object, so the object in the
+    // storage is found by URI
+    IXML_Element* object = item->watchedDoc;
+    if (item->isOperation || (object == NULL))
+    {
+        object = xmldb_getDOM(item->uri, NULL);
+    }
+
+    return (object != NULL) && isInSubtree(ixmlElement_getNode(object), root);
+}
+
+int obixWatch_deleteSubtreeItems(IXML_Element* object)
+{
+    IXML_Node* root = ixmlElement_getNode(object);
+    int count = 0;
+    int i;
+
+    for (i = 0; i < MAX_WATCH_COUNT; i++)
+    {
+        oBIX_Watch* watch = _watches[i];
+        if (watch == NULL)
+        {
+            continue;
+        }
+
+        oBIX_Watch_Item** link = &(watch->items);
+        while (*link != NULL)
+        {
+            if (isWatchItemInSubtree(*link, root))
+            {
+                log_debug("Removing \"%s\" from Watch %d: "
+                          "The object is deleted.", (*link)->uri, watch->id);
+                *link = obixWatchItem_free(*link);
+                count++;
+            }
+            else
+            {
+                link = &((*link)->next);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&_localListenersMutex);
+    Local_Listener** link = &_localListeners;
+    while (*link != NULL)
+    {
+        Local_Listener* localListener = *link;
+        if (isInSubtree(ixmlElement_getNode(localListener->watchedDoc), root))
+        {
+            *link = localListener->next;
+            free(localListener);
+            count++;
+        }
+        else
+        {
+            link = &(localListener->next);
+        }
+    }
+    pthread_mutex_unlock(&_localListenersMutex);
+
+    return count;
+}
+
 BOOL obixWatch_isWatchUri(const char* uri)
 {
     if (strncmp(uri, WATCH_URI_TEMPLATE, WATCH_URI_PREFIX_LENGTH) == 0)
@@ -1058,6 +1266,7 @@ void obixWatch_longPollTask(void* arg)
     // 0 poll task id means that it is not scheduled anymore
     params->watch->pollTaskId = 0;
     (*(params->pollHandler))(params->watch, params->response, params->uri);
+    obixMetrics_add(METRICS_LONG_POLLS, -1);
     // notify that task is completed
     pthread_cond_signal(&(params->watch->pollTaskCompleted));
     pthread_mutex_unlock(&(params->watch->pollTaskMutex));
@@ -1116,6 +1325,7 @@ int obixWatch_holdPollRequest(obixWatch_pollHandler pollHandler,
     params->response = response;
     params->uri = uri;
 
+    obixMetrics_add(METRICS_LONG_POLLS, 1);
     watch->pollTaskId = ptask_schedule(_threadLongPoll,
                                        &obixWatch_longPollTask,
                                        (void*) params,
@@ -1124,12 +1334,14 @@ int obixWatch_holdPollRequest(obixWatch_pollHandler pollHandler,
     pthread_mutex_unlock(&(watch->pollTaskMutex));
     if (watch->pollTaskId < 0)
     {
+        obixMetrics_add(METRICS_LONG_POLLS, -1);
         log_error("Unable to hold Watch poll request: "
                   "Unable to schedule task.");
         return watch->pollTaskId;
     }
 
     log_debug("Request handling is suspended for %ld ms.", delay);
+    OBIX_PROBE2(longpoll__park, watch->id, delay);
 
     return 0;
 }
@@ -1152,11 +1364,11 @@ int obixWatch_init()
 
     _watchesCount = 0;
 
-    // initialize table for storing watched operation invocations
-    _watchedOpInvocations = table_create(20);
-    if (_watchedOpInvocations == NULL)
+    // initialize table for storing watched operations
+    _watchedOperations = table_create(20);
+    if (_watchedOperations == NULL)
     {
-        log_error("Unable to allocate memory for operation requests cache.");
+        log_error("Unable to allocate memory for watched operations table.");
         return -2;
     }
 
@@ -1196,6 +1408,18 @@ int obixWatch_dispose()
 
     free(_watches);
     _watches = NULL;
+    table_free(_watchedOperations);
+    _watchedOperations = NULL;
+
+    // remove local listeners
+    pthread_mutex_lock(&_localListenersMutex);
+    while (_localListeners != NULL)
+    {
+        Local_Listener* next = _localListeners->next;
+        free(_localListeners);
+        _localListeners = next;
+    }
+    pthread_mutex_unlock(&_localListenersMutex);
 
     // stop threads
     if (_threadLease != NULL)
@@ -1238,6 +1462,7 @@ static int obixWatchItem_saveOperationInput(
     ixmlElement_setAttributeWithLog(watchItem->input,
                                     OBIX_ATTR_NAME,
                                     "in");
+    xmldb_updateVersion(watchItem->watchedDoc);
 
     return 0;
 }
@@ -1259,53 +1484,51 @@ void obixWatchItem_clearOperationInput(oBIX_Watch_Item* watchItem)
 
     // remove RemoteInvocation contract
     ixmlElement_removeAttributeWithLog(watchItem->watchedDoc, OBIX_ATTR_IS);
+    xmldb_updateVersion(watchItem->watchedDoc);
 }
 
-int obixWatchItem_saveRemoteOperationResponse(
-    const char* uri,
-    Response* response)
+/** Returns Watch Item subscribed for the operation with provided URI. */
+static oBIX_Watch_Item* getOperationWatchItem(const char* uri)
 {
-    pthread_mutex_lock(&_watchedOpInvocationsMutex);
-    int error = table_put(_watchedOpInvocations, uri, response);
-    pthread_mutex_unlock(&_watchedOpInvocationsMutex);
-    if (error != 0)
-    {
-        log_error("Unable to save invocation object into a table (error #%d).",
-                  error);
-    }
-    return error;
+    pthread_mutex_lock(&_watchedOperationsMutex);
+    oBIX_Watch_Item* watchItem =
+        (oBIX_Watch_Item*) table_get(_watchedOperations, uri);
+    pthread_mutex_unlock(&_watchedOperationsMutex);
+    return watchItem;
 }
 
-int obixWatchItem_saveOperationInvocation(
-    oBIX_Watch_Item* watchItem,
-    const char* uri,
-    Response* response,
-    IXML_Element* input)
+int obixWatch_forwardOperationInput(const char* uri, IXML_Element* input)
 {
-    // save response object in order to use it later
-    int error =
-        obixWatchItem_saveRemoteOperationResponse(uri, response);
-    if (error != 0)
+    oBIX_Watch_Item* watchItem = getOperationWatchItem(uri);
+    if (watchItem == NULL)
     {
-        return error;
+        log_warning("Unable to forward invocation of \"%s\": Nobody is "
+                    "subscribed for the operation.", uri);
+        return -1;
+    }
+
+    if (watchItem->input != NULL)
+    {
+        log_warning("WatchItem input field is not empty when someone tries to "
+                    "invoke watched operation. Probably last request is not "
+                    "yet processed (URI \"%s\").", uri);
+        return -2;
     }
 
     // update watch item state
-    error = xmldb_changeMetaVariable(watchItem->updated,
-                                     OBIX_META_WATCH_UPDATED_YES);
+    int error = xmldb_changeMetaVariable(watchItem->updated,
+                                         OBIX_META_WATCH_UPDATED_YES);
     if (error != 0)
-    {	// remove saved operation response
-        obixWatchItem_getSavedRemoteOperationResponse(uri);
-        return -1;
+    {
+        return -3;
     }
 
     error = obixWatchItem_saveOperationInput(watchItem, input);
     if (error != 0)
-    {	// remove saved operation response and reset updated flag
-        obixWatchItem_getSavedRemoteOperationResponse(uri);
+    {	// reset updated flag
         xmldb_changeMetaVariable(watchItem->updated,
                                  OBIX_META_WATCH_UPDATED_NO);
-        return -1;
+        return -3;
     }
 
     // notify Watch object that watch item is changed
@@ -1316,10 +1539,21 @@ int obixWatchItem_saveOperationInvocation(
     return 0;
 }
 
-Response* obixWatchItem_getSavedRemoteOperationResponse(const char* uri)
+int obixWatch_cancelOperationInput(const char* uri)
 {
-    pthread_mutex_lock(&_watchedOpInvocationsMutex);
-    Response* response = (Response*)table_remove(_watchedOpInvocations, uri);
-    pthread_mutex_unlock(&_watchedOpInvocationsMutex);
-    return response;
+    oBIX_Watch_Item* watchItem = getOperationWatchItem(uri);
+    if (watchItem == NULL)
+    {
+        return -1;
+    }
+
+    if (watchItem->input == NULL)
+    {
+        // input is already sent to the subscriber
+        return 0;
+    }
+
+    obixWatchItem_clearOperationInput(watchItem);
+    xmldb_changeMetaVariable(watchItem->updated, OBIX_META_WATCH_UPDATED_NO);
+    return 1;
 }
@@ -41,12 +41,6 @@ extern const char* OBIX_META_WATCH_UPDATED_YES;
 extern const char* OBIX_META_WATCH_UPDATED_NO;
 /** @} */
 
-/**
- * Name of the meta tag, which stores pointer to a watch item, subscribed for
- * the object.
- */
-extern const char* OBIX_META_VAR_WATCHITEM_P;
-
 /**
  * Represents a separate watch item.
  *
@@ -118,6 +112,16 @@ typedef void (*obixWatch_pollHandler)(oBIX_Watch* watch,
                                       Response* response,
                                       const char* uri);
 
+/**
+ * Prototype of a function, which is notified about updates of a monitored
+ * object. Used by clients running in the same process as the server.
+ *
+ * @param object Updated object in the storage. It should not be modified or
+ *               stored by the listener.
+ * @param arg Argument, which was provided when listener was added.
+ */
+typedef void (*obixWatch_localListener)(IXML_Element* object, void* arg);
+
 /**
  * Initializes Watch engine.
  * @return @a 0 on success; negative error code otherwise.
@@ -217,45 +221,80 @@ int obixWatchItem_setUpdated(oBIX_Watch_Item* item, BOOL isUpdated);
 void obixWatchItem_clearOperationInput(oBIX_Watch_Item* watchItem);
 
 /**
- * Saves parameters of remote operation invocation.
+ * Passes input of remote operation invocation to the Watch Item subscribed
+ * for this operation, so that the subscriber receives it with the next
+ * @a Watch.pollChanges.
  *
- * @param watchItem Watch item subscribed for this operation.
  * @param uri URI of invoked operation.
- * @param response Response object, which will be used later to send back
- * 			operation results.
- * @param input Input arguments for the operation.
+ * @param input Input arguments for the operation. They are copied.
+ * @return @li @a 0 on success;
+ *         @li @a -1 if nobody is subscribed for the operation;
+ *         @li @a -2 if input of the previous invocation is not yet received
+ *                   by the subscriber;
+ *         @li @a -3 on internal error.
  */
-int obixWatchItem_saveOperationInvocation(
-    oBIX_Watch_Item* watchItem,
-    const char* uri,
-    Response* response,
-    IXML_Element* input);
+int obixWatch_forwardOperationInput(const char* uri, IXML_Element* input);
 
 /**
- * Saves response object of operation, which is forwarded to the subscribed
- * user. This response can be later retrieved back with
- * #obixWatch_getSavedOperationInvocation.
+ * Removes input of remote operation invocation if it is not yet received by
+ * the subscriber.
  *
  * @param uri URI of invoked operation.
- * @param response Response object, which will be used later to send back
- * 			operation results.
+ * @return @li @a 1 if input is removed;
+ *         @li @a 0 if input was already sent to the subscriber;
+ *         @li @a -1 if nobody is subscribed for the operation.
+ */
+int obixWatch_cancelOperationInput(const char* uri);
+
+/**
+ * Sets Watch attributes of the provided meta tag to "updated" state.
+ */
+void obixWatch_updateMeta(IXML_Element* meta);
+
+/**
+ * Subscribes local listener for updates of the object with provided URI.
+ * Unlike Watch items, local listeners are notified immediately when the
+ * object or any of its children is updated, so there is no need for polling.
+ *
+ * @param uri URI of the object to be monitored.
+ * @param listener Function, which will be called on every update.
+ * @param arg Argument, which will be passed to the listener.
+ * @return Id of the listener (>= 0), or @a -1 if object with provided URI is
+ *         not found or there is not enough memory.
  */
-int obixWatchItem_saveRemoteOperationResponse(
-    const char* uri,
-    Response* response);
+int obixWatch_addLocalListener(const char* uri,
+                               obixWatch_localListener listener,
+                               void* arg);
 
 /**
- * Returns saved response object of operation, which was forwarded to the
- * subscribed user.
+ * Removes local listener.
  *
- * @param uri URI of forwarded operation.
+ * @param listenerId Id of the listener, returned by
+ *                   #obixWatch_addLocalListener.
+ * @return @a 0 on success; @a -1 if there is no listener with such id.
  */
-Response* obixWatchItem_getSavedRemoteOperationResponse(const char* uri);
+int obixWatch_removeLocalListener(int listenerId);
 
 /**
- * Sets Watch attributes of the provided meta tag to "updated" state.
+ * Notifies local listeners, which monitor the updated object or any of its
+ * parents.
  */
-void obixWatch_updateMeta(IXML_Element* meta);
+void obixWatch_notifyLocalListeners(IXML_Element* object);
+
+/**
+ * Notifies local listeners about several updated objects at once. Each
+ * listener, which monitors any of these objects or their parents, is called
+ * only once.
+ */
+void obixWatch_notifyLocalListenersOnce(IXML_Element** objects, int count);
+
+/**
+ * Removes all Watch Items and local listeners, which monitor the provided
+ * object or any of its children. Should be called before the object is
+ * deleted from the storage, because Watch Items keep links to it.
+ * @return Number of removed items and listeners.
+ */
+int obixWatch_deleteSubtreeItems(IXML_Element* object);
 
 /**
  * Checks whether provided URI is an URI of Watch object.
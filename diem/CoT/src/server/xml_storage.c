@@ -34,6 +34,9 @@
 #include <ixml_ext.h>
 #include <xml_config.h>
 #include <log_utils.h>
+#include <probes.h>
+#include "metrics.h"
+#include "storage_usage.h"
 #include "xml_storage.h"
 
 /** Link to the list of references for each connected device. */
@@ -53,6 +56,8 @@ const char* OBIX_META = "meta";
 
 const char* OBIX_META_VAR_HANDLER_ID = "h-id";
 
+const char* OBIX_META_VAR_VERSION = "ver";
+
 /** Files with initial storage contents. */
 static const char* OBIX_STORAGE_FILES[] =
     {"server_lobby.xml",		//Lobby object
@@ -70,9 +75,46 @@ static const int OBIX_STORAGE_FILES_COUNT = 7;
 /** The place where all data is stored. */
 static IXML_Document* _storage = NULL;
 
+/** Counter of storage modifications. Its value is assigned as a version to
+ * every modified object (see #xmldb_updateVersion). */
+static long _storageVersion = 0;
+
+/** Initial size of #_rootIndex. */
+#define ROOT_INDEX_SIZE_INITIAL 64
+
+/**
+ * Object stored in the root of the storage, indexed by its base path: the
+ * part of its URI which is inherited by child objects (without trailing
+ * slash).
+ */
+typedef struct
+{
+    /** Base path of the object, or @a NULL if the slot is free. */
+    char* base;
+    int baseLength;
+    unsigned int hash;
+    IXML_Node* node;
+    /** Tells whether the object has children which can be found by URI.
+     * Lists of references (e.g. the device list) are not searched. */
+    BOOL searchChildren;
+}
+Root_Object;
+
+/** Hash table of all objects in the root of the storage. Several objects can
+ * have the same base path, thus all matching slots are checked on lookup. */
+static Root_Object* _rootIndex = NULL;
+/** Size of #_rootIndex; always a power of two. */
+static int _rootIndexSize = 0;
+static int _rootCount = 0;
+
 /** Prints contents of XML node to debug log. */
 static void printXMLContents(IXML_Node* node, const char* title)
 {
+    // printing of the whole node is expensive
+    if (!log_isDebugEnabled())
+    {
+        return;
+    }
     DOMString str = ixmlPrintNode(node);
     log_debug("\n%s:\n%s",title, str);
     ixmlFreeDOMString(str);
@@ -204,7 +246,7 @@ static int compare_uri(const char* currentUri,
 }
 
 /**
- * Helper function for #getNodeByHref(IXML_Document*,const char*).
+ * Helper function for #getNodeByHref.
  *
  * @param checked specifies number of symbols from href which are already
  * checked (and match) in parent node.
@@ -271,8 +313,230 @@ static IXML_Node* getNodeByHrefRecursive(IXML_Node* node, const char* href,
     return match;
 }
 
+/** FNV-1a hash of the first @a length characters of the string. */
+static unsigned int getHash(const char* str, int length)
+{
+    unsigned int hash = 2166136261u;
+    int i;
+    for (i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/** Returns length of the base path of the object with provided URI (see
+ * #compare_uri for the rules). */
+static int getBaseLength(const char* href)
+{
+    int length = strlen(href);
+    if ((length > 0) && (href[length - 1] == '/'))
+    {
+        return length - 1;
+    }
+
+    int slashPos = getLastSlashPosition(href, length - 1);
+    return (slashPos <= 0) ? length : slashPos;
+}
+
+/** Checks whether the subtree has objects which can be found by URI. */
+static BOOL hasAddressableChildren(IXML_Node* node)
+{
+    node = ixmlNode_getFirstChild(node);
+    for ( ; node != NULL; node = ixmlNode_getNextSibling(node))
+    {
+        IXML_Element* element = ixmlNode_convertToElement(node);
+        if (element == NULL)
+        {
+            continue;
+        }
+        if (((ixmlElement_getAttribute(element, OBIX_ATTR_HREF) != NULL)
+                && (strcmp(ixmlElement_getTagName(element), OBIX_OBJ_REF) != 0))
+                || hasAddressableChildren(node))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * Allocates the index of the provided size and moves all objects there.
+ * @return @a 0 on success, @a -1 if there is not enough memory.
+ */
+static int resizeRootIndex(int size)
+{
+    Root_Object* old = _rootIndex;
+    int oldSize = _rootIndexSize;
+    _rootIndex = (Root_Object*) calloc(size, sizeof(Root_Object));
+    if (_rootIndex == NULL)
+    {
+        _rootIndex = old;
+        return -1;
+    }
+    _rootIndexSize = size;
+
+    int i;
+    for (i = 0; i < oldSize; i++)
+    {
+        if (old[i].base != NULL)
+        {
+            int j = old[i].hash & (size - 1);
+            while (_rootIndex[j].base != NULL)
+            {
+                j = (j + 1) & (size - 1);
+            }
+            _rootIndex[j] = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+/**
+ * Adds object, which is appended to the root of the storage, to the index.
+ * @return @a 0 on success, @a -1 if there is not enough memory.
+ */
+static int addRootObject(IXML_Node* node)
+{
+    if (((_rootCount + 1) * 2 > _rootIndexSize)
+            && (resizeRootIndex((_rootIndexSize == 0) ?
+                                ROOT_INDEX_SIZE_INITIAL :
+                                _rootIndexSize * 2) != 0))
+    {
+        log_error("Unable to index stored object: Not enough memory.");
+        return -1;
+    }
+
+    const char* href = ixmlElement_getAttribute(
+                           ixmlNode_convertToElement(node),
+                           OBIX_ATTR_HREF);
+    int length = getBaseLength(href);
+    char* base = (char*) malloc(length + 1);
+    if (base == NULL)
+    {
+        log_error("Unable to index stored object: Not enough memory.");
+        return -1;
+    }
+    strncpy(base, href, length);
+    base[length] = '\0';
+
+    unsigned int hash = getHash(base, length);
+    int mask = _rootIndexSize - 1;
+    int i = hash & mask;
+    while (_rootIndex[i].base != NULL)
+    {
+        i = (i + 1) & mask;
+    }
+    _rootIndex[i].base = base;
+    _rootIndex[i].baseLength = length;
+    _rootIndex[i].hash = hash;
+    _rootIndex[i].node = node;
+    _rootIndex[i].searchChildren = hasAddressableChildren(node);
+    _rootCount++;
+    return 0;
+}
+
+/**
+ * Removes object from the index. Following slots of the same cluster are
+ * shifted back, so that lookups never need deleted markers.
+ */
+static void removeRootObject(IXML_Node* node)
+{
+    const char* href = ixmlElement_getAttribute(
+                           ixmlNode_convertToElement(node),
+                           OBIX_ATTR_HREF);
+    if ((_rootCount == 0) || (href == NULL))
+    {
+        return;
+    }
+
+    int mask = _rootIndexSize - 1;
+    int slot = getHash(href, getBaseLength(href)) & mask;
+    while (_rootIndex[slot].node != node)
+    {
+        if (_rootIndex[slot].base == NULL)
+        {   // the object is not indexed
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    free(_rootIndex[slot].base);
+    _rootCount--;
+    int i = slot;
+    for (;;)
+    {
+        _rootIndex[slot].base = NULL;
+        _rootIndex[slot].node = NULL;
+        int home;
+        do
+        {
+            i = (i + 1) & mask;
+            if (_rootIndex[i].base == NULL)
+            {
+                return;
+            }
+            home = _rootIndex[i].hash & mask;
+        }
+        // object stays if its home slot lies cyclically in (slot, i]
+        while ((slot <= i) ? ((slot < home) && (home <= i))
+                : ((slot < home) || (home <= i)));
+        _rootIndex[slot] = _rootIndex[i];
+        slot = i;
+    }
+}
+
+/** Releases the index of root objects. */
+static void freeRootIndex()
+{
+    int i;
+    for (i = 0; i < _rootIndexSize; i++)
+    {
+        if (_rootIndex[i].base != NULL)
+        {
+            free(_rootIndex[i].base);
+        }
+    }
+    free(_rootIndex);
+    _rootIndex = NULL;
+    _rootIndexSize = 0;
+    _rootCount = 0;
+}
+
+/**
+ * Searches object with provided URI in the subtree of the root object. The
+ * same as #getNodeByHrefRecursive but does not check neighbors of the root.
+ */
+static IXML_Node* getNodeByHrefInRoot(Root_Object* root,
+                                      const char* href,
+                                      int* slashFlag)
+{
+    const char* rootHref = ixmlElement_getAttribute(
+                               ixmlNode_convertToElement(root->node),
+                               OBIX_ATTR_HREF);
+    int compareResult = compare_uri(rootHref, href, 0, slashFlag);
+    if (compareResult == 0)
+    {
+        return root->node;
+    }
+    if ((compareResult > 0) && root->searchChildren)
+    {
+        return getNodeByHrefRecursive(ixmlNode_getFirstChild(root->node),
+                                      href,
+                                      compareResult,
+                                      slashFlag);
+    }
+    return NULL;
+}
+
 /**
  * Retrieves XML node with provided URI from the storage.
+ * Only root objects whose base path is a prefix of the URI are checked,
+ * starting from the longest one. They are found in the index of root objects
+ * instead of scanning the whole storage.
+ *
  * @param slashFlag Slash flag is returned here. This flag shows whether
  * 			requested URI differs from URI of returned object in trailing slash.
  * 			@li @a 0 if both URI had the same ending symbol;
@@ -281,9 +545,7 @@ static IXML_Node* getNodeByHrefRecursive(IXML_Node* node, const char* href,
  *			@li @a -1 if requested URI had trailing slash, but the object
  *					hadn't.
  */
-static IXML_Node* getNodeByHref(IXML_Document* doc,
-                                const char* href,
-                                int* slashFlag)
+static IXML_Node* getNodeByHref(const char* href, int* slashFlag)
 {
     // in case if no slash flag is required, provide a temp variable to the
     // further methods.
@@ -292,10 +554,47 @@ static IXML_Node* getNodeByHref(IXML_Document* doc,
     {
         slashFlag = &temp;
     }
-    return getNodeByHrefRecursive(ixmlDocument_getNode(doc),
-                                  href,
-                                  0,
-                                  slashFlag);
+    if (_rootCount == 0)
+    {
+        return NULL;
+    }
+
+    int mask = _rootIndexSize - 1;
+    int length = strlen(href);
+    if ((length > 0) && (href[length - 1] == '/'))
+    {
+        length--;
+    }
+    for (;;)
+    {
+        unsigned int hash = getHash(href, length);
+        int i;
+        for (i = hash & mask; _rootIndex[i].base != NULL; i = (i + 1) & mask)
+        {
+            Root_Object* root = &(_rootIndex[i]);
+            if ((root->hash != hash) || (root->baseLength != length)
+                    || (strncmp(root->base, href, length) != 0))
+            {
+                continue;
+            }
+            IXML_Node* match = getNodeByHrefInRoot(root, href, slashFlag);
+            if (match != NULL)
+            {
+                return match;
+            }
+        }
+
+        if (length == 0)
+        {
+            return NULL;
+        }
+        // try the parent path
+        do
+        {
+            length--;
+        }
+        while ((length > 0) && (href[length] != '/'));
+    }
 }
 
 /**
@@ -426,7 +725,7 @@ static int xmldb_putDOMHelper(IXML_Element* data, BOOL checkPrefix)
     }
 
     // look for available node with the same href
-    IXML_Node* nodeInStorage = getNodeByHref(_storage, href, NULL);
+    IXML_Node* nodeInStorage = getNodeByHref(href, NULL);
     if (nodeInStorage != NULL)
     {
         log_warning("Unable to write to the storage: The object with the same "
@@ -449,6 +748,15 @@ static int xmldb_putDOMHelper(IXML_Element* data, BOOL checkPrefix)
         onError();
         return error;
     }
+    if (addRootObject(newNode) != 0)
+    {
+        ixmlNode_removeChild(ixmlDocument_getNode(_storage), newNode, &newNode);
+        onError();
+        return -1;
+    }
+    // new object must not share version with the one which could have the
+    // same URI before
+    xmldb_updateVersion(ixmlNode_convertToElement(newNode));
 
     return 0;
 }
@@ -480,12 +788,18 @@ static int xmldb_putHelper(const char* data, BOOL checkPrefix)
 
 IXML_Element* xmldb_getDOM(const char* href, int* slashFlag)
 {
-    return ixmlNode_convertToElement(getNodeByHref(_storage, href, slashFlag));
+    OBIX_PROBE1(storage__lookup__start, href);
+    unsigned long long start = obixMetrics_startTimer();
+    IXML_Element* element =
+        ixmlNode_convertToElement(getNodeByHref(href, slashFlag));
+    obixMetrics_stopTimer(METRICS_TIMER_STORAGE_LOOKUP, start);
+    OBIX_PROBE2(storage__lookup__done, href, element != NULL);
+    return element;
 }
 
 char* xmldb_get(const char* href, int* slashFlag)
 {
-    return ixmlPrintNode(getNodeByHref(_storage, href, slashFlag));
+    return ixmlPrintNode(getNodeByHref(href, slashFlag));
 }
 
 int xmldb_putDOM(IXML_Element* data)
@@ -493,18 +807,28 @@ int xmldb_putDOM(IXML_Element* data)
     return xmldb_putDOMHelper(data, TRUE);
 }
 
-int xmldb_putDeviceReference(IXML_Element* deviceData)
+/** Returns the list of devices from the storage. */
+static IXML_Element* getDeviceList()
 {
     IXML_Element* devices =
         ixmlNode_convertToElement(
-            getNodeByHref(_storage, DEVICE_LIST_URI, NULL));
+            getNodeByHref(DEVICE_LIST_URI, NULL));
     if (devices == NULL)
     {
         // database failure
         log_error("Unable to find device list in the storage.");
-        return -1;
     }
 
+    return devices;
+}
+
+/**
+ * Adds reference to the device to the provided list of devices.
+ * @return @a 0 on success, @a -1 on error.
+ */
+static int putDeviceReference(IXML_Element* devices,
+                              IXML_Element* deviceData)
+{
     //TODO check that there are no links with such address yet
 
     // create new <ref/> object and copy 'href', 'name', 'display' and
@@ -561,7 +885,231 @@ int xmldb_putDeviceReference(IXML_Element* deviceData)
     return 0;
 }
 
-int xmldb_init()
+int xmldb_putDeviceReference(IXML_Element* deviceData)
+{
+    IXML_Element* devices = getDeviceList();
+    if ((devices == NULL) || (putDeviceReference(devices, deviceData) != 0))
+    {
+        return -1;
+    }
+
+    long objects;
+    long bytes = obixUsage_measure(deviceData, &objects);
+    obixUsage_addDevice(ixmlElement_getAttribute(deviceData, OBIX_ATTR_HREF),
+                        bytes, objects);
+    xmldb_updateVersion(devices);
+    return 0;
+}
+
+int xmldb_checkDeviceQuota(IXML_Element* deviceData)
+{
+    return obixUsage_checkDevice(obixUsage_measure(deviceData, NULL));
+}
+
+int xmldb_putDevices(IXML_Element* input, int* results, int count)
+{
+    IXML_Element* devices = getDeviceList();
+    if (devices == NULL)
+    {
+        return -1;
+    }
+
+    // one pass over the whole input adds default prefix to all URIs
+    IXML_Node* node = ixmlNode_getFirstChild(ixmlElement_getNode(input));
+    insertDefaultUriPrefix(node);
+
+    IXML_Node* storageRoot = ixmlDocument_getNode(_storage);
+    int stored = 0;
+    int i = 0;
+    for ( ; (node != NULL) && (i < count); node = ixmlNode_getNextSibling(node))
+    {
+        IXML_Element* device = ixmlNode_convertToElement(node);
+        if (device == NULL)
+        {
+            continue;
+        }
+
+        int* result = &(results[i++]);
+        const char* href = checkNode(node, FALSE);
+        if (href == NULL)
+        {
+            *result = -1;
+            continue;
+        }
+
+        // devices stored earlier from the same input are also found here
+        if (getNodeByHref(href, NULL) != NULL)
+        {
+            log_warning("Unable to write to the storage: The object with the "
+                        "same URI (%s) already exists.", href);
+            *result = -2;
+            continue;
+        }
+
+        // check limits before the device data is copied to the storage
+        long objects;
+        long bytes = obixUsage_measure(device, &objects);
+        if (obixUsage_checkDevice(bytes) != 0)
+        {
+            *result = -4;
+            continue;
+        }
+
+        IXML_Node* newNode;
+        int error = ixmlDocument_importNode(_storage, node, TRUE, &newNode);
+        if (error != IXML_SUCCESS)
+        {
+            log_warning("Unable to write to the storage (error %d).", error);
+            *result = -3;
+            continue;
+        }
+
+        error = ixmlNode_appendChild(storageRoot, newNode);
+        if (error != IXML_SUCCESS)
+        {
+            log_warning("Unable to write to the storage (error %d).", error);
+            ixmlNode_free(newNode);
+            *result = -3;
+            continue;
+        }
+
+        if (addRootObject(newNode) != 0)
+        {
+            ixmlNode_removeChild(storageRoot, newNode, &newNode);
+            ixmlNode_free(newNode);
+            *result = -3;
+            continue;
+        }
+
+        if (putDeviceReference(devices, device) != 0)
+        {
+            removeRootObject(newNode);
+            ixmlNode_removeChild(storageRoot, newNode, &newNode);
+            ixmlNode_free(newNode);
+            *result = -3;
+            continue;
+        }
+
+        xmldb_updateVersion(ixmlNode_convertToElement(newNode));
+        obixUsage_addDevice(href, bytes, objects);
+        *result = 0;
+        stored++;
+    }
+
+    // mark the rest, if the input contains less objects than expected
+    for ( ; i < count; i++)
+    {
+        results[i] = -1;
+    }
+
+    if (stored > 0)
+    {
+        xmldb_updateVersion(devices);
+    }
+    return stored;
+}
+
+int xmldb_deleteDeviceReference(const char* href)
+{
+    IXML_Element* devices = getDeviceList();
+    if (devices == NULL)
+    {
+        return -1;
+    }
+
+    IXML_Node* node = ixmlNode_getFirstChild(ixmlElement_getNode(devices));
+    for ( ; node != NULL; node = ixmlNode_getNextSibling(node))
+    {
+        IXML_Element* ref = ixmlNode_convertToElement(node);
+        if (ref == NULL)
+        {
+            continue;
+        }
+
+        const char* refHref = ixmlElement_getAttribute(ref, OBIX_ATTR_HREF);
+        if ((refHref == NULL) || (strcmp(refHref, href) != 0))
+        {
+            continue;
+        }
+
+        int error = ixmlNode_removeChild(ixmlElement_getNode(devices),
+                                         node,
+                                         &node);
+        if (error != IXML_SUCCESS)
+        {
+            log_error("Unable to remove device reference (error %d).", error);
+            return -1;
+        }
+
+        ixmlNode_free(node);
+        obixUsage_removeDevice(href);
+        xmldb_updateVersion(devices);
+        return 0;
+    }
+
+    log_debug("Device \"%s\" is not found in the device list.", href);
+    return -1;
+}
+
+/**
+ * Loads the contents of the specified file to the storage.
+ *
+ * @param xmlFile Full path to the file.
+ * @return @a 0 on success, error code otherwise.
+ */
+static int loadFile(const char* xmlFile)
+{
+    // open the file
+    FILE* file = fopen(xmlFile, "rb");
+    if (file == NULL)
+    {
+        log_error("Unable to access file \"%s\".", xmlFile);
+        return -1;
+    }
+
+    // check the file size
+    int error = fseek(file, 0, SEEK_END);
+    if (error != 0)
+    {
+        log_error("Error reading file \'%s\' (%d).", xmlFile, error);
+        fclose(file);
+        return error;
+    }
+    int size = ftell(file);
+    if (size <= 0)
+    {
+        log_error("Error reading file \"%s\".", xmlFile);
+        fclose(file);
+        return -1;
+    }
+    rewind(file);
+
+    // read the file to the buffer
+    char* data = (char*) malloc(size + 1);
+    if (data == NULL)
+    {
+        log_error("Error reading file \"%s\". File is too big.", xmlFile);
+        fclose(file);
+        return -1;
+    }
+    int bytesRead = fread(data, 1, size, file);
+    data[bytesRead] = '\0';
+    fclose(file);
+
+    // put data to the storage
+    error = xmldb_putHelper(data, FALSE);
+    free(data);
+    if (error != 0)
+    {
+        log_error("Unable to update storage. File \"%s\" is corrupted "
+                  "(error %d).", xmlFile, error);
+        return error;
+    }
+
+    return 0;
+}
+
+int xmldb_init(const char* resourceDir)
 {
     if (_storage != NULL)
     {
@@ -582,7 +1130,29 @@ int xmldb_init()
     int i;
     for (i = 0; i < OBIX_STORAGE_FILES_COUNT; i++)
     {
-        error = xmldb_loadFile(OBIX_STORAGE_FILES[i]);
+        char* path;
+        if (resourceDir == NULL)
+        {
+            path = config_getResFullPath(OBIX_STORAGE_FILES[i]);
+        }
+        else
+        {
+            path = (char*) malloc(strlen(resourceDir)
+                                  + strlen(OBIX_STORAGE_FILES[i]) + 1);
+            if (path != NULL)
+            {
+                strcpy(path, resourceDir);
+                strcat(path, OBIX_STORAGE_FILES[i]);
+            }
+        }
+        if (path == NULL)
+        {
+            log_error("Unable to initialize the storage: Not enough memory.");
+            return -1;
+        }
+
+        error = loadFile(path);
+        free(path);
         if (error != 0)
         {
             return error;
@@ -595,6 +1165,8 @@ int xmldb_init()
 
 void xmldb_dispose()
 {
+    obixUsage_reset();
+    freeRootIndex();
     ixmlDocument_free(_storage);
     _storage = NULL;
 }
@@ -604,10 +1176,7 @@ int xmldb_put(const char* data)
     return xmldb_putHelper(data, TRUE);
 }
 
-int xmldb_updateDOM(IXML_Element* input,
-                    const char* href,
-                    IXML_Element** updatedNode,
-                    int* slashFlag)
+int xmldb_updateObject(IXML_Element* object, IXML_Element* input)
 {
     const char* newValue = ixmlElement_getAttribute(input, OBIX_ATTR_VAL);
     if (newValue == NULL)
@@ -618,60 +1187,86 @@ int xmldb_updateDOM(IXML_Element* input,
         return -1;
     }
 
-    // get the object from the storage
-    IXML_Element* nodeInStorage = xmldb_getDOM(href, slashFlag);
-    if (nodeInStorage == NULL)
-    {
-        log_warning("Unable to update the storage: "
-                    "No object with the URI \"%s\" is found.", href);
-        return -2;
-    }
-
     // check that the object is writable
-    const char* writable = ixmlElement_getAttribute(nodeInStorage,
+    const char* writable = ixmlElement_getAttribute(object,
                            OBIX_ATTR_WRITABLE);
     if ((writable == NULL) || (strcmp(writable, XML_TRUE) != 0))
     {
         log_warning("Unable to update the storage: "
-                    "The object with the URI \"%s\" is not writable.", href);
+                    "The object with the URI \"%s\" is not writable.",
+                    ixmlElement_getAttribute(object, OBIX_ATTR_HREF));
         return -3;
     }
 
     // check the current value of the object in storage
-    const char* oldValue = ixmlElement_getAttribute(nodeInStorage,
-                           OBIX_ATTR_VAL);
+    const char* oldValue = ixmlElement_getAttribute(object, OBIX_ATTR_VAL);
     if ((oldValue != NULL) && (strcmp(oldValue, newValue) == 0))
     {
         // new value is the same as was in storage.
-        // return address of the node in the storage
-        if (updatedNode != NULL)
-        {
-            *updatedNode = nodeInStorage;
-        }
         return 1;
     }
 
+    // values of registered devices should fit to their memory limits
+    long delta = strlen(newValue) - ((oldValue != NULL) ? strlen(oldValue) : 0);
+    if ((delta != 0) && (obixUsage_resize(object, delta) != 0))
+    {
+        return -6;
+    }
+
     // overwrite 'val' attribute
-    int error = ixmlElement_setAttributeWithLog(
-                    nodeInStorage,
-                    OBIX_ATTR_VAL,
-                    newValue);
+    int error = ixmlElement_setAttributeWithLog(object,
+                OBIX_ATTR_VAL,
+                newValue);
     if (error != 0)
     {
+        if (delta != 0)
+        {
+            obixUsage_resize(object, -delta);
+        }
         return -4;
     }
+    return 0;
+}
 
-    // return address of updated node
-    if (updatedNode != NULL)
+int xmldb_updateDOM(IXML_Element* input,
+                    const char* href,
+                    IXML_Element** updatedNode,
+                    int* slashFlag)
+{
+    if (ixmlElement_getAttribute(input, OBIX_ATTR_VAL) == NULL)
+    {
+        log_warning("Unable to update the storage: "
+                    "Input data doesn't contain \'%s\' attribute.",
+                    OBIX_ATTR_VAL);
+        return -1;
+    }
+
+    // get the object from the storage
+    IXML_Element* nodeInStorage = xmldb_getDOM(href, slashFlag);
+    if (nodeInStorage == NULL)
+    {
+        log_warning("Unable to update the storage: "
+                    "No object with the URI \"%s\" is found.", href);
+        return -2;
+    }
+
+    int error = xmldb_updateObject(nodeInStorage, input);
+    if (error == 0)
+    {
+        xmldb_updateVersion(nodeInStorage);
+    }
+
+    // return address of the node in the storage
+    if ((error >= 0) && (updatedNode != NULL))
     {
         *updatedNode = nodeInStorage;
     }
-    return 0;
+    return error;
 }
 
 int xmldb_delete(const char* href)
 {
-    IXML_Node* node = getNodeByHref(_storage, href, NULL);
+    IXML_Node* node = getNodeByHref(href, NULL);
     if (node == NULL)
     {
         log_warning("Unable to delete data. Provided URI (%s) doesn't "
@@ -679,71 +1274,39 @@ int xmldb_delete(const char* href)
         return -1;
     }
 
-    int error = ixmlNode_removeChild(ixmlNode_getParentNode(node), node, &node);
+    IXML_Node* parent = ixmlNode_getParentNode(node);
+    int error = ixmlNode_removeChild(parent, node, &node);
     if (error != IXML_SUCCESS)
     {
         log_warning("Error occurred when deleting data (error %d).", error);
         return -1;
     }
+    if (parent == ixmlDocument_getNode(_storage))
+    {
+        removeRootObject(node);
+    }
 
     ixmlNode_free(node);
+    // contents of the parent object are changed
+    IXML_Element* parentElement = ixmlNode_convertToElement(parent);
+    if (parentElement != NULL)
+    {
+        xmldb_updateVersion(parentElement);
+    }
     return 0;
 }
 
 int xmldb_loadFile(const char* filename)
 {
     char* xmlFile = config_getResFullPath(filename);
-
-    // open the file
-    FILE* file = fopen(xmlFile, "rb");
-    if (file == NULL)
-    {
-        log_error("Unable to access file \"%s\".", xmlFile);
-        free(xmlFile);
-        return -1;
-    }
-
-    // check the file size
-    int error = fseek(file, 0, SEEK_END);
-    if (error != 0)
-    {
-        log_error("Error reading file \'%s\' (%d).", xmlFile, error);
-        free(xmlFile);
-        return error;
-    }
-    int size = ftell(file);
-    if (size <= 0)
+    if (xmlFile == NULL)
     {
-        log_error("Error reading file \"%s\".", xmlFile);
-        free(xmlFile);
         return -1;
     }
-    rewind(file);
-
-    // read the file to the buffer
-    char* data = (char*) malloc(size + 1);
-    if (data == NULL)
-    {
-        log_error("Error reading file \"%s\". File is too big.", xmlFile);
-        free(xmlFile);
-        return -1;
-    }
-    int bytesRead = fread(data, 1, size, file);
-    data[bytesRead] = '\0';
-
-    // put data to the storage
-    error = xmldb_putHelper(data, FALSE);
-    free(data);
-    if (error != 0)
-    {
-        log_error("Unable to update storage. File \"%s\" is corrupted "
-                  "(error %d).", xmlFile, error);
-        free(xmlFile);
-        return error;
-    }
 
+    int error = loadFile(xmlFile);
     free(xmlFile);
-    return 0;
+    return error;
 }
 
 void xmldb_printDump()
@@ -880,31 +1443,117 @@ const char* xmldb_getMetaVariableValue(IXML_Element* obj, const char* name)
 
 IXML_Element* xmldb_getMetaInfo(IXML_Element* doc)
 {
-    IXML_NodeList* list = ixmlElement_getElementsByTagName(doc, OBIX_META);
-    if (list == NULL)
+    // check only direct children, because meta tags of child objects are
+    // not needed. It is much faster than searching the whole subtree.
+    IXML_Node* node = ixmlNode_getFirstChild(ixmlElement_getNode(doc));
+    for (; node != NULL; node = ixmlNode_getNextSibling(node))
     {
-        return NULL;
+        IXML_Element* element = ixmlNode_convertToElement(node);
+        if ((element != NULL) &&
+                (strcmp(ixmlElement_getTagName(element), OBIX_META) == 0))
+        {
+            return element;
+        }
     }
 
-    int length = ixmlNodeList_length(list);
+    // We did not find anything
+    return NULL;
+}
+
+void xmldb_updateVersion(IXML_Element* element)
+{
+    char version[24];
+    sprintf(version, "%ld", ++_storageVersion);
+
+    // contents of all parent objects are changed too
+    IXML_Node* node = ixmlElement_getNode(element);
+    for (; node != NULL; node = ixmlNode_getParentNode(node))
+    {
+        element = ixmlNode_convertToElement(node);
+        if (element == NULL)
+        {   // reached the document node
+            break;
+        }
+
+        IXML_Node* meta = xmldb_getMetaVariable(element, OBIX_META_VAR_VERSION);
+        if (meta != NULL)
+        {
+            xmldb_changeMetaVariable(meta, version);
+        }
+        else
+        {
+            xmldb_putMetaVariable(element, OBIX_META_VAR_VERSION, version);
+        }
+    }
+}
+
+void xmldb_updateVersions(IXML_Element** elements,
+                          int count,
+                          void (*listener)(IXML_Element* element))
+{
+    char version[24];
+    sprintf(version, "%ld", ++_storageVersion);
+
     int i;
-    IXML_Node* result = NULL;
+    for (i = 0; i < count; i++)
+    {
+        IXML_Node* node = ixmlElement_getNode(elements[i]);
+        for (; node != NULL; node = ixmlNode_getParentNode(node))
+        {
+            IXML_Element* element = ixmlNode_convertToElement(node);
+            if (element == NULL)
+            {   // reached the document node
+                break;
+            }
 
-    for (i = 0; i < length; i++)
+            IXML_Node* meta =
+                xmldb_getMetaVariable(element, OBIX_META_VAR_VERSION);
+            if (meta == NULL)
+            {
+                xmldb_putMetaVariable(element, OBIX_META_VAR_VERSION, version);
+            }
+            else if ((ixmlNode_getNodeValue(meta) != NULL)
+                     && (strcmp(ixmlNode_getNodeValue(meta), version) == 0))
+            {
+                // this object and all its parents are already updated by
+                // one of the previous elements
+                break;
+            }
+            else
+            {
+                xmldb_changeMetaVariable(meta, version);
+            }
+
+            if (listener != NULL)
+            {
+                (*listener)(element);
+            }
+        }
+    }
+}
+
+long xmldb_getVersion(IXML_Element* element)
+{
+    // objects which were not modified since they were stored have the
+    // version of the closest parent which has it
+    IXML_Node* node = ixmlElement_getNode(element);
+    for (; node != NULL; node = ixmlNode_getParentNode(node))
     {
-        result = ixmlNodeList_item(list, i);
-        // check that we have found meta of exactly this tag but not of
-        // meta of it's child
-        if (ixmlNode_getParentNode(result) == ixmlElement_getNode(doc))
+        element = ixmlNode_convertToElement(node);
+        if (element == NULL)
+        {   // reached the document node
+            break;
+        }
+
+        const char* version =
+            xmldb_getMetaVariableValue(element, OBIX_META_VAR_VERSION);
+        if (version != NULL)
         {
-            ixmlNodeList_free(list);
-            return ixmlNode_convertToElement(result);
+            return atol(version);
         }
     }
 
-    // We did not find anything
-    ixmlNodeList_free(list);
-    return NULL;
+    return 0;
 }
 
 void xmldb_deleteMetaInfo(IXML_Element* doc)
@@ -52,12 +52,19 @@ extern const char* OBIX_META;
  * oBIX operations. */
 extern const char* OBIX_META_VAR_HANDLER_ID;
 
+/** Name of meta variable, which stores version of the object
+ * (see #xmldb_getVersion). */
+extern const char* OBIX_META_VAR_VERSION;
+
 /**
  * Initializes storage. Should be executed only once on startup.
  *
+ * @param resourceDir Folder with storage files, or @a NULL to use the
+ *                    resource folder of the configuration (see
+ *                    #config_setResourceDir).
  * @return error code or @a 0 on success.
  */
-int xmldb_init();
+int xmldb_init(const char* resourceDir);
 
 /**
  * Stops work of the storage and releases all resources.
@@ -115,12 +122,63 @@ int xmldb_putDOM(IXML_Element* data);
 
 /**
  * Creates a reference to the new device. This reference is stored at the
- * server in special list of devices accessible from Lobby object.
+ * server in special list of devices accessible from Lobby object. Memory
+ * used by the device is accounted from now on (see storage_usage.h).
  *
  * @param deviceData Data of the new device.
  */
 int xmldb_putDeviceReference(IXML_Element* deviceData);
 
+/**
+ * Checks that the new device fits to memory limits of the storage (see
+ * storage_usage.h). Should be called before the device data is stored.
+ *
+ * @param deviceData Data of the new device.
+ * @return @a 0 if the device can be stored, @a -1 if it is too big.
+ */
+int xmldb_checkDeviceQuota(IXML_Element* deviceData);
+
+/**
+ * Stores several devices at once. Each device is added to the storage and
+ * to the list of devices, like it is done by #xmldb_putDOM and
+ * #xmldb_putDeviceReference, but the input is checked in one pass.
+ *
+ * @param input Object (normally a list), which child objects are device
+ *              data.
+ * @param results Array where result for each device is written:
+ *              @li @a 0 - device is stored;
+ *              @li @a -1 - device data has wrong format;
+ *              @li @a -2 - object with the same URI already exists;
+ *              @li @a -3 - internal storage error;
+ *              @li @a -4 - device exceeds memory limits of the storage.
+ * @param count Number of device objects in the input (size of @a results).
+ * @return Number of stored devices, or @a -1 if the list of devices is not
+ *         found.
+ */
+int xmldb_putDevices(IXML_Element* input, int* results, int count);
+
+/**
+ * Removes reference to the device from the list of devices and stops
+ * accounting of its memory.
+ *
+ * @param href URI of the device.
+ * @return @a 0 on success, @a -1 if there is no such device in the list.
+ */
+int xmldb_deleteDeviceReference(const char* href);
+
+/**
+ * Writes new value to the provided storage object. Unlike #xmldb_updateDOM,
+ * the object is not searched and its version is not changed: the caller
+ * should call #xmldb_updateVersions for all updated objects afterwards. It
+ * allows to modify many objects at once (e.g. in Batch) and to update their
+ * common parents only once.
+ *
+ * @param object Object in the storage.
+ * @param input New state of the object. Only @a val attribute is used.
+ * @return The same codes as #xmldb_updateDOM, except @a -2.
+ */
+int xmldb_updateObject(IXML_Element* object, IXML_Element* input);
+
 /**
  * Updates XML node to the storage. Only @a val attribute is
  * updated and only for nodes which have @a writable attribute
@@ -144,7 +202,9 @@ int xmldb_putDeviceReference(IXML_Element* deviceData);
  * 		   @li @b -1 if request data is corrupted/wrong format;
  * 		   @li @b -2 if object with specified href is not found;
  * 		   @li @b -3 if object is not writable;
- * 		   @li @b -4 if request failed because of internal server error.
+ * 		   @li @b -4 if request failed because of internal server error;
+ * 		   @li @b -6 if the new value doesn't fit to memory limits of the
+ * 		   		device (see storage_usage.h).
  */
 int xmldb_updateDOM(IXML_Element* input,
                     const char* href,
@@ -234,4 +294,34 @@ IXML_Element* xmldb_getMetaInfo(IXML_Element* doc);
  */
 void xmldb_deleteMetaInfo(IXML_Element* doc);
 
+/**
+ * Marks the object as modified: assigns a new version to it and to all its
+ * parent objects, because their contents are changed too. Called
+ * automatically by #xmldb_updateDOM and #xmldb_delete; other code, which
+ * modifies storage objects directly, should call it explicitly.
+ */
+void xmldb_updateVersion(IXML_Element* element);
+
+/**
+ * Marks several objects as modified at once. Works like
+ * #xmldb_updateVersion, but all objects get the same version, so that parents
+ * which they have in common are updated only once.
+ *
+ * @param listener If not @a NULL, it is called once for every modified object
+ *                 and for each of its parents.
+ */
+void xmldb_updateVersions(IXML_Element** elements,
+                          int count,
+                          void (*listener)(IXML_Element* element));
+
+/**
+ * Returns version of the object. Version grows every time when the object
+ * or any of its children is modified, and every new object gets a new
+ * version when it is stored. Objects which were not modified since then
+ * share the version of their parent.
+ * @return Version number, or @a 0 if the object was not modified since
+ *         server start.
+ */
+long xmldb_getVersion(IXML_Element* element);
+
 #endif /*XML_STORAGE_H_*/
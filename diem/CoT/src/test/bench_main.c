@@ -0,0 +1,537 @@
+/* *****************************************************************************
+ * Copyright (c) 2009 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * Microbenchmarks of the server hot paths.
+ *
+ * Loads synthetic storage (N devices with M points each) and measures the
+ * time of the most frequent server operations. Each result is printed as a
+ * single JSON object per line:
+ * @code
+ * {"benchmark":"xmldb_getDOM","devices":100,"points":10,"ops":10000,
+ *  "ops_per_sec":1234567.8,"p50_ns":700,"p99_ns":2100}
+ * @endcode
+ * Only the measured operation is timed; preparation of each iteration (e.g.
+ * changing the value which is written) is not included.
+ *
+ * Usage: obix_bench [-d devices] [-p points] [-n iterations] [res_dir]
+ *
+ * @author Andrey Litvinov
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <obix_utils.h>
+#include <log_utils.h>
+#include <xml_config.h>
+#include <ixml_ext.h>
+#include <ptask.h>
+#include <table.h>
+#include <str_buffer.h>
+#include <xml_storage.h>
+#include <server.h>
+#include <watch.h>
+#include <response.h>
+#include <request.h>
+
+/** @name Default benchmark parameters
+ * @{ */
+#define DEVICES_DEFAULT 100
+#define POINTS_DEFAULT 10
+#define ITERATIONS_DEFAULT 10000
+/** @} */
+
+/** URI prefix of synthetic devices. */
+#define DEVICE_URI "/obix/bench/dev%d/"
+/** URI of synthetic points. */
+#define POINT_URI DEVICE_URI "p%d"
+
+/** Number of commands in the benchmarked Batch request. */
+#define BATCH_SIZE 10
+
+static int _devices = DEVICES_DEFAULT;
+static int _points = POINTS_DEFAULT;
+static int _iterations = ITERATIONS_DEFAULT;
+
+/** Durations of the iterations of the current benchmark (in nanoseconds). */
+static long* _samples;
+
+/** Request object of all benchmarked requests. */
+static Request _request;
+
+/** URI of the Watch, used by benchmarks. */
+static char _watchUri[64];
+
+/** Returns current time in nanoseconds. */
+static long getTimeNs()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (time.tv_sec * 1000000000L) + time.tv_nsec;
+}
+
+static int compareSamples(const void* a, const void* b)
+{
+    long diff = *((const long*) a) - *((const long*) b);
+    return (diff > 0) - (diff < 0);
+}
+
+/**
+ * Prints results of the benchmark, whose iteration times are stored in
+ * #_samples.
+ */
+static void printResult(const char* name, int count)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    long total = 0;
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        total += _samples[i];
+    }
+    qsort(_samples, count, sizeof(long), &compareSamples);
+
+    printf("{\"benchmark\":\"%s\",\"devices\":%d,\"points\":%d,\"ops\":%d,"
+           "\"ops_per_sec\":%.1f,\"p50_ns\":%ld,\"p99_ns\":%ld}\n",
+           name, _devices, _points, count,
+           (total > 0) ? (count * 1e9 / total) : 0.0,
+           _samples[(count - 1) / 2],
+           _samples[(count * 99 - 1) / 100]);
+    fflush(stdout);
+}
+
+/** Returns URI of the point which is used at the iteration. */
+static void getPointUri(char* buffer, int iteration)
+{
+    int point = iteration % (_devices * _points);
+    sprintf(buffer, POINT_URI, point / _points, point % _points);
+}
+
+/** Sends response by simply releasing it. */
+static void benchResponseListener(Response* response)
+{
+    obixResponse_free(response);
+}
+
+/** Generates synthetic devices and puts them to the storage. */
+static int loadStorage()
+{
+    int size = 128 + _points * 96;
+    char* data = (char*) malloc(size);
+    if (data == NULL)
+    {
+        return -1;
+    }
+
+    int d;
+    for (d = 0; d < _devices; d++)
+    {
+        int length = sprintf(data, "<obj href=\"" DEVICE_URI "\" "
+                             "name=\"dev%d\">\r\n", d, d);
+        int p;
+        for (p = 0; p < _points; p++)
+        {
+            length += sprintf(data + length,
+                              "  <int name=\"p%d\" href=\"p%d\" val=\"0\" "
+                              "writable=\"true\"/>\r\n", p, p);
+        }
+        strcpy(data + length, "</obj>");
+
+        if (xmldb_put(data) != 0)
+        {
+            fprintf(stderr, "Unable to put device %d to the storage.\n", d);
+            free(data);
+            return -1;
+        }
+    }
+
+    free(data);
+    return 0;
+}
+
+/** Measures search of objects in the storage. */
+static void benchGetDOM()
+{
+    char uri[64];
+    int i;
+    for (i = 0; i < _iterations; i++)
+    {
+        getPointUri(uri, i);
+        long start = getTimeNs();
+        xmldb_getDOM(uri, NULL);
+        _samples[i] = getTimeNs() - start;
+    }
+    printResult("xmldb_getDOM", _iterations);
+}
+
+/** Measures writing of values including update of Watch meta data. */
+static void benchWrite()
+{
+    IXML_Element* input = ixmlElement_parseBuffer("<int val=\"0\"/>");
+    if (input == NULL)
+    {
+        return;
+    }
+
+    char uri[64];
+    char value[16];
+    int i;
+    for (i = 0; i < _iterations; i++)
+    {
+        getPointUri(uri, i);
+        sprintf(value, "%d", i + 1);
+        ixmlElement_setAttribute(input, OBIX_ATTR_VAL, value);
+        long start = getTimeNs();
+        obix_server_writeDOM(uri, input);
+        _samples[i] = getTimeNs() - start;
+    }
+    ixmlElement_freeOwnerDocument(input);
+    printResult("xmldb_updateDOM+updateMetaWatch", _iterations);
+}
+
+/** Measures serialization of a device object. */
+static void benchGenerateResponse()
+{
+    char uri[64];
+    int i;
+    for (i = 0; i < _iterations; i++)
+    {
+        sprintf(uri, DEVICE_URI, i % _devices);
+        IXML_Element* device = xmldb_getDOM(uri, NULL);
+        Response* response = obixResponse_create(&_request);
+        long start = getTimeNs();
+        obix_server_generateResponse(response, device, uri, 0, FALSE);
+        _samples[i] = getTimeNs() - start;
+        obixResponse_free(response);
+    }
+    printResult("obix_server_generateResponse", _iterations);
+}
+
+/**
+ * Invokes operation and returns its duration. The response is released by
+ * #benchResponseListener.
+ */
+static long invoke(const char* uri, IXML_Element* input)
+{
+    Response* response = obixResponse_create(&_request);
+    long start = getTimeNs();
+    obix_server_invoke(response, uri, input);
+    return getTimeNs() - start;
+}
+
+/** Creates Watch and saves its URI. */
+static int createWatch()
+{
+    Response* response = obixResponse_create(&_request);
+    obix_server_invoke(response, "/obix/watchService/make", NULL);
+    // response is released by the listener, thus Watch id is taken from the
+    // number of existing Watches
+    int watchId;
+    for (watchId = 1; obixWatch_get(watchId + 1) != NULL; watchId++)
+        ;
+    oBIX_Watch* watch = obixWatch_get(watchId);
+    if (watch == NULL)
+    {
+        return -1;
+    }
+    char* uri = obixWatch_getUri(watch);
+    if (uri == NULL)
+    {
+        return -1;
+    }
+    strncpy(_watchUri, uri, sizeof(_watchUri) - 1);
+    free(uri);
+    return 0;
+}
+
+/** Measures Watch.add, Watch.pollChanges and Watch.pollRefresh. */
+static void benchWatch()
+{
+    if (createWatch() != 0)
+    {
+        fprintf(stderr, "Unable to create Watch.\n");
+        return;
+    }
+
+    // each point is added only once
+    char operationUri[128];
+    char pointUri[64];
+    char text[256];
+    int count = _devices * _points;
+    if (count > _iterations)
+    {
+        count = _iterations;
+    }
+    sprintf(operationUri, "%sadd", _watchUri);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        getPointUri(pointUri, i);
+        sprintf(text, "<obj is=\"obix:WatchIn\"><list name=\"hrefs\">"
+                "<uri val=\"%s\"/></list></obj>", pointUri);
+        IXML_Element* input = ixmlElement_parseBuffer(text);
+        _samples[i] = invoke(operationUri, input);
+        ixmlElement_freeOwnerDocument(input);
+    }
+    printResult("Watch.add", count);
+
+    // one watched point is changed before each poll
+    IXML_Element* value = ixmlElement_parseBuffer("<int val=\"0\"/>");
+    sprintf(operationUri, "%spollChanges", _watchUri);
+    for (i = 0; i < _iterations; i++)
+    {
+        getPointUri(pointUri, i % count);
+        sprintf(text, "%d", -i - 1);
+        ixmlElement_setAttribute(value, OBIX_ATTR_VAL, text);
+        obix_server_writeDOM(pointUri, value);
+        _samples[i] = invoke(operationUri, NULL);
+    }
+    ixmlElement_freeOwnerDocument(value);
+    printResult("Watch.pollChanges", _iterations);
+
+    // poll refresh returns all watched points, thus it is much slower
+    int refreshCount = _iterations / 10 + 1;
+    sprintf(operationUri, "%spollRefresh", _watchUri);
+    for (i = 0; i < refreshCount; i++)
+    {
+        _samples[i] = invoke(operationUri, NULL);
+    }
+    printResult("Watch.pollRefresh", refreshCount);
+
+    sprintf(operationUri, "%sdelete", _watchUri);
+    invoke(operationUri, NULL);
+}
+
+/** Measures Batch with equal number of reads and writes. */
+static void benchBatch()
+{
+    String_Buffer* buffer = strbuf_create(1024);
+    char uri[64];
+    char text[160];
+    strbuf_append(buffer, "<list is=\"obix:BatchIn\" of=\"obix:uri\">");
+    int i;
+    for (i = 0; i < BATCH_SIZE; i++)
+    {
+        getPointUri(uri, i * 7);
+        if (i % 2 == 0)
+        {
+            sprintf(text, "<uri is=\"obix:Read\" val=\"%s\"/>", uri);
+        }
+        else
+        {
+            sprintf(text, "<uri is=\"obix:Write\" val=\"%s\">"
+                    "<int val=\"%d\"/></uri>", uri, i);
+        }
+        strbuf_append(buffer, text);
+    }
+    strbuf_append(buffer, "</list>");
+    IXML_Element* input = ixmlElement_parseBuffer(strbuf_getString(buffer));
+    strbuf_free(buffer);
+    if (input == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < _iterations; i++)
+    {
+        _samples[i] = invoke("/obix/batch/", input);
+    }
+    ixmlElement_freeOwnerDocument(input);
+    printResult("handlerBatch", _iterations);
+}
+
+static void emptyTask(void* arg)
+{
+}
+
+/** Measures scheduling and canceling of periodic tasks. */
+static void benchPtask()
+{
+    Task_Thread* thread = ptask_init();
+    if (thread == NULL)
+    {
+        return;
+    }
+
+    int* ids = (int*) malloc(_iterations * sizeof(int));
+    if (ids == NULL)
+    {
+        ptask_dispose(thread, TRUE);
+        return;
+    }
+
+    // tasks are never executed during the benchmark
+    int i;
+    for (i = 0; i < _iterations; i++)
+    {
+        long start = getTimeNs();
+        ids[i] = ptask_schedule(thread, &emptyTask, NULL,
+                                3600000 + i, EXECUTE_INDEFINITE);
+        _samples[i] = getTimeNs() - start;
+    }
+    printResult("ptask_schedule", _iterations);
+
+    for (i = 0; i < _iterations; i++)
+    {
+        long start = getTimeNs();
+        ptask_cancel(thread, ids[i], FALSE);
+        _samples[i] = getTimeNs() - start;
+    }
+    printResult("ptask_cancel", _iterations);
+
+    free(ids);
+    ptask_dispose(thread, TRUE);
+}
+
+/** Measures operations of the table. */
+static void benchTable()
+{
+    char** keys = (char**) malloc(_iterations * sizeof(char*));
+    Table* table = table_create(16);
+    if ((keys == NULL) || (table == NULL))
+    {
+        free(keys);
+        return;
+    }
+
+    int i;
+    for (i = 0; i < _iterations; i++)
+    {
+        keys[i] = (char*) malloc(64);
+        getPointUri(keys[i], i);
+        sprintf(keys[i] + strlen(keys[i]), "/%d", i);
+    }
+
+    for (i = 0; i < _iterations; i++)
+    {
+        long start = getTimeNs();
+        table_put(table, keys[i], keys[i]);
+        _samples[i] = getTimeNs() - start;
+    }
+    printResult("table_put", _iterations);
+
+    for (i = 0; i < _iterations; i++)
+    {
+        const char* key = keys[(i * 7919) % _iterations];
+        long start = getTimeNs();
+        table_get(table, key);
+        _samples[i] = getTimeNs() - start;
+    }
+    printResult("table_get", _iterations);
+
+    for (i = 0; i < _iterations; i++)
+    {
+        long start = getTimeNs();
+        table_remove(table, keys[i]);
+        _samples[i] = getTimeNs() - start;
+    }
+    printResult("table_remove", _iterations);
+
+    table_free(table);
+    for (i = 0; i < _iterations; i++)
+    {
+        free(keys[i]);
+    }
+    free(keys);
+}
+
+/** Parses command line arguments. */
+static const char* parseArguments(int argc, char** argv)
+{
+    int option;
+    while ((option = getopt(argc, argv, "d:p:n:")) != -1)
+    {
+        switch (option)
+        {
+        case 'd':
+            _devices = atoi(optarg);
+            break;
+        case 'p':
+            _points = atoi(optarg);
+            break;
+        case 'n':
+            _iterations = atoi(optarg);
+            break;
+        default:
+            return NULL;
+        }
+    }
+
+    if ((_devices <= 0) || (_points <= 0) || (_iterations <= 0))
+    {
+        return NULL;
+    }
+
+    return (optind < argc) ? argv[optind] : "res/";
+}
+
+/** Benchmark entry point. */
+int main(int argc, char** argv)
+{
+    const char* resFolder = parseArguments(argc, argv);
+    if (resFolder == NULL)
+    {
+        fprintf(stderr, "Usage: %s [-d devices] [-p points] [-n iterations] "
+                "[res_dir]\n", argv[0]);
+        return 1;
+    }
+
+    // nothing but results should be printed to the output
+    log_setLevel(LOG_LEVEL_NO);
+    config_setResourceDir((char*) resFolder);
+
+    _samples = (long*) malloc(_iterations * sizeof(long));
+    if ((_samples == NULL) || (obix_server_init(NULL) != 0))
+    {
+        fprintf(stderr, "Unable to initialize the server.\n");
+        return 1;
+    }
+
+    memset(&_request, 0, sizeof(Request));
+    _request.serverAddress = "http://localhost";
+    _request.serverAddressLength = 16;
+    _request.depth = -1;
+    _request.limit = -1;
+    obixResponse_setListener(&benchResponseListener);
+
+    if (loadStorage() != 0)
+    {
+        return 1;
+    }
+
+    benchGetDOM();
+    benchWrite();
+    benchGenerateResponse();
+    benchWatch();
+    benchBatch();
+    benchPtask();
+    benchTable();
+
+    obix_server_shutdown();
+    free(_samples);
+    return 0;
+}
@@ -0,0 +1,1162 @@
+/* *****************************************************************************
+ * Copyright (c) 2009 Andrey Litvinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ****************************************************************************/
+/** @file
+ * FastCGI load driver of the oBIX server.
+ *
+ * Sends requests directly to obix.fcgi using FastCGI protocol, so that the
+ * server can be benchmarked without HTTP server and HTTP client. The driver
+ * either connects to a server which is already listening at some socket
+ * (e.g. started by spawn-fcgi) or starts obix.fcgi itself, passing it
+ * a private Unix domain socket as a standard input, exactly as web servers do.
+ *
+ * Requests are taken from a script file, where each line describes one
+ * request:
+ * @code
+ * # comment
+ * GET /obix/about/
+ * PUT /obix/kitchen/1/temp <real val="23.5"/>
+ * POST /obix/watchService/make
+ * @endcode
+ * The rest of the line after URI is sent as request body. Each worker thread
+ * goes through the script in a loop, starting from its own line, thus the mix
+ * of requests is defined by how often each request appears in the script.
+ *
+ * Instead of a script, the driver can replay a trace captured by the server
+ * (see trace.h). Recorded requests are sent with their recorded headers and
+ * bodies in the same order and with the same delays between them, divided by the speed factor (option -a).
+ * Speed 0 sends them as fast as possible. Latency of replayed requests is
+ * measured from the moment when they should have been sent, thus an
+ * overloaded server or too few connections show up as growing latency.
+ *
+ * Results are printed as a single JSON object, e.g.:
+ * @code
+ * {"requests":10000,"errors":0,"obix_errors":0,"concurrency":8,
+ *  "duration_s":1.234,"requests_per_sec":8103.7,"p50_us":900,
+ *  "p90_us":1500,"p99_us":3100,"max_us":8000}
+ * @endcode
+ *
+ * Usage:
+ * @code
+ * obix_fcgi_bench [-x obix.fcgi -r res_dir | -s socket] [-f script]
+ *                 [-c concurrency] [-n requests | -d seconds]
+ * obix_fcgi_bench [-x obix.fcgi -r res_dir | -s socket] -t trace
+ *                 [-a speed] [-c concurrency]
+ * @endcode
+ * where @a socket is either a path to Unix domain socket or host:port.
+ *
+ * @author Andrey Litvinov
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "trace.h"
+
+#define USAGE_MESSAGE "\n" \
+	"Usage:\n" \
+	"   obix_fcgi_bench [-x obix.fcgi -r res_dir | -s socket] [-f script]\n" \
+	"                   [-c concurrency] [-n requests | -d seconds]\n" \
+	"   obix_fcgi_bench [-x obix.fcgi -r res_dir | -s socket] -t trace\n" \
+	"                   [-a speed] [-c concurrency]\n" \
+	"where\n" \
+	" -x <file>:   \t Server executable, which is started by the driver;\n" \
+	" -r <dir>:    \t Resource folder passed to the started server;\n" \
+	" -s <socket>: \t Socket of already running server: path of Unix\n" \
+	"              \t domain socket or host:port;\n" \
+	" -f <file>:   \t Script with requests. Each line is a request:\n" \
+	"              \t \"METHOD URI [body]\". By default, the driver reads\n" \
+	"              \t /obix/about/;\n" \
+	" -c <count>:  \t Number of concurrent connections (default %d);\n" \
+	" -n <count>:  \t Total number of requests (default %d);\n" \
+	" -d <sec>:    \t Test duration. Overrides number of requests;\n" \
+	" -t <file>:   \t Trace captured by the server, which is replayed\n" \
+	"              \t once instead of the script;\n" \
+	" -a <speed>:  \t Replay speed factor (default 1). Speed 0 replays\n" \
+	"              \t the trace as fast as possible.\n"
+
+#define CONCURRENCY_DEFAULT 8
+#define REQUESTS_DEFAULT 10000
+
+/** Time which is given to the started server for initialization. */
+#define SERVER_START_TIMEOUT 10
+
+/** @name FastCGI protocol constants
+ * See FastCGI specification for details.
+ * @{ */
+#define FCGI_VERSION_1 1
+#define FCGI_BEGIN_REQUEST 1
+#define FCGI_END_REQUEST 3
+#define FCGI_PARAMS 4
+#define FCGI_STDIN 5
+#define FCGI_STDOUT 6
+#define FCGI_STDERR 7
+#define FCGI_RESPONDER 1
+#define FCGI_HEADER_LEN 8
+#define FCGI_MAX_CONTENT 65535
+/** @} */
+
+/** Request of the script. */
+typedef struct
+{
+    char* method;
+    char* uri;
+    /** Request body. Bodies from traces can be binary. */
+    char* body;
+    int bodyLength;
+    /** Time when request should be sent, counted in microseconds from the
+     * test start. Used only during trace replay. */
+    long long time;
+    /** Encoded FastCGI records BEGIN_REQUEST and PARAMS. */
+    unsigned char* header;
+    int headerLength;
+} Script_Request;
+
+/** Statistics of one worker thread. */
+typedef struct
+{
+    pthread_t thread;
+    int id;
+    /** Latencies of successful requests in microseconds. */
+    long* samples;
+    long sampleCount;
+    long sampleSize;
+    long errors;
+    long obixErrors;
+} Worker;
+
+static Script_Request* _script = NULL;
+static int _scriptSize = 0;
+/** Request, which checks whether started server is ready. */
+static Script_Request _probe;
+
+static const char* _serverProgram = NULL;
+static const char* _resourceDir = NULL;
+static const char* _socketAddress = NULL;
+static const char* _scriptFile = NULL;
+static const char* _traceFile = NULL;
+static double _speed = 1;
+static int _concurrency = CONCURRENCY_DEFAULT;
+static long _requestCount = REQUESTS_DEFAULT;
+static long _duration = 0;
+
+/** Address of the server socket. */
+static struct sockaddr_storage _address;
+static socklen_t _addressLength;
+
+static pid_t _serverPid = 0;
+static char _serverSocket[64];
+
+/** Number of requests which are already started by workers. */
+static long _sentCounter = 0;
+static long long _startTime = 0;
+static long long _stopTime = 0;
+
+/** Returns current time in microseconds. */
+static long long getTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return ((long long) time.tv_sec * 1000000) + (time.tv_nsec / 1000);
+}
+
+/** Writes header of FastCGI record to the buffer. */
+static void writeRecordHeader(unsigned char* buffer, int type, int length)
+{
+    buffer[0] = FCGI_VERSION_1;
+    buffer[1] = type;
+    buffer[2] = 0;  // request id = 1
+    buffer[3] = 1;
+    buffer[4] = (length >> 8) & 0xff;
+    buffer[5] = length & 0xff;
+    buffer[6] = 0;  // no padding
+    buffer[7] = 0;
+}
+
+/** Writes length of FastCGI name-value pair component. */
+static int writePairLength(unsigned char* buffer, int length)
+{
+    if (length < 128)
+    {
+        buffer[0] = length;
+        return 1;
+    }
+
+    buffer[0] = ((length >> 24) & 0x7f) | 0x80;
+    buffer[1] = (length >> 16) & 0xff;
+    buffer[2] = (length >> 8) & 0xff;
+    buffer[3] = length & 0xff;
+    return 4;
+}
+
+/** Amount of FastCGI parameters which are sent with every request. */
+#define DEFAULT_PARAMS_COUNT 11
+
+/**
+ * Encodes FastCGI records which start the request: BEGIN_REQUEST, PARAMS and
+ * the empty PARAMS record. They are the same for all executions of the
+ * request, thus they are generated only once.
+ *
+ * @param extraParams Additional parameters (name-value pairs), e.g. recorded
+ *                    in the trace. They override default parameters with
+ *                    the same name.
+ * @param extraCount Amount of strings in @a extraParams.
+ */
+static int encodeRequestHeader(Script_Request* request,
+                               char** extraParams,
+                               int extraCount)
+{
+    char contentLength[16];
+    sprintf(contentLength, "%d", request->bodyLength);
+    const char* query = strchr(request->uri, '?');
+    const char* params[DEFAULT_PARAMS_COUNT * 2 + extraCount + 1];
+    const char* defaultParams[DEFAULT_PARAMS_COUNT * 2] = {
+        "GATEWAY_INTERFACE", "CGI/1.1",
+        "SERVER_PROTOCOL", "HTTP/1.1",
+        "SERVER_NAME", "localhost",
+        "SERVER_PORT", "80",
+        "HTTP_HOST", "localhost",
+        "REQUEST_METHOD", request->method,
+        "REQUEST_URI", request->uri,
+        "SCRIPT_NAME", "/obix",
+        "QUERY_STRING", (query != NULL) ? query + 1 : "",
+        "CONTENT_TYPE", "text/xml",
+        "CONTENT_LENGTH", contentLength
+    };
+    int count = DEFAULT_PARAMS_COUNT * 2;
+    memcpy(params, defaultParams, sizeof(defaultParams));
+
+    int i;
+    for (i = 0; i + 1 < extraCount; i += 2)
+    {
+        int j = 0;
+        while ((j < DEFAULT_PARAMS_COUNT * 2) &&
+                (strcmp(params[j], extraParams[i]) != 0))
+        {
+            j += 2;
+        }
+        if (j == DEFAULT_PARAMS_COUNT * 2)
+        {   // not a default parameter
+            j = count;
+            count += 2;
+            params[j] = extraParams[i];
+        }
+        params[j + 1] = extraParams[i + 1];
+    }
+    params[count] = NULL;
+
+    int paramsLength = 0;
+    for (i = 0; params[i] != NULL; i += 2)
+    {
+        paramsLength += strlen(params[i]) + strlen(params[i + 1]) + 8;
+    }
+    if (paramsLength > FCGI_MAX_CONTENT)
+    {
+        fprintf(stderr, "Request URI is too long: %s\n", request->uri);
+        return -1;
+    }
+
+    request->header = (unsigned char*) malloc(FCGI_HEADER_LEN * 4 +
+                      paramsLength);
+    if (request->header == NULL)
+    {
+        return -1;
+    }
+    unsigned char* buffer = request->header;
+
+    // BEGIN_REQUEST: role and flags (connection is closed after request)
+    writeRecordHeader(buffer, FCGI_BEGIN_REQUEST, 8);
+    memset(buffer + FCGI_HEADER_LEN, 0, 8);
+    buffer[FCGI_HEADER_LEN + 1] = FCGI_RESPONDER;
+    int length = FCGI_HEADER_LEN * 2;
+
+    // PARAMS: header is written after the length of content is known
+    int paramsStart = length;
+    length += FCGI_HEADER_LEN;
+    for (i = 0; params[i] != NULL; i += 2)
+    {
+        int nameLength = strlen(params[i]);
+        int valueLength = strlen(params[i + 1]);
+        length += writePairLength(buffer + length, nameLength);
+        length += writePairLength(buffer + length, valueLength);
+        memcpy(buffer + length, params[i], nameLength);
+        length += nameLength;
+        memcpy(buffer + length, params[i + 1], valueLength);
+        length += valueLength;
+    }
+    writeRecordHeader(buffer + paramsStart, FCGI_PARAMS,
+                      length - paramsStart - FCGI_HEADER_LEN);
+
+    // empty PARAMS record ends the stream
+    writeRecordHeader(buffer + length, FCGI_PARAMS, 0);
+    length += FCGI_HEADER_LEN;
+
+    request->headerLength = length;
+    return 0;
+}
+
+/**
+ * Fills in request properties. Body can be @a NULL.
+ *
+ * @param params Additional FastCGI parameters (name-value pairs), or @a NULL.
+ * @param paramCount Amount of strings in @a params.
+ */
+static int initRequest(Script_Request* request,
+                       const char* method,
+                       const char* uri,
+                       const char* body,
+                       int bodyLength,
+                       char** params,
+                       int paramCount,
+                       long long time)
+{
+    if (body == NULL)
+    {
+        bodyLength = 0;
+    }
+    request->method = strdup(method);
+    request->uri = strdup(uri);
+    request->body = (char*) malloc(bodyLength + 1);
+    request->bodyLength = bodyLength;
+    request->time = time;
+    if ((request->method == NULL) || (request->uri == NULL) ||
+            (request->body == NULL))
+    {
+        fprintf(stderr, "Not enough memory.\n");
+        return -1;
+    }
+    if (bodyLength > 0)
+    {
+        memcpy(request->body, body, bodyLength);
+    }
+    request->body[bodyLength] = '\0';
+
+    return encodeRequestHeader(request, params, paramCount);
+}
+
+/** Appends request to the end of the script. */
+static int addRequest(const char* method,
+                      const char* uri,
+                      const char* body,
+                      int bodyLength,
+                      char** params,
+                      int paramCount,
+                      long long time)
+{
+    Script_Request* script = (Script_Request*) realloc(_script,
+                             sizeof(Script_Request) * (_scriptSize + 1));
+    if (script == NULL)
+    {
+        fprintf(stderr, "Not enough memory.\n");
+        return -1;
+    }
+    _script = script;
+
+    if (initRequest(&(_script[_scriptSize]), method, uri, body, bodyLength,
+                    params, paramCount, time) != 0)
+    {
+        return -1;
+    }
+
+    _scriptSize++;
+    return 0;
+}
+
+/** Adds one line of the script. */
+static int addScriptLine(char* line)
+{
+    // cut the line end
+    line[strcspn(line, "\r\n")] = '\0';
+    char* method = strtok(line, " \t");
+    if ((method == NULL) || (*method == '#'))
+    {   // empty line or comment
+        return 0;
+    }
+    char* uri = strtok(NULL, " \t");
+    if (uri == NULL)
+    {
+        fprintf(stderr, "Request URI is missing: %s\n", method);
+        return -1;
+    }
+    char* body = strtok(NULL, "");
+
+    return addRequest(method, uri, body, (body != NULL) ? strlen(body) : 0,
+                      NULL, 0, 0);
+}
+
+/** Loads script from the file, or generates the default one. */
+static int loadScript()
+{
+    if (_scriptFile == NULL)
+    {
+        char defaultLine[] = "GET /obix/about/";
+        return addScriptLine(defaultLine);
+    }
+
+    FILE* file = fopen(_scriptFile, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Unable to open script file \"%s\".\n", _scriptFile);
+        return -1;
+    }
+
+    // the line buffer grows if there are long request bodies
+    size_t size = 0;
+    char* line = NULL;
+    int error = 0;
+    while ((error == 0) && (getline(&line, &size, file) != -1))
+    {
+        error = addScriptLine(line);
+    }
+    free(line);
+    fclose(file);
+
+    if ((error == 0) && (_scriptSize == 0))
+    {
+        fprintf(stderr, "Script file \"%s\" has no requests.\n", _scriptFile);
+        return -1;
+    }
+    return error;
+}
+
+/**
+ * Reads LEB128 number from the trace.
+ * @return @a 0 on success, @a -1 if the trace ends.
+ */
+static int readNumber(FILE* file, unsigned long long* value)
+{
+    *value = 0;
+    int shift = 0;
+    int byte;
+    do
+    {
+        byte = fgetc(file);
+        if ((byte == EOF) || (shift > 63))
+        {
+            return -1;
+        }
+        *value |= ((unsigned long long) (byte & 0x7f)) << shift;
+        shift += 7;
+    }
+    while ((byte & 0x80) != 0);
+
+    return 0;
+}
+
+/** Reads string of the given length from the trace. */
+static char* readString(FILE* file, unsigned long long length)
+{
+    if (length > (1 << 30))
+    {   // trace is broken
+        return NULL;
+    }
+
+    char* string = (char*) malloc(length + 1);
+    if (string == NULL)
+    {
+        return NULL;
+    }
+    if (fread(string, 1, length, file) != length)
+    {
+        free(string);
+        return NULL;
+    }
+    string[length] = '\0';
+    return string;
+}
+
+/** Maximum amount of parameters in one trace record. */
+#define TRACE_PARAMS_MAX 16
+
+/**
+ * Reads FastCGI parameters of the trace record as name-value pairs.
+ * @return Amount of read strings, or @a -1 if the trace is broken.
+ */
+static int readParams(FILE* file, char** params)
+{
+    unsigned long long count;
+    if ((readNumber(file, &count) != 0) || (count > TRACE_PARAMS_MAX))
+    {
+        return -1;
+    }
+
+    int i;
+    for (i = 0; i < count * 2; i++)
+    {
+        unsigned long long length;
+        if ((readNumber(file, &length) != 0) ||
+                ((params[i] = readString(file, length)) == NULL))
+        {
+            while (i > 0)
+            {
+                free(params[--i]);
+            }
+            return -1;
+        }
+    }
+    return count * 2;
+}
+
+/** Loads requests captured by the server (see trace.h). */
+static int loadTrace()
+{
+    const char* methods[] = {NULL, "GET", "PUT", "POST"};
+
+    FILE* file = fopen(_traceFile, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Unable to open trace file \"%s\".\n", _traceFile);
+        return -1;
+    }
+
+    char magic[TRACE_MAGIC_LENGTH + 1];
+    if ((fread(magic, 1, sizeof(magic), file) != sizeof(magic)) ||
+            (strncmp(magic, TRACE_MAGIC, TRACE_MAGIC_LENGTH) != 0) ||
+            (magic[TRACE_MAGIC_LENGTH] != TRACE_VERSION))
+    {
+        fprintf(stderr, "\"%s\" is not a trace file of supported version.\n",
+                _traceFile);
+        fclose(file);
+        return -1;
+    }
+
+    long long time = 0;
+    int error = 0;
+    int method;
+    while ((error == 0) && ((method = fgetc(file)) != EOF))
+    {
+        unsigned long long delay;
+        unsigned long long length;
+        unsigned long long bodyLength = 0;
+        char* uri = NULL;
+        char* body = NULL;
+        char* params[TRACE_PARAMS_MAX * 2];
+        int paramCount = 0;
+
+        error = -1;
+        if ((method >= TRACE_METHOD_GET) && (method <= TRACE_METHOD_POST) &&
+                (readNumber(file, &delay) == 0) &&
+                (readNumber(file, &length) == 0) &&
+                ((uri = readString(file, length)) != NULL) &&
+                ((paramCount = readParams(file, params)) >= 0) &&
+                (readNumber(file, &bodyLength) == 0) &&
+                ((body = readString(file, bodyLength)) != NULL))
+        {
+            time += delay;
+            error = addRequest(methods[method], uri, body, bodyLength,
+                               params, paramCount, time);
+        }
+        else
+        {
+            fprintf(stderr, "Trace file \"%s\" is broken after %d "
+                    "requests.\n", _traceFile, _scriptSize);
+        }
+        while (paramCount > 0)
+        {
+            free(params[--paramCount]);
+        }
+        free(uri);
+        free(body);
+    }
+    fclose(file);
+
+    if ((error == 0) && (_scriptSize == 0))
+    {
+        fprintf(stderr, "Trace file \"%s\" has no requests.\n", _traceFile);
+        return -1;
+    }
+
+    // trace is replayed once
+    _requestCount = _scriptSize;
+    _duration = 0;
+    return error;
+}
+
+/** Resolves server address: either host:port or Unix socket path. */
+static int resolveAddress(const char* address)
+{
+    const char* colon = strrchr(address, ':');
+    if ((colon == NULL) || (strchr(address, '/') != NULL))
+    {
+        struct sockaddr_un* unixAddress = (struct sockaddr_un*) &_address;
+        if (strlen(address) >= sizeof(unixAddress->sun_path))
+        {
+            fprintf(stderr, "Socket path is too long: %s\n", address);
+            return -1;
+        }
+        memset(unixAddress, 0, sizeof(struct sockaddr_un));
+        unixAddress->sun_family = AF_UNIX;
+        strcpy(unixAddress->sun_path, address);
+        _addressLength = sizeof(struct sockaddr_un);
+        return 0;
+    }
+
+    char host[256];
+    int hostLength = colon - address;
+    if (hostLength >= (int) sizeof(host))
+    {
+        return -1;
+    }
+    strncpy(host, address, hostLength);
+    host[hostLength] = '\0';
+
+    struct addrinfo hints;
+    struct addrinfo* result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int error = getaddrinfo(host, colon + 1, &hints, &result);
+    if (error != 0)
+    {
+        fprintf(stderr, "Unable to resolve \"%s\": %s\n",
+                address, gai_strerror(error));
+        return -1;
+    }
+    memcpy(&_address, result->ai_addr, result->ai_addrlen);
+    _addressLength = result->ai_addrlen;
+    freeaddrinfo(result);
+    return 0;
+}
+
+/** Opens new connection to the server. */
+static int openConnection()
+{
+    int fd = socket(_address.ss_family, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*) &_address, _addressLength) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int writeAll(int fd, const void* data, int length)
+{
+    const char* buffer = (const char*) data;
+    while (length > 0)
+    {
+        int written = write(fd, buffer, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        buffer += written;
+        length -= written;
+    }
+    return 0;
+}
+
+static int readAll(int fd, void* data, int length)
+{
+    char* buffer = (char*) data;
+    while (length > 0)
+    {
+        int received = read(fd, buffer, length);
+        if (received < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (received == 0)
+        {   // connection is closed
+            return -1;
+        }
+        buffer += received;
+        length -= received;
+    }
+    return 0;
+}
+
+/** Sends request body in STDIN records and ends the stream. */
+static int sendBody(int fd, const char* body, int length)
+{
+    unsigned char header[FCGI_HEADER_LEN];
+    while (length > 0)
+    {
+        int chunk = (length < FCGI_MAX_CONTENT) ? length : FCGI_MAX_CONTENT;
+        writeRecordHeader(header, FCGI_STDIN, chunk);
+        if ((writeAll(fd, header, FCGI_HEADER_LEN) != 0) ||
+                (writeAll(fd, body, chunk) != 0))
+        {
+            return -1;
+        }
+        body += chunk;
+        length -= chunk;
+    }
+
+    writeRecordHeader(header, FCGI_STDIN, 0);
+    return writeAll(fd, header, FCGI_HEADER_LEN);
+}
+
+/**
+ * Receives the response. Only the beginning of the response is kept in
+ * @a output in order to check the status and look for oBIX error object.
+ *
+ * @return @a 0 on success, @a -1 on error.
+ */
+static int receiveResponse(int fd, char* output, int outputSize)
+{
+    unsigned char header[FCGI_HEADER_LEN];
+    char content[FCGI_MAX_CONTENT + 255];
+    int outputLength = 0;
+
+    while (1)
+    {
+        if (readAll(fd, header, FCGI_HEADER_LEN) != 0)
+        {
+            return -1;
+        }
+        int length = (header[4] << 8) + header[5] + header[6];
+        if ((length > 0) && (readAll(fd, content, length) != 0))
+        {
+            return -1;
+        }
+        length -= header[6];
+
+        switch (header[1])
+        {
+        case FCGI_STDOUT:
+            if (outputLength < outputSize - 1)
+            {
+                int copied = outputSize - 1 - outputLength;
+                if (copied > length)
+                {
+                    copied = length;
+                }
+                memcpy(output + outputLength, content, copied);
+                outputLength += copied;
+            }
+            break;
+        case FCGI_END_REQUEST:
+            output[outputLength] = '\0';
+            return 0;
+        default:
+            // STDERR and management records are ignored
+            break;
+        }
+    }
+}
+
+/**
+ * Executes one request.
+ *
+ * @return @a 0 on success, @a 1 if server returned oBIX error object and
+ *         @a -1 if the request failed.
+ */
+static int executeRequest(Script_Request* request)
+{
+    int fd = openConnection();
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    char response[1024];
+    int error = writeAll(fd, request->header, request->headerLength);
+    if (error == 0)
+    {
+        error = sendBody(fd, request->body, request->bodyLength);
+    }
+    if (error == 0)
+    {
+        error = receiveResponse(fd, response, sizeof(response));
+    }
+    close(fd);
+    if (error != 0)
+    {
+        return -1;
+    }
+
+    // response without status header is '200 OK'
+    if ((strncmp(response, "Status:", 7) == 0) &&
+            (strncmp(response + 7 + strspn(response + 7, " "), "2", 1) != 0))
+    {
+        return -1;
+    }
+
+    return (strstr(response, "<err") != NULL) ? 1 : 0;
+}
+
+static int addSample(Worker* worker, long sample)
+{
+    if (worker->sampleCount == worker->sampleSize)
+    {
+        long size = (worker->sampleSize == 0) ? 1024 : worker->sampleSize * 2;
+        long* samples = (long*) realloc(worker->samples, size * sizeof(long));
+        if (samples == NULL)
+        {
+            return -1;
+        }
+        worker->samples = samples;
+        worker->sampleSize = size;
+    }
+
+    worker->samples[worker->sampleCount++] = sample;
+    return 0;
+}
+
+/** Main function of worker thread. */
+static void* workerCycle(void* arg)
+{
+    Worker* worker = (Worker*) arg;
+    int line = worker->id % _scriptSize;
+
+    while (1)
+    {
+        long long start;
+        if (_traceFile != NULL)
+        {
+            // workers take trace requests one by one
+            line = __sync_fetch_and_add(&_sentCounter, 1);
+            if (line >= _scriptSize)
+            {
+                break;
+            }
+
+            start = getTime();
+            if (_speed > 0)
+            {
+                long long scheduled =
+                    _startTime + (long long) (_script[line].time / _speed);
+                if (scheduled > start)
+                {
+                    usleep(scheduled - start);
+                }
+                start = scheduled;
+            }
+        }
+        else
+        {
+            if (_duration > 0)
+            {
+                if (getTime() >= _stopTime)
+                {
+                    break;
+                }
+            }
+            else if (__sync_fetch_and_add(&_sentCounter, 1) >= _requestCount)
+            {
+                break;
+            }
+            start = getTime();
+        }
+
+        int result = executeRequest(&(_script[line]));
+        long long end = getTime();
+        line = (line + 1) % _scriptSize;
+
+        if (result < 0)
+        {
+            worker->errors++;
+            continue;
+        }
+        if (result > 0)
+        {
+            worker->obixErrors++;
+        }
+        if (addSample(worker, (long) (end - start)) != 0)
+        {
+            worker->errors++;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Starts the server, which accepts FastCGI connections at a private Unix
+ * domain socket. The listening socket is passed to the server as standard
+ * input, as FastCGI specification requires.
+ */
+static int startServer()
+{
+    sprintf(_serverSocket, "/tmp/obix_fcgi_bench.%d", (int) getpid());
+    unlink(_serverSocket);
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, _serverSocket);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((fd < 0) ||
+            (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0) ||
+            (listen(fd, 1024) != 0))
+    {
+        fprintf(stderr, "Unable to listen at %s.\n", _serverSocket);
+        return -1;
+    }
+
+    _serverPid = fork();
+    if (_serverPid < 0)
+    {
+        fprintf(stderr, "Unable to start the server.\n");
+        close(fd);
+        return -1;
+    }
+    if (_serverPid == 0)
+    {
+        // server log goes to stderr, keeping results alone at stdout
+        dup2(fd, 0);
+        dup2(2, 1);
+        close(fd);
+        execl(_serverProgram, _serverProgram, _resourceDir, (char*) NULL);
+        fprintf(stderr, "Unable to execute %s.\n", _serverProgram);
+        _exit(1);
+    }
+    close(fd);
+
+    if (resolveAddress(_serverSocket) != 0)
+    {
+        return -1;
+    }
+
+    // wait until the server answers the first request
+    long long deadline = getTime() + SERVER_START_TIMEOUT * 1000000LL;
+    while (executeRequest(&_probe) < 0)
+    {
+        if ((getTime() > deadline) || (waitpid(_serverPid, NULL, WNOHANG) != 0))
+        {
+            fprintf(stderr, "Server is not responding.\n");
+            return -1;
+        }
+        usleep(100000);
+    }
+
+    return 0;
+}
+
+static void stopServer()
+{
+    if (_serverPid > 0)
+    {
+        kill(_serverPid, SIGTERM);
+        waitpid(_serverPid, NULL, 0);
+        _serverPid = 0;
+    }
+    if (_serverSocket[0] != '\0')
+    {
+        unlink(_serverSocket);
+    }
+}
+
+static int compareSamples(const void* a, const void* b)
+{
+    long diff = *((const long*) a) - *((const long*) b);
+    return (diff > 0) - (diff < 0);
+}
+
+/** Merges results of all workers and prints them. */
+static int printResults(Worker* workers, long long duration)
+{
+    long count = 0;
+    long errors = 0;
+    long obixErrors = 0;
+    int i;
+    for (i = 0; i < _concurrency; i++)
+    {
+        count += workers[i].sampleCount;
+        errors += workers[i].errors;
+        obixErrors += workers[i].obixErrors;
+    }
+
+    long* samples = (long*) malloc((count + 1) * sizeof(long));
+    if (samples == NULL)
+    {
+        return -1;
+    }
+    long position = 0;
+    for (i = 0; i < _concurrency; i++)
+    {
+        memcpy(samples + position, workers[i].samples,
+               workers[i].sampleCount * sizeof(long));
+        position += workers[i].sampleCount;
+    }
+    qsort(samples, count, sizeof(long), &compareSamples);
+
+    printf("{\"requests\":%ld,\"errors\":%ld,\"obix_errors\":%ld,"
+           "\"concurrency\":%d,\"duration_s\":%.3f,\"requests_per_sec\":%.1f,"
+           "\"p50_us\":%ld,\"p90_us\":%ld,\"p99_us\":%ld,\"max_us\":%ld}\n",
+           count, errors, obixErrors, _concurrency, duration / 1e6,
+           (duration > 0) ? (count * 1e6 / duration) : 0.0,
+           (count > 0) ? samples[(count - 1) / 2] : 0,
+           (count > 0) ? samples[(count * 90 - 1) / 100] : 0,
+           (count > 0) ? samples[(count * 99 - 1) / 100] : 0,
+           (count > 0) ? samples[count - 1] : 0);
+
+    free(samples);
+    return 0;
+}
+
+/** Parses command line arguments. */
+static int parseArguments(int argc, char** argv)
+{
+    int option;
+    while ((option = getopt(argc, argv, "x:r:s:f:c:n:d:t:a:")) != -1)
+    {
+        switch (option)
+        {
+        case 'x':
+            _serverProgram = optarg;
+            break;
+        case 'r':
+            _resourceDir = optarg;
+            break;
+        case 's':
+            _socketAddress = optarg;
+            break;
+        case 'f':
+            _scriptFile = optarg;
+            break;
+        case 'c':
+            _concurrency = atoi(optarg);
+            break;
+        case 'n':
+            _requestCount = atol(optarg);
+            break;
+        case 'd':
+            _duration = atol(optarg);
+            break;
+        case 't':
+            _traceFile = optarg;
+            break;
+        case 'a':
+            _speed = atof(optarg);
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    if ((_serverProgram == NULL) == (_socketAddress == NULL))
+    {
+        fprintf(stderr, "Either server executable (-x) or socket of running "
+                "server (-s) should be provided.\n");
+        return -1;
+    }
+    if ((_serverProgram != NULL) && (_resourceDir == NULL))
+    {
+        fprintf(stderr, "Resource folder (-r) of the server is missing.\n");
+        return -1;
+    }
+    if ((_scriptFile != NULL) && (_traceFile != NULL))
+    {
+        fprintf(stderr, "Script (-f) and trace (-t) can't be used "
+                "simultaneously.\n");
+        return -1;
+    }
+    if ((_concurrency <= 0) || (_requestCount <= 0) || (_duration < 0) ||
+            (_speed < 0))
+    {
+        fprintf(stderr, "Wrong number of connections, requests or "
+                "duration.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/** Entry point of the driver. */
+int main(int argc, char** argv)
+{
+    if (parseArguments(argc, argv) != 0)
+    {
+        fprintf(stderr, USAGE_MESSAGE, CONCURRENCY_DEFAULT, REQUESTS_DEFAULT);
+        return 1;
+    }
+
+    // broken connections should not kill the driver
+    signal(SIGPIPE, SIG_IGN);
+
+    int error = (_traceFile != NULL) ? loadTrace() : loadScript();
+    if ((error != 0) || (initRequest(&_probe, "GET", "/obix/about/",
+                                     NULL, 0, NULL, 0, 0) != 0))
+    {
+        return 1;
+    }
+
+    error = (_serverProgram != NULL) ?
+                startServer() : resolveAddress(_socketAddress);
+    if (error != 0)
+    {
+        stopServer();
+        return 1;
+    }
+
+    Worker* workers = (Worker*) calloc(_concurrency, sizeof(Worker));
+    if (workers == NULL)
+    {
+        stopServer();
+        return 1;
+    }
+
+    _startTime = getTime();
+    _stopTime = _startTime + _duration * 1000000LL;
+    int started;
+    for (started = 0; started < _concurrency; started++)
+    {
+        workers[started].id = started;
+        if (pthread_create(&(workers[started].thread), NULL,
+                           &workerCycle, &(workers[started])) != 0)
+        {
+            fprintf(stderr, "Unable to start worker thread.\n");
+            break;
+        }
+    }
+
+    int i;
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    long long duration = getTime() - _startTime;
+
+    stopServer();
+    error = (started == _concurrency) ? printResults(workers, duration) : -1;
+
+    for (i = 0; i < _concurrency; i++)
+    {
+        free(workers[i].samples);
+    }
+    free(workers);
+    return (error == 0) ? 0 : 1;
+}
@@ -28,9 +28,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <log_utils.h>
 #include <xml_config.h>
 #include <obix_utils.h>
+#include <str_buffer.h>
+#include <local_socket.h>
+#include <obix_binary.h>
 #include "test_main.h"
 
 /**
@@ -218,11 +224,292 @@ static int testObixUtils()
     return result;
 }
 
+/**
+ * Tests functions from str_buffer module.
+ * Checks that the buffer grows when needed and escapes XML special characters.
+ */
+static int testStrBuffer()
+{
+    const char* testName = "Test str_buffer.c";
+
+    // start with the tiny buffer so that it has to grow several times
+    String_Buffer* buffer = strbuf_create(2);
+    if (buffer == NULL)
+    {
+        printf("Unable to create buffer: strbuf_create() returned NULL.\n");
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    int error = strbuf_append(buffer, "<obj val=\"");
+    error += strbuf_appendXml(buffer, "a&b<c>\"d'");
+    error += strbuf_appendLength(buffer, "\"/>ignored", 3);
+    const char* expected = "<obj val=\"a&amp;b&lt;c&gt;&quot;d&apos;\"/>";
+    if ((error != 0)
+            || (strcmp(strbuf_getString(buffer), expected) != 0)
+            || (buffer->length != strlen(expected)))
+    {
+        printf("Buffer contains \"%s\", but \"%s\" is expected.\n",
+               strbuf_getString(buffer), expected);
+        strbuf_free(buffer);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    // memory should be kept after reset
+    int size = buffer->size;
+    strbuf_reset(buffer);
+    error = strbuf_appendXml(buffer, "no escaping");
+    if ((error != 0)
+            || (strcmp(strbuf_getString(buffer), "no escaping") != 0)
+            || (buffer->size != size))
+    {
+        printf("Buffer contains \"%s\" (size %d) after reset, but "
+               "\"no escaping\" (size %d) is expected.\n",
+               strbuf_getString(buffer), buffer->size, size);
+        strbuf_free(buffer);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    strbuf_free(buffer);
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
+/**
+ * Tests local_socket.c: sends a frame with several body parts through a
+ * socket pair and checks that it is received correctly.
+ */
+static int testLocalSocket()
+{
+    const char* testName = "Test local_socket.c";
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        printf("Unable to create socket pair.\n");
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    const char* parts[] = {"<obj>", "", "<int val=\"1\"/>", "</obj>"};
+    int lengths[] = {5, 0, 14, 6};
+    const char* expected = "<obj><int val=\"1\"/></obj>";
+    Local_Socket_Header header;
+    char uri[32];
+    char body[32];
+
+    int error = lsocket_writeFrame(fds[0], LSOCKET_POST, "/obix/test/",
+                                   parts, lengths, 4);
+    error += lsocket_readHeader(fds[1], &header);
+    if ((error != 0)
+            || (header.type != LSOCKET_POST)
+            || (header.uriLength != 11)
+            || (header.bodyLength != strlen(expected)))
+    {
+        printf("Wrong frame header is received: type %d, URI length %d, "
+               "body length %d.\n",
+               header.type, header.uriLength, header.bodyLength);
+        close(fds[0]);
+        close(fds[1]);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    error = lsocket_read(fds[1], uri, header.uriLength);
+    error += lsocket_read(fds[1], body, header.bodyLength);
+    uri[header.uriLength] = '\0';
+    body[header.bodyLength] = '\0';
+    if ((error != 0)
+            || (strcmp(uri, "/obix/test/") != 0)
+            || (strcmp(body, expected) != 0))
+    {
+        printf("Wrong frame is received: URI \"%s\", body \"%s\".\n",
+               uri, body);
+        close(fds[0]);
+        close(fds[1]);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    // frames with too big body are rejected before anything is allocated
+    const unsigned char bigFrame[LSOCKET_HEADER_SIZE] =
+        {LSOCKET_POST, 0, 0, 1, 0x7F, 0xFF, 0xFF, 0xFF};
+    if ((write(fds[0], bigFrame, LSOCKET_HEADER_SIZE) != LSOCKET_HEADER_SIZE)
+            || (lsocket_readHeader(fds[1], &header) == 0))
+    {
+        printf("lsocket_readHeader() accepts too big frame.\n");
+        close(fds[0]);
+        close(fds[1]);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    // reading from the closed connection should fail
+    close(fds[0]);
+    if (lsocket_readHeader(fds[1], &header) == 0)
+    {
+        printf("lsocket_readHeader() doesn't fail on closed connection.\n");
+        close(fds[1]);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    close(fds[1]);
+
+    // existing file, which is not a socket, should never be removed
+    char path[] = "/tmp/obix_lsocket_XXXXXX";
+    int fileFd = mkstemp(path);
+    int listenFd = (fileFd < 0) ? 0 : lsocket_listen(path, 0600);
+    BOOL kept = (fileFd >= 0) && (access(path, F_OK) == 0);
+    if (fileFd >= 0)
+    {
+        close(fileFd);
+        unlink(path);
+    }
+    if ((listenFd >= 0) || !kept)
+    {
+        printf("lsocket_listen() replaces a regular file.\n");
+        if (listenFd > 0)
+        {
+            close(listenFd);
+        }
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    // socket file should get requested permissions
+    listenFd = lsocket_listen(path, 0600);
+    struct stat fileStat;
+    BOOL protected = (listenFd >= 0) && (stat(path, &fileStat) == 0)
+                     && ((fileStat.st_mode & 0777) == 0600);
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+        unlink(path);
+    }
+    if (!protected)
+    {
+        printf("lsocket_listen() doesn't set permissions of socket file.\n");
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
+/**
+ * Tests obix_binary.c: encodes XML text, decodes the result and checks that
+ * encoding of the decoded DOM structure gives the same data.
+ */
+static int testObixBinary()
+{
+    const char* testName = "Test obix_binary.c";
+    const char* xml = "<?xml version=\"1.0\"?>\r\n"
+                      "<obj href=\"/obix/test/\" name=\"test\">"
+                      "<str name=\"s\" val=\"a&amp;b &#x44;\" custom=\"1\"/>"
+                      "<custom><int val=\"-1\"/></custom>"
+                      "</obj>";
+
+    String_Buffer* encoded = strbuf_create(16);
+    String_Buffer* reencoded = strbuf_create(16);
+    int error = obixBinary_appendHeader(encoded);
+    error += obixBinary_encodeXml(xml, encoded);
+    if ((error != 0) || (encoded->length <= 2))
+    {
+        printf("Unable to encode XML text.\n");
+        strbuf_free(encoded);
+        strbuf_free(reencoded);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    IXML_Element* element = obixBinary_decode(encoded->data, encoded->length);
+    if (element == NULL)
+    {
+        printf("Unable to decode binary data.\n");
+        strbuf_free(encoded);
+        strbuf_free(reencoded);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    IXML_Element* str = config_getChildTag(element, OBIX_OBJ_STR, TRUE);
+    const char* value = (str == NULL) ? NULL :
+                        ixmlElement_getAttribute(str, OBIX_ATTR_VAL);
+    error = obixBinary_appendHeader(reencoded);
+    error += obixBinary_encode(element, reencoded);
+    if ((error != 0)
+            || (value == NULL)
+            || (strcmp(value, "a&b D") != 0)
+            || (reencoded->length != encoded->length)
+            || (memcmp(reencoded->data, encoded->data, encoded->length) != 0))
+    {
+        printf("Decoded object differs from the original one: "
+               "value \"%s\", encoded size %d, expected %d.\n",
+               (value == NULL) ? "(null)" : value,
+               reencoded->length, encoded->length);
+        ixmlElement_freeOwnerDocument(element);
+        strbuf_free(encoded);
+        strbuf_free(reencoded);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    ixmlElement_freeOwnerDocument(element);
+
+    // truncated data should not be accepted
+    element = obixBinary_decode(encoded->data, encoded->length - 1);
+    strbuf_free(encoded);
+    strbuf_free(reencoded);
+    if (element != NULL)
+    {
+        printf("obixBinary_decode() accepts truncated data.\n");
+        ixmlElement_freeOwnerDocument(element);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    // objects composed from tokens should match encoded XML
+    encoded = strbuf_create(16);
+    reencoded = strbuf_create(16);
+    error = obixBinary_encodeXml("<list is=\"obix:BatchOut\">"
+                                 "<obj custom=\"x\"/></list>", encoded);
+    error += obixBinary_appendTag(reencoded, OBIX_OBJ_LIST);
+    error += obixBinary_appendAttr(reencoded, OBIX_ATTR_IS, "obix:BatchOut");
+    error += obixBinary_appendEnd(reencoded);
+    error += obixBinary_appendTag(reencoded, OBIX_OBJ);
+    error += obixBinary_appendAttr(reencoded, "custom", "x");
+    error += obixBinary_appendEnd(reencoded);
+    error += obixBinary_appendEnd(reencoded);
+    error += obixBinary_appendEnd(reencoded);
+    if ((error != 0)
+            || (reencoded->length != encoded->length)
+            || (memcmp(reencoded->data, encoded->data, encoded->length) != 0))
+    {
+        printf("Tokens differ from encoded XML: size %d, expected %d.\n",
+               reencoded->length, encoded->length);
+        strbuf_free(encoded);
+        strbuf_free(reencoded);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    strbuf_free(encoded);
+    strbuf_free(reencoded);
+
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
 int test_common()
 {
     int result = 0;
 
     result += testObixUtils();
+    result += testStrBuffer();
+    result += testLocalSocket();
+    result += testObixBinary();
 
     return result;
 }
@@ -36,7 +36,11 @@
 #include <ixml_ext.h>
 #include <server.h>
 #include <watch.h>
+#include <metrics.h>
+#include <object_stats.h>
+#include <storage_usage.h>
 #include <obix_fcgi.h>
+#include <local_server.h>
 #include "test_main.h"
 
 /** @name Global server test variables.
@@ -101,6 +105,15 @@ static Request* createDummyRequest(BOOL canWait)
     request->serverAddress = "http://localhost";
     request->serverAddressLength = 16;
     request->canWait = canWait;
+    request->binaryResponse = FALSE;
+    request->ifNoneMatch = NULL;
+    request->depth = -1;
+    request->offset = 0;
+    request->limit = -1;
+    request->input = NULL;
+    request->inputSize = 0;
+    request->responseListener = NULL;
+    request->detached = FALSE;
     request->next = NULL;
     return request;
 }
@@ -929,6 +942,47 @@ static int testSignUp()
     return result;
 }
 
+/**
+ * Tests signUpDevices operation: valid devices should be stored, while
+ * duplicates and broken objects are reported with errors.
+ */
+static int testSignUpDevices(const char* testName)
+{
+    Response* response = createTestResponse(TRUE, FALSE);
+    obix_server_handlePOST(response, "/obix/signUpDevices/",
+                           "<list of=\"obix:obj\">"
+                           "<obj name=\"bulk1\" href=\"/bulkDevice1/\"/>"
+                           "<obj name=\"bulk2\" href=\"/bulkDevice2/\"/>"
+                           "<obj name=\"bulk1copy\" href=\"/bulkDevice1/\"/>"
+                           "<obj name=\"noHref\"/>"
+                           "</list>");
+    if ((checkResponse(response, TRUE) != 0)
+            || (strstr(response->body, "<ref") == NULL)
+            || (strstr(response->body, "already exists") == NULL))
+    {
+        freeTestResponse(response);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    freeTestResponse(response);
+
+    if ((testSearch("signUpDevices: search for the first device",
+                    "/obix/bulkDevice1/", "bulk1", TRUE) != 0)
+            || (testSearch("signUpDevices: search for the second device",
+                           "/obix/bulkDevice2/", "bulk2", TRUE) != 0)
+            || (testSearch("signUpDevices: duplicate is not stored",
+                           "/obix/bulkDevice1/", "bulk1copy", FALSE) != 0)
+            || (testSearch("signUpDevices: search for device references",
+                           "/obix/devices/", "/obix/bulkDevice2/", TRUE) != 0))
+    {
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
 static int testWatchRemoteOperationsHelper(const char* testName,
         const char* operationUri,
         const char* operationName,
@@ -992,6 +1046,107 @@ static int testWatchRemoteOperationsHelper(const char* testName,
     return 0;
 }
 
+/**
+ * Sends result of the remote operation in the same way as device adapter
+ * does.
+ */
+static int sendOperationResponse(const char* operationUri, const char* output)
+{
+    char operationResponseMessage[300];
+    sprintf(operationResponseMessage,
+            "<op is=\"/obix/def/OperationResponse\" href=\"%s\">\r\n"
+            "	%s\r\n"
+            "</op>",
+            operationUri, output);
+    Response* response = createTestResponse(TRUE, FALSE);
+    obix_server_handlePOST(response,
+                           "/obix/watchService/watch1/operationResponse",
+                           operationResponseMessage);
+    int error = checkResponse(response, FALSE);
+    freeTestResponse(response);
+    return error;
+}
+
+/**
+ * Invokes the same remote operation twice before the first invocation is
+ * answered. Invocations should be forwarded one by one and each caller
+ * should receive its own result.
+ */
+static int testWatchQueuedOperations(const char* testName,
+                                     const char* operationUri)
+{
+    Response* first = createTestResponse(TRUE, TRUE);
+    obix_server_handlePOST(first, operationUri, "<obj null=\"true\" />");
+    Response* second = createTestResponse(TRUE, TRUE);
+    obix_server_handlePOST(second, operationUri, "<obj null=\"true\" />");
+
+    const char* checkStrings[] = {"OperationInvocation"};
+    int error = testWatchPollChanges("Queued Remote Operations: "
+                                     "1st invocation",
+                                     "/obix/watchService/watch1/pollChanges",
+                                     checkStrings, 1, TRUE, FALSE);
+    error += sendOperationResponse(operationUri,
+                                   "<str name=\"out\" val=\"1stCall\" />");
+    if ((error != 0) || (first->body == NULL) || (second->body != NULL))
+    {
+        printf("First invocation is not answered or the second invocation "
+               "is answered too early.\n");
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    error = testWatchPollChanges("Queued Remote Operations: "
+                                 "2nd invocation",
+                                 "/obix/watchService/watch1/pollChanges",
+                                 checkStrings, 1, TRUE, FALSE);
+    error += sendOperationResponse(operationUri,
+                                   "<str name=\"out\" val=\"2ndCall\" />");
+    if ((error != 0) || (second->body == NULL))
+    {
+        printf("Second invocation is not answered.\n");
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    error = findInResponse(first, "1stCall", TRUE);
+    error += findInResponse(second, "2ndCall", TRUE);
+    freeTestResponse(first);
+    freeTestResponse(second);
+    if (error != 0)
+    {
+        printf("Results of remote operation are mixed up.\n");
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
+/**
+ * Invokes remote operation in the same process. Nobody can wait for results
+ * of such invocation, so it should be answered with an error at once.
+ */
+static int testLocalRemoteOperation(const char* testName,
+                                    const char* operationUri)
+{
+    IXML_Element* input = ixmlElement_parseBuffer("<obj null=\"true\" />");
+    char* output = obixLocal_invoke(operationUri, input);
+    ixmlElement_freeOwnerDocument(input);
+    if ((output == NULL) || (strstr(output, "<err") == NULL))
+    {
+        printf("Locally invoked remote operation is not answered with an "
+               "error: %s\n", (output == NULL) ? "NULL" : output);
+        free(output);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    free(output);
+
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
 static int testWatchAddOperationHelper(const char* operationUri)
 {
     //add operation to the watch
@@ -1064,6 +1219,10 @@ static int testWatchRemoteOperations()
                                         "op1",
                                         "<str name=\"out\" val=\"2ndEx\" />",
                                         "2ndEx");
+    error += testWatchQueuedOperations("Queued remote op executions",
+                                       "/obix/remoptest/op1");
+    error += testLocalRemoteOperation("Remote op invoked locally",
+                                      "/obix/remoptest/op1");
     if (error != 0)
     {
         return error;
@@ -1108,13 +1267,545 @@ static int testResponse_setRightUri(const char* testName,
     return 0;
 }
 
+/** Counts notifications received by #localTestListener. */
+static int _localNotifications;
+
+/** Listener used in #testLocalAccess. */
+static void localTestListener(IXML_Element* object, void* arg)
+{
+    _localNotifications++;
+}
+
+/**
+ * Tests #obix_server_writeDOM and #obix_server_readDOM together with local
+ * listeners of the Watch engine.
+ * @param listenedUri URI of the object, which is monitored by listener.
+ * @param uri URI of the object, which is updated.
+ */
+static int testLocalAccess(const char* testName,
+                           const char* listenedUri,
+                           const char* uri)
+{
+    _localNotifications = 0;
+    int listenerId = obixWatch_addLocalListener(listenedUri,
+                     &localTestListener,
+                     NULL);
+    if (listenerId < 0)
+    {
+        printf("Unable to add local listener of \"%s\".\n", listenedUri);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    IXML_Element* input =
+        ixmlElement_parseBuffer("<str val=\"local value\"/>");
+    int error = obix_server_writeDOM(uri, input);
+    ixmlElement_freeOwnerDocument(input);
+    if ((error != 0) || (_localNotifications != 1))
+    {
+        printf("obix_server_writeDOM returned %d, listener was notified %d "
+               "times.\n", error, _localNotifications);
+        obixWatch_removeLocalListener(listenerId);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    // the same value should not generate notification
+    input = ixmlElement_parseBuffer("<str val=\"local value\"/>");
+    obix_server_writeDOM(uri, input);
+    ixmlElement_freeOwnerDocument(input);
+    obixWatch_removeLocalListener(listenerId);
+    if (_localNotifications != 1)
+    {
+        printf("Listener is notified when value is not changed.\n");
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    IXML_Element* object = obix_server_readDOM(uri);
+    if (object == NULL)
+    {
+        printf("obix_server_readDOM returned NULL.\n");
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    const char* value = ixmlElement_getAttribute(object, OBIX_ATTR_VAL);
+    if ((value == NULL) || (strcmp(value, "local value") != 0))
+    {
+        printf("obix_server_readDOM returned wrong value \"%s\".\n", value);
+        ixmlElement_freeOwnerDocument(object);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    ixmlElement_freeOwnerDocument(object);
+
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
+/**
+ * Tests Batch operation: all commands should be executed in their order, while
+ * local listeners are notified only once per Batch.
+ * @param listenedUri URI of the object, which is monitored by listener.
+ * @param uri URI of the object, which is updated twice in the Batch.
+ */
+static int testBatch(const char* testName,
+                     const char* listenedUri,
+                     const char* uri)
+{
+    _localNotifications = 0;
+    int listenerId = obixWatch_addLocalListener(listenedUri,
+                     &localTestListener,
+                     NULL);
+    if (listenerId < 0)
+    {
+        printf("Unable to add local listener of \"%s\".\n", listenedUri);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    char input[512];
+    sprintf(input,
+            "<list is=\"obix:BatchIn\" of=\"obix:uri\">"
+            "<uri is=\"obix:Write\" val=\"%s\"><str val=\"batch 1\"/></uri>"
+            "<uri is=\"obix:Write\" val=\"%s\"><str val=\"batch 2\"/></uri>"
+            "<uri is=\"obix:Read\" val=\"%s\"/>"
+            "<uri is=\"obix:Read\" val=\"/obix/batchNotFound/\"/>"
+            "</list>",
+            uri, uri, listenedUri);
+
+    Response* response = createTestResponse(TRUE, FALSE);
+    obix_server_handlePOST(response, "/obix/batch/", input);
+    obixWatch_removeLocalListener(listenerId);
+    if ((checkResponse(response, TRUE) != 0)
+            || (strstr(response->body, "BatchOut") == NULL)
+            || (strstr(response->body, "batch 1") == NULL)
+            || (strstr(response->body, "batch 2") == NULL)
+            || (strstr(response->body, "<meta") != NULL)
+            || (response->next != NULL)
+            || (_localNotifications != 1))
+    {
+        printf("Listener was notified %d times.\n", _localNotifications);
+        freeTestResponse(response);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    freeTestResponse(response);
+
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
+/**
+ * Tests unregister operation: device data, its reference in the device list
+ * and listeners of the device should be removed.
+ */
+static int testUnregister(const char* testName)
+{
+    if (testSignUpHelper("Unregister: sign up device",
+                         "<obj name=\"unregDevice\" href=\"/unregDevice/\">"
+                         "<int name=\"value\" href=\"value\" val=\"1\"/>"
+                         "</obj>",
+                         "/obix/devices/",
+                         "/obix/unregDevice/",
+                         TRUE) != 0)
+    {
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    int listenerId = obixWatch_addLocalListener("/obix/unregDevice/value",
+                     &localTestListener,
+                     NULL);
+
+    Response* response = createTestResponse(TRUE, FALSE);
+    obix_server_handlePOST(response, "/obix/unregister/",
+                           "<uri val=\"/obix/unregDevice/\"/>");
+    if (checkResponse(response, FALSE) != 0)
+    {
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    freeTestResponse(response);
+
+    if ((listenerId < 0) || (obixWatch_removeLocalListener(listenerId) == 0))
+    {
+        printf("Listener of the unregistered device is not removed.\n");
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    if ((testSearch("Unregister: search for device data",
+                    "/obix/unregDevice/", NULL, FALSE) != 0)
+            || (testSearch("Unregister: search for device reference",
+                           "/obix/devices/", "unregDevice", FALSE) != 0))
+    {
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    // objects which are not in the device list can't be removed
+    response = createTestResponse(TRUE, FALSE);
+    obix_server_handlePOST(response, "/obix/unregister/",
+                           "<uri val=\"/obix/about/\"/>");
+    if ((checkResponse(response, TRUE) != 0)
+            || (testSearch("Unregister: search for system object",
+                           "/obix/about/", NULL, TRUE) != 0))
+    {
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    freeTestResponse(response);
+
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
+/**
+ * Reads the object conditionally using provided entity tag.
+ * @return Response of the read request. Should be freed with
+ *         #freeTestResponse.
+ */
+static Response* conditionalRead(const char* uri, const char* etag)
+{
+    Response* response = createTestResponse(TRUE, FALSE);
+    if (response == NULL)
+    {
+        return NULL;
+    }
+    response->request->ifNoneMatch = etag;
+    obix_server_read(response, uri);
+    return response;
+}
+
+/**
+ * Tests entity tags of the objects: reading of not modified object should
+ * not generate response body, while modification of a child object should
+ * change the tag of the parent.
+ *
+ * @param parentUri URI of the object, which is read.
+ * @param uri URI of the writable child object, which is modified.
+ */
+static int testConditionalRead(const char* testName,
+                               const char* parentUri,
+                               const char* uri)
+{
+    Response* response = conditionalRead(parentUri, NULL);
+    if ((response == NULL) || (response->etag == NULL) ||
+            (response->body == NULL))
+    {
+        printf("Object \"%s\" is read without entity tag.\n", parentUri);
+        if (response != NULL)
+        {
+            freeTestResponse(response);
+        }
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    char etag[strlen(response->etag) + 1];
+    strcpy(etag, response->etag);
+    freeTestResponse(response);
+
+    response = conditionalRead(parentUri, etag);
+    if ((response == NULL) || !response->notModified ||
+            (response->body != NULL))
+    {
+        printf("Not modified object \"%s\" is sent again.\n", parentUri);
+        if (response != NULL)
+        {
+            freeTestResponse(response);
+        }
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    freeTestResponse(response);
+
+    IXML_Element* input =
+        ixmlElement_parseBuffer("<str val=\"conditional read\"/>");
+    int error = obix_server_writeDOM(uri, input);
+    ixmlElement_freeOwnerDocument(input);
+
+    response = conditionalRead(parentUri, etag);
+    if ((error != 0) || (response == NULL) || response->notModified ||
+            (response->body == NULL) || (response->etag == NULL) ||
+            (strcmp(response->etag, etag) == 0))
+    {
+        printf("Entity tag of \"%s\" is not changed after modification of "
+               "\"%s\" (write returned %d).\n", parentUri, uri, error);
+        if (response != NULL)
+        {
+            freeTestResponse(response);
+        }
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    freeTestResponse(response);
+
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
+/**
+ * Tests reading of the object with limited depth or number of children.
+ *
+ * @param checkString String which should be present in the response.
+ * @param forbiddenString String which should not be present in the response,
+ *                        or @a NULL.
+ */
+static int testLimitedRead(const char* testName,
+                           const char* uri,
+                           int depth,
+                           int offset,
+                           int limit,
+                           const char* checkString,
+                           const char* forbiddenString)
+{
+    Response* response = createTestResponse(TRUE, FALSE);
+    if (response == NULL)
+    {
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+    response->request->depth = depth;
+    response->request->offset = offset;
+    response->request->limit = limit;
+
+    obix_server_read(response, uri);
+
+    if ((response->body == NULL)
+            || (strstr(response->body, checkString) == NULL)
+            || ((forbiddenString != NULL)
+                && (strstr(response->body, forbiddenString) != NULL)))
+    {
+        printf("Wrong response for \"%s\" (depth %d, offset %d, "
+               "limit %d):\n%s\n", uri, depth, offset, limit,
+               (response->body != NULL) ? response->body : "(null)");
+        freeTestResponse(response);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    freeTestResponse(response);
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
+/**
+ * Checks that handled GET request appears in server metrics.
+ * @param uri URI of existing object, which is read during the test.
+ */
+static int testMetrics(const char* testName, const char* uri)
+{
+    obixMetrics_reset();
+    obixResponse_setListener(&dummyResponseListener);
+    Response* response = createTestResponse(TRUE, FALSE);
+    obix_server_handleGET(response, uri);
+    freeTestResponse(response);
+
+    char* obix = obixMetrics_toObix("/obix-metrics/");
+    char* prometheus = obixMetrics_toPrometheus();
+    if ((obix == NULL) || (prometheus == NULL)
+            || (strstr(obix, "<obj name=\"GET\">") == NULL)
+            || (strstr(obix, "<obj name=\"storageLookup\">") == NULL)
+            || (strstr(prometheus,
+                       "obix_request_duration_seconds_count"
+                       "{method=\"GET\"} 1\n") == NULL)
+            || (strstr(prometheus,
+                       "obix_request_duration_seconds_count"
+                       "{method=\"PUT\"}") != NULL))
+    {
+        printf("Wrong metrics:\n%s\n%s\n", obix, prometheus);
+        free(obix);
+        free(prometheus);
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    free(obix);
+    free(prometheus);
+    printTestResult(testName, TRUE);
+    return 0;
+}
+
+/**
+ * Tests statistics of the most used objects.
+ * @param hotUri Object, which is read twice.
+ * @param coldUri Object, which is read once and should not get to the top.
+ */
+static int testObjectStats(const char* testName,
+                           const char* hotUri,
+                           const char* coldUri)
+{
+    // count every event
+    obixObjectStats_setSampleRate(1);
+    obixObjectStats_reset();
+    obixResponse_setListener(&dummyResponseListener);
+    const char* uris[] = {coldUri, hotUri, hotUri};
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        Response* response = createTestResponse(TRUE, FALSE);
+        obix_server_handleGET(response, uris[i]);
+        freeTestResponse(response);
+    }
+
+    char* obix = obixObjectStats_toObix("/obix-metrics/objects", 1);
+    char expected[256];
+    char unexpected[256];
+    sprintf(expected, "<uri name=\"uri\" val=\"%s\"/>\r\n"
+            "      <int name=\"reads\" val=\"2\"/>", hotUri);
+    sprintf(unexpected, "val=\"%s\"", coldUri);
+    BOOL passed = (obix != NULL)
+                  && (strstr(obix, "<int name=\"tracked\" val=\"2\"/>") != NULL)
+                  && (strstr(obix, expected) != NULL)
+                  && (strstr(obix, unexpected) == NULL);
+    if (!passed)
+    {
+        printf("Wrong object statistics:\n%s\n", obix);
+    }
+
+    free(obix);
+    obixObjectStats_setSampleRate(OBJECT_STATS_SAMPLE_RATE_DEFAULT);
+    obixObjectStats_reset();
+    printTestResult(testName, passed);
+    return passed ? 0 : 1;
+}
+
+/**
+ * Tests that new objects replace the least active ones when the maximum
+ * number of objects is tracked.
+ */
+static int testObjectStatsReplace(const char* testName)
+{
+    obixObjectStats_setSampleRate(1);
+    obixObjectStats_setMaxObjects(2);
+    obixObjectStats_reset();
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        obixObjectStats_count("/hot", OBJECT_STATS_READS, 1);
+    }
+    obixObjectStats_count("/cold1", OBJECT_STATS_READS, 1);
+    obixObjectStats_count("/cold2", OBJECT_STATS_READS, 1);
+
+    // cold1 is replaced by cold2, which inherits its activity as the error
+    char* obix = obixObjectStats_toObix("/obix-metrics/objects", 2);
+    const char* expected[] =
+        {
+            "<int name=\"tracked\" val=\"2\"/>",
+            "<uri name=\"uri\" val=\"/hot\"/>\r\n"
+            "      <int name=\"reads\" val=\"3\"/>",
+            "<obj name=\"untracked\">\r\n"
+            "    <int name=\"reads\" val=\"1\"/>",
+            "<uri name=\"uri\" val=\"/cold2\"/>",
+            "<int name=\"error\" val=\"1\"/>"
+        };
+    BOOL passed = (obix != NULL) && (strstr(obix, "/cold1") == NULL);
+    for (i = 0; passed && (i < 5); i++)
+    {
+        passed = (strstr(obix, expected[i]) != NULL);
+    }
+    if (!passed)
+    {
+        printf("Wrong object statistics:\n%s\n", obix);
+    }
+
+    free(obix);
+    obixObjectStats_setSampleRate(OBJECT_STATS_SAMPLE_RATE_DEFAULT);
+    obixObjectStats_setMaxObjects(OBJECT_STATS_MAX_OBJECTS_DEFAULT);
+    obixObjectStats_reset();
+    printTestResult(testName, passed);
+    return passed ? 0 : 1;
+}
+
+/**
+ * Writes new value to the object and checks whether it was accepted.
+ */
+static int writeWithQuota(const char* uri, const char* value, BOOL accepted)
+{
+    char input[128];
+    sprintf(input, "<str val=\"%s\"/>", value);
+    Response* response = createTestResponse(TRUE, FALSE);
+    obix_server_handlePUT(response, uri, input);
+    int result = checkResponse(response, !accepted);
+    freeTestResponse(response);
+    return result;
+}
+
+/**
+ * Tests memory accounting and limits of registered devices.
+ */
+static int testDeviceQuota(const char* testName)
+{
+    obixResponse_setListener(&dummyResponseListener);
+    if (testSignUpHelper("Device quota: sign up device",
+                         "<obj name=\"quotaDevice\" href=\"/quotaDevice/\">"
+                         "<str name=\"s\" href=\"s\" val=\"ab\" "
+                         "writable=\"true\"/></obj>",
+                         "/obix/quotaDevice/",
+                         "quotaDevice",
+                         TRUE) != 0)
+    {
+        printTestResult(testName, FALSE);
+        return 1;
+    }
+
+    long objects;
+    long bytes = obixUsage_measure(xmldb_getDOM("/obix/quotaDevice/", NULL),
+                                   &objects);
+    char* obix = obixUsage_toObix("/obix-metrics/devices", 100);
+    BOOL passed = (obix != NULL) && (objects == 2)
+                  && (strstr(obix, "val=\"/obix/quotaDevice/\"") != NULL);
+    if (!passed)
+    {
+        printf("Device is not accounted (%ld objects):\n%s\n", objects, obix);
+    }
+    free(obix);
+
+    // device may grow only by 4 bytes
+    obixUsage_setLimits(bytes + 4, 0);
+    if (passed && ((writeWithQuota("/obix/quotaDevice/s", "abcdefghij", FALSE)
+                    != 0)
+                   || (writeWithQuota("/obix/quotaDevice/s", "abcd", TRUE) != 0)
+                   || (writeWithQuota("/obix/quotaDevice/s", "a", TRUE) != 0)
+                   || (testSignUpHelper("Device quota: too big device",
+                                        "<obj href=\"/bigDevice/\">"
+                                        "<str name=\"s1\" val=\"1\"/>"
+                                        "<str name=\"s2\" val=\"2\"/>"
+                                        "</obj>",
+                                        "/obix/bigDevice/",
+                                        "bigDevice",
+                                        FALSE) != 0)))
+    {
+        printf("Device limit is not applied.\n");
+        passed = FALSE;
+    }
+    obixUsage_setLimits(0, 0);
+
+    // unregistered device is not accounted anymore
+    Response* response = createTestResponse(TRUE, FALSE);
+    obix_server_handlePOST(response, "/obix/unregister/",
+                           "<uri val=\"/obix/quotaDevice/\"/>");
+    freeTestResponse(response);
+    obix = obixUsage_toObix("/obix-metrics/devices", 100);
+    if ((obix == NULL) || (strstr(obix, "quotaDevice") != NULL))
+    {
+        printf("Unregistered device is still accounted:\n%s\n", obix);
+        passed = FALSE;
+    }
+    free(obix);
+
+    printTestResult(testName, passed);
+    return passed ? 0 : 1;
+}
+
 int test_server(char* resFolder)
 {
     config_setResourceDir(resFolder);
 
     int result = 0;
 
-    if (xmldb_init())
+    if (xmldb_init(NULL))
     {
         printf("FAILED: Unable to start tests. database init failed.\n");
         return 1;
@@ -1293,6 +1984,45 @@ int test_server(char* resFolder)
 
     result += testSignUp();
 
+    result += testSignUpDevices("Sign up several devices at once");
+
+    result += testLocalAccess("Local access: listener of the parent object",
+                              "/obix/kitchen/1/2/3/",
+                              "/obix/kitchen/1/2/3/long");
+
+    result += testBatch("Batch: write twice and read",
+                        "/obix/kitchen/1/2/3/",
+                        "/obix/kitchen/1/2/3/long");
+
+    result += testUnregister("Unregister device");
+
+    result += testDeviceQuota("Memory limits of devices");
+
+    result += testConditionalRead("Conditional read of the parent object",
+                                  "/obix/kitchen/1/2/3/",
+                                  "/obix/kitchen/1/2/3/long");
+
+    result += testLimitedRead("Read with depth 0",
+                              "/obix/kitchen/1/", 0, 0, -1,
+                              "<ref", "<obj name=\"2\"");
+
+    result += testLimitedRead("Read with depth 1",
+                              "/obix/kitchen/1/", 1, 0, -1,
+                              "<obj name=\"2\"", "test-long");
+
+    result += testLimitedRead("Read list with limit 0",
+                              "/obix/devices/", -1, 0, 0,
+                              "<list", "<ref");
+
+    result += testLimitedRead("Read list with limit 1",
+                              "/obix/devices/", -1, 0, 1,
+                              "<ref", NULL);
+
+    result += testMetrics("Metrics of GET request", "/obix/kitchen/1/");
+    result += testObjectStats("Most used objects",
+                              "/obix/kitchen/1/", "/obix/kitchen/");
+    result += testObjectStatsReplace("Most used objects: replacement");
+
     result += testWatch();
 
     result += testResponse_setRightUri("obixResponse_setRightUri 1",